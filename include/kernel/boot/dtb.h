@@ -22,6 +22,8 @@ struct MemInfo {
 };
 
 extern struct MemInfo memInfo;
+// 设备树中的timebase-frequency，没有这个属性时为0
+extern uint32_t timebaseFreq;
 
 void parseDtb(uint64 dtbEntry);
 
@@ -0,0 +1,67 @@
+#ifndef _CLOCKEVENT_H_
+#define _CLOCKEVENT_H_
+
+#include <kernel/percpu.h>
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+
+/*
+ * 时钟事件层：每个hart只有一个SBI定时器，按需编程为最近的截止时刻。
+ *
+ * 截止时刻取周期tick（时间片记账）和所有已注册定时源中最早的一个；
+ * 就绪队列为空时停掉周期tick，hart在wfi中一直睡到真正有事可做。
+ * 所有时刻都以time CSR的计数表示。
+ */
+
+// 没有截止时刻，SBI定时器被设为永不触发
+#define CLOCKEVENT_NONE (~0ULL)
+
+/*
+ * 定时源，例如睡眠任务和软件定时器。
+ * next_deadline()返回最早的到期时刻，没有时返回CLOCKEVENT_NONE；
+ * expire()在中断上下文中处理所有now之前到期的事件。两者都只看本hart
+ * 的状态，各hart同时调用互不阻塞。定时源只注册、不注销。
+ */
+struct clock_event_source {
+	const char* name;
+	uint64 (*next_deadline)(void);
+	void (*expire)(uint64 now);
+};
+
+#define CLOCKEVENT_MAX_SOURCES 8
+
+// 每个hart的时钟事件状态
+struct clock_event_device {
+	uint64 next_event;   // 已编程的截止时刻
+	uint64 tick_next;    // 下一次周期tick的时刻
+	int32 tick_stopped;  // 空闲时周期tick已停
+	uint64 idle_start;   // 本次进入空闲的时刻
+	uint64 idle_time;    // 累计空闲时间
+	uint64 nr_events;    // 处理过的定时器中断数
+	int32 in_handler;    // 正在处理定时器中断，结束时会重新编程
+};
+
+DECLARE_PER_CPU(struct clock_event_device, clockevents);
+
+void clockevent_init(uint64 hartid);
+void clockevent_register_source(struct clock_event_source* src);
+
+/* 定时器中断入口：补记jiffies、tick记账、处理到期事件并重新编程 */
+void clockevent_handle_event(void);
+
+/*
+ * 定时源新增了更早的截止时刻后调用，必要时提前定时器。
+ * 在expire()回调里调用时什么也不做，由中断处理结束时统一编程。
+ */
+void clockevent_reprogram(void);
+
+/* 进出空闲：停止/恢复周期tick并记录空闲时间 */
+void tick_nohz_idle_enter(void);
+void tick_nohz_idle_exit(void);
+
+uint64 cpu_idle_time(int32 hartid);
+
+/* 第j个jiffy开始的时刻，按tick网格换算；已经过去时返回0 */
+uint64 jiffies_deadline(uint64 j);
+
+#endif
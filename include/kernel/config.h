@@ -1,12 +1,15 @@
 #ifndef _CONFIG_H_
 #define _CONFIG_H_
 
-// we use two HART (cpu) in challenge3
-#define NCPU 1
+// maximum number of harts brought up; harts with a higher id stay parked in SBI
+#define NCPU 4
 
 //interval of timer interrupt. added @lab1_3
 #define TIMER_INTERVAL 1000000
 
+// frequency of the time CSR; 10 MHz on the qemu virt machine
+#define TIMEBASE_FREQ 10000000
+
 // the maximum memory space that PKE is allowed to manage. added @lab2_1
 #define PKE_MAX_ALLOWABLE_RAM 128 * 1024 * 1024
 
@@ -19,6 +22,10 @@
 // virtual address of stack top of user process
 #define USER_STACK_TOP 0x80000000
 
+// end of the user part of every address space; everything above it is the
+// kernel mapping shared by all page tables
+#define TASK_SIZE USER_STACK_TOP
+
 // start virtual address (4MB) of our simple heap. added @lab2_2
 #define USER_FREE_ADDRESS_START 0x00000000 + PAGE_SIZE * 1024
 
@@ -27,4 +34,25 @@
 // the ending physical address that PKE observes. added @lab2_1
 #define PHYS_TOP (DRAM_BASE + PKE_MAX_ALLOWABLE_RAM)
 
+// lock debugging: track rwlock/mutex owners and panic on recursive locking or
+// on unlocking a lock the caller does not hold
+// #define CONFIG_DEBUG_LOCKS
+
+// run the spinlock contention benchmark on all harts at boot, before the
+// first process starts; see kernel/sched/lock_bench.c
+// #define CONFIG_LOCK_BENCH
+
+// per-lock-class contention statistics (acquisitions, wait and hold times),
+// read through the SYS_lock_stat debug syscall; see include/kernel/util/lock_stat.h
+// #define CONFIG_LOCK_STAT
+
+// measure the cost of a blocking context switch with two kernel threads
+// ping-ponging on one hart; see kernel/sched/switch_bench.c
+// #define CONFIG_SWITCH_BENCH
+
+// send every return from a syscall through switch_to() and the full register
+// restore instead of the fast path; for before/after measurements with
+// user/syscall_bench, see prepare_syscall_return() in kernel/sched/sched.c
+// #define CONFIG_NO_FAST_SYSCALL_RETURN
+
 #endif
@@ -5,6 +5,7 @@
 #include <kernel/util/spinlock.h>
 #include <kernel/types.h>
 #include <kernel/util/atomic.h>
+#include <kernel/sched/wait.h>
 
 /* Buffer states (b_state) */
 enum {
@@ -35,7 +36,8 @@ struct buffer_head {
     char               *b_data;        /* Pointer to data block */
     
     struct list_head    b_lru;         /* LRU list entry */
-    spinlock_t          b_lock;        /* Buffer lock */
+    spinlock_t          b_lock;        /* Protects BH_Lock */
+    wait_queue_head_t   b_wait;        /* Tasks waiting for BH_Lock to clear */
     
     /* 以下成员是可选的，如果需要，可以稍后实现 */
     
@@ -56,6 +56,15 @@ typedef struct __attribute__((packed)) {
 #define ELF_MAGIC 0x464C457FU  // "\x7FELF" in little endian
 #define ELF_PROG_LOAD 1
 
+// 初始用户栈上辅助向量的类型，数值与Linux相同
+#define AT_NULL 0
+#define AT_PHDR 3
+#define AT_PHENT 4
+#define AT_PHNUM 5
+#define AT_PAGESZ 6
+#define AT_ENTRY 9
+#define AT_SYSINFO_EHDR 33 // vDSO的ELF头
+
 typedef enum elf_status_t {
   EL_OK = 0,
   EL_EIO,
@@ -30,6 +30,7 @@
 
 #include <kernel/vfs.h>
 #include <kernel/types.h>
+#include <kernel/sched/mutex.h>
 /*helper functions*/
 void ext4_timestamp_to_timespec64(uint32_t timestamp, struct timespec* ts);
 
@@ -37,10 +38,10 @@ uint32_t timespec64_to_ext4_timestamp(struct timespec* ts);
 void make_fsid_from_uuid(const uint8_t uuid[16], fsid_t *fsid);
 
 
-/*global ext4 superblock lock*/
-extern spinlock_t ext4_spinlock;
-static inline void ext4_lock(void) { spinlock_lock(&ext4_spinlock); }
-static inline void ext4_unlock(void) { spinlock_unlock(&ext4_spinlock); }
+/*global ext4 superblock lock, held across disk I/O so it sleeps instead of spinning*/
+extern struct mutex ext4_mutex;
+static inline void ext4_lock(void) { mutex_lock(&ext4_mutex); }
+static inline void ext4_unlock(void) { mutex_unlock(&ext4_mutex); }
 
 int32 ext4_sync_inode(struct ext4_inode_ref* inode_ref);
 int32 ext4_fs_sync(struct ext4_fs* fs);
@@ -55,6 +56,7 @@ void ext4_blockdev_free_adapter(struct ext4_blockdev* e_blockdevice);
 /* Forward declarations for file and dir operations */
 extern const struct file_operations ext4_file_operations;
 extern const struct file_operations ext4_dir_operations;
+extern const struct addrSpace_ops ext4_file_aops;
 
 // int32 ext4_fs_flush_journal(struct ext4_fs *fs);
 
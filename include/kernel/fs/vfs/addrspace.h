@@ -2,6 +2,7 @@
 #define _ADDRESS_SPACE_H
 
 
+#include <kernel/util/list.h>
 #include <kernel/util/radix_tree.h>
 #include <kernel/util/spinlock.h>
 #include <kernel/types.h>
@@ -11,11 +12,13 @@ struct inode;
 struct writeback_control;
 /* Memory management */
 struct addrSpace {
-	// struct inode *host;               /* Owning inode */
+	struct inode *host;                 /* Owning inode */
 	struct radixTreeRoot page_tree;             /* Page cache radix tree */
 	spinlock_t tree_lock;                         /* Lock for tree manipulation */
 	uint64 nrpages;                        /* Number of total pages */
 	const struct addrSpace_ops* a_ops; /* s_operations */
+	struct list_head i_mmap;            /* Shared VMAs mapping this file */
+	spinlock_t i_mmap_lock;             /* Protects i_mmap */
 };
 
 
@@ -43,6 +46,7 @@ uint32 addrSpace_getDirtyPages(struct addrSpace* mapping, struct page** pages, u
 int32 addrSpace_removeDirtyTag(struct addrSpace *mapping, struct page *page);
 int32 addrSpace_writeBack(struct addrSpace *mapping);
 int32 addrSpace_writeback_range(struct addrSpace *mapping, loff_t start, loff_t end, int32 sync_mode);
+int32 __addrSpace_writeback(struct addrSpace *mapping, struct writeback_control *wbc);
 int32 addrSpace_invalidate(struct addrSpace *mapping, struct page *page);
 
 struct page* addrSpace_readPage(struct addrSpace* mapping, uint64 index);
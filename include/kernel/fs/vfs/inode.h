@@ -4,6 +4,7 @@
 #include "forward_declarations.h"
 #include <kernel/mm/vma.h>
 #include <kernel/util.h>
+#include <kernel/sched/rwsem.h>
 
 extern struct hashtable inode_hashtable;
 
@@ -104,6 +105,7 @@ struct inode {
 	/* Reference counting and locking */
 	atomic_t i_refcount;  /* Reference count */
 	spinlock_t i_lock; /* Protects changes to inode */
+	struct rw_semaphore i_rwsem; /* Held across I/O: shared by readers, exclusive for writers */
 
 	/* State tracking */
 	uint64 i_state; /* Inode state flags */
@@ -194,6 +196,12 @@ struct inode* inode_acquire(struct superblock* sb, uint64 ino);
 struct inode* inode_ref(struct inode* inode);
 void inode_unref(struct inode* inode);
 
+/* i_rwsem: writers of a file exclude each other and its readers */
+static inline void inode_lock(struct inode* inode) { down_write(&inode->i_rwsem); }
+static inline void inode_unlock(struct inode* inode) { up_write(&inode->i_rwsem); }
+static inline void inode_lock_shared(struct inode* inode) { down_read(&inode->i_rwsem); }
+static inline void inode_unlock_shared(struct inode* inode) { up_read(&inode->i_rwsem); }
+
 
 
 /* Inode lookup and creation */
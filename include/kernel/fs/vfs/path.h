@@ -23,6 +23,24 @@ int32 filename_lookup(int32 dfd, const char* name, uint32 flags, struct path* pa
 struct vfsmount* path_lookupMount(struct path* path);
 int32 resolve_path_parent(const char* path_str, struct path* out_parent);
 
+/*
+ * 从用户空间拷入的路径名。缓冲区来自专用的names cache（每个PATH_MAX大小），
+ * 短路径直接放在结构体后面，只拷贝到结束符为止。
+ */
+struct filename {
+	const char* name;         /* 内核中的路径字符串 */
+	const char __user* uptr;  /* 原始用户指针 */
+	int32 separate;           /* name不在本结构所在的缓冲区里 */
+	char iname[];             /* 短路径内嵌于此 */
+};
+
+struct filename* getname(const char __user* filename);
+void putname(struct filename* name);
+
+/* names cache：PATH_MAX大小的路径缓冲区 */
+char* __getname(void);
+void __putname(char* name);
+
 /* Lookup flags */
 #define LOOKUP_FOLLOW 0x0001    /* Follow terminal symlinks */
 #define LOOKUP_DIRECTORY 0x0002 /* Want only directories */
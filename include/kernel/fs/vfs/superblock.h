@@ -6,6 +6,7 @@
 #include <kernel/types.h>
 #include <kernel/util/list.h>
 #include <kernel/util/spinlock.h>
+#include <kernel/sched/rwsem.h>
 
 struct fstype;
 struct superblock_operations;
@@ -13,6 +14,7 @@ struct dentry;
 struct block_device;
 struct seq_file;
 struct writeback_control;
+struct file;
 
 /* Superblock structure representing a mounted filesystem */
 struct superblock {
@@ -48,6 +50,7 @@ struct superblock {
 
 	/*********************** vfs variables ******************************/
 	spinlock_t s_lock; // Lock protecting the superblock
+	struct rw_semaphore s_umount; // Shared while syncing, exclusive while shutting down
 	atomic_t s_refcount; // Reference count: mount point count + open file count
 	atomic_t s_ninodes;          // Number of inodes
 	atomic64_t s_next_ino; // Next inode number to allocate
@@ -188,6 +191,9 @@ struct writeback_control {
     
     /* Reason for writeback */
     enum wb_reason reason;        /* Why writeback was triggered */
+
+    /* Open file handed to ->writepage, NULL if not known */
+    struct file *file;
 };
 
 /* Core writeback functions */
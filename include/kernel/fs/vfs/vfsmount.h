@@ -3,6 +3,7 @@
 
 #include "forward_declarations.h"
 #include <kernel/util.h>
+#include <kernel/util/rwlock.h>
 
 /**
  * Mount point structure
@@ -55,7 +56,7 @@ int32 iterate_mounts(int32 (*f)(struct vfsmount*, void*), void* arg, struct vfsm
 
 
 extern struct list_head mount_list;
-extern spinlock_t mount_lock;
+extern rwlock_t mount_lock;
 extern struct hashtable mount_hashtable;
 
 #endif
\ No newline at end of file
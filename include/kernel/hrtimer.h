@@ -0,0 +1,54 @@
+#ifndef _HRTIMER_H_
+#define _HRTIMER_H_
+
+#include <kernel/types.h>
+#include <kernel/util/rbtree.h>
+
+/*
+ * 高精度定时器：到期时刻以time CSR的计数表示，挂在每个hart按到期时刻
+ * 排序的红黑树上，最早的一个有缓存。SBI定时器直接编程到最早的到期时刻，
+ * 不受tick粒度限制。用于睡眠、itimer这类要求准时的超时；只要粗略超时
+ * 的用timer_list。
+ *
+ * 回调在定时器中断里、放开树的锁后运行，不能睡眠。返回HRTIMER_RESTART
+ * 时按回调里改好的到期时刻（通常用hrtimer_forward()）重新排上。
+ */
+
+struct hrtimer_cpu_base;
+
+enum hrtimer_restart {
+	HRTIMER_NORESTART,
+	HRTIMER_RESTART,
+};
+
+enum hrtimer_mode {
+	HRTIMER_MODE_ABS, // 绝对时刻
+	HRTIMER_MODE_REL, // 相对现在
+};
+
+#define HRTIMER_STATE_INACTIVE 0x0
+#define HRTIMER_STATE_ENQUEUED 0x1
+
+struct hrtimer {
+	struct rb_node node;
+	uint64 expires; // 到期时刻，time CSR的计数
+	enum hrtimer_restart (*function)(struct hrtimer* timer);
+	struct hrtimer_cpu_base* base; // 所在hart的树
+	uint32 state;
+};
+
+void hrtimer_init(struct hrtimer* timer, enum hrtimer_restart (*function)(struct hrtimer*));
+void hrtimer_start(struct hrtimer* timer, uint64 tim, enum hrtimer_mode mode);
+int32 hrtimer_try_to_cancel(struct hrtimer* timer);
+int32 hrtimer_cancel(struct hrtimer* timer);
+uint64 hrtimer_forward(struct hrtimer* timer, uint64 now, uint64 interval);
+uint64 hrtimer_get_remaining(struct hrtimer* timer);
+int32 hrtimer_active(struct hrtimer* timer);
+
+static inline int32 hrtimer_is_queued(struct hrtimer* timer) {
+	return timer->state & HRTIMER_STATE_ENQUEUED;
+}
+
+void hrtimers_init(void);
+
+#endif
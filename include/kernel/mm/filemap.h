@@ -0,0 +1,67 @@
+/**
+ * @file filemap.h
+ * @brief Page cache backed file mappings
+ *
+ * Generic fault handling for file VMAs: faults are served straight from the
+ * inode's addrSpace, and neighbouring cached pages are mapped in the same
+ * fault (fault-around) to cut the number of traps.
+ */
+
+#ifndef _FILEMAP_H
+#define _FILEMAP_H
+
+#include <kernel/types.h>
+
+struct file;
+struct page;
+struct addrSpace;
+struct vm_area_struct;
+struct vm_fault;
+
+/* 一次缺页最多顺带映射的页数，窗口按此大小对齐 */
+#define FAULT_AROUND_PAGES 16
+
+/**
+ * @brief 从页缓存获取文件页，不在缓存或未读入时调用readpage
+ *
+ * @param file 用于readpage的打开文件
+ * @param index 文件内的页索引
+ * @return struct page* 带一个引用的页，失败返回ERR_PTR
+ */
+struct page *filemap_get_page(struct file *file, uint64 index);
+
+/**
+ * @brief 文件映射的通用缺页处理，可直接作为inode_operations.page_fault
+ *
+ * @param vma 虚拟内存区域结构
+ * @param vmf 页面故障信息
+ * @return vm_fault_t 故障处理结果
+ */
+vm_fault_t filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf);
+
+/**
+ * @brief 共享映射的干净页首次被写：打脏标记并放开写权限
+ *
+ * @param vma 虚拟内存区域结构
+ * @param vmf 页面故障信息
+ * @param page 当前只读映射的页缓存页
+ * @return vm_fault_t 故障处理结果
+ */
+vm_fault_t filemap_page_mkwrite(struct vm_area_struct *vma, struct vm_fault *vmf, struct page *page);
+
+/* 共享文件映射挂到addrSpace->i_mmap上，回写时据此写保护 */
+void filemap_link_vma(struct vm_area_struct *vma);
+void filemap_unlink_vma(struct vm_area_struct *vma);
+
+/**
+ * @brief 写回文件[start, end)范围内被标记为脏的页缓存页，供msync/fsync使用
+ *
+ * @param file 打开的文件，传给writepage
+ * @param start 起始字节偏移
+ * @param end 结束字节偏移（不含）
+ * @param sync_mode WB_SYNC_ALL或WB_SYNC_NONE
+ * @return int32 成功返回0，失败返回错误码
+ */
+int32 filemap_write_range(struct file *file, loff_t start, loff_t end, int32 sync_mode);
+
+#endif /* _FILEMAP_H */
@@ -7,6 +7,7 @@
 #include <kernel/mm/vma.h>
 #include <kernel/riscv.h>
 #include <kernel/sched/process.h>
+#include <kernel/sched/rwsem.h>
 #include <kernel/types.h>
 #include <kernel/util/list.h>
 #include <kernel/util/spinlock.h>
@@ -42,6 +43,7 @@ struct mm_struct {
 
   // 锁和引用计数
   spinlock_t mm_lock; // mm锁
+  struct rw_semaphore mmap_lock; // 保护VMA链表：缺页持读锁，mmap等修改布局的操作持写锁
   atomic_t mm_users;  // 用户数量
   atomic_t mm_count;  // 引用计数
 };
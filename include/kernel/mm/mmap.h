@@ -19,6 +19,11 @@
 #define MAP_LOCKED 0x2000     /* 锁定页面 */
 #define MAP_POPULATE 0x8000   /* 预先填充页表 */
 
+/* msync函数的标志位 */
+#define MS_ASYNC 1      /* 异步回写 */
+#define MS_INVALIDATE 2 /* 使其他映射失效 */
+#define MS_SYNC 4       /* 同步回写 */
+
 /* PROT_* 定义 */
 #define PROT_NONE 0x0  /* 页不可访问 */
 #define PROT_READ 0x1  /* 页可读 */
@@ -30,7 +35,9 @@ struct file;
 int32 do_unmap(struct mm_struct *mm, uint64 start, size_t len);
 uint64 do_brk(struct mm_struct *mm, uint64 new_brk);
 int32 do_protect(struct mm_struct *mm, __page_aligned uint64 start, size_t len, int32 prot);
+int32 do_msync(struct mm_struct *mm, __page_aligned uint64 start, size_t len, int32 flags);
 uint64 find_free_area(struct mm_struct *mm, size_t length);
+uint64 vm_flags_to_type(uint64 vm_flags);
 
 
 
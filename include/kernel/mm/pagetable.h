@@ -72,6 +72,15 @@ void pagetable_server_init(void);
 pagetable_t create_pagetable(void);
 void free_pagetable(pagetable_t pagetable);
 
+/**
+ * @brief 让用户页表共享内核页表中TASK_SIZE以上的根页表项
+ *
+ * 这样内核在用户页表下也能正常运行，uaccess可以直接访问用户地址。
+ *
+ * @param pagetable 新建的用户根页表
+ */
+void pagetable_share_kernel(pagetable_t pagetable);
+
 int32 pgt_map_page(pagetable_t pagetable, vaddr_t va, paddr_t pa, int32 perm);
 int32 pgt_map_pages(pagetable_t pagetable, vaddr_t va, paddr_t pa, uint64 size,  int32 perm);
 
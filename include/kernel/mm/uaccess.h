@@ -9,30 +9,163 @@ char *user_to_kernel_str(const char *user_ptr);
 uint64 copy_from_user(void *to, const void __user *from, uint64 n);
 uint64 copy_to_user(void __user *to, const void *from, uint64 n);
 int64 strlen_user(const char __user *str);
+int64 strnlen_user(const char __user *str, int64 n);
 int64 strncpy_from_user(char *dst, const char __user *src, int64 count);
 uint64 clear_user(void __user *to, uint64 n);
 int32 access_ok(const void __user *addr, uint64 size);
 
-// 更简单的单值访问宏
-#define get_user(x, ptr) ({ \
-    uint64 __ret; \
-    __ret = copy_from_user(&(x), (ptr), sizeof(*(ptr))); \
-    __ret ? -EFAULT : 0; \
-})
+/*
+ * 持有自旋锁或关着中断时访问用户内存，用pagefault_disable()包起来：
+ * 期间的缺页不进do_page_fault()（它要拿mmap_lock，可能睡眠），直接
+ * 走异常表，copy_from_user()等返回未完成的字节数。调用者放开锁以后
+ * 正常访问一次把页换进来，再重试。
+ */
+static inline void pagefault_disable(void) {
+    current->pagefault_disabled++;
+    __sync_synchronize();
+}
 
-#define put_user(x, ptr) ({ \
-    uint64 __ret; \
-    __ret = mm_copy_to_user((ptr), &(x), sizeof(*(ptr))); \
-    __ret ? -EFAULT : 0; \
-})
+static inline void pagefault_enable(void) {
+    __sync_synchronize();
+    current->pagefault_disabled--;
+}
 
+static inline int32 pagefault_disabled(void) { return current->pagefault_disabled != 0; }
 
+/*
+ * 异常表：记录可能因访问用户地址而缺页的指令及其修复地址。
+ * 由链接脚本收集到__start___ex_table/__stop___ex_table之间。
+ */
+struct exception_table_entry {
+    uint64 insn;  // 可能出错的指令地址
+    uint64 fixup; // 出错后继续执行的地址
+};
 
+struct trapframe;
+/**
+ * @brief 在异常表中查找tf->epc，找到则把tf->epc改为修复地址
+ *
+ * @return int32 找到返回1，否则返回0
+ */
+int32 fixup_exception(struct trapframe *tf);
 
+#define _ASM_EXTABLE(from, to)                                                 \
+    "	.pushsection __ex_table, \"a\"\n"                                      \
+    "	.balign 8\n"                                                           \
+    "	.dword " #from ", " #to "\n"                                           \
+    "	.popsection\n"
 
+/* arch/riscv/uaccess.S，返回未完成的字节数；必须在user_access_begin()之后调用 */
+uint64 __asm_copy_to_user(void __user *to, const void *from, uint64 n);
+uint64 __asm_copy_from_user(void *to, const void __user *from, uint64 n);
+uint64 __asm_clear_user(void __user *to, uint64 n);
 
+/**
+ * user_access_begin - 打开直接访问用户内存的窗口
+ *
+ * 置位sstatus.SUM；如果当前还运行在别的页表上，切到当前进程的页表。
+ * 返回值交给user_access_end()恢复。窗口内的缺页可能在do_page_fault()里
+ * 睡眠，SUM由schedule()跟着任务保存和恢复。
+ */
+static inline uint64 user_access_begin(void) {
+    uint64 old_satp = read_csr(satp);
+    uint64 satp = MAKE_SATP(current->mm->pagetable);
 
+    if (old_satp != satp) {
+        write_csr(satp, satp);
+        flush_tlb();
+    }
+    set_csr(sstatus, SSTATUS_SUM);
+    return old_satp;
+}
 
+static inline void user_access_end(uint64 old_satp) {
+    clear_csr(sstatus, SSTATUS_SUM);
+    if (old_satp != read_csr(satp)) {
+        write_csr(satp, old_satp);
+        flush_tlb();
+    }
+}
 
+/*
+ * 单个标量的访问，出错时err被置为-EFAULT、读出的值为0。
+ * 双下划线版本不检查地址，也不打开访问窗口，供已经处于窗口内的循环使用。
+ */
+#define __get_user_asm(insn, x, ptr, err)                                      \
+    asm volatile("1:	" insn " %1, %2\n"                                      \
+                 "2:\n"                                                        \
+                 "	.pushsection .text.fixup, \"ax\"\n"                         \
+                 "3:	li %0, %3\n"                                            \
+                 "	li %1, 0\n"                                                 \
+                 "	j 2b\n"                                                     \
+                 "	.popsection\n" _ASM_EXTABLE(1b, 3b)                         \
+                 : "+r"(err), "=&r"(x)                                         \
+                 : "m"(*(ptr)), "i"(-EFAULT))
 
-#endif /* _UACCESS_H */
\ No newline at end of file
+#define __put_user_asm(insn, x, ptr, err)                                      \
+    asm volatile("1:	" insn " %z2, %1\n"                                     \
+                 "2:\n"                                                        \
+                 "	.pushsection .text.fixup, \"ax\"\n"                         \
+                 "3:	li %0, %3\n"                                            \
+                 "	j 2b\n"                                                     \
+                 "	.popsection\n" _ASM_EXTABLE(1b, 3b)                         \
+                 : "+r"(err), "=m"(*(ptr))                                     \
+                 : "rJ"(x), "i"(-EFAULT))
+
+#define __get_user(x, ptr)                                                     \
+    ({                                                                         \
+        int64 __gu_err = 0;                                                    \
+        uint64 __gu_val;                                                       \
+        switch (sizeof(*(ptr))) {                                              \
+        case 1: __get_user_asm("lbu", __gu_val, (ptr), __gu_err); break;       \
+        case 2: __get_user_asm("lhu", __gu_val, (ptr), __gu_err); break;       \
+        case 4: __get_user_asm("lwu", __gu_val, (ptr), __gu_err); break;       \
+        case 8: __get_user_asm("ld", __gu_val, (ptr), __gu_err); break;        \
+        default: __gu_val = 0; __gu_err = -EFAULT; break;                      \
+        }                                                                      \
+        (x) = (__typeof__(*(ptr)))__gu_val;                                    \
+        __gu_err;                                                              \
+    })
+
+#define __put_user(x, ptr)                                                     \
+    ({                                                                         \
+        int64 __pu_err = 0;                                                    \
+        __typeof__(*(ptr)) __pu_val = (x);                                     \
+        switch (sizeof(*(ptr))) {                                              \
+        case 1: __put_user_asm("sb", __pu_val, (ptr), __pu_err); break;        \
+        case 2: __put_user_asm("sh", __pu_val, (ptr), __pu_err); break;        \
+        case 4: __put_user_asm("sw", __pu_val, (ptr), __pu_err); break;        \
+        case 8: __put_user_asm("sd", __pu_val, (ptr), __pu_err); break;        \
+        default: __pu_err = -EFAULT; break;                                    \
+        }                                                                      \
+        __pu_err;                                                              \
+    })
+
+// 单值访问：检查地址、打开访问窗口，成功返回0，失败返回-EFAULT
+#define get_user(x, ptr)                                                       \
+    ({                                                                         \
+        __typeof__(ptr) __gu_p = (ptr);                                        \
+        int64 __gu_ret = -EFAULT;                                              \
+        if (current && current->mm && access_ok(__gu_p, sizeof(*__gu_p))) {    \
+            uint64 __gu_satp = user_access_begin();                            \
+            __gu_ret = __get_user((x), __gu_p);                                \
+            user_access_end(__gu_satp);                                        \
+        } else {                                                               \
+            (x) = (__typeof__(*(ptr)))0;                                       \
+        }                                                                      \
+        __gu_ret;                                                              \
+    })
+
+#define put_user(x, ptr)                                                       \
+    ({                                                                         \
+        __typeof__(ptr) __pu_p = (ptr);                                        \
+        int64 __pu_ret = -EFAULT;                                              \
+        if (current && current->mm && access_ok(__pu_p, sizeof(*__pu_p))) {    \
+            uint64 __pu_satp = user_access_begin();                            \
+            __pu_ret = __put_user((x), __pu_p);                                \
+            user_access_end(__pu_satp);                                        \
+        }                                                                      \
+        __pu_ret;                                                              \
+    })
+
+#endif /* _UACCESS_H */
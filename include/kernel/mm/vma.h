@@ -71,13 +71,17 @@ struct vm_area_struct {
   // 文件映射相关字段
   struct file *vm_file; // 映射的文件（如果是文件映射）
   uint64 vm_pgoff;       // 文件页偏移
+  struct list_head vm_shared; // 共享文件映射挂在addrSpace->i_mmap上
 
-  // 页数据
-  struct page **pages; // 区域包含的页数组
-  int32 page_count;      // 页数量
+  // 已映射的页只记录在页表中：每个有效的PTE持有对应页的一个引用
   spinlock_t vma_lock; // VMA锁
 };
 
+/* VMA覆盖的虚拟页数（不代表已分配的物理页数） */
+static inline uint64 vma_pages(const struct vm_area_struct *vma) {
+  return (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
+}
+
 
 /**
  * 虚拟内存故障信息结构
@@ -116,6 +120,33 @@ struct vm_area_struct *vm_area_setup(struct mm_struct *mm, uint64 addr,
 
 void free_vma(struct vm_area_struct *vma);
 
+/**
+ * @brief 在addr处把VMA一分为二，原VMA保留低半部分
+ *
+ * @param vma 被拆分的虚拟内存区域
+ * @param addr 拆分点，必须页对齐且位于VMA内部
+ * @return struct vm_area_struct* 新的高半部分VMA，失败返回NULL
+ */
+struct vm_area_struct *vma_split(struct vm_area_struct *vma, uint64 addr);
+
+/**
+ * @brief 解除VMA中[start, end)的映射并释放各PTE持有的页引用
+ *
+ * @param vma 虚拟内存区域结构
+ * @param start 起始地址（页对齐）
+ * @param end 结束地址（不含）
+ */
+void vm_zap_range(struct vm_area_struct *vma, uint64 start, uint64 end);
+
+/**
+ * @brief 查找addr处当前映射的页
+ *
+ * @param vma 虚拟内存区域结构
+ * @param addr 虚拟地址
+ * @return struct page* 已映射的页，未映射返回NULL（不增加引用）
+ */
+struct page *vm_lookup_page(struct vm_area_struct *vma, uint64 addr);
+
 int32 populate_vma(struct vm_area_struct *vma, uint64 addr, size_t length,
                  int32 prot);
 
@@ -138,4 +169,14 @@ vm_fault_t handle_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf);
  */
 int32 vm_insert_page(struct vm_area_struct *vma, uint64 addr, struct page *page);
 
+/**
+ * @brief 为写时复制的页建立私有可写副本
+ * 
+ * @param vma 虚拟内存区域结构
+ * @param addr 虚拟地址
+ * @param src 被复制的源页面（页缓存页或共享的匿名页）
+ * @return int32 成功返回0，失败返回错误码
+ */
+int32 vm_cow_page(struct vm_area_struct *vma, uint64 addr, struct page *src);
+
 #endif
\ No newline at end of file
@@ -2,4 +2,5 @@
 #include <kernel/mm/kmalloc.h>
 #include <kernel/mm/mm_struct.h>
 #include <kernel/mm/uaccess.h>
-#include <kernel/mm/slab.h>
\ No newline at end of file
+#include <kernel/mm/slab.h>
+#include <kernel/mm/filemap.h>
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include <kernel/riscv.h>
+#include <kernel/types.h>
+
+/*
+ * 每个hart一份的变量，见kernel/percpu.c。
+ *
+ * DEFINE_PER_CPU定义的变量都放进.data..percpu节，链接出来的这一份只是
+ * 模板。启动时setup_per_cpu_areas()给每个hart复制一份，各份按cacheline
+ * 对齐，互相之间不会伪共享；__per_cpu_offset[cpu]是第cpu份相对模板的
+ * 偏移。hart号一直在tp里，取本hart的那份是一次查表加一次加法。
+ *
+ * 内核不可抢占，拿到this_cpu_ptr()以后只要不睡眠就一直在这个hart上；
+ * 中断处理里也会改的变量，读改写要关中断。
+ */
+
+#define L1_CACHE_BYTES 64
+#define SMP_CACHE_BYTES L1_CACHE_BYTES
+#define ____cacheline_aligned __attribute__((__aligned__(SMP_CACHE_BYTES)))
+
+#define __percpu
+#define __PER_CPU_SECTION ".data..percpu"
+
+#define DEFINE_PER_CPU(type, name) __attribute__((section(__PER_CPU_SECTION))) __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) extern __attribute__((section(__PER_CPU_SECTION))) __typeof__(type) name
+
+// 模板的位置，由链接脚本给出
+extern char __per_cpu_start[], __per_cpu_end[];
+extern uint64 __per_cpu_offset[NCPU];
+
+#define per_cpu_offset(cpu) (__per_cpu_offset[(cpu)])
+#define per_cpu_ptr(ptr, cpu) ((__typeof__(ptr))((uint64)(ptr) + per_cpu_offset(cpu)))
+#define per_cpu(var, cpu) (*per_cpu_ptr(&(var), cpu))
+
+#define this_cpu_ptr(ptr) per_cpu_ptr(ptr, read_tp())
+#define this_cpu_read(var) (*this_cpu_ptr(&(var)))
+#define this_cpu_write(var, val) (*this_cpu_ptr(&(var)) = (val))
+
+#define for_each_possible_cpu(cpu) for (int32 cpu = 0; cpu < NCPU; cpu++)
+
+// 每份后面留给alloc_percpu()的空间
+#define PERCPU_DYNAMIC_SIZE 4096
+
+void* __alloc_percpu(size_t size, size_t align);
+void free_percpu(void __percpu* ptr);
+#define alloc_percpu(type) ((__typeof__(type) __percpu*)__alloc_percpu(sizeof(type), __alignof__(type)))
+
+void setup_per_cpu_areas(void);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _PERCPU_COUNTER_H_
+#define _PERCPU_COUNTER_H_
+
+#include <kernel/percpu.h>
+#include <kernel/types.h>
+#include <kernel/util/atomic.h>
+
+/*
+ * 分散到每个hart上的计数器，见kernel/percpu_counter.c。
+ *
+ * 加减只改本hart的那份，攒到batch才原子地并进count，多个hart频繁更新
+ * 同一个计数也不会抢同一条cacheline。不用锁：percpu_counter_read()只读
+ * count，误差不超过NCPU * batch；percpu_counter_sum()把各份加起来，
+ * 和并行的加减同时进行时也可能差一个batch。
+ */
+
+struct percpu_counter {
+	atomic64_t count;
+	int32 __percpu* counters;
+};
+
+extern int32 percpu_counter_batch;
+
+int32 percpu_counter_init(struct percpu_counter* fbc, int64 amount);
+void percpu_counter_destroy(struct percpu_counter* fbc);
+void percpu_counter_add_batch(struct percpu_counter* fbc, int64 amount, int32 batch);
+int64 percpu_counter_sum(struct percpu_counter* fbc);
+int32 __percpu_counter_compare(struct percpu_counter* fbc, int64 rhs, int32 batch);
+
+static inline void percpu_counter_add(struct percpu_counter* fbc, int64 amount) {
+	percpu_counter_add_batch(fbc, amount, percpu_counter_batch);
+}
+
+static inline void percpu_counter_sub(struct percpu_counter* fbc, int64 amount) {
+	percpu_counter_add(fbc, -amount);
+}
+
+static inline void percpu_counter_inc(struct percpu_counter* fbc) {
+	percpu_counter_add(fbc, 1);
+}
+
+static inline void percpu_counter_dec(struct percpu_counter* fbc) {
+	percpu_counter_add(fbc, -1);
+}
+
+// 快但不准，误差见上
+static inline int64 percpu_counter_read(struct percpu_counter* fbc) {
+	return atomic64_read(&fbc->count);
+}
+
+// 计数本身不会小于0时用，各份还没并进来时count可能暂时是负的
+static inline int64 percpu_counter_read_positive(struct percpu_counter* fbc) {
+	int64 ret = atomic64_read(&fbc->count);
+	return ret >= 0 ? ret : 0;
+}
+
+static inline int32 percpu_counter_compare(struct percpu_counter* fbc, int64 rhs) {
+	return __percpu_counter_compare(fbc, rhs, percpu_counter_batch);
+}
+
+#endif
@@ -56,10 +56,18 @@
 // irqs (interrupts). added @lab1_3
 #define CAUSE_MTIMER 0x8000000000000007
 #define CAUSE_MTIMER_S_TRAP 0x8000000000000001
+// s-mode timer interrupt, raised by the timer armed through SBI
+#define CAUSE_STIMER_S_TRAP 0x8000000000000005
+// s-mode software interrupt; the timer is no longer forwarded through it
+// from M-mode, so it only carries inter-processor interrupts now
+#define CAUSE_SSOFT_S_TRAP 0x8000000000000001
 
 //Supervisor interrupt-pending register
 #define SIP_SSIP (1L << 1)
 
+// scounteren: allow U-mode to read the time CSR
+#define SCOUNTEREN_TM (1L << 1)
+
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8 * (hartid))
@@ -73,6 +81,11 @@
 #define SSTATUS_UIE (1L << 0)   // User Interrupt Enable
 #define SSTATUS_SUM 0x00040000
 #define SSTATUS_FS 0x00006000
+// sstatus.FS的四种状态：Off时浮点指令是非法指令，Dirty表示寄存器被改过
+#define SSTATUS_FS_OFF 0x00000000
+#define SSTATUS_FS_INITIAL 0x00002000
+#define SSTATUS_FS_CLEAN 0x00004000
+#define SSTATUS_FS_DIRTY 0x00006000
 
 // Supervisor Interrupt Enable
 #define SIE_SEIE (1L << 9)  // external
@@ -124,6 +137,13 @@ static inline int32 supports_extension(char ext) {
     __tmp;                                                            \
   })
 
+#define clear_csr(reg, bit)                                           \
+  ({                                                                  \
+    uint64 __tmp;                                              \
+    asm volatile("csrrc %0, " #reg ", %1" : "=r"(__tmp) : "rK"(bit)); \
+    __tmp;                                                            \
+  })
+
 // enable device interrupts
 static inline void intr_on(void) { write_csr(sstatus, read_csr(sstatus) | SSTATUS_SIE); }
 
@@ -154,6 +174,13 @@ static inline uint64 read_tp(void) {
 // write tp, the thread pointer, holding hartid (core number), the index into cpus[].
 static inline void write_tp(uint64 x) { asm volatile("mv tp, %0" : : "r"(x)); }
 
+// read the time CSR, the platform timer counting since boot.
+static inline uint64 read_time(void) {
+  uint64 x;
+  asm volatile("rdtime %0" : "=r"(x));
+  return x;
+}
+
 typedef struct riscv_regs_t {
   /*  0  */ uint64 ra;
   /*  8  */ uint64 sp;
@@ -190,6 +217,8 @@ typedef struct riscv_regs_t {
 
 // following lines are added @lab2_1
 static inline void flush_tlb(void) { asm volatile("sfence.vma zero, zero"); }
+// 只刷一个虚拟地址的表项，包括以前缓存的无效项
+static inline void flush_tlb_page(uint64 va) { asm volatile("sfence.vma %0, zero" : : "r"(va) : "memory"); }
 #define PAGE_SIZE 4096  // bytes per page
 /* 
  * Mark parameters that must be page-aligned.
@@ -3,4 +3,12 @@
 
 #include <kernel/sched/signal.h>
 #include <kernel/sched/pid.h>
-#include <kernel/sched/process.h>
\ No newline at end of file
+#include <kernel/sched/process.h>
+#include <kernel/sched/wait.h>
+#include <kernel/sched/completion.h>
+#include <kernel/sched/mutex.h>
+#include <kernel/sched/rwsem.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sched/workqueue.h>
+#include <kernel/sched/fpu.h>
+#include <kernel/sched/futex.h>
@@ -0,0 +1,39 @@
+#ifndef _COMPLETION_H_
+#define _COMPLETION_H_
+
+#include <kernel/sched/wait.h>
+
+/*
+ * 完成量：一方等某件事做完，另一方做完后complete()。
+ * done记录还没被等待者消耗的complete()次数，所以complete()先于
+ * wait_for_completion()发生也不会丢。complete_all()之后所有等待者
+ * 都直接通过，直到reinit_completion()。
+ */
+struct completion {
+	uint32 done;
+	wait_queue_head_t wait;
+};
+
+#define COMPLETION_INITIALIZER(work) { 0, __WAIT_QUEUE_HEAD_INITIALIZER((work).wait) }
+#define DECLARE_COMPLETION(work) struct completion work = COMPLETION_INITIALIZER(work)
+
+// complete_all()把done设成这个值，之后的等待都不再消耗它
+#define COMPLETION_DONE_ALL ((uint32)~0U)
+
+static inline void init_completion(struct completion* x) {
+	x->done = 0;
+	init_waitqueue_head(&x->wait);
+}
+
+static inline void reinit_completion(struct completion* x) {
+	x->done = 0;
+}
+
+void wait_for_completion(struct completion* x);
+int32 wait_for_completion_interruptible(struct completion* x);
+int32 try_wait_for_completion(struct completion* x);
+int32 completion_done(struct completion* x);
+void complete(struct completion* x);
+void complete_all(struct completion* x);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include <kernel/types.h>
+
+/*
+ * 浮点寄存器的延迟保存和恢复。
+ *
+ * 内核自己不用浮点，sstatus.FS只反映用户态：硬件在浮点寄存器被写时把它
+ * 置为Dirty。任务让出CPU时只有FS为Dirty才保存32个浮点寄存器；返回
+ * 用户态时，如果这个hart的寄存器里还是它的状态就直接用，否则把FS关掉，
+ * 等它第一次执行浮点指令触发非法指令异常时再装回来。不用浮点的进程和
+ * 系统调用都不需要碰浮点寄存器。
+ */
+
+struct task_struct;
+struct fp_state;
+
+// kernel/arch/riscv/fpu.S，调用时FS不能是Off
+void __fstate_save(struct fp_state* state);
+void __fstate_restore(struct fp_state* state);
+
+void fpu_save(struct task_struct* p);
+void fpu_prepare_return(struct task_struct* p);
+int32 fpu_handle_trap(struct task_struct* p);
+
+#endif
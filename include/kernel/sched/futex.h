@@ -0,0 +1,42 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+
+/*
+ * futex：用户态锁的慢路径。没有竞争时用户态只做原子操作，不进内核；
+ * 有竞争时在FUTEX_WAIT里睡眠，由FUTEX_WAKE唤醒。
+ *
+ * 等待者按key散列到一组桶里，每个桶一把锁、一条等待者链表。私有futex
+ * 的key是(mm, uaddr)；共享futex的key是(物理页, 页内偏移)，不同进程
+ * 把同一页映射在不同地址上也能对上。私有映射上的共享futex和私有的
+ * 一样用(mm, uaddr)。
+ */
+
+// futex()的op，数值与Linux相同
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+#define FUTEX_REQUEUE 3
+#define FUTEX_CMP_REQUEUE 4
+#define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
+#define FUTEX_PRIVATE_FLAG 128
+#define FUTEX_CLOCK_REALTIME 256
+#define FUTEX_CMD_MASK (~(FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME))
+
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
+
+struct futex_key {
+	void* ptr;     // 私有：mm；共享：page
+	uint64 offset; // 私有：uaddr；共享：页内偏移
+	int32 shared;  // ptr是page，持有它的引用
+};
+
+int32 futex_wait(uint32 __user* uaddr, int32 shared, uint32 val, uint64 expires, uint32 bitset);
+int32 futex_wake(uint32 __user* uaddr, int32 shared, int32 nr_wake, uint32 bitset);
+int32 futex_requeue(uint32 __user* uaddr, int32 shared, uint32 __user* uaddr2, int32 nr_wake, int32 nr_requeue,
+                    uint32* cmpval);
+void futex_init(void);
+
+#endif
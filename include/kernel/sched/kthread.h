@@ -0,0 +1,40 @@
+#ifndef _KTHREAD_H_
+#define _KTHREAD_H_
+
+#include <kernel/sched/completion.h>
+#include <kernel/types.h>
+
+/*
+ * 内核线程：只在内核态运行、不属于任何用户进程的任务，用来做后台工作。
+ *
+ * kthread_create()建好的线程处于睡眠状态，可以先kthread_bind()到某个
+ * hart，再用wake_up_process()让它第一次运行；kthread_run()两步一起做。
+ * 线程函数返回或者调用kthread_exit()后线程结束，由kthread_stop()回收。
+ *
+ * 内核态不抢占，长时间运行的内核线程要在安全点调用cond_resched()。
+ */
+
+struct task_struct;
+
+struct kthread {
+	int32 (*threadfn)(void* data);
+	void* data;
+	volatile int32 should_stop; // kthread_stop()要求线程退出
+	int32 result;               // 线程函数的返回值
+	struct completion exited;
+};
+
+struct task_struct* kthread_create(int32 (*threadfn)(void* data), void* data, const char* namefmt, ...);
+void kthread_bind(struct task_struct* p, int32 cpu);
+int32 kthread_should_stop(void);
+int32 kthread_stop(struct task_struct* p);
+void kthread_exit(int32 result) __attribute__((noreturn));
+
+#define kthread_run(threadfn, data, namefmt, ...)                                                  \
+	({                                                                                         \
+		struct task_struct* __k = kthread_create(threadfn, data, namefmt, ##__VA_ARGS__);  \
+		if (!PTR_IS_ERROR(__k)) wake_up_process(__k);                                      \
+		__k;                                                                               \
+	})
+
+#endif
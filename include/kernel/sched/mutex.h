@@ -0,0 +1,72 @@
+#ifndef _MUTEX_H_
+#define _MUTEX_H_
+
+#include <kernel/config.h>
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+#include <kernel/util/lock_stat.h>
+#include <kernel/util/spinlock.h>
+
+/*
+ * 睡眠互斥锁，用于可能持有很久、持有期间会睡眠的临界区（例如磁盘I/O）。
+ *
+ * 拿不到锁时，如果持有者正在别的hart上运行，先乐观地自旋一会儿：
+ * 临界区通常很短，自旋比睡下再被唤醒便宜。持有者不在运行（它自己
+ * 睡了），或者当前任务该让出CPU了，才挂到wait_list上睡眠。
+ *
+ * owner是持有者的task_struct指针，最低位MUTEX_FLAG_WAITERS表示有任务
+ * 在睡眠等待，解锁时只有它置位才需要走慢路径去唤醒。
+ * 只有持有者能解锁，不能在中断处理中使用。
+ */
+#define MUTEX_FLAG_WAITERS 0x01UL
+#define MUTEX_FLAGS 0x01UL
+
+struct task_struct;
+
+struct mutex {
+	volatile uint64 owner;
+	spinlock_t wait_lock; // 保护wait_list
+	struct list_head wait_list;
+#ifdef CONFIG_DEBUG_LOCKS
+	const char* name;
+#endif
+#ifdef CONFIG_LOCK_STAT
+	struct lock_class* lock_class;
+	uint64 held_since;
+#endif
+};
+
+#ifdef CONFIG_DEBUG_LOCKS
+#define __MUTEX_DEBUG_INIT(lockname) , .name = #lockname
+#else
+#define __MUTEX_DEBUG_INIT(lockname)
+#endif
+
+#define __MUTEX_INITIALIZER(lockname)                                                              \
+	{ .owner = 0, .wait_lock = SPINLOCK_INIT, .wait_list = LIST_HEAD_INIT(lockname.wait_list)  \
+	  __MUTEX_DEBUG_INIT(lockname) }
+#define DEFINE_MUTEX(mutexname) struct mutex mutexname = __MUTEX_INITIALIZER(mutexname)
+
+static inline void mutex_init(struct mutex* lock) {
+	lock->owner = 0;
+	spinlock_init(&lock->wait_lock);
+	INIT_LIST_HEAD(&lock->wait_list);
+#ifdef CONFIG_DEBUG_LOCKS
+	lock->name = "mutex";
+#endif
+}
+
+static inline int32 mutex_is_locked(struct mutex* lock) {
+	return (lock->owner & ~MUTEX_FLAGS) != 0;
+}
+
+static inline struct task_struct* mutex_owner(struct mutex* lock) {
+	return (struct task_struct*)(lock->owner & ~MUTEX_FLAGS);
+}
+
+void mutex_lock(struct mutex* lock);
+int32 mutex_lock_interruptible(struct mutex* lock);
+int32 mutex_trylock(struct mutex* lock);
+void mutex_unlock(struct mutex* lock);
+
+#endif
@@ -2,25 +2,53 @@
 #define PID_H
 
 #include <stdint.h>
+#include <kernel/util/list.h>
+#include <kernel/util/rwlock.h>
 #include <kernel/util/spinlock.h>    // 自旋锁支持
 #include <kernel/types.h>
 
-#define PID_MAX 8192    // 最大PID值
+#define PID_MAX 32768    // 最大PID值
+#define INIT_PID 1       // 留给init进程，pid_alloc()不会分出去
 
+/*
+ * PID位图分两层：map的每一位是一个PID，full的每一位表示map中对应的
+ * 一个字已经满了。找空闲PID时先在当前字里用ctz找，再用ctz在full里
+ * 跳到下一个没满的字，最多看PID_MAX/64/64个字，和已用的PID数无关。
+ * 分配是循环的：从上次分配的下一个开始找，到头后回到开头，
+ * 刚释放的PID不会马上被重用。
+ */
+#define PID_MAP_WORDS (PID_MAX / 64)
+#define PID_FULL_WORDS (PID_MAP_WORDS / 64)
 
 struct pid_manager {
     spinlock_t lock;   // 自旋锁
     int32_t next_pid;          // 下一个待分配的PID
-    uint8_t pid_map[PID_MAX/8];// PID位图（含位操作对齐）
+    uint64 map[PID_MAP_WORDS];    // 第一层：PID是否已用
+    uint64 full[PID_FULL_WORDS];  // 第二层：map[i]是否已满
 };
 
+// PID到任务的哈希表，桶数是2的幂
+#define PIDHASH_BITS 10
+#define PIDHASH_SIZE (1 << PIDHASH_BITS)
+
+struct task_struct;
+
 // 初始化PID管理器（需检查返回值）
 void pid_init();
 
-// 分配PID（返回错误码，pid通过指针输出）
+// 分配PID，没有空闲时返回-EAGAIN
 pid_t pid_alloc(void);
 
 // 释放PID（返回错误码）
 void pid_free(pid_t pid);
 
-#endif
\ No newline at end of file
+// 把已经有pid的任务放进哈希表，之后find_process_by_pid()能找到它
+void attach_pid(struct task_struct* p);
+// 从哈希表中摘下并释放它的PID
+void detach_pid(struct task_struct* p);
+// 换成调用者已经占有的另一个PID，例如init的INIT_PID
+void change_pid(struct task_struct* p, pid_t pid);
+// 按PID查任务，带着一个引用返回，用完put_task_struct()
+struct task_struct* pid_task(pid_t pid);
+
+#endif
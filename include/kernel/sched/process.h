@@ -1,13 +1,23 @@
 #ifndef _PROC_H_
 #define _PROC_H_
 
+#include <kernel/hrtimer.h>
 #include <kernel/riscv.h>
 #include <kernel/trapframe.h>
 #include <kernel/sched/signal.h>
+#include <kernel/sched/stats.h>
+#include <kernel/sched/wait.h>
+#include <kernel/util/atomic.h>
 #include <kernel/util/list.h>
+#include <kernel/util/rbtree.h>
 
 struct fdtable;
 struct fs_struct;
+struct sched_class;
+
+// hart位图，第i位表示hart i
+typedef uint64 cpumask_t;
+#define CPU_MASK_ALL ((cpumask_t)((1UL << NCPU) - 1))
 
 /* Linux内核进程flags定义表 */
 
@@ -87,6 +97,7 @@ struct fs_struct;
 #define TASK_STATE_MAX 0x00010000
 
 #define TASK_ANY (TASK_STATE_MAX - 1)
+#define TASK_NORMAL (TASK_INTERRUPTIBLE | TASK_UNINTERRUPTIBLE) // wake_up()唤醒的睡眠状态
 /* 复合状态(组合状态) */
 #define TASK_KILLABLE (TASK_WAKEKILL | TASK_UNINTERRUPTIBLE) // 不可中断但可被SIGKILL终止
 #define TASK_STOPPED (TASK_WAKEKILL | __TASK_STOPPED)        // 已停止并会在唤醒时被杀死
@@ -95,6 +106,91 @@ struct fs_struct;
 /* 状态掩码 */
 #define TASK_STATE_TO_CHAR_STR "RSDTtXZPI" // 状态显示字符
 
+#define TASK_COMM_LEN 16 // 任务名的长度，含结尾的0
+
+/*
+ * 优先级：0到99留给实时任务，100到139对应nice值-20到19。
+ * 数值越小优先级越高。
+ */
+#define MAX_NICE 19
+#define MIN_NICE -20
+#define NICE_WIDTH (MAX_NICE - MIN_NICE + 1)
+#define MAX_RT_PRIO 100
+#define DEFAULT_PRIO (MAX_RT_PRIO + NICE_WIDTH / 2)
+#define NICE_TO_PRIO(nice) ((nice) + DEFAULT_PRIO)
+#define PRIO_TO_NICE(prio) ((prio) - DEFAULT_PRIO)
+#define task_nice(p) PRIO_TO_NICE((p)->static_prio)
+
+// 调度策略，数值与Linux相同
+#define SCHED_NORMAL 0
+#define SCHED_FIFO 1
+#define SCHED_RR 2
+#define SCHED_BATCH 3
+#define SCHED_IDLE 5
+// 实时优先级rt_priority的范围，越大越优先；内部的prio = MAX_RT_PRIO - 1 - rt_priority
+#define MAX_USER_RT_PRIO 100
+#define rt_policy(policy) ((policy) == SCHED_FIFO || (policy) == SCHED_RR)
+#define rt_prio(prio) ((prio) < MAX_RT_PRIO)
+#define rt_task(p) rt_prio((p)->prio)
+
+// clone()的flags，数值与Linux相同；低8位是子进程退出时发给父进程的信号
+#define CSIGNAL 0x000000ff
+#define CLONE_VM 0x00000100             // 共用地址空间
+#define CLONE_FS 0x00000200             // 共用根目录和当前目录
+#define CLONE_FILES 0x00000400          // 共用文件描述符表
+#define CLONE_SIGHAND 0x00000800        // 共用信号处理函数
+#define CLONE_VFORK 0x00004000          // 父进程等子进程exec或退出
+#define CLONE_PARENT 0x00008000         // 和调用者同一个父进程
+#define CLONE_THREAD 0x00010000         // 同一个线程组
+#define CLONE_SETTLS 0x00080000         // 子线程的tp设为tls参数
+#define CLONE_PARENT_SETTID 0x00100000  // 把新的tid写到父进程的ptid
+#define CLONE_CHILD_CLEARTID 0x00200000 // 子线程退出时把ctid清零
+#define CLONE_CHILD_SETTID 0x01000000   // 把新的tid写到子线程的ctid
+
+// signal_flags，只在线程组的leader上设置
+#define SIGNAL_GROUP_EXIT 0x1 // exit_group()已经开始，其他线程回用户态前退出
+
+// nice 0对应的权重，nice每差1，权重相差约1.25倍
+#define NICE_0_LOAD 1024
+
+/*
+ * 公平调度类的调度实体。vruntime是按权重折算的运行时间：
+ * 权重为NICE_0_LOAD的任务跑1个time CSR周期，vruntime就增加1，
+ * 权重越大增长越慢。时间单位都是time CSR的计数。
+ */
+struct sched_entity {
+	struct rb_node run_node;
+	uint64 load_weight;
+	uint64 vruntime;
+	uint64 exec_start;            // 本次开始记账的时刻
+	uint64 sum_exec_runtime;      // 累计运行时间
+	uint64 prev_sum_exec_runtime; // 本次被选中时的sum_exec_runtime
+};
+
+// 实时调度类的调度实体，挂在所在优先级的链表上
+struct sched_rt_entity {
+	struct list_head run_list;
+	uint32 time_slice; // SCHED_RR剩余的tick数；为0时放回队尾
+};
+
+/*
+ * 任务在内核中让出CPU时的上下文，由__switch_to()保存和恢复。
+ * 切换是一次普通的函数调用，调用者保存的寄存器编译器已经处理了，
+ * 只需要ra、sp和s0-s11；其余的都在任务自己的内核栈上。
+ * 布局和kernel/arch/riscv/switch.S一致。
+ */
+struct thread_struct {
+	/* offset:0  */ uint64 ra;
+	/* offset:8  */ uint64 sp;
+	/* offset:16 */ uint64 s[12];
+};
+
+// 用户态的浮点寄存器（D扩展），布局和kernel/arch/riscv/fpu.S一致
+struct fp_state {
+	/* offset:0   */ uint64 f[32];
+	/* offset:256 */ uint32 fcsr;
+};
+
 // types of a segment
 enum fork_choice {
 	FORK_MAP = 0, // 直接映射代码段
@@ -106,7 +202,10 @@ struct task_struct {
 	uint64 kstack; // 分配一个页面当内核栈，注意内核栈的范围是[kstack-PAGE_SIZE,
 	               // kstack)
 	struct trapframe* trapframe;
-	struct trapframe* ktrapframe;
+	struct thread_struct thread; // 在内核中让出CPU时的上下文
+	// 浮点状态，PF_USED_MATH之后才有效；fpu_cpu是寄存器里最近装着它的hart
+	struct fp_state fpstate;
+	int32 fpu_cpu;
 
 	struct mm_struct* mm;
 	// struct mm_struct *active_mm;
@@ -115,24 +214,61 @@ struct task_struct {
 	struct fs_struct* fs;
 	struct fdtable* fdtable;
 
-	// process id
+	// process id；线程组里每个线程有自己的pid（即tid），getpid()返回的是tgid
 	pid_t pid;
+	pid_t tgid;
+	struct task_struct* group_leader; // 第一个线程，tgid就是它的pid
+	struct list_head thread_group;    // leader上是链表头，其他线程挂在上面
+	// set_tid_address()和CLONE_CHILD_SETTID/CLEARTID给的用户地址
+	int32 __user* set_child_tid;
+	int32 __user* clear_child_tid;
+	struct list_head pid_chain; // PID哈希表的链，见kernel/sched/pid.c
+	struct list_head tasks;     // task_list上的链
+	// 引用计数：alloc_empty_process()给的一个由free_empty_process()放掉，
+	// pid_task()查到的任务另带一个，用完put_task_struct()
+	atomic_t usage;
 	// process state
 	uint32 state;
 	uint32 flags;
+	char comm[TASK_COMM_LEN];
+	struct kthread* kthread; // 只有内核线程有，见kernel/sched/kthread.c
 	// parent process
 	struct task_struct* parent;
 	struct list_head children;
 	struct list_head sibling;
-	// ready queue
-	struct list_head ready_queue_node;
+	// scheduling: class, policy, priorities and the classes' queue linkage
+	const struct sched_class* sched_class;
+	int32 policy;
+	int32 prio;        // 实际使用的优先级，实时任务小于MAX_RT_PRIO
+	int32 static_prio; // nice值对应的优先级
+	int32 rt_priority; // 实时优先级，1到99，普通任务为0
+	int32 on_rq;       // 在某个hart的就绪队列中
+	struct sched_entity se;
+	struct sched_rt_entity rt;
+	// 所在（或上次运行）的hart，以及允许运行的hart集合
+	int32 cpu;
+	cpumask_t cpus_allowed;
+	// 正在某个hart上运行（或者还在用它的内核栈），别的hart要等它清零才能切换过去
+	volatile int32 on_cpu;
+	// 已经在schedule()中睡下、离开了就绪队列，try_to_wake_up()要把它放回去
+	int32 sleeping;
 
-	// accounting. added @lab3_3
-	int32 tick_count;
+	// 时间片用完，回到用户态之前需要让出CPU
+	volatile int32 need_resched;
+
+	// CPU时间和调度统计，见kernel/sched/stats.c
+	struct task_cputime cputime;
+	struct sched_info sched_info;
+	uint64 vtime_start; // 上次进出用户态或上CPU的时刻
+	int32 in_iowait;    // 这次睡眠是在等I/O
+	// 只在leader上有效：已退出的其他线程、已回收的子进程的合计
+	struct task_cputime dead_cputime;
+	struct task_cputime children_cputime;
 
 	// int32 sem_index;
 
-	// int32 pagefault_disabled;
+	// pagefault_disable()的嵌套深度，非0时内核访问用户地址缺页直接按-EFAULT修复
+	int32 pagefault_disabled;
 
 	/* Signal handling */
 	sigset_t pending;                // Pending signals
@@ -141,7 +277,14 @@ struct task_struct {
 	struct sigaction sighand[_NSIG]; // Signal handlers
 
 	uint64 signal_flags; // Signal-related flags
+	int32 group_exit_code;        // exit_group()的参数，只在leader上有效
 	int32 exit_signal;            // Signal delivered to parent on exit
+	int32 exit_code;              // exit()的参数，wait时交给父进程
+	wait_queue_head_t wait_chldexit; // 父进程在这里等子进程退出
+
+	// ITIMER_REAL，只用leader上的，见kernel/itimer.c
+	struct hrtimer real_timer;
+	uint64 it_real_incr; // 周期，time CSR的计数，0表示只触发一次
 
 	uid_t uid;
 	uid_t euid;
@@ -160,6 +303,17 @@ int32 do_exec(uint64 path);
 ssize_t do_wait(int32 pid);
 int32 current_is_in_group(gid_t gid);
 
+static inline int32 thread_group_leader(struct task_struct* p) { return p->group_leader == p; }
+
+// 除了leader以外没有别的线程了
+static inline void get_task_struct(struct task_struct* p) { atomic_inc(&p->usage); }
+void put_task_struct(struct task_struct* p);
+static inline int32 thread_group_empty(struct task_struct* p) { return list_empty(&p->group_leader->thread_group); }
+
+static inline int32 signal_group_exit(struct task_struct* p) {
+	return p->group_leader && (p->group_leader->signal_flags & SIGNAL_GROUP_EXIT);
+}
+
 /**
  * 打印进程的内存布局信息，用于调试
  */
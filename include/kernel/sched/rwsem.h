@@ -0,0 +1,50 @@
+#ifndef _RWSEM_H_
+#define _RWSEM_H_
+
+#include <kernel/config.h>
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+#include <kernel/util/spinlock.h>
+
+/*
+ * 读写信号量：可以睡眠的读写锁，用于持有时间长、读多写少的场合，
+ * 例如mmap_lock、inode的i_rwsem和超级块的s_umount。
+ *
+ * count大于0是持有的读者数，-1表示写者持有。拿不到时按到达顺序在
+ * wait_list上排队睡眠；释放时把锁直接交给队首：队首是写者就只交给它，
+ * 是读者就交给队首连续的所有读者。已经有人排队时新来的读者也要排队，
+ * 所以写者不会被饿死。
+ */
+struct task_struct;
+
+struct rw_semaphore {
+	int64 count;
+	struct task_struct* owner; // 持有写锁的任务
+	spinlock_t wait_lock;      // 保护count和wait_list
+	struct list_head wait_list;
+};
+
+#define __RWSEM_INITIALIZER(name)                                                                  \
+	{ .count = 0, .owner = NULL, .wait_lock = SPINLOCK_INIT, .wait_list = LIST_HEAD_INIT(name.wait_list) }
+#define DECLARE_RWSEM(name) struct rw_semaphore name = __RWSEM_INITIALIZER(name)
+
+static inline void init_rwsem(struct rw_semaphore* sem) {
+	sem->count = 0;
+	sem->owner = NULL;
+	spinlock_init(&sem->wait_lock);
+	INIT_LIST_HEAD(&sem->wait_list);
+}
+
+static inline int32 rwsem_is_locked(struct rw_semaphore* sem) {
+	return sem->count != 0;
+}
+
+void down_read(struct rw_semaphore* sem);
+int32 down_read_trylock(struct rw_semaphore* sem);
+void up_read(struct rw_semaphore* sem);
+void down_write(struct rw_semaphore* sem);
+int32 down_write_trylock(struct rw_semaphore* sem);
+void up_write(struct rw_semaphore* sem);
+void downgrade_write(struct rw_semaphore* sem);
+
+#endif
@@ -1,12 +1,121 @@
 #ifndef _SCHED_H_
 #define _SCHED_H_
 
+#include <kernel/percpu.h>
+#include <kernel/percpu_counter.h>
 #include <kernel/sched/process.h>
-// riscv-pke kernel supports at most 32 processes
-#define NPROC 32
+#include <kernel/util/rbtree.h>
+#include <kernel/util/rwlock.h>
+#include <kernel/util/spinlock.h>
+// default SCHED_RR time slice, in timer interrupts
 #define TIME_SLICE_LEN  2
-extern struct task_struct* current_percpu[NCPU];
-#define CURRENT (current_percpu[read_tp()])
+// current SCHED_RR time slice, tunable at runtime with the sched_tune syscall
+extern uint32 sched_timeslice;
+// 每隔多少个tick做一次周期性负载均衡
+#define LOAD_BALANCE_TICKS 8
+DECLARE_PER_CPU(struct task_struct*, current_percpu);
+#define CURRENT this_cpu_read(current_percpu)
+
+/*
+ * 公平调度类的就绪队列：按vruntime排序的红黑树，最左边的任务最先运行。
+ * min_vruntime单调不减，新任务和被唤醒的任务以它为基准放置。
+ */
+struct cfs_rq {
+	struct rb_root_cached tasks_timeline;
+	uint64 min_vruntime;
+	uint64 load;       // 队列中任务的权重之和
+	uint32 nr_running;
+};
+
+/*
+ * 实时调度类的就绪队列：每个优先级一个FIFO链表，bitmap中第i位表示
+ * 链表i非空，所以最高优先级的任务用一次ctz就能找到。
+ *
+ * 一个周期（sysctl_sched_rt_period）内实时任务最多运行
+ * sysctl_sched_rt_runtime，超出后被节流，剩下的时间留给普通任务，
+ * 防止失控的实时任务锁死整个hart。
+ */
+#define RT_BITMAP_WORDS ((MAX_RT_PRIO + 63) / 64)
+struct rt_prio_array {
+	uint64 bitmap[RT_BITMAP_WORDS];
+	struct list_head queue[MAX_RT_PRIO];
+};
+
+struct rt_rq {
+	struct rt_prio_array active;
+	uint32 rt_nr_running;
+	uint64 rt_time;         // 本周期内实时任务已运行的时间
+	uint64 rt_period_start; // 本周期开始的时刻
+	int32 rt_throttled;
+};
+
+/*
+ * 每个hart一个运行队列。队列里只有就绪任务，正在运行的任务是per_cpu(current_percpu, cpu)。
+ * 空闲的hart会从最忙的队列偷任务，忙碌的hart每LOAD_BALANCE_TICKS个tick
+ * 检查一次，差距达到2个任务时拉过来一个。
+ */
+struct rq {
+	spinlock_t lock;
+	struct rt_rq rt;
+	struct cfs_rq cfs;
+	uint32 nr_running;        // 队列中的就绪任务数，所有调度类合计
+	int32 cpu;
+	struct task_struct* idle; // 本hart的idle任务
+	uint32 balance_ticks;
+	uint64 nr_switches;
+	uint64 nr_migrations;
+	struct rq_sched_info sched_info; // 本队列上任务的调度延迟
+};
+DECLARE_PER_CPU(struct rq, runqueues);
+#define cpu_rq(cpu) (&per_cpu(runqueues, (cpu)))
+#define this_rq() this_cpu_ptr(&runqueues)
+
+/*
+ * 调度类。正在运行的任务不在队列里：pick_next_task()把选中的任务从队列
+ * 取下，它被抢占时再由enqueue_task()放回去。以下回调都在持有rq->lock时调用。
+ */
+struct sched_class {
+	const struct sched_class* next; // 优先级更低的调度类
+
+	void (*enqueue_task)(struct rq* rq, struct task_struct* p, int32 flags);
+	void (*dequeue_task)(struct rq* rq, struct task_struct* p, int32 flags);
+	// 取下并返回下一个要运行的任务，没有时返回NULL
+	struct task_struct* (*pick_next_task)(struct rq* rq);
+	// p即将开始运行 / 停止运行，用于运行时间记账
+	void (*set_next_task)(struct rq* rq, struct task_struct* p);
+	void (*put_prev_task)(struct rq* rq, struct task_struct* p);
+	// 时钟中断中对正在运行的p记账，时间片用完时置need_resched
+	void (*task_tick)(struct rq* rq, struct task_struct* p);
+	// 同一调度类的p进入rq后，判断是否应当抢占rq上正在运行的任务
+	void (*check_preempt_curr)(struct rq* rq, struct task_struct* p);
+	// 负载均衡：在rq中找一个可以迁到cpu上运行的任务
+	struct task_struct* (*pick_migrate_task)(struct rq* rq, int32 cpu);
+	// p即将被放到另一个hart上，不持锁调用
+	void (*migrate_task_rq)(struct task_struct* p, int32 new_cpu);
+	// p的nice值变了
+	void (*prio_changed)(struct rq* rq, struct task_struct* p);
+	// p刚从别的调度类换到这个调度类，在入队或set_next_task()之前调用
+	void (*switched_to)(struct rq* rq, struct task_struct* p);
+	// p调用了sched_yield()
+	void (*yield_task)(struct rq* rq, struct task_struct* p);
+	// p每次运行的时间片长度，time CSR计数
+	uint64 (*get_rr_interval)(struct rq* rq, struct task_struct* p);
+};
+
+// enqueue_task()/dequeue_task()的flags
+#define ENQUEUE_WAKEUP 0x01  // 从睡眠中醒来
+#define ENQUEUE_INITIAL 0x02 // 新创建的任务第一次入队
+#define ENQUEUE_MIGRATE 0x04 // 从别的hart迁来，vruntime是相对值
+#define DEQUEUE_MIGRATE 0x04 // 要迁到别的hart，vruntime改成相对值
+
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class fair_sched_class;
+#define sched_class_highest (&rt_sched_class)
+#define for_each_class(class) for (class = sched_class_highest; class; class = class->next)
+
+// 已经上线、参与调度的hart
+extern volatile cpumask_t cpu_online_mask;
+#define cpu_online(cpu) ((cpu_online_mask >> (cpu)) & 1)
 #define current current_task()
 
 static inline struct task_struct* current_task() {
@@ -15,13 +124,68 @@ static inline struct task_struct* current_task() {
 
 void init_scheduler();
 void insert_to_ready_queue( struct task_struct* proc );
+void wake_up_new_task(struct task_struct* p);
+int32 try_to_wake_up(struct task_struct* p, uint32 state);
+int32 wake_up_process(struct task_struct* p);
+void sched_fork(struct task_struct* p);
+void resched_curr(struct rq* rq);
 struct task_struct *alloc_empty_process();
+void free_empty_process(struct task_struct *p);
 
 void switch_to(struct task_struct*);
+int32 prepare_syscall_return(struct task_struct*);
+
+/* 上下文切换：kernel/arch/riscv/switch.S，返回last，即切换到本任务之前在这个hart上运行的任务 */
+struct task_struct* __switch_to(struct thread_struct* prev, struct thread_struct* next, struct task_struct* last);
+void finish_task_switch(struct task_struct* prev);
+void ret_from_fork(struct task_struct* prev) __attribute__((noreturn));
 
 void schedule();
+/* 带超时的睡眠：kernel/sched/timeout.c，expires是time CSR上的绝对时刻 */
+int32 schedule_hrtimeout(uint64 expires);
+void scheduler_tick(void);
+void rrsched(void);
+void cond_resched(void);
+int32 sched_set_timeslice(uint32 ticks);
+int32 idle_balance(struct rq* rq);
+int32 sched_setaffinity(pid_t pid, cpumask_t mask);
+int32 sched_getaffinity(pid_t pid, cpumask_t* mask);
+uint64 sched_task_timeslice(struct task_struct* p);
+int32 sched_setscheduler(struct task_struct* p, int32 policy, int32 rt_priority);
+void sched_yield(void);
+void set_user_nice(struct task_struct* p, int32 nice);
+int32 can_nice(struct task_struct* p, int32 nice);
+
+/* 公平调度类：kernel/sched/fair.c */
+void init_cfs_rq(struct cfs_rq* cfs_rq);
+void set_load_weight(struct task_struct* p);
+
+/* 实时调度类：kernel/sched/rt.c */
+void init_rt_rq(struct rt_rq* rt_rq);
+void sched_rt_period_tick(struct rq* rq);
+
+// sched_setscheduler()等系统调用的参数
+struct sched_param {
+	int32 sched_priority;
+};
+
+/* SMP: kernel/sched/smp.c */
+void smp_boot_secondary_harts(void);
+void smp_send_reschedule(int32 cpu);
+void handle_ipi(void);
+void lock_bench_run(void);
+void switch_bench_start(void);
 struct task_struct *find_process_by_pid(pid_t pid);
 
+// 所有任务（不含idle），遍历时要拿读锁
+extern struct list_head task_list;
+extern rwlock_t tasklist_lock;
+#define for_each_process(p) list_for_each_entry(p, &task_list, tasks)
+
+// alloc_empty_process()分配出去还没还回来的任务数，clone()按max_threads限制它
+extern struct percpu_counter nr_threads;
+extern int32 max_threads;
+
 /**
  * set_current_task - Explicitly set the current task for the calling CPU
  * @task: Task to set as current
@@ -31,8 +195,7 @@ struct task_struct *find_process_by_pid(pid_t pid);
  * initialization or special operations like setting up the init task.
  */
 static inline void set_current_task(struct task_struct* task) {
-    int32 hartid = read_tp();
-    current_percpu[hartid] = task;
+    this_cpu_write(current_percpu, task);
 }
 
 
@@ -136,6 +136,8 @@ struct sigevent {
 
 
 
+struct task_struct;
+
 /* Core signal operations */
 int32 do_send_signal(pid_t pid, int32 sig);
 int32 do_sigaction(int32 sig, const struct sigaction *act, struct sigaction *oldact);
@@ -143,6 +145,7 @@ int32 do_sigprocmask(int32 how, const sigset_t *set, sigset_t *oldset);
 int32 do_kill(pid_t pid, int32 sig);
 int32 do_sigsuspend(const sigset_t *mask);
 void do_signal_delivery(void);
+int32 signal_pending(struct task_struct *p);
 
 /* Signal set operations */
 int32 sigemptyset(sigset_t *set);
@@ -0,0 +1,62 @@
+#ifndef _SCHED_STATS_H_
+#define _SCHED_STATS_H_
+
+#include <kernel/types.h>
+
+/*
+ * 调度统计和CPU时间记账，见kernel/sched/stats.c。
+ *
+ * 时间都是time CSR的计数。用户态/内核态时间在进出用户态和切换任务时
+ * 按rdtime的差值记，不靠tick采样，短于一个tick的运行也记得准。
+ */
+
+struct rq;
+struct task_struct;
+
+// 就绪到上CPU的延迟直方图：第0格不到1us，第i格是[2^(i-1), 2^i)us，最后一格不封顶
+#define SCHED_LAT_BUCKETS 16
+
+// 一组CPU时间和切换次数；线程组里已退出线程、已回收子进程的合计也用它
+struct task_cputime {
+	uint64 utime;  // 用户态时间
+	uint64 stime;  // 内核态时间
+	uint64 iowait; // 等I/O睡眠的时间
+	uint64 nvcsw;  // 主动让出CPU（睡眠）的次数
+	uint64 nivcsw; // 被抢占的次数
+};
+
+struct sched_info {
+	uint64 pcount;      // 上CPU的次数
+	uint64 run_delay;   // 在就绪队列里等的总时间
+	uint64 last_queued; // 进就绪队列的时刻，不在队列里等时为0
+	uint64 sleep_start; // 开始等I/O的时刻
+	uint64 lat_hist[SCHED_LAT_BUCKETS];
+};
+
+// 每个hart就绪队列的合计，放在struct rq里
+struct rq_sched_info {
+	uint64 run_delay;
+	uint64 max_delay; // 最长的一次等待
+	uint64 lat_hist[SCHED_LAT_BUCKETS];
+};
+
+/* 以下在持有rq->lock时调用 */
+void sched_info_enqueue(struct task_struct* p);
+void sched_info_switch(struct rq* rq, struct task_struct* prev, struct task_struct* next);
+void sched_info_wakeup(struct task_struct* p);
+
+/* 进出用户态，只由任务自己调用 */
+void vtime_user_enter(struct task_struct* p);
+void vtime_user_exit(struct task_struct* p);
+
+/* 等I/O的睡眠算作iowait，prepare返回旧值交给finish */
+int32 io_schedule_prepare(void);
+void io_schedule_finish(int32 token);
+
+void task_cputime(struct task_struct* p, struct task_cputime* times);
+void thread_group_cputime(struct task_struct* p, struct task_cputime* times);
+void task_cputime_add(struct task_cputime* sum, const struct task_cputime* t);
+
+int64 sched_stat_dump(pid_t pid, char* buf, size_t len);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef _WAIT_H_
+#define _WAIT_H_
+
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+#include <kernel/util/spinlock.h>
+
+/*
+ * 等待队列：任务在某个事件上睡眠，事件发生时由wake_up()唤醒。
+ *
+ * 睡眠的一方先用prepare_to_wait()挂到队列上并设置状态，再检查条件，
+ * 条件不满足才调用schedule()。唤醒的一方先让条件成立再调用wake_up()。
+ * 唤醒如果发生在检查条件和schedule()之间，任务的状态已经被改回
+ * TASK_RUNNING，schedule()会直接返回，所以不会丢失唤醒。
+ * 一般直接用wait_event()系列的宏。
+ */
+
+struct task_struct;
+struct wait_queue_entry;
+
+typedef int32 (*wait_queue_func_t)(struct wait_queue_entry* wq_entry, uint32 mode);
+
+// 独占等待：wake_up()只唤醒一个独占的等待者，避免惊群
+#define WQ_FLAG_EXCLUSIVE 0x01
+
+struct wait_queue_entry {
+	uint32 flags;
+	struct task_struct* private;
+	wait_queue_func_t func;
+	struct list_head entry;
+};
+
+struct wait_queue_head {
+	spinlock_t lock;
+	struct list_head head;
+};
+typedef struct wait_queue_head wait_queue_head_t;
+typedef struct wait_queue_entry wait_queue_entry_t;
+
+#define __WAIT_QUEUE_HEAD_INITIALIZER(name) { .lock = SPINLOCK_INIT, .head = LIST_HEAD_INIT(name.head) }
+#define DECLARE_WAIT_QUEUE_HEAD(name) struct wait_queue_head name = __WAIT_QUEUE_HEAD_INITIALIZER(name)
+
+// 唤醒后把自己从队列上摘下来的等待项，prepare_to_wait()/finish_wait()用它
+#define DEFINE_WAIT(name)                                                                          \
+	struct wait_queue_entry name = {                                                           \
+		.private = current_task(), .func = autoremove_wake_function, .entry = LIST_HEAD_INIT(name.entry) }
+
+static inline void init_waitqueue_head(struct wait_queue_head* wq_head) {
+	spinlock_init(&wq_head->lock);
+	INIT_LIST_HEAD(&wq_head->head);
+}
+
+// 没有人在等时可以省掉唤醒；调用者必须先让条件成立并保证其可见
+static inline int32 waitqueue_active(struct wait_queue_head* wq_head) {
+	return !list_empty(&wq_head->head);
+}
+
+int32 default_wake_function(struct wait_queue_entry* wq_entry, uint32 mode);
+int32 autoremove_wake_function(struct wait_queue_entry* wq_entry, uint32 mode);
+void init_wait_entry(struct wait_queue_entry* wq_entry, uint32 flags);
+
+void add_wait_queue(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry);
+void add_wait_queue_exclusive(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry);
+void remove_wait_queue(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry);
+
+void prepare_to_wait(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state);
+void prepare_to_wait_exclusive(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state);
+int32 prepare_to_wait_event(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state);
+void finish_wait(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry);
+
+void __wake_up(struct wait_queue_head* wq_head, uint32 mode, int32 nr_exclusive);
+
+#define wake_up(x) __wake_up(x, TASK_NORMAL, 1)
+#define wake_up_nr(x, nr) __wake_up(x, TASK_NORMAL, nr)
+#define wake_up_all(x) __wake_up(x, TASK_NORMAL, 0)
+#define wake_up_interruptible(x) __wake_up(x, TASK_INTERRUPTIBLE, 1)
+#define wake_up_interruptible_all(x) __wake_up(x, TASK_INTERRUPTIBLE, 0)
+
+/*
+ * 睡眠直到condition成立。可中断的睡眠在有信号未处理时返回-EINTR，
+ * 否则返回0。condition在每次醒来后重新求值，调用者不需要再检查一遍。
+ */
+#define ___wait_event(wq_head, condition, state, exclusive)                                        \
+	({                                                                                         \
+		int32 __ret = 0;                                                                   \
+		struct wait_queue_entry __wq_entry;                                                \
+		init_wait_entry(&__wq_entry, (exclusive) ? WQ_FLAG_EXCLUSIVE : 0);                 \
+		for (;;) {                                                                         \
+			int32 __int = prepare_to_wait_event(&(wq_head), &__wq_entry, state);       \
+			if (condition) break;                                                      \
+			if (__int) {                                                               \
+				__ret = __int;                                                     \
+				break;                                                             \
+			}                                                                          \
+			schedule();                                                                \
+		}                                                                                  \
+		finish_wait(&(wq_head), &__wq_entry);                                              \
+		__ret;                                                                             \
+	})
+
+#define wait_event(wq_head, condition)                                                             \
+	do {                                                                                       \
+		if (condition) break;                                                              \
+		(void)___wait_event(wq_head, condition, TASK_UNINTERRUPTIBLE, 0);                  \
+	} while (0)
+
+#define wait_event_interruptible(wq_head, condition)                                               \
+	({                                                                                         \
+		int32 __r = 0;                                                                     \
+		if (!(condition)) __r = ___wait_event(wq_head, condition, TASK_INTERRUPTIBLE, 0);  \
+		__r;                                                                               \
+	})
+
+#define wait_event_interruptible_exclusive(wq_head, condition)                                     \
+	({                                                                                         \
+		int32 __r = 0;                                                                     \
+		if (!(condition)) __r = ___wait_event(wq_head, condition, TASK_INTERRUPTIBLE, 1);  \
+		__r;                                                                               \
+	})
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+#include <kernel/config.h>
+#include <kernel/percpu.h>
+#include <kernel/sched/wait.h>
+#include <kernel/timer.h>
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+#include <kernel/util/spinlock.h>
+
+/*
+ * 工作队列：把不能或不想在当前上下文里做的事推迟到内核线程中做。
+ *
+ * 每个工作队列在每个在线hart上有一个worker_pool和一个绑定在该hart上的
+ * worker线程，按提交顺序逐个执行work。queue_work()可以在中断上下文中
+ * 调用；work函数运行在线程上下文，可以睡眠、拿mutex。
+ *
+ * work在排队期间带PENDING标记，重复提交不会排两次；work函数开始执行前
+ * 标记已经清掉，所以它可以把自己重新排上。
+ *
+ * delayed_work先挂在提交时所在hart的时间轮上，到期后由定时器中断
+ * 排进工作队列。延迟以jiffies为单位。
+ */
+
+struct work_struct;
+struct worker_pool;
+struct workqueue_struct;
+struct task_struct;
+
+typedef void (*work_func_t)(struct work_struct* work);
+
+#define WORK_STRUCT_PENDING 0x1UL // 已在worklist或定时器上等待执行
+
+struct work_struct {
+	volatile uint64 data;
+	struct list_head entry;
+	work_func_t func;
+	struct worker_pool* pool; // 最近一次排入的pool
+};
+
+struct delayed_work {
+	struct work_struct work;
+	struct timer_list timer;
+	struct workqueue_struct* wq;
+	int32 cpu; // 到期后排到哪个hart
+};
+
+struct worker_pool {
+	spinlock_t lock;
+	struct list_head worklist;
+	wait_queue_head_t wait; // worker在这里等新的work
+	struct task_struct* worker;
+	struct work_struct* current_work;
+	int32 cpu;
+};
+
+struct workqueue_struct {
+	const char* name;
+	struct worker_pool __percpu* pools; // alloc_percpu()分配，每个hart一个
+};
+
+// delayed_work的定时器到期后把work排进工作队列
+void delayed_work_timer_fn(struct timer_list* timer);
+
+#define __WORK_INITIALIZER(n, f) { .data = 0, .entry = LIST_HEAD_INIT((n).entry), .func = (f), .pool = NULL }
+#define __DELAYED_WORK_INITIALIZER(n, f)                                                                \
+	{                                                                                               \
+		.work = __WORK_INITIALIZER((n).work, (f)), .timer = __TIMER_INITIALIZER((n).timer, delayed_work_timer_fn), \
+		.wq = NULL, .cpu = 0                                                                    \
+	}
+
+#define DECLARE_WORK(n, f) struct work_struct n = __WORK_INITIALIZER(n, f)
+#define DECLARE_DELAYED_WORK(n, f) struct delayed_work n = __DELAYED_WORK_INITIALIZER(n, f)
+
+static inline void INIT_WORK(struct work_struct* work, work_func_t func) {
+	work->data = 0;
+	INIT_LIST_HEAD(&work->entry);
+	work->func = func;
+	work->pool = NULL;
+}
+
+static inline void INIT_DELAYED_WORK(struct delayed_work* dwork, work_func_t func) {
+	INIT_WORK(&dwork->work, func);
+	timer_setup(&dwork->timer, delayed_work_timer_fn);
+	dwork->wq = NULL;
+	dwork->cpu = 0;
+}
+
+static inline struct delayed_work* to_delayed_work(struct work_struct* work) {
+	return container_of(work, struct delayed_work, work);
+}
+
+static inline int32 work_pending(struct work_struct* work) {
+	return work->data & WORK_STRUCT_PENDING;
+}
+
+// 开机时创建的通用工作队列，schedule_work()用它
+extern struct workqueue_struct* system_wq;
+
+struct workqueue_struct* alloc_workqueue(const char* name);
+void destroy_workqueue(struct workqueue_struct* wq);
+void flush_workqueue(struct workqueue_struct* wq);
+
+int32 queue_work_on(int32 cpu, struct workqueue_struct* wq, struct work_struct* work);
+int32 queue_work(struct workqueue_struct* wq, struct work_struct* work);
+int32 cancel_work(struct work_struct* work);
+int32 queue_delayed_work_on(int32 cpu, struct workqueue_struct* wq, struct delayed_work* dwork, uint64 delay);
+int32 queue_delayed_work(struct workqueue_struct* wq, struct delayed_work* dwork, uint64 delay);
+int32 cancel_delayed_work(struct delayed_work* dwork);
+
+static inline int32 schedule_work(struct work_struct* work) {
+	return queue_work(system_wq, work);
+}
+
+static inline int32 schedule_delayed_work(struct delayed_work* dwork, uint64 delay) {
+	return queue_delayed_work(system_wq, dwork, delay);
+}
+
+void workqueue_init(void);
+
+#endif
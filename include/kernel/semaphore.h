@@ -2,13 +2,14 @@
 #define _SEMAPHORE_H_
 
 #include <kernel/sched/process.h>
+#include <kernel/sched/wait.h>
 
 #define NSEM 256
 
 typedef struct semaphore_t {
   int32 isActive;
   int32 value;
-  struct task_struct *wait_queue;
+  wait_queue_head_t wait_queue; // P操作拿不到资源的任务睡在这里
   int32 pid; // 系统信号量为-1
 } semaphore;
 
@@ -18,4 +19,4 @@ int32 sem_P(int32 sem_index);
 int32 sem_V(int32 sem_index);
 
 
-#endif
\ No newline at end of file
+#endif
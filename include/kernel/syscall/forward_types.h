@@ -3,4 +3,5 @@
 struct linux_dirent;
 struct dir_context;
 struct file;
-struct vfsmount;
\ No newline at end of file
+struct vfsmount;
+struct sched_param;
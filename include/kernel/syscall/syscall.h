@@ -1,6 +1,7 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 
+#include <kernel/config.h>
 #include <kernel/types.h>
 //#include <asm/unistd.h>
 #include "forward_types.h"
@@ -32,13 +33,34 @@ int64 sys_write(int32 fd,const void* buf, size_t count);
 int64 sys_lseek(int32 fd, off_t offset, int32 whence);
 int64 sys_mount(const char* source, const char* target, const char* fstype, uint64 flags, const void* data);
 int64 sys_getdents64(int32 fd, void* user_buf, size_t count);
+int64 sys_fsync(int32 fd);
 
 /* Process-related syscalls */
 int64 sys_exit(int32 status);
+int64 sys_exit_group(int32 status);
 int64 sys_getpid(void);
+int64 sys_gettid(void);
+int64 sys_setuid(uid_t uid);
+int64 sys_getuid(void);
+int64 sys_geteuid(void);
+int64 sys_getcpu(uint32* cpu, uint32* node, void* unused);
+int64 sys_set_tid_address(int32* tidptr);
+int64 sys_futex(uint32* uaddr, int32 op, uint32 val, const struct timespec* utime, uint32* uaddr2, uint32 val3);
 int64 sys_getppid(void);
 int64 sys_clone(uint64 flags, uint64 stack, uint64 ptid, uint64 tls, uint64 ctid);
 int64 sys_execve(const char* filename, const char* const argv[], const char* const envp[]);
+int64 sys_sched_yield(void);
+int64 sys_sched_rr_get_interval(pid_t pid, struct timespec* interval);
+int64 sys_sched_setaffinity(pid_t pid, size_t len, const uint64* user_mask);
+int64 sys_sched_getaffinity(pid_t pid, size_t len, uint64* user_mask);
+int64 sys_setpriority(int32 which, int32 who, int32 niceval);
+int64 sys_sched_setscheduler(pid_t pid, int32 policy, const struct sched_param* param);
+int64 sys_sched_setparam(pid_t pid, const struct sched_param* param);
+int64 sys_sched_getscheduler(pid_t pid);
+int64 sys_sched_getparam(pid_t pid, struct sched_param* param);
+int64 sys_sched_get_priority_max(int32 policy);
+int64 sys_sched_get_priority_min(int32 policy);
+int64 sys_getpriority(int32 which, int32 who);
 //int64 sys_wait4(pid_t pid, int32* wstatus, int32 options, struct rusage* rusage);
 
 /* Memory-related syscalls */
@@ -47,14 +69,36 @@ int64 sys_mmap(void* addr, size_t length, int32 prot, int32 flags, int32 fd, off
 int64 sys_munmap(void* addr, size_t length);
 int64 sys_mprotect(void* addr, size_t len, int32 prot);
 int64 sys_mremap(void* old_address, size_t old_size, size_t new_size, int32 flags, void* new_address);
+int64 sys_msync(void* addr, size_t length, int32 flags);
 
 /* Time-related syscalls */
 int64 sys_time(time_t* tloc);
 int64 sys_nanosleep(const struct timespec* req, struct timespec* rem);
 int64 sys_gettimeofday(struct timeval* tv, struct timezone* tz);
 int64 sys_clock_gettime(clockid_t clk_id, struct timespec* tp);
+int64 sys_clock_nanosleep(clockid_t which_clock, int32 flags, const struct timespec* req, struct timespec* rem);
+int64 sys_getitimer(int32 which, struct itimerval* value);
+int64 sys_setitimer(int32 which, const struct itimerval* value, struct itimerval* ovalue);
+int64 sys_times(struct tms* tbuf);
+int64 sys_getrusage(int32 who, struct rusage* ru);
 
 /* Misc syscalls */
+#ifdef CONFIG_LOCK_STAT
+// 内核自己的调试调用，号码在Linux的系统调用号之外
+#define SYS_lock_stat 500
+#define LOCK_STAT_RESET 0x1 // 读出后清零
+int64 sys_lock_stat(char* buf, size_t len, int32 flags);
+#endif
+// 调度统计：pid的线程组，0是自己，负数是各hart的就绪队列
+#define SYS_sched_stat 501
+int64 sys_sched_stat(pid_t pid, char* buf, size_t len);
+// 调度参数：SCHED_RR的时间片（时钟中断数）和时钟中断间隔（time CSR的tick）
+#define SYS_sched_tune 502
+struct sched_tunables {
+	uint64 timeslice;
+	uint64 timer_interval;
+};
+int64 sys_sched_tune(const struct sched_tunables* new, struct sched_tunables* old);
 int64 sys_getrandom(void* buf, size_t buflen, uint32 flags);
 int64 sys_yield(void);
 int64 sys_time(time_t* tloc);
@@ -67,6 +111,7 @@ int32 do_mount(const char* dev_name, const char* path, const char* fstype, uint6
 /* Unmount operations */
 int32 do_umount(struct vfsmount* mnt, int32 flags);
 int64 do_exit(int32 status);
+int64 do_group_exit(int32 status);
 int64 do_clone(uint64 flags, uint64 stack, uint64 ptid, uint64 tls, uint64 ctid);
 int64 do_mmap(void* addr, size_t length, int32 prot, int32 flags, int32 fd, off_t offset);
 int64 do_time(time_t* tloc);
@@ -76,7 +121,7 @@ int32 do_clock_gettime(clockid_t which_clock, struct timespec* tp);
 ssize_t do_write(int32 fd, const void *buf, size_t count);
 
 
-uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, uint64 flags, struct file* file, off_t pgoff);
+uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, uint64 flags, struct file* file, off_t offset);
 ssize_t file_read(struct file *filp, char* buf, size_t count, loff_t *ppos);
 ssize_t file_write(struct file*, const char*, size_t, loff_t*);
 
@@ -1,6 +1,8 @@
 #ifndef _KERNEL_TIME_H
 #define _KERNEL_TIME_H
 
+#include <kernel/config.h>
+#include <kernel/hrtimer.h>
 #include <kernel/sched/signal.h>
 #include <kernel/types.h>
 
@@ -8,7 +10,6 @@ extern uint64 jiffies; /* Current system time in jiffies */
 
 /** defined in <sys/time.h>
  * struct timezone;
- * struct itimerval;
  *
  *
  *
@@ -29,6 +30,9 @@ struct superblock;
 #define CLOCK_BOOTTIME 2           /* Monotonic clock that includes time system was suspended */
 #define CLOCK_PROCESS_CPUTIME_ID 3 /* Per-process CPU time clock */
 
+/* clock_nanosleep()的flags：req是绝对时刻 */
+#define TIMER_ABSTIME 1
+
 /* Filesystem time range capabilities */
 struct timerange {
 	time_t min_time;    /* Earliest representable time */
@@ -53,6 +57,26 @@ static inline void timeval_to_timespec(struct timespec* ts, const struct timeval
 	ts->tv_nsec = tv->tv_usec * NSEC_PER_USEC;
 }
 
+static inline int64 timespec_to_ns(const struct timespec* ts) {
+	return (int64)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+/* time CSR的频率，来自设备树，默认TIMEBASE_FREQ */
+extern uint64 timebase_freq;
+
+// 纳秒换成time CSR的计数，向上取整，超时不会提前到期
+static inline uint64 ns_to_ticks(uint64 ns) {
+	return ns / NSEC_PER_SEC * timebase_freq + (ns % NSEC_PER_SEC * timebase_freq + NSEC_PER_SEC - 1) / NSEC_PER_SEC;
+}
+
+// time CSR的计数换成纳秒，先除后乘，不会溢出
+static inline uint64 ticks_to_ns(uint64 ticks) {
+	return ticks / timebase_freq * NSEC_PER_SEC + ticks % timebase_freq * NSEC_PER_SEC / timebase_freq;
+}
+
+// 某个时钟上的绝对时刻换成time CSR的计数，开机以前的时刻返回0
+uint64 clock_to_ticks(clockid_t which_clock, int64 ns);
+
 /**
  * current_time - Get current system time
  * @sb: Superblock (optional, can be NULL)
@@ -127,6 +151,13 @@ int32 do_clock_getres(clockid_t which_clock, struct timespec* tp);
  */
 int32 do_nanosleep(const struct timespec* req, struct timespec* rem);
 
+/*
+ * Interval timers (kernel/itimer.c), only ITIMER_REAL
+ */
+int32 do_setitimer(int32 which, const struct itimerval* value, struct itimerval* ovalue);
+int32 do_getitimer(int32 which, struct itimerval* value);
+enum hrtimer_restart it_real_fn(struct hrtimer* timer);
+
 /* Timer functions */
 
 /*
@@ -166,4 +197,19 @@ void update_sys_time_from_hw(void);
  */
 void time_init(void);
 
+/* Timer interrupt */
+
+/* time CSR ticks between two timer interrupts, TIMER_INTERVAL by default */
+extern uint64 timer_interval;
+
+/*
+ * Enable the s-mode timer interrupt on this hart and arm the first one
+ */
+void timerinit(uint64 hartid);
+
+/*
+ * Change the timer interrupt interval at runtime, in time CSR ticks
+ */
+int32 timer_set_interval(uint64 ticks);
+
 #endif /* _KERNEL_TIME_H */
\ No newline at end of file
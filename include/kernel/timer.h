@@ -0,0 +1,51 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+
+/*
+ * 软件定时器：以jiffies计的粗粒度超时，挂在每个hart的分层时间轮上，
+ * 加入和删除都是O(1)。
+ *
+ * 到期时间按所在层的粒度向上取整，离得越远误差越大（不超过1/8），
+ * 但不会提前到期。要求准时的用hrtimer。
+ *
+ * 回调在定时器中断里运行，不能睡眠；可以重新加自己。
+ */
+
+struct timer_list {
+	struct list_head entry; // 挂在时间轮的桶上，不在轮上时为空
+	uint64 expires;         // 到期的jiffies
+	void (*function)(struct timer_list* timer);
+	uint32 flags; // 所在的hart和TIMER_MIGRATING
+	uint32 idx;   // 所在的桶
+};
+
+#define TIMER_CPUMASK 0x0000ffffU
+#define TIMER_MIGRATING 0x00010000U // 正在换到别的hart的轮上
+
+#define __TIMER_INITIALIZER(n, f) { .entry = LIST_HEAD_INIT((n).entry), .expires = 0, .function = (f), .flags = 0, .idx = 0 }
+
+#define DEFINE_TIMER(n, f) struct timer_list n = __TIMER_INITIALIZER(n, f)
+
+static inline void timer_setup(struct timer_list* timer, void (*func)(struct timer_list*)) {
+	INIT_LIST_HEAD(&timer->entry);
+	timer->expires = 0;
+	timer->function = func;
+	timer->flags = 0;
+	timer->idx = 0;
+}
+
+static inline int32 timer_pending(const struct timer_list* timer) {
+	return !list_empty(&timer->entry);
+}
+
+void add_timer(struct timer_list* timer);
+int32 mod_timer(struct timer_list* timer, uint64 expires);
+int32 del_timer(struct timer_list* timer);
+int32 del_timer_sync(struct timer_list* timer);
+
+void timers_init(void);
+
+#endif
@@ -16,80 +16,24 @@ struct trapframe {
   /* offset:264 */ uint64 epc;
 
   // kernel page table. added @lab2_1
-  /* offset:272 */ uint64 kernel_satp;
+  /* offset:272 */ uint64 kernel_satp;	// 弃用了，内核运行在进程的页表上，陷入时不换satp
 	// kernel scheduler, added @lab3_challenge2
 	/* offset:280 */ uint64 kernel_schedule;
 };
 
-#define store_all_registers(trapframe)                                                \
-  asm volatile("sd ra, 0(%0)\n"                                                \
-               "sd sp, 8(%0)\n"                                                \
-               "sd gp, 16(%0)\n"                                               \
-               "sd tp, 24(%0)\n"                                               \
-               "sd t0, 32(%0)\n"                                               \
-               "sd t1, 40(%0)\n"                                               \
-               "sd t2, 48(%0)\n"                                               \
-               "sd s0, 56(%0)\n"                                               \
-               "sd s1, 64(%0)\n"                                               \
-               "sd a0, 72(%0)\n"                                               \
-               "sd a1, 80(%0)\n"                                               \
-               "sd a2, 88(%0)\n"                                               \
-               "sd a3, 96(%0)\n"                                               \
-               "sd a4, 104(%0)\n"                                              \
-               "sd a5, 112(%0)\n"                                              \
-               "sd a6, 120(%0)\n"                                              \
-               "sd a7, 128(%0)\n"                                              \
-               "sd s2, 136(%0)\n"                                              \
-               "sd s3, 144(%0)\n"                                              \
-               "sd s4, 152(%0)\n"                                              \
-               "sd s5, 160(%0)\n"                                              \
-               "sd s6, 168(%0)\n"                                              \
-               "sd s7, 176(%0)\n"                                              \
-               "sd s8, 184(%0)\n"                                              \
-               "sd s9, 192(%0)\n"                                              \
-               "sd s10, 200(%0)\n"                                             \
-               "sd s11, 208(%0)\n"                                             \
-               "sd t3, 216(%0)\n"                                              \
-               "sd t4, 224(%0)\n"                                              \
-               "sd t5, 232(%0)\n"                                              \
-               "sd t6, 240(%0)\n"                                              \
-               :                                                               \
-               : "r"(trapframe)                                                       \
-               : "memory")
-#define restore_all_registers(trapframe)                                              \
-  asm volatile("ld ra, 0(%0)\n"                                                \
-               "ld sp, 8(%0)\n"                                                \
-               "ld gp, 16(%0)\n"                                               \
-               "ld tp, 24(%0)\n"                                               \
-               "ld t0, 32(%0)\n"                                               \
-               "ld t1, 40(%0)\n"                                               \
-               "ld t2, 48(%0)\n"                                               \
-               "ld s0, 56(%0)\n"                                               \
-               "ld s1, 64(%0)\n"                                               \
-               "ld a0, 72(%0)\n"                                               \
-               "ld a1, 80(%0)\n"                                               \
-               "ld a2, 88(%0)\n"                                               \
-               "ld a3, 96(%0)\n"                                               \
-               "ld a4, 104(%0)\n"                                              \
-               "ld a5, 112(%0)\n"                                              \
-               "ld a6, 120(%0)\n"                                              \
-               "ld a7, 128(%0)\n"                                              \
-               "ld s2, 136(%0)\n"                                              \
-               "ld s3, 144(%0)\n"                                              \
-               "ld s4, 152(%0)\n"                                              \
-               "ld s5, 160(%0)\n"                                              \
-               "ld s6, 168(%0)\n"                                              \
-               "ld s7, 176(%0)\n"                                              \
-               "ld s8, 184(%0)\n"                                              \
-               "ld s9, 192(%0)\n"                                              \
-               "ld s10, 200(%0)\n"                                             \
-               "ld s11, 208(%0)\n"                                             \
-               "ld t3, 216(%0)\n"                                              \
-               "ld t4, 224(%0)\n"                                              \
-               "ld t5, 232(%0)\n"                                              \
-               "ld t6, 240(%0)\n"                                              \
-               :                                                               \
-               : "r"(trapframe)                                                       \
-               : "memory")
+//
+// 每个hart一份，sscratch一直指向本hart的这一份。用户态陷入时入口先借
+// t0、t1两个槽暂存寄存器，从tf找到当前进程的trapframe，存完用户的tp以后
+// 再从hartid装入内核用的tp（内核一直用tp当hart号，用户的tp可以是任何值）。
+//
+struct trap_scratch {
+  /* offset:0  */ uint64 t0;
+  /* offset:8  */ uint64 t1;
+  /* offset:16 */ uint64 hartid;
+  // 下一次从用户态陷入时寄存器存到哪里，返回用户态前设好
+  /* offset:24 */ struct trapframe *tf;
+} __attribute__((aligned(64)));
+
+extern struct trap_scratch trap_scratch[NCPU];
 
 #endif
\ No newline at end of file
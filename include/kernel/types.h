@@ -96,6 +96,56 @@ struct itimerspec {
 	struct timespec it_value;    /* initial expiration */
 };
 
+/*
+ * Interval timer value for setitimer()/getitimer()
+ */
+struct itimerval {
+	struct timeval it_interval; /* timer interval */
+	struct timeval it_value;    /* current value */
+};
+
+#define ITIMER_REAL 0    /* real time, delivers SIGALRM */
+#define ITIMER_VIRTUAL 1 /* user CPU time, delivers SIGVTALRM */
+#define ITIMER_PROF 2    /* user and system CPU time, delivers SIGPROF */
+
+/*
+ * Resource usage for getrusage(), Linux layout
+ */
+struct rusage {
+	struct timeval ru_utime; /* user CPU time used */
+	struct timeval ru_stime; /* system CPU time used */
+	long ru_maxrss;
+	long ru_ixrss;
+	long ru_idrss;
+	long ru_isrss;
+	long ru_minflt;
+	long ru_majflt;
+	long ru_nswap;
+	long ru_inblock;
+	long ru_oublock;
+	long ru_msgsnd;
+	long ru_msgrcv;
+	long ru_nsignals;
+	long ru_nvcsw;  /* voluntary context switches */
+	long ru_nivcsw; /* involuntary context switches */
+};
+
+#define RUSAGE_SELF 0
+#define RUSAGE_CHILDREN (-1)
+#define RUSAGE_THREAD 1
+
+/*
+ * Process times for times(), in USER_HZ clock ticks
+ */
+struct tms {
+	long tms_utime;
+	long tms_stime;
+	long tms_cutime;
+	long tms_cstime;
+};
+
+#define USER_HZ 100 /* sysconf(_SC_CLK_TCK) in libc */
+
 /*ERRNO TYPES*/
 #define MAX_ERRNO 4095L
 #define IS_ERR_VALUE(x) ((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
@@ -137,6 +187,9 @@ typedef unsigned int vm_fault_t;
 #define VM_FAULT_LOCKED 0x000080
 #define VM_FAULT_DONE_COW 0x000100
 #define VM_FAULT_NEEDDSYNC 0x000200
+#define VM_FAULT_SIGSEGV 0x000400
+#define VM_FAULT_HWPOISON_LARGE 0x000800
+#define VM_FAULT_FALLBACK 0x001000
 
 // file system type
 /*
@@ -506,6 +506,15 @@
  #define smp_mb__before_atomic()         mb()
  #define smp_mb__after_atomic()          mb()
 
+/*
+ * 自旋等待循环体里调用。Zihintpause的pause编码为fence w,0，不支持该扩展
+ * 的核把它当作普通fence执行，所以直接写机器码，不依赖汇编器的-march。
+ */
+static inline void cpu_relax(void)
+{
+		__asm__ __volatile__ (".insn i 0x0f, 0, x0, x0, 0x010" ::: "memory");
+}
+
 
  // 读取 `sstatus`
 static inline uint64_t read_sstatus() {
@@ -526,9 +535,9 @@ static inline uint64_t disable_irqsave() {
 	return sstatus;
 }
 
-// 恢复 S-mode 中断
+// 恢复 S-mode 中断。只恢复 SIE，sstatus 的其余位（FS、SUM）在这期间可能被合法地改过
 static inline void enable_irqrestore(uint64_t flags) {
-	write_sstatus(flags);
+	asm volatile("csrs sstatus, %0" :: "r"(flags & 0x2) : "memory");
 }
 
  
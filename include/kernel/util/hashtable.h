@@ -3,7 +3,7 @@
 
 #include <kernel/types.h>
 #include <kernel/util/list.h>
-#include <kernel/util/spinlock.h>
+#include <kernel/util/rwlock.h>
 
 /**
  * 哈希表结构 - 使用container_of模式
@@ -18,8 +18,11 @@ struct hashtable {
 
 	struct hash_bucket {
 		struct list_head head; /* 链表头 */
-		spinlock_t lock;       /* 桶级锁 */
+		rwlock_t lock;         /* 桶级读写锁，查找只取读锁 */
 	}* buckets;
+#ifdef CONFIG_LOCK_STAT
+	struct lock_class* lock_class; /* 各桶锁所属的锁类 */
+#endif
 
 	/* 回调函数 */
 	uint32 (*hash_func)(const void* key); /* 返回完整哈希值，用来支持2幂的哈希表大小 */
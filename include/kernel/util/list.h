@@ -25,6 +25,11 @@ struct list_head {
 
 #define list_node list_head
 
+/*
+ * 链表的静态初始化
+ */
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+
 
 /*
  * 链表的动态初始化函数
@@ -190,6 +195,14 @@ static inline void list_splice_init(struct list_head *list,
        &pos->member != (head);                                                 \
        pos = container_of(pos->member.next, typeof(*pos), member))
 
+/*
+ * 反向遍历链表并获取结构体实例
+ */
+#define list_for_each_entry_reverse(pos, head, member)                         \
+  for (pos = container_of((head)->prev, typeof(*pos), member);                 \
+       &pos->member != (head);                                                 \
+       pos = container_of(pos->member.prev, typeof(*pos), member))
+
 /*
  * 安全遍历链表并获取结构体实例（可以在遍历中删除节点）
  */
@@ -0,0 +1,96 @@
+#ifndef _LOCK_STAT_H_
+#define _LOCK_STAT_H_
+
+#include <kernel/config.h>
+#include <kernel/types.h>
+
+/*
+ * 锁竞争统计（CONFIG_LOCK_STAT）。
+ *
+ * 同一类用途的锁归为一个锁类，按名字注册，例如所有slab缓存的锁都算
+ * "slab_cache"。每个锁类按hart分别记录：拿锁次数、需要等待的次数、
+ * 等待时间的总和与最大值、持有时间的总和与最大值，单位是rdtime的tick。
+ * 计数是per-cpu变量，按锁类的编号索引，各hart只写自己那一份，统计本身
+ * 不引入新的竞争。
+ *
+ * 初始化锁之后用lock_set_class(&lock, "name")把它归到某个锁类，没有
+ * 归类的锁不统计。spinlock_t、rwlock_t和struct mutex都支持；读写锁只统计
+ * 写者的持有时间。关掉CONFIG_LOCK_STAT后这些字段和调用全部消失。
+ *
+ * 结果通过SYS_lock_stat系统调用读出，见kernel/util/lock_stat.c。
+ */
+
+#ifdef CONFIG_LOCK_STAT
+
+#include <kernel/percpu.h>
+#include <kernel/riscv.h>
+
+#define LOCK_CLASS_MAX 32
+#define LOCK_CLASS_NAME_LEN 24
+
+struct lock_class_stats {
+	uint64 acquisitions;
+	uint64 contended;
+	uint64 wait_total;
+	uint64 wait_max;
+	uint64 hold_total;
+	uint64 hold_max;
+};
+
+struct lock_class {
+	char name[LOCK_CLASS_NAME_LEN];
+	int32 id; // 在lock_class_stats里的下标
+};
+
+DECLARE_PER_CPU(struct lock_class_stats, lock_class_stats[LOCK_CLASS_MAX]);
+
+struct lock_class* lock_class_register(const char* name);
+int64 lock_stat_dump(char* buf, size_t len);
+void lock_stat_reset(void);
+void lock_stat_init(void);
+void lock_stat_percpu_init(void);
+
+#define lock_set_class(lock, name) ((lock)->lock_class = lock_class_register(name))
+
+// 开始等待的时刻；0表示没有等待
+static inline uint64 lock_stat_wait_start(void) {
+	return read_time();
+}
+
+static inline void lock_stat_acquired(struct lock_class* cls, uint64 wait_start, uint64* held_since) {
+	struct lock_class_stats* st;
+	uint64 now;
+
+	if (!cls) return;
+	now = read_time();
+	st = this_cpu_ptr(&lock_class_stats[cls->id]);
+	st->acquisitions++;
+	if (wait_start) {
+		uint64 wait = now - wait_start;
+		st->contended++;
+		st->wait_total += wait;
+		if (wait > st->wait_max) st->wait_max = wait;
+	}
+	if (held_since) *held_since = now;
+}
+
+static inline void lock_stat_released(struct lock_class* cls, uint64 held_since) {
+	struct lock_class_stats* st;
+	uint64 hold;
+
+	if (!cls) return;
+	hold = read_time() - held_since;
+	st = this_cpu_ptr(&lock_class_stats[cls->id]);
+	st->hold_total += hold;
+	if (hold > st->hold_max) st->hold_max = hold;
+}
+
+#else
+
+#define lock_set_class(lock, name) do { } while (0)
+#define lock_stat_init() do { } while (0)
+#define lock_stat_percpu_init() do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _MCS_SPINLOCK_H_
+#define _MCS_SPINLOCK_H_
+
+#include <kernel/types.h>
+#include <kernel/util/atomic.h>
+
+/*
+ * MCS队列自旋锁。
+ *
+ * 每个等待者带一个自己的节点，排到队尾后只在自己节点的locked上自旋，
+ * 前驱解锁时直接把它置1。每个hart盯着不同的cache line，持锁hart再多
+ * 解锁也只写一条line，适合竞争很激烈的锁；无竞争时比排号锁多一次交换。
+ *
+ * 节点通常放在调用者的栈上，加锁和解锁必须传同一个节点：
+ *
+ *	struct mcs_spinlock node;
+ *	mcs_spin_lock(&lock, &node);
+ *	...
+ *	mcs_spin_unlock(&lock, &node);
+ */
+struct mcs_spinlock {
+	struct mcs_spinlock* volatile next;
+	volatile int32 locked; // 前驱交出锁后置1
+};
+
+// 锁本身就是队尾指针，NULL表示没有人持有
+typedef struct mcs_spinlock* mcs_lock_t;
+
+#define MCS_LOCK_INIT NULL
+
+static inline void mcs_spin_lock(mcs_lock_t* lock, struct mcs_spinlock* node) {
+	struct mcs_spinlock* prev;
+
+	node->next = NULL;
+	node->locked = 0;
+	prev = __atomic_exchange_n(lock, node, __ATOMIC_ACQ_REL);
+	if (!prev) return;
+
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) cpu_relax();
+}
+
+static inline int32 mcs_spin_trylock(mcs_lock_t* lock, struct mcs_spinlock* node) {
+	struct mcs_spinlock* expected = NULL;
+
+	node->next = NULL;
+	node->locked = 0;
+	return __atomic_compare_exchange_n(lock, &expected, node, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void mcs_spin_unlock(mcs_lock_t* lock, struct mcs_spinlock* node) {
+	struct mcs_spinlock* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+	if (!next) {
+		struct mcs_spinlock* expected = node;
+		// 自己还是队尾，说明没有等待者
+		if (__atomic_compare_exchange_n(lock, &expected, NULL, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+		// 有人已经换掉了队尾，但还没来得及把自己链到node后面
+		while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) cpu_relax();
+	}
+	__atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _RBTREE_H
+#define _RBTREE_H
+
+#include <kernel/types.h>
+#include <kernel/util/list.h>
+
+/*
+ * Red-black tree, intrusive like list_head: embed a struct rb_node in the
+ * object and get back to it with rb_entry().
+ *
+ * The tree does not compare keys itself. Callers walk down from the root
+ * to find the insertion point, then call rb_link_node() and
+ * rb_insert_color() to link and rebalance:
+ *
+ *	struct rb_node **link = &root->rb_node, *parent = NULL;
+ *	while (*link) {
+ *		parent = *link;
+ *		if (key < rb_entry(parent, struct foo, node)->key)
+ *			link = &parent->rb_left;
+ *		else
+ *			link = &parent->rb_right;
+ *	}
+ *	rb_link_node(&new->node, parent, link);
+ *	rb_insert_color(&new->node, root);
+ */
+
+/* The BSD tree.h used by lwext4 owns RB_RED, RB_BLACK and RB_ROOT */
+#define RB_COLOR_RED 0
+#define RB_COLOR_BLACK 1
+
+struct rb_node {
+    struct rb_node *rb_parent;
+    struct rb_node *rb_left;
+    struct rb_node *rb_right;
+    int32 rb_color;
+};
+
+struct rb_root {
+    struct rb_node *rb_node;
+};
+
+/*
+ * Tree that also caches its leftmost node, so that finding the smallest
+ * key is O(1). Use the _cached variants to insert and erase.
+ */
+struct rb_root_cached {
+    struct rb_root rb_root;
+    struct rb_node *rb_leftmost;
+};
+
+#define RB_ROOT_CACHED ((struct rb_root_cached){{NULL}, NULL})
+
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+#define rb_entry_safe(ptr, type, member)                                       \
+    ({                                                                         \
+        struct rb_node *__rb = (ptr);                                          \
+        __rb ? rb_entry(__rb, type, member) : NULL;                            \
+    })
+
+#define RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
+
+/* A node that is not in any tree points to itself, see RB_CLEAR_NODE() */
+#define RB_EMPTY_NODE(node) ((node)->rb_parent == (node))
+#define RB_CLEAR_NODE(node) ((node)->rb_parent = (node))
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **rb_link) {
+    node->rb_parent = parent;
+    node->rb_left = node->rb_right = NULL;
+    node->rb_color = RB_COLOR_RED;
+    *rb_link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+
+/* In-order traversal; NULL at either end */
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+/*
+ * @leftmost: the new node went left at every step of the descent
+ */
+static inline void rb_insert_color_cached(struct rb_node *node,
+                                          struct rb_root_cached *root,
+                                          int32 leftmost) {
+    if (leftmost) root->rb_leftmost = node;
+    rb_insert_color(node, &root->rb_root);
+}
+
+static inline void rb_erase_cached(struct rb_node *node,
+                                   struct rb_root_cached *root) {
+    if (root->rb_leftmost == node) root->rb_leftmost = rb_next(node);
+    rb_erase(node, &root->rb_root);
+}
+
+#define rb_first_cached(root) ((root)->rb_leftmost)
+
+#endif /* _RBTREE_H */
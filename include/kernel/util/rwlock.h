@@ -0,0 +1,167 @@
+#ifndef _RWLOCK_H_
+#define _RWLOCK_H_
+
+#include <kernel/config.h>
+#include <kernel/riscv.h>
+#include <kernel/util/atomic.h>
+#include <kernel/util/lock_stat.h>
+#include <kernel/util/spinlock.h>
+#ifdef CONFIG_DEBUG_LOCKS
+#include <kernel/util/print.h>
+#endif
+
+/*
+ * 读写自旋锁：多个读者可以同时持有，写者独占。和spinlock_t一样忙等，
+ * 只用于很短的、读远多于写的临界区，例如挂载表和哈希桶。
+ *
+ * cnt的低位是读者数，RW_WRITER表示写者持有。写者在等时置上RW_WAITING，
+ * 挡住新来的读者，所以源源不断的读者不会把写者饿死。
+ */
+#define RW_WRITER 0x80000000U
+#define RW_WAITING 0x40000000U
+#define RW_READERS (RW_WAITING - 1)
+
+typedef struct {
+	volatile uint32 cnt;
+#ifdef CONFIG_DEBUG_LOCKS
+	volatile int32 owner_cpu; // 持有写锁的hart，没有时为-1
+#endif
+#ifdef CONFIG_LOCK_STAT
+	struct lock_class* lock_class;
+	uint64 held_since; // 写者拿到锁的时刻
+#endif
+} rwlock_t;
+
+#ifdef CONFIG_DEBUG_LOCKS
+#define RWLOCK_INIT { .cnt = 0, .owner_cpu = -1 }
+#else
+#define RWLOCK_INIT { .cnt = 0 }
+#endif
+
+static inline void rwlock_init(rwlock_t* lock) {
+	lock->cnt = 0;
+#ifdef CONFIG_DEBUG_LOCKS
+	lock->owner_cpu = -1;
+#endif
+}
+
+// 只尝试一次，不计入统计；下面的加锁函数在它外面记账
+static inline int32 __read_trylock(rwlock_t* lock) {
+	uint32 c = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+
+	while (!(c & (RW_WRITER | RW_WAITING))) {
+		if (__atomic_compare_exchange_n(&lock->cnt, &c, c + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return 1;
+	}
+	return 0;
+}
+
+static inline int32 __write_trylock(rwlock_t* lock) {
+	uint32 c = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+
+	// 等待位可能是别的写者留下的，拿到锁时一并清掉，它会重新置上
+	if ((c & ~RW_WAITING) || !__atomic_compare_exchange_n(&lock->cnt, &c, RW_WRITER, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return 0;
+#ifdef CONFIG_DEBUG_LOCKS
+	lock->owner_cpu = read_tp();
+#endif
+	return 1;
+}
+
+static inline int32 read_trylock(rwlock_t* lock) {
+	if (!__read_trylock(lock)) return 0;
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, 0, NULL);
+#endif
+	return 1;
+}
+
+static inline void read_lock(rwlock_t* lock) {
+#ifdef CONFIG_LOCK_STAT
+	uint64 wait_start = 0;
+#endif
+#ifdef CONFIG_DEBUG_LOCKS
+	// 本hart持有写锁时再读，一定会死锁
+	if (lock->owner_cpu == (int32)read_tp()) panic("read_lock: write lock held by this hart\n");
+#endif
+	if (!__read_trylock(lock)) {
+#ifdef CONFIG_LOCK_STAT
+		wait_start = lock_stat_wait_start();
+#endif
+		while (!__read_trylock(lock)) cpu_relax();
+	}
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, wait_start, NULL);
+#endif
+}
+
+static inline void read_unlock(rwlock_t* lock) {
+#ifdef CONFIG_DEBUG_LOCKS
+	if (!(lock->cnt & RW_READERS)) panic("read_unlock: lock not read-held\n");
+#endif
+	__atomic_fetch_sub(&lock->cnt, 1, __ATOMIC_RELEASE);
+}
+
+static inline int32 write_trylock(rwlock_t* lock) {
+	if (!__write_trylock(lock)) return 0;
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, 0, &lock->held_since);
+#endif
+	return 1;
+}
+
+static inline void write_lock(rwlock_t* lock) {
+#ifdef CONFIG_LOCK_STAT
+	uint64 wait_start = 0;
+#endif
+#ifdef CONFIG_DEBUG_LOCKS
+	if (lock->owner_cpu == (int32)read_tp()) panic("write_lock: recursive locking on this hart\n");
+#endif
+	if (!__write_trylock(lock)) {
+#ifdef CONFIG_LOCK_STAT
+		wait_start = lock_stat_wait_start();
+#endif
+		while (!__write_trylock(lock)) {
+			uint32 c = __atomic_load_n(&lock->cnt, __ATOMIC_RELAXED);
+			if (!(c & RW_WAITING)) __atomic_fetch_or(&lock->cnt, RW_WAITING, __ATOMIC_RELAXED);
+			cpu_relax();
+		}
+	}
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, wait_start, &lock->held_since);
+#endif
+}
+
+static inline void write_unlock(rwlock_t* lock) {
+#ifdef CONFIG_DEBUG_LOCKS
+	if (lock->owner_cpu != (int32)read_tp()) panic("write_unlock: lock not write-held by this hart\n");
+	lock->owner_cpu = -1;
+#endif
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_released(lock->lock_class, lock->held_since);
+#endif
+	__atomic_fetch_and(&lock->cnt, ~RW_WRITER, __ATOMIC_RELEASE);
+}
+
+static inline int64 read_lock_irqsave(rwlock_t* lock) {
+	int64 flags = disable_irqsave();
+	read_lock(lock);
+	return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock_t* lock, int64 flags) {
+	read_unlock(lock);
+	enable_irqrestore(flags);
+}
+
+static inline int64 write_lock_irqsave(rwlock_t* lock) {
+	int64 flags = disable_irqsave();
+	write_lock(lock);
+	return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock_t* lock, int64 flags) {
+	write_unlock(lock);
+	enable_irqrestore(flags);
+}
+
+#endif
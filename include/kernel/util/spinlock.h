@@ -6,43 +6,92 @@
 #define _RISCV_SPINLOCK_H_
 #include <stdint.h>
 #include <kernel/util/atomic.h>
+#include <kernel/util/lock_stat.h>
 
-
+/*
+ * 排号自旋锁（ticket lock）。
+ *
+ * 加锁时用一次amoadd.w从next取号，然后只读地等owner轮到自己；解锁只有
+ * 持有者写owner。等待的hart之间不再反复用AMO抢同一条cache line，并且
+ * 严格按取号顺序拿到锁，不会有hart被饿死。
+ *
+ * 两个16位字段放在同一个32位字里，trylock可以用一次CAS同时检查并取号。
+ * 竞争非常激烈、持锁hart很多的地方可以改用mcs_spinlock.h里的MCS锁。
+ */
+#define TICKET_SHIFT 16
 
 typedef struct {
-  atomic_flag lock;
+	union {
+		volatile uint32 val;
+		struct {
+			volatile uint16 owner; // 正在服务的号，小端下在低16位
+			volatile uint16 next;  // 下一个要发出的号
+		};
+	};
+#ifdef CONFIG_LOCK_STAT
+	struct lock_class* lock_class;
+	uint64 held_since;
+#endif
 } spinlock_t;
 
-#define SPINLOCK_INIT  ATOMIC_FLAG_INIT 
+#define SPINLOCK_INIT { { 0 } }
 
 static inline void spinlock_init(spinlock_t* lock) {
-	atomic_flag_clear(&lock->lock);
+	__atomic_store_n(&lock->val, 0, __ATOMIC_RELEASE);
+}
+
+static inline int32 spinlock_is_locked(spinlock_t* lock) {
+	uint32 v = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+	return (uint16)v != (uint16)(v >> TICKET_SHIFT);
 }
 
 static inline int32 spinlock_trylock(spinlock_t* lock) {
-    return atomic_flag_test_and_set(&lock->lock) == 0;  // 成功返回 1
+	uint32 v = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+
+	if ((uint16)v != (uint16)(v >> TICKET_SHIFT)) return 0;
+	if (!__atomic_compare_exchange_n(&lock->val, &v, v + (1U << TICKET_SHIFT), 0, __ATOMIC_ACQUIRE,
+	                                 __ATOMIC_RELAXED))
+		return 0;
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, 0, &lock->held_since);
+#endif
+	return 1;  // 成功返回 1
 }
 
 static inline void spinlock_lock(spinlock_t* lock) {
-    while (atomic_flag_test_and_set(&lock->lock)) {
-        // 自旋等待
-    }
+	uint32 v = __atomic_fetch_add(&lock->val, 1U << TICKET_SHIFT, __ATOMIC_ACQUIRE);
+	uint16 ticket = v >> TICKET_SHIFT;
+	uint16 owner = v;
+#ifdef CONFIG_LOCK_STAT
+	uint64 wait_start = owner != ticket ? lock_stat_wait_start() : 0;
+#endif
+
+	while (owner != ticket) {
+		// 前面每多一个等待者多等一会，少去读被频繁写的那条cache line
+		for (uint16 i = (uint16)(ticket - owner); i; i--) cpu_relax();
+		owner = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE);
+	}
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, wait_start, &lock->held_since);
+#endif
 }
 
 static inline void spinlock_unlock(spinlock_t* lock) {
-    atomic_flag_clear(&lock->lock);
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_released(lock->lock_class, lock->held_since);
+#endif
+	// 只有持有者会写owner，不需要原子加
+	__atomic_store_n(&lock->owner, (uint16)(lock->owner + 1), __ATOMIC_RELEASE);
 }
 
 static inline void spinlock_unlock_irqrestore(spinlock_t* lock, int64 flags) {
-    atomic_flag_clear(&lock->lock);
-    enable_irqrestore(flags);
+	spinlock_unlock(lock);
+	enable_irqrestore(flags);
 }
 
 static inline int64 spinlock_lock_irqsave(spinlock_t* lock) {
 	int64 flags = disable_irqsave();
-	while (atomic_flag_test_and_set(&lock->lock)) {
-			// 自旋等待
-	}
+	spinlock_lock(lock);
 	return flags;
 }
 
@@ -0,0 +1,56 @@
+#ifndef _VDSO_H_
+#define _VDSO_H_
+
+#include <kernel/mm/memlayout.h>
+
+/*
+ * vDSO：映射进每个进程的两页，用户态读时钟不用进内核。
+ *
+ * 前一页是计时核心（kernel/time.c）维护的vdso_data，用户只读；后一页是
+ * 一个很小的ELF共享对象（kernel/arch/riscv/vdso.S），导出
+ * __vdso_clock_gettime和__vdso_gettimeofday，通过auxv的AT_SYSINFO_EHDR
+ * 交给libc。代码按相对pc的距离找数据页，两页必须紧挨着。
+ *
+ * 两页都在内核镜像里，所有进程映射同一份物理页。
+ */
+
+// 在用户栈预留区域的下面
+#define VDSO_DATA_BASE (USER_STACK_TOP - TD_USTACK_SIZE - 2 * PAGE_SIZE)
+#define VDSO_TEXT_BASE (VDSO_DATA_BASE + PAGE_SIZE)
+
+// struct vdso_data的偏移，vdso.S用
+#define VDSO_SEQ 0
+#define VDSO_MULT 4
+#define VDSO_SHIFT 8
+#define VDSO_CYCLE_LAST 16
+#define VDSO_MONO_NS 24
+#define VDSO_WALL_OFFSET 32
+
+#ifndef __ASSEMBLER__
+
+#include <kernel/types.h>
+
+struct mm_struct;
+
+/*
+ * 读者先读seq，是奇数（写者正在改）或者读完后seq变了就重读。
+ * CLOCK_MONOTONIC = mono_ns + ((time - cycle_last) * mult >> shift)，
+ * CLOCK_REALTIME再加上wall_offset。
+ */
+struct vdso_data {
+	uint32 seq;
+	uint32 mult;
+	uint32 shift;
+	uint32 __pad;
+	uint64 cycle_last; // 上次更新时的time CSR
+	uint64 mono_ns;    // cycle_last时刻的CLOCK_MONOTONIC
+	int64 wall_offset; // CLOCK_REALTIME - CLOCK_MONOTONIC
+};
+
+extern struct vdso_data* const vdso_data;
+
+int32 vdso_map(struct mm_struct* mm);
+
+#endif /* __ASSEMBLER__ */
+
+#endif
@@ -10,6 +10,7 @@
 
 uint64_t dtbEntry = 0;
 struct MemInfo memInfo;
+uint32_t timebaseFreq = 0;
 
 static void swapChar(void* a, void* b) {
 	char c = *(char*)a;
@@ -118,7 +119,8 @@ static void* parseFdtNode(struct FDTHeader* fdtHeader, void* node, char* parent)
 				node += 4;
 				uint32_t nameoff = readBigEndian32(node);
 				node += 4;
-				char* name = (char*)(node + fdtHeader->off_dt_strings + nameoff);
+				// 属性名在strings块里，偏移从设备树头算起
+				char* name = (char*)fdtHeader + fdtHeader->off_dt_strings + nameoff;
 
 				if (name[0] != '\0') {
 					// log(LEVEL_MODULE, "name:   %s\n", name);
@@ -139,6 +141,11 @@ static void* parseFdtNode(struct FDTHeader* fdtHeader, void* node, char* parent)
 					// log(LEVEL_MODULE, "values: %s\n", nodeStr);
 				}
 
+				// /cpus节点上的time CSR频率
+				if (len == 4 && strcmp(name, "timebase-frequency") == 0) {
+					timebaseFreq = readBigEndian32(node);
+				}
+
 				node = (void*)FOURROUNDUP((uint64_t)(node + len));
 				while (readBigEndian32(node) == FDT_NOP) {
 					node += 4;
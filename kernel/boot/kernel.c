@@ -5,10 +5,13 @@
 #include <kernel/boot/dtb.h>
 #include <kernel/device/sbi.h>
 #include <kernel/elf.h>
+#include <kernel/hrtimer.h>
 #include <kernel/mmu.h>
 #include <kernel/riscv.h>
 #include <kernel/sched.h>
 #include <kernel/syscall/syscall.h>
+#include <kernel/time.h>
+#include <kernel/timer.h>
 #include <kernel/types.h>
 #include <kernel/util.h>
 #include <kernel/vfs.h>
@@ -113,7 +116,7 @@ int32 create_init_process(void) {
 	if (!init_task) return -ENOMEM;
 
 	// Set up process ID and other basic attributes
-	init_task->pid = 1;
+	change_pid(init_task, INIT_PID);
 	init_task->parent = NULL; // No parent
 
 	setup_init_fds(init_task);
@@ -122,7 +125,7 @@ int32 create_init_process(void) {
 	if (error) goto fail_exec;
 
 	// Add to scheduler queue and start running
-	insert_to_ready_queue(init_task);
+	wake_up_new_task(init_task);
 
 	// we should never reach here.
 	return 0;
@@ -133,57 +136,89 @@ fail_exec:
 		if (init_task->fdtable->fd_array[fd]) fdtable_closeFd(init_task->fdtable, fd);
 	}
 fail_fds:
-	fs_struct_unref(init_task->fs);
 fail_fs:
+	// fs_struct和fd表由free_process()放掉
 	free_process(init_task);
 	return error;
 }
 
 void start_trap() { while (1); }
 
-struct task_struct boot_task;
+// boot_task、boot_trapframe和trap_scratch在per-cpu区建好之前就要用，是普通数组
+struct task_struct boot_task[NCPU];
 
 
-struct trapframe boot_trapframe;
-// 这个boot_trapframe应该给每个核都发一个
+// 每个核一份boot_trapframe
+struct trapframe boot_trapframe[NCPU];
+// sscratch指向的每个hart一份的暂存区，第一次陷入前就要设好，所以不放per-cpu
+struct trap_scratch trap_scratch[NCPU];
 void boot_trap_setup(void){
-	current_percpu[read_tp()] = &boot_task;
-	boot_task.trapframe = &boot_trapframe;
+	int32 hartid = read_tp();
+	this_cpu_write(current_percpu, &boot_task[hartid]);
+	boot_task[hartid].trapframe = &boot_trapframe[hartid];
 
+	// 之后stvec和sscratch不再改。启动阶段一直在S态，smode_trap_vector按SPP转到内核入口
 	extern char smode_trap_vector[];
-	write_csr(sstatus, read_csr(sstatus) | SSTATUS_SIE);
+	trap_scratch[hartid].hartid = hartid;
+	trap_scratch[hartid].tf = &boot_trapframe[hartid];
+	write_csr(sscratch, (uint64)&trap_scratch[hartid]);
 	write_csr(stvec, (uint64)smode_trap_vector);
-	write_csr(sscratch, (uint64)&boot_trapframe);
+	write_csr(sstatus, read_csr(sstatus) | SSTATUS_SIE);
 	uint64 ksp = read_reg(sp);
-	boot_trapframe.kernel_sp = ROUNDUP(ksp, PAGE_SIZE);
-	boot_trapframe.kernel_schedule = (uint64)schedule;
+	boot_trapframe[hartid].kernel_sp = ROUNDUP(ksp, PAGE_SIZE);
+	boot_trapframe[hartid].kernel_schedule = (uint64)schedule;
 
 	return;
 }
 
+// 时钟、核间和外部中断，以及本hart的idle任务；之后本hart参与调度
+static void hart_online(uint64 hartid) {
+	extern void init_idle_task(int32 hartid);
+
+	write_csr(sie, read_csr(sie) | SIE_SEIE | SIE_STIE | SIE_SSIE);
+	// init timing. added @lab1_3
+	timerinit(hartid);
+	init_idle_task(hartid);
+	__sync_fetch_and_or(&cpu_online_mask, 1UL << hartid);
+}
 
 //
-// s_start: S-mode entry point of riscv-pke OS kernel.
+// s_start_secondary: entry of the other harts, started by
+// smp_boot_secondary_harts() after the boot hart has set everything up.
 //
-volatile static int32 sig = 1;
-volatile static int counter = 0;
+void s_start_secondary(uintptr_t hartid) {
+	write_tp(hartid);
+	boot_trap_setup();
+
+	pagetable_activate(g_kernel_pagetable);
+	boot_trapframe[hartid].kernel_satp = MAKE_SATP(g_kernel_pagetable);
+	hart_online(hartid);
+
+	kprintf("hart %d online\n", hartid);
+#ifdef CONFIG_LOCK_BENCH
+	lock_bench_run();
+#endif
+	schedule();
+}
 
+
+//
+// s_start: S-mode entry point of riscv-pke OS kernel.
+// only the boot hart gets here; SBI keeps the others stopped until
+// smp_boot_secondary_harts() starts them.
+//
 void s_start(uintptr_t hartid, uintptr_t dtb) {
+	extern int32 boot_hartid;
+
 	write_tp(hartid);
+	if (hartid >= NCPU) panic("boot hart %d is out of range (NCPU = %d)\n", hartid, NCPU);
+	boot_hartid = hartid;
 	boot_trap_setup();
 	// 最重要！先把中断服务程序挂上去，不然崩溃都不知道怎么死的。
 
-	if (hartid == 0) {
-		// spike_file_init(); //TODO: 将文件系统迁移到 QEMU
-		// init_dtb(dtb);
-		parseDtb(dtb);
-	}
-	if (NCPU > 1) sync_barrier(&counter, NCPU);
-	write_csr(sie, read_csr(sie) | SIE_SEIE | SIE_STIE); // 不启用核间中断（暂时） TODO
-
-	// init timing. added @lab1_3
-	// lab1_challenge1 为了调试便利，禁用了外部时钟中断：
-	// timerinit(hartid);
+	// spike_file_init(); //TODO: 将文件系统迁移到 QEMU
+	// init_dtb(dtb);
+	parseDtb(dtb);
 
 	// switch to supervisor mode (S mode) and jump to s_start(), i.e., set pc to
 	// mepc
@@ -199,34 +234,41 @@ void s_start(uintptr_t hartid, uintptr_t dtb) {
 
 	//write_csr(stvec, (uint64)start_trap);
 
-	extern void init_idle_task(void);
-
 	kprintf("Enter supervisor mode...\n");
 	write_csr(satp, 0);
 
-	if (hartid == 0) {
-		init_page_manager();
-		kernel_vm_init();
-		pagetable_activate(g_kernel_pagetable);
-		boot_trapframe.kernel_satp = MAKE_SATP(g_kernel_pagetable);
-		create_init_mm();
-		kmem_init();
-		init_scheduler();
-
-		init_idle_task();
-		// kmalloc在形式上需要使用init_mm的“用户虚拟空间分配器”
-		// 所以我们在启用kmalloc之前，需要先初始化0号进程
-
-		// init_scheduler();
-		vfs_init();
-		sig = 0;
-	} else {
-		while (sig) {
-		}
-		pagetable_activate(g_kernel_pagetable);
-	}
-
-	// sync_barrier(&sync_counter, NCPU);
+	lock_stat_init();
+	init_page_manager();
+	kernel_vm_init();
+	pagetable_activate(g_kernel_pagetable);
+	boot_trapframe[hartid].kernel_satp = MAKE_SATP(g_kernel_pagetable);
+	create_init_mm();
+	kmem_init();
+	// 之后每个hart用自己的一份per-cpu变量，其他hart启动前就要建好
+	setup_per_cpu_areas();
+	// 之前写进模板的值被复制到了每一份里，按hart重新设：只有本hart在跑boot_task
+	for_each_possible_cpu(cpu) per_cpu(current_percpu, cpu) = cpu == hartid ? &boot_task[hartid] : NULL;
+	lock_stat_percpu_init();
+	time_init();
+	init_scheduler();
+
+	hart_online(hartid);
+	// kmalloc在形式上需要使用init_mm的“用户虚拟空间分配器”
+	// 所以我们在启用kmalloc之前，需要先初始化0号进程
+
+	// init_scheduler();
+	vfs_init();
+	smp_boot_secondary_harts();
+#ifdef CONFIG_LOCK_BENCH
+	lock_bench_run();
+#endif
+	hrtimers_init();
+	timers_init();
+	futex_init();
+	workqueue_init();
+#ifdef CONFIG_SWITCH_BENCH
+	switch_bench_start();
+#endif
 
 	//  写入satp寄存器并刷新tlb缓存
 	//    从这里开始，所有内存访问都通过MMU进行虚实转换
@@ -0,0 +1,206 @@
+/*
+ * 时钟事件层：按需为SBI定时器编程一次性截止时刻
+ *
+ * 有任务运行时保留周期tick，用来给时间片记账；就绪队列为空时
+ * tick_nohz_idle_enter()停掉tick，只为最早的定时源编程，没有定时源时
+ * 定时器被设为永不触发。jiffies不再靠逐次累加，而是按流逝的时间补记，
+ * 所以停掉tick不会让它变慢。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/device/sbi.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+#include <kernel/util/spinlock.h>
+
+DEFINE_PER_CPU(struct clock_event_device, clockevents);
+
+/*
+ * 定时源只在启动时注册，从不删除：先写好槽位再发布个数，中断里按个数
+ * 遍历不用拿锁，各hart的到期处理不会互相等待。锁只用来串行注册。
+ */
+static struct clock_event_source* clock_sources[CLOCKEVENT_MAX_SOURCES];
+static int32 nr_clock_sources;
+static spinlock_t clock_sources_lock = SPINLOCK_INIT;
+
+// 读到的个数之内的槽位都已经写好
+static inline int32 clock_sources_count(void) {
+	int32 n = READ_ONCE(nr_clock_sources);
+
+	__sync_synchronize();
+	return n;
+}
+
+// jiffies按tick网格补记，任何一个hart都可以推进它
+static spinlock_t jiffies_lock = SPINLOCK_INIT;
+static uint64 tick_last_update;
+
+static void clockevent_program(struct clock_event_device* ce, uint64 deadline) {
+	ce->next_event = deadline;
+	SBI_SET_TIMER(deadline);
+}
+
+/*
+ * 把jiffies推进到now，返回推进的tick数
+ */
+static uint64 tick_do_update_jiffies(uint64 now) {
+	uint64 ticks = 0;
+
+	spinlock_lock(&jiffies_lock);
+	if (now - tick_last_update >= timer_interval) {
+		ticks = (now - tick_last_update) / timer_interval;
+		jiffies += ticks;
+		tick_last_update += ticks * timer_interval;
+	}
+	spinlock_unlock(&jiffies_lock);
+	return ticks;
+}
+
+static uint64 clockevent_next_deadline(struct clock_event_device* ce) {
+	uint64 deadline = ce->tick_stopped ? CLOCKEVENT_NONE : ce->tick_next;
+	int32 n = clock_sources_count();
+
+	for (int32 i = 0; i < n; i++) {
+		uint64 next = clock_sources[i]->next_deadline();
+		if (next < deadline) deadline = next;
+	}
+	return deadline;
+}
+
+/**
+ * clockevent_init - Start the clock event device of this hart
+ * @hartid: The calling hart
+ */
+void clockevent_init(uint64 hartid) {
+	struct clock_event_device* ce = per_cpu_ptr(&clockevents, hartid);
+	uint64 now = read_time();
+
+	if (!tick_last_update) tick_last_update = now;
+	ce->tick_stopped = 0;
+	ce->idle_time = 0;
+	ce->nr_events = 0;
+	ce->in_handler = 0;
+	ce->tick_next = now + timer_interval;
+	clockevent_program(ce, ce->tick_next);
+}
+
+/**
+ * clockevent_register_source - Add a source of timer deadlines
+ * @src: The source, ->next_deadline and ->expire must be set
+ */
+void clockevent_register_source(struct clock_event_source* src) {
+	spinlock_lock(&clock_sources_lock);
+	if (nr_clock_sources >= CLOCKEVENT_MAX_SOURCES) panic("clockevent: too many sources, %s\n", src->name);
+	clock_sources[nr_clock_sources] = src;
+	__sync_synchronize();
+	WRITE_ONCE(nr_clock_sources, nr_clock_sources + 1);
+	spinlock_unlock(&clock_sources_lock);
+}
+
+/**
+ * clockevent_reprogram - Pull the timer in if a source now expires earlier
+ */
+void clockevent_reprogram(void) {
+	struct clock_event_device* ce = this_cpu_ptr(&clockevents);
+	uint64 deadline;
+
+	// 回调里重新加的定时器由中断处理结束时统一编程
+	if (ce->in_handler) return;
+	deadline = clockevent_next_deadline(ce);
+	if (deadline < ce->next_event) clockevent_program(ce, deadline);
+}
+
+/**
+ * clockevent_handle_event - Timer interrupt handler
+ *
+ * SBI set_timer also clears the pending interrupt, so reprogramming at the
+ * end doubles as the acknowledgement.
+ */
+void clockevent_handle_event(void) {
+	struct clock_event_device* ce = this_cpu_ptr(&clockevents);
+	uint64 now = read_time();
+	int32 n;
+
+	ce->nr_events++;
+	tick_do_update_jiffies(now);
+
+	if (!ce->tick_stopped && now >= ce->tick_next) {
+		scheduler_tick();
+		// 错过的tick不补，下一次仍然落在tick网格上
+		while (ce->tick_next <= now) ce->tick_next += timer_interval;
+	}
+
+	ce->in_handler = 1;
+	n = clock_sources_count();
+	for (int32 i = 0; i < n; i++) {
+		struct clock_event_source* src = clock_sources[i];
+		if (src->next_deadline() <= now) src->expire(now);
+	}
+	ce->in_handler = 0;
+
+	clockevent_program(ce, clockevent_next_deadline(ce));
+}
+
+/**
+ * tick_nohz_idle_enter - Stop the periodic tick before the hart goes idle
+ *
+ * Must be called with interrupts disabled.
+ */
+void tick_nohz_idle_enter(void) {
+	struct clock_event_device* ce = this_cpu_ptr(&clockevents);
+	uint64 deadline;
+
+	ce->idle_start = read_time();
+	ce->tick_stopped = 1;
+	deadline = clockevent_next_deadline(ce);
+	if (deadline != ce->next_event) clockevent_program(ce, deadline);
+}
+
+/**
+ * tick_nohz_idle_exit - Restart the periodic tick when work shows up
+ *
+ * Catches jiffies up with the time spent idle and charges it to the hart.
+ * Must be called with interrupts disabled.
+ */
+void tick_nohz_idle_exit(void) {
+	struct clock_event_device* ce = this_cpu_ptr(&clockevents);
+	uint64 now = read_time();
+
+	ce->idle_time += now - ce->idle_start;
+	ce->tick_stopped = 0;
+	tick_do_update_jiffies(now);
+	ce->tick_next = tick_last_update + timer_interval;
+	if (ce->tick_next < ce->next_event) clockevent_program(ce, ce->tick_next);
+}
+
+/**
+ * cpu_idle_time - Time a hart has spent idle, in time CSR ticks
+ * @hartid: The hart
+ */
+uint64 cpu_idle_time(int32 hartid) {
+	struct clock_event_device* ce = per_cpu_ptr(&clockevents, hartid);
+	uint64 idle = ce->idle_time;
+
+	if (ce->tick_stopped) idle += read_time() - ce->idle_start;
+	return idle;
+}
+
+/**
+ * jiffies_deadline - Time CSR value at which a jiffy begins
+ * @j: The jiffy
+ *
+ * Lies on the same grid as the periodic tick, so a timer source that
+ * returns it never fires just before jiffies has moved on.
+ *
+ * Returns 0 if @j has already begun. Must be called with interrupts disabled.
+ */
+uint64 jiffies_deadline(uint64 j) {
+	uint64 deadline = 0;
+
+	spinlock_lock(&jiffies_lock);
+	if (j > jiffies) deadline = tick_last_update + (j - jiffies) * timer_interval;
+	spinlock_unlock(&jiffies_lock);
+	return deadline;
+}
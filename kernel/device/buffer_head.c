@@ -1,5 +1,6 @@
 #include <kernel/device/buffer_head.h>
 #include <kernel/mm/kmalloc.h>
+#include <kernel/sched.h>
 #include <kernel/types.h>
 #include <kernel/util/hashtable.h>
 #include <kernel/util/list.h>
@@ -62,6 +63,7 @@ struct buffer_head* alloc_buffer_head(void) {
 		memset(bh, 0, sizeof(struct buffer_head));
 		INIT_LIST_HEAD(&bh->b_lru);
 		spinlock_init(&bh->b_lock);
+		init_waitqueue_head(&bh->b_wait);
 		atomic_set(&bh->b_count, 0);
 	}
 	return bh;
@@ -226,25 +228,35 @@ void ll_rw_block(int32 rw, int32 nr, struct buffer_head* bhs[]) {
 	}
 }
 
-// 锁住一个缓冲区
+// 锁住一个缓冲区。BH_Lock是睡眠锁，I/O期间一直持有；b_lock只保护这个位
 void lock_buffer(struct buffer_head* bh) {
-	spinlock_lock(&bh->b_lock);
-	set_buffer_locked(bh);
+	for (;;) {
+		spinlock_lock(&bh->b_lock);
+		if (!buffer_locked(bh)) {
+			set_buffer_locked(bh);
+			spinlock_unlock(&bh->b_lock);
+			return;
+		}
+		spinlock_unlock(&bh->b_lock);
+		wait_on_buffer(bh);
+	}
 }
 
-// 解锁一个缓冲区
+// 解锁一个缓冲区，唤醒等它的任务
 void unlock_buffer(struct buffer_head* bh) {
+	spinlock_lock(&bh->b_lock);
 	clear_buffer_locked(bh);
 	spinlock_unlock(&bh->b_lock);
+	wake_up_all(&bh->b_wait);
 }
 
-// 等待缓冲区操作完成
+// 等待缓冲区操作完成，等待期间不占用CPU
 void wait_on_buffer(struct buffer_head* bh) {
-	while (buffer_locked(bh)) {
-		// 在实际实现中，这里应该使用睡眠/唤醒机制
-		// 简单起见，使用简单的轮询
-		// yield_cpu(); // 让出CPU时间
-	}
+	// 算作等I/O，记进iowait
+	int32 token = io_schedule_prepare();
+
+	wait_event(bh->b_wait, !buffer_locked(bh));
+	io_schedule_finish(token);
 }
 
 // 初始化buffer_head子系统
@@ -259,6 +271,7 @@ void buffer_init(void) {
 	// 初始化LRU列表
 	INIT_LIST_HEAD(&bh_lru_list);
 	spinlock_init(&bh_lru_lock);
+	lock_set_class(&bh_lru_lock, "bh_lru_lock");
 }
 
 // 同步脏缓冲区
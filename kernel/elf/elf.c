@@ -14,6 +14,7 @@
 #include <kernel/riscv.h>
 #include <kernel/sched/process.h>
 #include <kernel/trapframe.h>
+#include <kernel/vdso.h>
 
 #include <kernel/util/print.h>
 #include <kernel/util/string.h>
@@ -27,6 +28,7 @@ typedef struct elf_context {
   struct task_struct *proc; // 目标进程
   elf_header ehdr;          // ELF头部
   uint64 entry_point;       // 入口点
+  uint64 phdr_addr;         // 程序头表在用户空间的地址，不在任何段里时为0
 } elf_context;
 
 static int32 init_elf_context(elf_context *ctx, int32 fd, struct task_struct *proc);
@@ -41,6 +43,7 @@ static ssize_t elf_read_at(elf_context *ctx, void* dest, size_t size,
                            off_t offset);
 static int32 load_debug_information(elf_context *ctx);
 static int32 load_elf_binary(elf_context *ctx);
+static int32 setup_user_stack(elf_context *ctx);
 
 
 
@@ -413,6 +416,37 @@ static int32 load_debug_information(elf_context *ctx) {
 }
 
 
+/**
+ * 在用户栈顶放好argc、argv、envp和辅助向量，并设置sp
+ * 还没有参数和环境变量，argv和envp都只有结尾的NULL；辅助向量里的
+ * AT_SYSINFO_EHDR告诉libc vDSO的位置
+ *
+ * @param ctx ELF上下文
+ * @return 0表示成功，非0表示失败
+ */
+static int32 setup_user_stack(elf_context *ctx) {
+  struct task_struct *proc = ctx->proc;
+  uint64 frame[] = {
+      0, // argc
+      0, // argv[0]
+      0, // envp[0]
+      AT_PHDR, ctx->phdr_addr,
+      AT_PHENT, sizeof(elf_prog_header),
+      AT_PHNUM, ctx->phdr_addr ? ctx->ehdr.phnum : 0,
+      AT_PAGESZ, PAGE_SIZE,
+      AT_ENTRY, ctx->entry_point,
+      AT_SYSINFO_EHDR, VDSO_TEXT_BASE,
+      AT_NULL, 0,
+  };
+  // ABI要求sp按16字节对齐
+  uint64 sp = ROUNDDOWN(proc->mm->end_stack - sizeof(frame), 16);
+
+  if (mm_copy_to_user(proc->mm, sp, frame, sizeof(frame)) != sizeof(frame))
+    return -1;
+  proc->trapframe->regs.sp = sp;
+  return 0;
+}
+
 /**
  * 加载ELF文件到进程
  *
@@ -438,6 +472,11 @@ static int32 load_elf_binary(elf_context *ctx) {
       kprintf("Failed to load segment %d\n", i);
       return -1;
     }
+
+    // 程序头表被哪个段装进来，libc要从AT_PHDR找TLS段
+    if (ph.type == ELF_PROG_LOAD && ph.off <= ehdr->phoff &&
+        ehdr->phoff < ph.off + ph.filesz)
+      ctx->phdr_addr = ph.vaddr + ehdr->phoff - ph.off;
   }
 
   // 设置全局指针
@@ -446,6 +485,11 @@ static int32 load_elf_binary(elf_context *ctx) {
   // 设置进程入口点
   ctx->proc->trapframe->epc = ctx->entry_point;
 
+  if (setup_user_stack(ctx) != 0) {
+    kprintf("Failed to set up the user stack\n");
+    return -1;
+  }
+
   kprintf("ELF loaded successfully, entry point: 0x%lx\n", ctx->entry_point);
   return 0;
 }
@@ -1,5 +1,7 @@
 #include <kernel/fs/ext4_adaptor.h>
 #include <kernel/mm/kmalloc.h>
+#include <kernel/mm/filemap.h>
+#include <kernel/mm/page.h>
 #include <kernel/util/print.h>
 #include <kernel/types.h>
 #include <kernel/util/string.h>
@@ -200,12 +202,98 @@ static int32 EXT4_dir_open(struct file* file, int32 flags)
  
 
 
+/**
+ * EXT4_file_readpage - Fill a page cache page from the file
+ * @file: Open ext4 file (f_private holds the lwext4 handle)
+ * @page: Page to fill, page->index is the page index in the file
+ *
+ * 文件末尾之后的部分清零，读成功后标记页为最新。
+ */
+static int32 EXT4_file_readpage(struct file* file, struct page* page)
+{
+	struct ext4_file* ext4_file = file ? (struct ext4_file*)file->f_private : NULL;
+	size_t bytes_read = 0;
+	int32 ret;
+
+	if (!ext4_file)
+		return -EBADF;
+
+	ret = ext4_fseek(ext4_file, (int64_t)page->index << PAGE_SHIFT, SEEK_SET);
+	if (ret != 0)
+		return -EIO;
+
+	ret = ext4_fread(ext4_file, (void*)page->paddr, PAGE_SIZE, &bytes_read);
+	if (ret != 0)
+		return -EIO;
+
+	if (bytes_read < PAGE_SIZE)
+		memset((char*)page->paddr + bytes_read, 0, PAGE_SIZE - bytes_read);
+
+	set_page_uptodate(page);
+	return 0;
+}
+
+/**
+ * EXT4_file_writepage - Write a dirty page cache page back to the file
+ * @page: Page to write, page->mapping->host is the inode
+ * @wbc: Writeback control; wbc->file supplies the lwext4 handle
+ *
+ * 只写到i_size为止，不会因为回写整页而把文件撑大。
+ */
+static int32 EXT4_file_writepage(struct page* page, struct writeback_control* wbc)
+{
+	struct ext4_file* ext4_file = (wbc && wbc->file) ? (struct ext4_file*)wbc->file->f_private : NULL;
+	struct inode* inode = page->mapping ? page->mapping->host : NULL;
+	loff_t pos = (loff_t)page->index << PAGE_SHIFT;
+	size_t len, bytes_written = 0;
+	int32 ret;
+
+	if (!ext4_file || !inode)
+		return -EBADF;
+
+	/* 页在文件尾之后（文件已被截断），没有需要写回的内容 */
+	if (pos >= inode->i_size)
+		return 0;
+	len = MIN(PAGE_SIZE, inode->i_size - pos);
+
+	ret = ext4_fseek(ext4_file, pos, SEEK_SET);
+	if (ret != 0)
+		return -EIO;
+
+	ret = ext4_fwrite(ext4_file, (void*)page->paddr, len, &bytes_written);
+	if (ret != 0 || bytes_written != len)
+		return -EIO;
+
+	return 0;
+}
+
+/**
+ * EXT4_file_fsync - Flush dirty mmap pages in [start, end) and the block cache
+ */
+static int32 EXT4_file_fsync(struct file* file, loff_t start, loff_t end, int32 datasync)
+{
+	int32 ret = filemap_write_range(file, start, end, WB_SYNC_ALL);
+	if (ret)
+		return ret;
+
+	return ext4_fs_sync(file->f_inode->i_superblock->s_fs_info);
+}
+
+/**
+ * Ext4 page cache operations
+ */
+const struct addrSpace_ops ext4_file_aops = {
+	.readpage = EXT4_file_readpage,
+	.writepage = EXT4_file_writepage,
+};
+
 /**
  * Ext4 file operations structure
  */
 const struct file_operations ext4_file_operations = {
     .open = EXT4_file_open,
 	.read = EXT4_file_read,
+	.fsync = EXT4_file_fsync,
 	//.write = ext4_file_write,
 
     // .llseek = ext4_file_llseek,
@@ -8,9 +8,9 @@
 #include <kernel/fs/lwext4/ext4_fs.h>
 #include <kernel/fs/lwext4/ext4_dir.h>
 
-#include <kernel/util/spinlock.h>
+#include <kernel/sched/mutex.h>
 
-spinlock_t ext4_spinlock = SPINLOCK_INIT;
+DEFINE_MUTEX(ext4_mutex);
 
 static inline void ext4_lock_noop(void) {
     // no-op placeholder: intentionally left blank
@@ -1,6 +1,7 @@
 #include <kernel/fs/ext4_adaptor.h>
 #include <kernel/vfs.h>
 #include <kernel/mm/kmalloc.h>
+#include <kernel/mm/filemap.h>
 #include <kernel/time.h>
 #include <kernel/sched/signal.h>
 #include <kernel/util/string.h>
@@ -120,6 +121,18 @@ const struct inode_operations ext4_symlink_inode_operations = {
     //.set_acl        = ext4_vfs_set_acl,
 };
 
+/**
+ * @brief Attach the page cache used by mmap to a regular file inode
+ * 
+ * @param inode The VFS inode
+ */
+static void ext4_inode_setup_mapping(struct inode *inode)
+{
+    if (!inode->i_mapping && !addrSpace_create(inode))
+        return;
+    inode->i_mapping->a_ops = &ext4_file_aops;
+}
+
 /**
  * ext4_inode_init - Initialize a VFS inode from an ext4 inode
  * @sb: The superblock
@@ -162,6 +175,7 @@ int32 ext4_inode_init(struct superblock *sb, struct inode *inode, uint32_t ino)
     if (S_ISREG(inode->i_mode)) {
         inode->i_op = &ext4_file_inode_operations;
         inode->i_fop = &ext4_file_operations;
+        ext4_inode_setup_mapping(inode);
     } else if (S_ISDIR(inode->i_mode)) {
         inode->i_op = &ext4_dir_inode_operations;
         inode->i_fop = &ext4_dir_operations;
@@ -303,6 +317,7 @@ static int32 ext4_vfs_create(struct inode *dir, struct dentry *dentry, mode_t mo
     inode->i_mode = mode;
     inode->i_op = &ext4_file_inode_operations;
     inode->i_fop = &ext4_file_operations;
+    ext4_inode_setup_mapping(inode);
     
     /* Link the dentry to the inode */
     dentry_instantiate(dentry, inode);
@@ -1623,25 +1638,8 @@ static int32 ext4_vfs_direct_IO(struct kiocb *kiocb, struct io_vector_iterator *
  */
 static vm_fault_t ext4_vfs_page_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
-	// TODO: 处理ext4_page_fault
-    // struct inode *inode = vma->vm_file->f_inode;
-    // struct page *page;
-    
-    // /* Get page from page cache or read it */
-    // page = addrSpace_getPage(inode->i_mapping, vmf->pgoff);
-    // if (!page) {
-    //     page = addrSpace_readPage(inode->i_mapping, vmf->pgoff);
-	// 	CHECK_PTR_VALID(page,VM_FAULT_ERROR);
-    // }
-    
-    // /* Map page to userspace */
-    // int32 ret = vm_insert_page(vma, vmf->address, page);
-    // if (ret != 0) {
-    //     addrSpace_putPage(inode->i_mapping, page);
-    //     return VM_FAULT_ERROR;
-    // }
-    
-    return VM_FAULT_NOPAGE;
+    /* Pages are served straight from the inode's page cache */
+    return filemap_fault(vma, vmf);
 }
 
 // /**
@@ -6,7 +6,6 @@
 #include <kernel/util/string.h>
 #include <kernel/vfs.h>
 
-int32 __addrSpace_writeback(struct addrSpace *mapping, struct writeback_control *wbc);
 /**
  * addrSpace_create - Create a new address space for an inode
  * @inode: Inode to associate with the address space
@@ -27,9 +26,13 @@ struct addrSpace* addrSpace_create(struct inode* inode)
         return NULL;
     
     // Initialize the address space structure
+    mapping->host = inode;
+    mapping->a_ops = NULL;
     mapping->nrpages = 0;
     radix_tree_init(&mapping->page_tree);
     spinlock_init(&mapping->tree_lock);
+    INIT_LIST_HEAD(&mapping->i_mmap);
+    spinlock_init(&mapping->i_mmap_lock);
     
     // // Get appropriate address_space_ops based on inode type and filesystem
     // const struct addrSpace_ops* a_ops = NULL;
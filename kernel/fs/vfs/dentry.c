@@ -111,6 +111,7 @@ int32 init_dentry_hashtable(void) {
 	kprintf("Initializing dentry hashtable\n");
 
 	/* 初始化dentry哈希表 */
+	lock_set_class(&dentry_hashtable, "dentry_hash");
 	return hashtable_setup(&dentry_hashtable, 1024, /* 初始桶数 */
 	                       75,                      /* 负载因子 */
 	                       __dentry_hashfunction, __dentry_get_key, __dentry_key_equals);
@@ -997,7 +998,7 @@ struct vfsmount* dentry_lookupMountpoint(struct dentry* dentry) {
 	struct dentry* current_dentry = dentry;
 	struct vfsmount* mnt = NULL;
 	struct path path;
-	extern spinlock_t mount_lock;
+	extern rwlock_t mount_lock;
 	extern struct hashtable mount_hashtable;
 	if (!current_dentry) return NULL;
 
@@ -1008,13 +1009,13 @@ struct vfsmount* dentry_lookupMountpoint(struct dentry* dentry) {
 			path.dentry = current_dentry;
 			path.mnt = NULL;
 
-			spinlock_lock(&mount_lock);
+			read_lock(&mount_lock);
 			struct list_node* node = hashtable_lookup(&mount_hashtable, &path);
 			if (node) {
 				mnt = container_of(node, struct vfsmount, mnt_hash_node);
 				mount_ref(mnt);
 			}
-			spinlock_unlock(&mount_lock);
+			read_unlock(&mount_lock);
 
 			if (mnt) return mnt;
 		}
@@ -1029,13 +1030,13 @@ struct vfsmount* dentry_lookupMountpoint(struct dentry* dentry) {
 		path.dentry = current_dentry;
 		path.mnt = NULL;
 
-		spinlock_lock(&mount_lock);
+		read_lock(&mount_lock);
 		struct list_node* node = hashtable_lookup(&mount_hashtable, &path);
 		if (node) {
 			mnt = container_of(node, struct vfsmount, mnt_hash_node);
 			mount_ref(mnt);
 		}
-		spinlock_unlock(&mount_lock);
+		read_unlock(&mount_lock);
 	}
 
 	return mnt;
@@ -212,6 +212,7 @@ static struct superblock* __fstype_allocSuperblock(struct fstype* type) {
 
 	/* Initialize locks */
 	spinlock_init(&sb->s_lock);
+	init_rwsem(&sb->s_umount);
 	spinlock_init(&sb->s_list_mounts_lock);
 	// 初始化原子计数器
 	atomic_set(&sb->s_refcount, 1);
@@ -228,4 +228,121 @@ int32 resolve_path_parent(const char* path_str, struct path* out_parent)
 
     /* Return the position of the final component */
     return name_index;
-}
\ No newline at end of file
+}
+/*
+ * names cache：路径缓冲区是整页（PATH_MAX == PAGE_SIZE），释放后留在空闲链表里
+ * 复用，getname()不用每次走kmalloc的大块分配路径。
+ */
+#define NAMES_CACHE_MAX 16
+
+static spinlock_t names_cache_lock = SPINLOCK_INIT;
+static void* names_cache_free;     /* 空闲缓冲区链表，next指针存在缓冲区开头 */
+static int32 names_cache_nr_free;
+
+/**
+ * __getname - Allocate a PATH_MAX buffer from the names cache
+ *
+ * Returns: The buffer, or NULL if out of memory
+ */
+char* __getname(void) {
+	void* buf;
+
+	spinlock_lock(&names_cache_lock);
+	buf = names_cache_free;
+	if (buf) {
+		names_cache_free = *(void**)buf;
+		names_cache_nr_free--;
+	}
+	spinlock_unlock(&names_cache_lock);
+
+	if (!buf) {
+		struct page* page = alloc_page();
+		if (!page) return NULL;
+		buf = (void*)page->paddr;
+	}
+	return buf;
+}
+
+/**
+ * __putname - Return a buffer obtained from __getname
+ * @name: The buffer
+ */
+void __putname(char* name) {
+	if (!name) return;
+
+	spinlock_lock(&names_cache_lock);
+	if (names_cache_nr_free < NAMES_CACHE_MAX) {
+		*(void**)name = names_cache_free;
+		names_cache_free = name;
+		names_cache_nr_free++;
+		name = NULL;
+	}
+	spinlock_unlock(&names_cache_lock);
+
+	if (name) put_page(addr_to_page((paddr_t)name));
+}
+
+/**
+ * getname - Copy a path name in from user space
+ * @filename: User space path
+ *
+ * 只拷贝到结束符为止。放不进内嵌空间的长路径另外申请一个结构体，
+ * 整个缓冲区都留给路径。
+ *
+ * Returns: The struct filename, or ERR_PTR on failure
+ */
+struct filename* getname(const char __user* filename) {
+	struct filename* result;
+	int64 len;
+	const int64 embedded_max = PATH_MAX - sizeof(struct filename);
+
+	if (!filename) return ERR_PTR(-EFAULT);
+
+	result = (struct filename*)__getname();
+	if (!result) return ERR_PTR(-ENOMEM);
+
+	result->uptr = filename;
+	result->separate = 0;
+	result->name = result->iname;
+
+	len = strncpy_from_user(result->iname, filename, embedded_max);
+	if (len == -ENAMETOOLONG) {
+		/* 路径比内嵌空间长：缓冲区整页给路径，结构体单独分配 */
+		struct filename* tmp = kmalloc(sizeof(struct filename));
+		if (!tmp) {
+			__putname((char*)result);
+			return ERR_PTR(-ENOMEM);
+		}
+		tmp->uptr = filename;
+		tmp->separate = 1;
+		tmp->name = (char*)result;
+		result = tmp;
+
+		len = strncpy_from_user((char*)result->name, filename, PATH_MAX);
+	}
+
+	if (len < 0) {
+		putname(result);
+		return ERR_PTR(len);
+	}
+	if (len == 0) {
+		putname(result);
+		return ERR_PTR(-ENOENT);
+	}
+	return result;
+}
+
+/**
+ * putname - Release a struct filename from getname
+ * @name: The filename
+ */
+void putname(struct filename* name) {
+	if (PTR_IS_ERROR(name) || !name) return;
+
+	if (name->separate) {
+		__putname((char*)name->name);
+		kfree(name);
+	} else {
+		__putname((char*)name);
+	}
+}
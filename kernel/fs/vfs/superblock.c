@@ -9,6 +9,7 @@
 #include <kernel/util/print.h>
 
 static void __deactivate_super(struct superblock* sb);
+static int32 __sync_filesystem(struct superblock* sb, int32 wait);
 
 /**
  * superblock_put - Decrease reference count of superblock
@@ -89,11 +90,22 @@ void deactivate_super_safe(struct superblock* sb) {
  * Returns 0 on success, negative error code on failure
  */
 int32 sync_filesystem(struct superblock* sb, int32 wait) {
-	int32 ret = 0;
-	struct inode *inode, *next;
+	int32 ret;
 
 	if (!sb) return -EINVAL;
 
+	/* Syncs may run side by side, but not against a shutdown */
+	down_read(&sb->s_umount);
+	ret = __sync_filesystem(sb, wait);
+	up_read(&sb->s_umount);
+	return ret;
+}
+
+/* sync_filesystem() without s_umount, for callers that already hold it */
+static int32 __sync_filesystem(struct superblock* sb, int32 wait) {
+	int32 ret = 0;
+	struct inode *inode, *next;
+
 	/* Call filesystem's sync_fs if defined */
 	if (sb->s_operations && sb->s_operations->sync_fs) {
 		ret = sb->s_operations->sync_fs(sb, wait);
@@ -135,8 +147,10 @@ void generic_shutdown_super(struct superblock* sb) {
 
 	if (!sb) return;
 
+	down_write(&sb->s_umount);
+
 	/* Write any dirty data */
-	sync_filesystem(sb, 1);
+	__sync_filesystem(sb, 1);
 
 	/* Free all inodes */
 	spinlock_lock(&sb->s_list_all_inodes_lock);
@@ -162,6 +176,8 @@ void generic_shutdown_super(struct superblock* sb) {
 		sb->s_root = NULL;
 	}
 
+	up_write(&sb->s_umount);
+
 	/* Decrease active count */
 	deactivate_super_safe(sb);
 
@@ -266,6 +282,7 @@ struct inode* superblock_createInode(struct superblock* sb) {
 	INIT_LIST_HEAD(&inode->i_s_list_node);
 	INIT_LIST_HEAD(&inode->i_state_list_node);
 	spinlock_init(&inode->i_lock);
+	init_rwsem(&inode->i_rwsem);
 	inode->i_superblock = sb;
 	// inode->i_state = I_NEW; /* Mark as new */
 	inode->i_ino = ino;
@@ -5,7 +5,7 @@
 
 /* Global mount list */
 struct list_head mount_list;
-spinlock_t mount_lock;
+rwlock_t mount_lock;
 
 /* Mount point hash table */
 struct hashtable mount_hashtable;
@@ -74,7 +74,7 @@ static int32 mount_key_equals(const void* k1, const void* k2) {
 void mcache_init(void) {
 	/* Initialize global mount list */
 	INIT_LIST_HEAD(&mount_list);
-	spinlock_init(&mount_lock);
+	rwlock_init(&mount_lock);
 
 	/* Initialize hash table */
 	hashtable_setup(&mount_hashtable, 256, 75, mount_hash_func, mount_get_key, mount_key_equals);
@@ -104,9 +104,9 @@ void mount_unref(struct vfsmount* mnt)
             hashtable_remove(&mount_hashtable, &mnt->mnt_hash_node);
             
         /* Remove from global list */
-        spinlock_lock(&mount_lock);
+        write_lock(&mount_lock);
         list_del(&mnt->mnt_node_global);
-        spinlock_unlock(&mount_lock);
+        write_unlock(&mount_lock);
         
         /* Remove from superblock list */
         if (mnt->mnt_superblock) {
@@ -282,9 +282,9 @@ struct vfsmount* mount_bind(struct path* source_path, uint64 flags) {
     }
     
     /* Add to global mount list */
-    spinlock_lock(&mount_lock);
+    write_lock(&mount_lock);
     list_add(&newmnt->mnt_node_global, &mount_list);
-    spinlock_unlock(&mount_lock);
+    write_unlock(&mount_lock);
     
     /* Copy device name if needed */
     if (source_path->mnt->mnt_devname) {
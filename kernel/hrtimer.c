@@ -0,0 +1,271 @@
+/*
+ * hrtimer.c - 高精度定时器
+ *
+ * 每个hart一棵按到期时刻排序的红黑树，最左的节点有缓存，取最早的到期
+ * 时刻是O(1)，加入和删除是O(log n)。作为"hrtimer"定时源接到时钟事件层。
+ *
+ * 定时器总是排到调用者所在hart的树上，这样重新编程的只是本地的SBI
+ * 定时器。换树时base先指向migration_base，别的hart上的lock_hrtimer_base()
+ * 看到它就等一等。回调正在运行的定时器不换树，hrtimer_cancel()靠
+ * running等回调结束。
+ *
+ * 锁的顺序：hrtimer_cpu_base->lock -> 就绪队列。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/hrtimer.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+
+struct hrtimer_cpu_base {
+	spinlock_t lock;
+	struct rb_root_cached active;
+	struct hrtimer* running; // 正在执行回调的定时器
+};
+
+static DEFINE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
+
+// 换树期间定时器挂在这里，不会有人拿它的锁
+static struct hrtimer_cpu_base migration_base;
+
+static struct hrtimer_cpu_base* lock_hrtimer_base(struct hrtimer* timer, int64* flags) {
+	for (;;) {
+		struct hrtimer_cpu_base* base = READ_ONCE(timer->base);
+
+		if (base != &migration_base) {
+			*flags = spinlock_lock_irqsave(&base->lock);
+			if (READ_ONCE(timer->base) == base) return base;
+			spinlock_unlock_irqrestore(&base->lock, *flags);
+		}
+		cpu_relax();
+	}
+}
+
+// 返回1表示它成了树上最早的
+static int32 enqueue_hrtimer(struct hrtimer* timer, struct hrtimer_cpu_base* base) {
+	struct rb_node** link = &base->active.rb_root.rb_node;
+	struct rb_node* parent = NULL;
+	int32 leftmost = 1;
+
+	// 到期时刻相同的按加入的先后
+	while (*link) {
+		parent = *link;
+		if (timer->expires < rb_entry(parent, struct hrtimer, node)->expires) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+	rb_link_node(&timer->node, parent, link);
+	rb_insert_color_cached(&timer->node, &base->active, leftmost);
+	timer->state = HRTIMER_STATE_ENQUEUED;
+	return leftmost;
+}
+
+static void __remove_hrtimer(struct hrtimer* timer, struct hrtimer_cpu_base* base) {
+	rb_erase_cached(&timer->node, &base->active);
+	RB_CLEAR_NODE(&timer->node);
+	timer->state = HRTIMER_STATE_INACTIVE;
+}
+
+/**
+ * hrtimer_init - Prepare a timer for use
+ * @timer: The timer
+ * @function: Callback run from the timer interrupt when it expires
+ */
+void hrtimer_init(struct hrtimer* timer, enum hrtimer_restart (*function)(struct hrtimer*)) {
+	RB_CLEAR_NODE(&timer->node);
+	timer->expires = 0;
+	timer->function = function;
+	timer->base = per_cpu_ptr(&hrtimer_bases, 0);
+	timer->state = HRTIMER_STATE_INACTIVE;
+}
+
+/**
+ * hrtimer_start - (Re)start a timer on the calling hart
+ * @timer: The timer
+ * @tim: Expiry time in time CSR ticks
+ * @mode: Whether @tim is absolute or relative to now
+ *
+ * A timer that is already queued is moved to the new expiry time.
+ */
+void hrtimer_start(struct hrtimer* timer, uint64 tim, enum hrtimer_mode mode) {
+	struct hrtimer_cpu_base *base, *new_base;
+	int32 first;
+	int64 flags;
+
+	if (mode == HRTIMER_MODE_REL) {
+		uint64 now = read_time();
+		tim = tim > CLOCKEVENT_NONE - now ? CLOCKEVENT_NONE : now + tim;
+	}
+
+	base = lock_hrtimer_base(timer, &flags);
+	if (hrtimer_is_queued(timer)) __remove_hrtimer(timer, base);
+
+	new_base = this_cpu_ptr(&hrtimer_bases);
+	if (base != new_base && base->running != timer) {
+		WRITE_ONCE(timer->base, &migration_base);
+		spinlock_unlock(&base->lock);
+		base = new_base;
+		spinlock_lock(&base->lock);
+		WRITE_ONCE(timer->base, base);
+	}
+
+	timer->expires = tim;
+	first = enqueue_hrtimer(timer, base);
+	spinlock_unlock(&base->lock);
+	// 留在别的hart上的只可能是回调正在运行的，那边处理完会重新编程
+	if (first && base == new_base) clockevent_reprogram();
+	enable_irqrestore(flags);
+}
+
+/**
+ * hrtimer_try_to_cancel - Try to deactivate a timer
+ * @timer: The timer
+ *
+ * Returns 1 if the timer was queued and has been removed, 0 if it was not
+ * active, or -1 if its callback is running and it cannot be stopped now.
+ */
+int32 hrtimer_try_to_cancel(struct hrtimer* timer) {
+	struct hrtimer_cpu_base* base;
+	int32 ret = 0;
+	int64 flags;
+
+	base = lock_hrtimer_base(timer, &flags);
+	if (base->running == timer) {
+		ret = -1;
+	} else if (hrtimer_is_queued(timer)) {
+		__remove_hrtimer(timer, base);
+		ret = 1;
+	}
+	spinlock_unlock_irqrestore(&base->lock, flags);
+	return ret;
+}
+
+/**
+ * hrtimer_cancel - Deactivate a timer and wait for its callback to finish
+ * @timer: The timer
+ *
+ * Must not be called from the timer's own callback.
+ *
+ * Returns 1 if the timer was queued, 0 otherwise.
+ */
+int32 hrtimer_cancel(struct hrtimer* timer) {
+	int32 ret;
+
+	while ((ret = hrtimer_try_to_cancel(timer)) < 0) cpu_relax();
+	return ret;
+}
+
+/**
+ * hrtimer_forward - Push the expiry time past a given time
+ * @timer: The timer, which must not be queued
+ * @now: The time to push past
+ * @interval: Period in time CSR ticks
+ *
+ * Returns the number of periods the expiry time moved by.
+ */
+uint64 hrtimer_forward(struct hrtimer* timer, uint64 now, uint64 interval) {
+	uint64 orun = 1;
+
+	if (now < timer->expires || !interval) return 0;
+	if (now - timer->expires >= interval) {
+		// 错过了好几个周期，一次跳过去
+		orun = (now - timer->expires) / interval;
+		timer->expires += orun * interval;
+		if (timer->expires > now) return orun;
+		orun++;
+	}
+	timer->expires += interval;
+	return orun;
+}
+
+/**
+ * hrtimer_get_remaining - Time left until a timer expires
+ * @timer: The timer
+ *
+ * Returns the time in time CSR ticks, 0 if it is not queued or already due.
+ */
+uint64 hrtimer_get_remaining(struct hrtimer* timer) {
+	struct hrtimer_cpu_base* base;
+	uint64 now, left = 0;
+	int64 flags;
+
+	base = lock_hrtimer_base(timer, &flags);
+	now = read_time();
+	if (hrtimer_is_queued(timer) && timer->expires > now) left = timer->expires - now;
+	spinlock_unlock_irqrestore(&base->lock, flags);
+	return left;
+}
+
+/**
+ * hrtimer_active - Check whether a timer is queued or running its callback
+ * @timer: The timer
+ */
+int32 hrtimer_active(struct hrtimer* timer) {
+	struct hrtimer_cpu_base* base;
+	int32 active;
+	int64 flags;
+
+	base = lock_hrtimer_base(timer, &flags);
+	active = hrtimer_is_queued(timer) || base->running == timer;
+	spinlock_unlock_irqrestore(&base->lock, flags);
+	return active;
+}
+
+static uint64 hrtimer_next_deadline(void) {
+	struct hrtimer_cpu_base* base = this_cpu_ptr(&hrtimer_bases);
+	struct rb_node* first;
+	uint64 deadline = CLOCKEVENT_NONE;
+
+	spinlock_lock(&base->lock);
+	first = rb_first_cached(&base->active);
+	if (first) deadline = rb_entry(first, struct hrtimer, node)->expires;
+	spinlock_unlock(&base->lock);
+	return deadline;
+}
+
+static void hrtimer_expire(uint64 now) {
+	struct hrtimer_cpu_base* base = this_cpu_ptr(&hrtimer_bases);
+	struct rb_node* first;
+
+	spinlock_lock(&base->lock);
+	while ((first = rb_first_cached(&base->active))) {
+		struct hrtimer* timer = rb_entry(first, struct hrtimer, node);
+		enum hrtimer_restart (*fn)(struct hrtimer*) = timer->function;
+		enum hrtimer_restart restart;
+
+		if (timer->expires > now) break;
+		__remove_hrtimer(timer, base);
+		base->running = timer;
+		spinlock_unlock(&base->lock);
+		restart = fn(timer);
+		spinlock_lock(&base->lock);
+		// 回调里已经hrtimer_start()过的不用再排
+		if (restart == HRTIMER_RESTART && !hrtimer_is_queued(timer)) enqueue_hrtimer(timer, base);
+		base->running = NULL;
+	}
+	spinlock_unlock(&base->lock);
+}
+
+static struct clock_event_source hrtimer_source = {
+    .name = "hrtimer",
+    .next_deadline = hrtimer_next_deadline,
+    .expire = hrtimer_expire,
+};
+
+/**
+ * hrtimers_init - Set up the per-hart timer trees
+ */
+void hrtimers_init(void) {
+	for_each_possible_cpu(cpu) {
+		struct hrtimer_cpu_base* base = per_cpu_ptr(&hrtimer_bases, cpu);
+
+		spinlock_init(&base->lock);
+		base->active = RB_ROOT_CACHED;
+		base->running = NULL;
+	}
+	clockevent_register_source(&hrtimer_source);
+}
@@ -0,0 +1,87 @@
+/*
+ * itimer.c - setitimer()和getitimer()
+ *
+ * 只支持ITIMER_REAL：按真实时间倒数，到期给进程发SIGALRM。定时器是线程组
+ * leader上的real_timer，周期由it_real_incr给出，回调里用hrtimer_forward()
+ * 推到下一个周期，不会因为中断处理的延迟越走越慢。
+ *
+ * ITIMER_VIRTUAL和ITIMER_PROF要按用户态/内核态分别记CPU时间，还不支持。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/hrtimer.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+
+// 远到换算会溢出的按这个算，加上当前时刻也不会溢出
+#define ITIMER_TICKS_MAX (CLOCKEVENT_NONE >> 1)
+
+static uint64 timeval_to_ticks(const struct timeval* tv) {
+	if (tv->tv_sec >= TIME_T_MAX / NSEC_PER_SEC) return ITIMER_TICKS_MAX;
+	return MIN(ns_to_ticks((uint64)tv->tv_sec * NSEC_PER_SEC + tv->tv_usec * NSEC_PER_USEC), ITIMER_TICKS_MAX);
+}
+
+// 向上取整到微秒，还没到期的定时器不会读成0
+static void ticks_to_timeval(uint64 ticks, struct timeval* tv) {
+	uint64 usec = (ticks_to_ns(ticks) + NSEC_PER_USEC - 1) / NSEC_PER_USEC;
+
+	tv->tv_sec = usec / USEC_PER_SEC;
+	tv->tv_usec = usec % USEC_PER_SEC;
+}
+
+/**
+ * it_real_fn - ITIMER_REAL expiry callback
+ * @timer: The real_timer of a thread group leader
+ *
+ * Delivers to the leader; once the leader has exited the signal is lost.
+ */
+enum hrtimer_restart it_real_fn(struct hrtimer* timer) {
+	struct task_struct* p = container_of(timer, struct task_struct, real_timer);
+
+	sigaddset(&p->pending, SIGALRM);
+	try_to_wake_up(p, TASK_INTERRUPTIBLE);
+
+	if (!p->it_real_incr) return HRTIMER_NORESTART;
+	hrtimer_forward(timer, read_time(), p->it_real_incr);
+	return HRTIMER_RESTART;
+}
+
+/**
+ * do_getitimer - Read an interval timer
+ * @which: Must be ITIMER_REAL
+ * @value: Receives the time left and the period
+ *
+ * Returns 0 on success, -EINVAL for other timers.
+ */
+int32 do_getitimer(int32 which, struct itimerval* value) {
+	struct task_struct* leader = current_task()->group_leader;
+
+	if (which != ITIMER_REAL) return -EINVAL;
+	ticks_to_timeval(hrtimer_get_remaining(&leader->real_timer), &value->it_value);
+	ticks_to_timeval(leader->it_real_incr, &value->it_interval);
+	return 0;
+}
+
+/**
+ * do_setitimer - Arm or disarm an interval timer
+ * @which: Must be ITIMER_REAL
+ * @value: First expiry relative to now and the period; a zero it_value disarms
+ * @ovalue: Receives the previous setting if not NULL
+ *
+ * Returns 0 on success, -EINVAL for other timers.
+ */
+int32 do_setitimer(int32 which, const struct itimerval* value, struct itimerval* ovalue) {
+	struct task_struct* leader = current_task()->group_leader;
+	struct hrtimer* timer = &leader->real_timer;
+
+	if (which != ITIMER_REAL) return -EINVAL;
+	if (ovalue) do_getitimer(which, ovalue);
+
+	// 回调可能正在别的hart上把它重新排上，等它跑完再改周期
+	hrtimer_cancel(timer);
+	leader->it_real_incr = timeval_to_ticks(&value->it_interval);
+	if (value->it_value.tv_sec || value->it_value.tv_usec)
+		hrtimer_start(timer, timeval_to_ticks(&value->it_value), HRTIMER_MODE_REL);
+	return 0;
+}
@@ -0,0 +1,236 @@
+/**
+ * @file filemap.c
+ * @brief 基于页缓存的文件映射缺页处理
+ *
+ * 文件VMA的PTE直接指向inode->i_mapping中的页缓存页，不再为每个映射
+ * 复制一份数据。MAP_PRIVATE映射的页以只读方式映射，首次写入时COW。
+ *
+ * MAP_SHARED映射的干净页同样以只读方式映射，首次写入时在addrSpace中
+ * 打上RADIX_TREE_TAG_DIRTY再放开写权限；回写前重新写保护，这样回写之后
+ * 的写入会再次被记录，msync/fsync只需要写回被标记的页。
+ */
+
+#include <kernel/mm/filemap.h>
+#include <kernel/mmu.h>
+#include <kernel/util.h>
+#include <kernel/vfs.h>
+
+/**
+ * filemap_get_page - Get an uptodate page cache page, reading it if needed
+ * @file: Open file used for ->readpage
+ * @index: Page index within the file
+ *
+ * Returns: The page with an extra reference held, or ERR_PTR on failure
+ */
+struct page* filemap_get_page(struct file* file, uint64 index) {
+	struct addrSpace* mapping = file->f_inode->i_mapping;
+	struct page* page;
+	int32 ret = 0;
+
+	if (!mapping || !mapping->a_ops || !mapping->a_ops->readpage) return ERR_PTR(-EINVAL);
+
+	page = addrSpace_acquirePage(mapping, index, 0);
+	if (!page) return ERR_PTR(-ENOMEM);
+	if (page_uptodate(page)) return page;
+
+	lock_page(page);
+	if (!page_uptodate(page)) ret = mapping->a_ops->readpage(file, page);
+	unlock_page(page);
+
+	if (ret == 0 && !page_uptodate(page)) ret = -EIO;
+	if (ret) {
+		put_page(page);
+		return ERR_PTR(ret);
+	}
+	return page;
+}
+
+/**
+ * filemap_map_pages - Fault-around: map neighbouring cached pages
+ * @vma: The faulting VMA
+ * @mapping: Page cache of the mapped file
+ * @address: Page aligned faulting address
+ * @nr_file_pages: Number of pages covered by i_size
+ *
+ * 以FAULT_AROUND_PAGES对齐的窗口（不会跨越叶子页表）内，把已经在页缓存
+ * 中且内容有效的页一次性映射进来；不会发起任何读盘。
+ */
+static void filemap_map_pages(struct vm_area_struct* vma, struct addrSpace* mapping, uint64 address, uint64 nr_file_pages) {
+	struct page* pages[FAULT_AROUND_PAGES];
+	uint64 window = FAULT_AROUND_PAGES * PAGE_SIZE;
+	uint64 start = MAX(ROUNDDOWN(address, window), vma->vm_start);
+	uint64 end = MIN(ROUNDDOWN(address, window) + window, vma->vm_end);
+	uint64 first = vma->vm_pgoff + ((start - vma->vm_start) >> PAGE_SHIFT);
+	uint64 last = MIN(first + ((end - start) >> PAGE_SHIFT), nr_file_pages);
+	uint32 nr, i;
+
+	if (first >= last) return;
+
+	spinlock_lock(&mapping->tree_lock);
+	nr = radix_tree_gang_lookup(&mapping->page_tree, (void**)pages, first, last - first);
+	for (i = 0; i < nr; i++) {
+		if (pages[i]->index >= last || !page_uptodate(pages[i]) || (pages[i]->flags & PAGE_LOCKED))
+			pages[i] = NULL;
+		else
+			get_page(pages[i]);
+	}
+	spinlock_unlock(&mapping->tree_lock);
+
+	for (i = 0; i < nr; i++) {
+		struct page* page = pages[i];
+		if (!page) continue;
+
+		uint64 va = start + ((page->index - first) << PAGE_SHIFT);
+		// 窗口位于同一张叶子页表内，目标页本身也要用到它，直接分配
+		pte_t* pte = page_walk(vma->vm_mm->pagetable, va, 1);
+		if (pte && !(*pte & PTE_V)) vm_insert_page(vma, va, page);
+		put_page(page);
+	}
+}
+
+/**
+ * filemap_fault - Generic ->page_fault for page cache backed files
+ * @vma: The faulting VMA (vma->vm_file must be set)
+ * @vmf: Fault description, vmf->pgoff already filled in
+ *
+ * Returns: 0 on success, VM_FAULT_* error bits on failure
+ */
+vm_fault_t filemap_fault(struct vm_area_struct* vma, struct vm_fault* vmf) {
+	struct file* file = vma->vm_file;
+	struct inode* inode = file->f_inode;
+	struct addrSpace* mapping = inode->i_mapping;
+	uint64 page_va = ROUNDDOWN(vmf->address, PAGE_SIZE);
+	uint64 nr_file_pages = ROUNDUP(inode->i_size, PAGE_SIZE) >> PAGE_SHIFT;
+	struct page* page;
+	vm_fault_t ret = 0;
+
+	if (!mapping) return VM_FAULT_SIGBUS;
+	if (vmf->pgoff >= nr_file_pages) return VM_FAULT_SIGBUS;
+
+	// 读缺页先做fault-around，目标页如果已经在缓存里，本次就处理完了
+	if (!(vmf->flags & FAULT_FLAG_WRITE)) {
+		filemap_map_pages(vma, mapping, page_va, nr_file_pages);
+		vmf->pte = page_walk(vma->vm_mm->pagetable, page_va, 0);
+		if (vmf->pte && (*vmf->pte & PTE_V)) return 0;
+	}
+
+	page = filemap_get_page(file, vmf->pgoff);
+	if (PTR_IS_ERROR(page)) return PTR_ERR(page) == -ENOMEM ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+
+	if ((vmf->flags & FAULT_FLAG_WRITE) && !(vma->vm_flags & VM_SHARED)) {
+		// 私有映射的首次写入：直接拷贝出私有页，省掉一次只读映射再COW的陷入
+		ret = vm_cow_page(vma, page_va, page) ? VM_FAULT_OOM : VM_FAULT_DONE_COW;
+	} else if (vm_insert_page(vma, page_va, page)) {
+		ret = VM_FAULT_OOM;
+	} else if (vmf->flags & FAULT_FLAG_WRITE) {
+		ret = filemap_page_mkwrite(vma, vmf, page);
+	}
+
+	put_page(page);
+	return ret;
+}
+
+/**
+ * filemap_page_mkwrite - First write to a clean page of a shared mapping
+ * @vma: The VMA (VM_SHARED, file backed)
+ * @vmf: Fault description
+ * @page: The page cache page currently mapped read-only
+ *
+ * Returns: 0 on success, VM_FAULT_* error bits on failure
+ */
+vm_fault_t filemap_page_mkwrite(struct vm_area_struct* vma, struct vm_fault* vmf, struct page* page) {
+	uint64 page_va = ROUNDDOWN(vmf->address, PAGE_SIZE);
+
+	// 页已经被移出页缓存（文件被截断），不能再写回
+	if (!page->mapping) return VM_FAULT_SIGBUS;
+
+	addrSpace_setPageDirty(page->mapping, page);
+	if (pgt_map_page(vma->vm_mm->pagetable, page_va, page->paddr, vm_flags_to_type(vma->vm_flags))) return VM_FAULT_OOM;
+	flush_tlb();
+	return 0;
+}
+
+/**
+ * filemap_link_vma - Track a shared file VMA on its addrSpace
+ * @vma: The VMA, vm_file already set
+ */
+void filemap_link_vma(struct vm_area_struct* vma) {
+	struct addrSpace* mapping;
+
+	if (!vma->vm_file || !(vma->vm_flags & VM_SHARED)) return;
+	mapping = vma->vm_file->f_inode->i_mapping;
+
+	spinlock_lock(&mapping->i_mmap_lock);
+	list_add(&vma->vm_shared, &mapping->i_mmap);
+	spinlock_unlock(&mapping->i_mmap_lock);
+}
+
+/**
+ * filemap_unlink_vma - Undo filemap_link_vma
+ * @vma: The VMA
+ */
+void filemap_unlink_vma(struct vm_area_struct* vma) {
+	struct addrSpace* mapping;
+
+	if (!vma->vm_file || list_empty(&vma->vm_shared)) return;
+	mapping = vma->vm_file->f_inode->i_mapping;
+
+	spinlock_lock(&mapping->i_mmap_lock);
+	list_del_init(&vma->vm_shared);
+	spinlock_unlock(&mapping->i_mmap_lock);
+}
+
+/**
+ * filemap_wrprotect_range - Write-protect every shared mapping of [first, last)
+ * @mapping: The addrSpace
+ * @first: First page index
+ * @last: Page index past the range
+ *
+ * 回写前调用：之后再写这些页会重新缺页并重新打脏标记。
+ */
+static void filemap_wrprotect_range(struct addrSpace* mapping, uint64 first, uint64 last) {
+	struct vm_area_struct* vma;
+
+	spinlock_lock(&mapping->i_mmap_lock);
+	list_for_each_entry(vma, &mapping->i_mmap, vm_shared) {
+		uint64 vma_last = vma->vm_pgoff + ((vma->vm_end - vma->vm_start) >> PAGE_SHIFT);
+		uint64 lo = MAX(first, vma->vm_pgoff);
+		uint64 hi = MIN(last, vma_last);
+
+		for (uint64 idx = lo; idx < hi; idx++) {
+			uint64 va = vma->vm_start + ((idx - vma->vm_pgoff) << PAGE_SHIFT);
+			pte_t* pte = page_walk(vma->vm_mm->pagetable, va, 0);
+			if (pte && (*pte & PTE_V) && (*pte & PTE_W)) *pte &= ~(PTE_W | PTE_D);
+		}
+	}
+	spinlock_unlock(&mapping->i_mmap_lock);
+	flush_tlb();
+}
+
+/**
+ * filemap_write_range - Write back the dirty page cache pages of a file range
+ * @file: Open file, passed on to ->writepage
+ * @start: First byte of the range
+ * @end: Byte past the range
+ * @sync_mode: WB_SYNC_ALL or WB_SYNC_NONE
+ *
+ * Only pages tagged RADIX_TREE_TAG_DIRTY are written.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int32 filemap_write_range(struct file* file, loff_t start, loff_t end, int32 sync_mode) {
+	struct addrSpace* mapping = file->f_inode->i_mapping;
+	struct writeback_control wbc;
+
+	if (!mapping || start >= end) return 0;
+	if (!mapping->a_ops || !mapping->a_ops->writepage) return -EINVAL;
+
+	filemap_wrprotect_range(mapping, (uint64)start >> PAGE_SHIFT, ROUNDUP((uint64)end, PAGE_SIZE) >> PAGE_SHIFT);
+
+	init_writeback_control(&wbc, sync_mode);
+	wbc.reason = WB_REASON_SYNC;
+	wbc.range_start = start;
+	wbc.range_end = end;
+	wbc.file = file;
+	return __addrSpace_writeback(mapping, &wbc);
+}
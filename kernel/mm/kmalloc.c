@@ -61,7 +61,6 @@ void kmem_init(void) {
  * @brief Allocate kernel memory
  */
  void *kmalloc(size_t size) {
-  kprintf("kmalloc: request mem size = %d\n",size);
   if (size == 0)
     return NULL;
 
@@ -88,8 +87,6 @@ void kmem_init(void) {
     // For large allocations, use page allocator without headers
     vaddr_t ret = mmap_file(&init_mm, 0, size, PROT_READ | PROT_WRITE,
                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, NULL, 0);
-					
-	kprintf("kmalloc:mmap_file ret=%lx\n", ret);
     struct page *page = addr_to_page(ret);
 
     if (page) {
@@ -102,7 +99,6 @@ void kmem_init(void) {
 	}
   }
   //kprintf("kmalloc: end\n");
-  kprintf("kmalloc: allocated %d bytes at %lx\n", size, mem);
   return mem;
 }
 
@@ -113,8 +109,6 @@ void kmem_init(void) {
   if (!ptr)
     return;
 
-  kprintf("calling kfree with ptr=%lx\n", ptr);
-
   // Check if this is a page allocation (page-aligned pointer)
   if (((uint64)ptr & (PAGE_SIZE - 1)) == 0) {
     // This is a page allocation
@@ -122,7 +116,7 @@ void kmem_init(void) {
     if (unlikely(!page)) {
       panic("kfree: invalid pointer 0x%lx\n", (uint64)ptr);
     }
-		do_unmap(&init_mm, (uint64)ptr, page->kmalloc_size);
+		do_unmap(&init_mm, (uint64)ptr, ROUNDUP(page->kmalloc_size, PAGE_SIZE));
 
     return;
   } else {
@@ -263,6 +257,7 @@ void kmalloc_stats(void) {
 
 void* alloc_kernel_stack(){
 	void* kstack = kmalloc(PAGE_SIZE);
+	if (!kstack) return NULL;
   return kstack + PAGE_SIZE - 16;
 }
 
@@ -3,6 +3,7 @@
 #include <kernel/mmu.h>
 #include <kernel/sched.h>
 #include <kernel/util.h>
+#include <kernel/vdso.h>
 
 
 // user_alloc_mm
@@ -18,14 +19,17 @@ struct mm_struct *user_alloc_mm(void) {
 
   mm->is_kernel_mm = 0;
   // 记录页表的内核虚拟地址
-  mm->pagetable = (pagetable_t)kmalloc(PAGE_SIZE);
+  // 根页表必须是物理页（satp里放的是物理页号），并由free_pagetable释放
+  mm->pagetable = create_pagetable();
   if (unlikely(mm->pagetable == NULL)) {
-    kprintf("alloc_mm: kmalloc failed\n");
+    kprintf("alloc_mm: create_pagetable failed\n");
     return NULL;
   }
-  memset(mm->pagetable, 0, PAGE_SIZE);
+  // 内核映射在所有页表里共享，陷入和uaccess都不必切换页表
+  pagetable_share_kernel(mm->pagetable);
 
   spinlock_init(&mm->mm_lock);
+  init_rwsem(&mm->mmap_lock);
   atomic_set(&mm->mm_users, 1);
   atomic_set(&mm->mm_count, 1);
 
@@ -51,6 +55,12 @@ struct mm_struct *user_alloc_mm(void) {
     return NULL;
   }
 
+  // 每个进程都映射vDSO，用户态读时钟不必进内核
+  if (unlikely(vdso_map(mm) != 0)) {
+    kprintf("alloc_mm: failed to map the vDSO\n");
+    return NULL;
+  }
+
   return mm;
 }
 
@@ -63,25 +73,17 @@ void free_mm(struct mm_struct *mm) {
 
   // 减少引用计数
   if (atomic_dec_and_test(&mm->mm_count)) {
-    // 引用计数为0，可以释放mm结构
+    // 引用计数为0，可以释放mm结构。本hart如果还在这个页表上，先换到内核页表
+    if (read_csr(satp) == MAKE_SATP(mm->pagetable)) {
+      write_csr(satp, MAKE_SATP(g_kernel_pagetable));
+      flush_tlb();
+    }
 
     // 释放所有VMA
     struct vm_area_struct *vma, *tmp;
     list_for_each_entry_safe(vma, tmp, &mm->vma_list, vm_list) {
+      // free_vma会释放VMA关联的所有页并把它从链表中摘除
       free_vma(vma);
-      // 释放VMA关联的所有页
-      if (vma->pages) {
-        for (int32 i = 0; i < vma->page_count; i++) {
-          if (vma->pages[i]) {
-            put_page(vma->pages[i]);
-          }
-        }
-        kfree(vma->pages);
-      }
-
-      // 从链表中移除并释放VMA
-      list_del(&vma->vm_list);
-      kfree(vma);
     }
 
     // 释放页表
@@ -128,6 +130,33 @@ struct vm_area_struct *find_vma_intersection(struct mm_struct *mm, uint64 start,
 
   return NULL;
 }
+/**
+ * mm_get_user_page - Return the page backing @va, faulting it in if needed
+ * @vma: The VMA containing @va
+ * @va: Page aligned user virtual address
+ * @write: Nonzero if the caller is going to write the page
+ *
+ * 页表是已映射页的唯一记录；不存在或写只读页时走一遍正常的缺页处理，
+ * 这样文件映射和写时复制的语义与用户态访问一致。
+ *
+ * Returns: The page (no reference taken), or NULL on failure
+ */
+static struct page *mm_get_user_page(struct vm_area_struct *vma, uint64 va,
+                                     int32 write) {
+  pte_t *pte = page_walk(vma->vm_mm->pagetable, va, 0);
+
+  if (!pte || !(*pte & PTE_V) || (write && !(*pte & PTE_W))) {
+    struct vm_fault vmf = {
+        .address = va,
+        .flags = write ? FAULT_FLAG_WRITE : 0,
+    };
+    if (handle_vm_fault(vma, &vmf) & VM_FAULT_ERROR)
+      return NULL;
+  }
+
+  return vm_lookup_page(vma, va);
+}
+
 /**
  * mm_copy_to_user - Internal implementation of copy to user
  * @mm:   The memory descriptor of target process
@@ -157,24 +186,19 @@ ssize_t mm_copy_to_user(struct mm_struct *mm, uint64 dst, const void* src,
       return bytes_copied > 0 ? bytes_copied : -EFAULT;
 
     // Calculate bytes to copy in current page
-    uint64 page_offset = (dst_addr + bytes_copied) | (PAGE_SIZE - 1);
+    uint64 page_offset = (dst_addr + bytes_copied) % PAGE_SIZE;
     uint64 page_bytes = MIN(PAGE_SIZE - page_offset, len - bytes_copied);
 
     // Get page virtual address
     uint64 page_va = ROUNDDOWN(dst_addr + bytes_copied, PAGE_SIZE);
 
-    // Find page index
-    int32 page_idx = (page_va - vma->vm_start) / PAGE_SIZE;
-    if (page_idx < 0 || page_idx >= vma->page_count)
+    // Fault the page in (and break COW) if needed
+    struct page *page = mm_get_user_page(vma, page_va, 1);
+    if (!page)
       return bytes_copied > 0 ? bytes_copied : -EFAULT;
 
-    // Ensure page is allocated
-    if (!vma->pages[page_idx]) {
-      populate_vma(vma, page_va, PAGE_SIZE, vma->vm_prot);
-    }
-
     // Calculate target address (kernel view)
-    char *target = (char *)vma->pages[page_idx]->paddr + page_offset;
+    char *target = (char *)page->paddr + page_offset;
 
     // Copy data
     memcpy(target, src_ptr + bytes_copied, page_bytes);
@@ -213,19 +237,13 @@ ssize_t mm_copy_from_user(struct mm_struct *mm, uint64 dst, const void* src,
     // 获取源页的虚拟地址
     uint64 page_va = ROUNDDOWN(src_addr + bytes_copied, PAGE_SIZE);
 
-    // 查找对应的页结构
-    int32 page_idx = (page_va - vma->vm_start) / PAGE_SIZE;
-    if (page_idx < 0 || page_idx >= vma->page_count)
-      return bytes_copied > 0 ? bytes_copied : -1;
-
-    // 确保页已分配
-    if (!vma->pages[page_idx]) {
-      // 页未分配，对于读操作这是错误
+    // 查找对应的页结构，未映射时按读缺页处理
+    struct page *page = mm_get_user_page(vma, page_va, 0);
+    if (!page)
       return bytes_copied > 0 ? bytes_copied : -1;
-    }
 
     // 计算实际源地址（内核视角）
-    const char *source = (const char *)vma->pages[page_idx]->paddr + page_offset;
+    const char *source = (const char *)page->paddr + page_offset;
 
     // 复制数据
     memcpy(dst_ptr + bytes_copied, source, page_bytes);
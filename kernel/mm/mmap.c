@@ -1,6 +1,7 @@
 #include <kernel/types.h>
 #include <kernel/mmu.h>
 #include <kernel/util.h>			//memset
+#include <kernel/vfs.h>
 
 /**
  * 将保护标志(PROT_*)转换为页表项标志
@@ -131,15 +132,14 @@ uint64 find_free_area(struct mm_struct *mm, size_t length) {
  * @len: Length of the region to unmap
  *
  * This function unmaps the specified memory region from the process address
- * space. It handles VMA splitting, page freeing, and page table updates.
+ * space. VMAs straddling either boundary are split first (O(1), the page
+ * tables are left alone), then every VMA inside the range is zapped and freed.
  *
  * Return: 0 on success, negative error code on failure
  */
 int32 do_unmap(struct mm_struct *mm, uint64 start, size_t len) {
   uint64 end;
-  struct vm_area_struct *vma, *prev, *next, *free_vma;
-  int32 count = 0;
-  int32 ret = 0;
+  struct vm_area_struct *vma, *next;
 
   /* Sanity checks */
   if (!mm || !len)
@@ -153,96 +153,27 @@ int32 do_unmap(struct mm_struct *mm, uint64 start, size_t len) {
   if (end < start)
     return -EINVAL; /* Overflow check */
 
-  /* Find first overlapping VMA */
-  vma = find_vma(mm, start);
-  if (!vma || vma->vm_start >= end)
+  if (!find_vma_intersection(mm, start, end))
     return 0; /* No overlap - nothing to do */
 
-  /* Handle the case where we need to split the first VMA */
-  if (start > vma->vm_start) {
-    /* Create a new VMA for the first part */
-    free_vma = vm_area_setup(mm, vma->vm_start, start - vma->vm_start,
-                             vma->vm_type, vma->vm_prot, vma->vm_flags);
-    if (!free_vma)
-      return -ENOMEM;
-
-    /* Copy relevant pages from original VMA to new VMA */
-    int32 orig_start_idx = 0;
-    int32 new_vma_page_count = (start - vma->vm_start) / PAGE_SIZE;
-    for (int32 i = 0; i < new_vma_page_count; i++) {
-      free_vma->pages[i] = vma->pages[i];
-      vma->pages[i] = NULL;
-    }
-
-    /* Shift remaining pages in original VMA */
-    int32 remain_pages = vma->page_count - new_vma_page_count;
-    if (remain_pages > 0) {
-      for (int32 i = 0; i < remain_pages; i++) {
-        vma->pages[i] = vma->pages[i + new_vma_page_count];
-      }
-      memset(&vma->pages[remain_pages], 0,
-             (vma->page_count - remain_pages) * sizeof(struct page *));
-    }
-
-    /* Update original VMA start address */
-    vma->vm_start = start;
-  }
+  /* Split the VMA straddling 'start'; the part above it gets unmapped */
+  vma = find_vma(mm, start);
+  if (vma && vma->vm_start < start && !vma_split(vma, start))
+    return -ENOMEM;
 
-  /* Handle the case where we need to split the last VMA */
-  next = find_vma(mm, end);
-  if (next && next->vm_start < end) {
-    if (end < next->vm_end) {
-      /* Create a new VMA for the part after 'end' */
-      free_vma = vm_area_setup(mm, end, next->vm_end - end, next->vm_type,
-                               next->vm_prot, next->vm_flags);
-      if (!free_vma)
-        return -ENOMEM;
-
-      /* Copy relevant pages */
-      int32 split_idx = (end - next->vm_start) / PAGE_SIZE;
-      int32 remain_pages = next->page_count - split_idx;
-      for (int32 i = 0; i < remain_pages; i++) {
-        free_vma->pages[i] = next->pages[i + split_idx];
-        next->pages[i + split_idx] = NULL;
-      }
-
-      /* Update end address for the last VMA to be unmapped */
-      next->vm_end = end;
-    }
-  }
+  /* Split the VMA straddling 'end'; the part below it gets unmapped */
+  vma = find_vma(mm, end);
+  if (vma && vma->vm_start < end && !vma_split(vma, end))
+    return -ENOMEM;
 
-  /* Free all VMAs in the range */
+  /* Free all VMAs in the range (the list is not sorted by address) */
   list_for_each_entry_safe(vma, next, &mm->vma_list, vm_list) {
-    if (vma->vm_start >= end)
-      break;
-
-    if (vma->vm_end <= start)
+    if (vma->vm_start >= end || vma->vm_end <= start)
       continue;
 
-    /* Calculate region to unmap in this VMA */
-    uint64 unmap_start = MAX(start, vma->vm_start);
-    uint64 unmap_end = MIN(end, vma->vm_end);
-
-    /* Free physical pages and unmap */
-    int32 start_idx = (unmap_start - vma->vm_start) / PAGE_SIZE;
-    int32 end_idx = (unmap_end - vma->vm_start + PAGE_SIZE - 1) / PAGE_SIZE;
-
-    for (int32 i = start_idx; i < end_idx && i < vma->page_count; i++) {
-      if (vma->pages[i]) {
-        uint64 page_va = vma->vm_start + (i * PAGE_SIZE);
-        pgt_unmap(mm->pagetable, page_va, PAGE_SIZE, 1);
-        put_page(vma->pages[i]);
-        vma->pages[i] = NULL;
-      }
-    }
-
-    /* Remove this VMA */
-    list_del(&vma->vm_list);
-    if (vma->pages)
-      kfree(vma->pages);
-    kfree(vma);
+    /* Unmaps the pages, drops the file reference and shared link too */
+    free_vma(vma);
     mm->map_count--;
-    count++;
   }
 
   /* Flush TLB */
@@ -300,66 +231,17 @@ uint64 do_brk(struct mm_struct *mm, uint64 new_brk) {
 							return -ENOMEM;
 					}
 			} else {
-					// Extend the existing heap VMA
+					// Extend the existing heap VMA; pages are faulted in on demand
 					vma->vm_end = new_brk;
-					
-					// Ensure the pages array can handle the extended size
-					uint64 old_npages = vma->page_count;
-					uint64 new_npages = (new_brk - vma->vm_start + PAGE_SIZE - 1) / PAGE_SIZE;
-					
-					if (new_npages > old_npages) {
-							// Reallocate the pages array
-							struct page **new_pages = 
-									kmalloc(new_npages * sizeof(struct page *));
-							if (!new_pages) {
-									kprintf("mm_brk: failed to allocate pages array\n");
-									vma->vm_end = old_brk;  // Restore old size
-									return -ENOMEM;
-							}
-							
-							// Initialize the new array
-							memset(new_pages, 0, new_npages * sizeof(struct page *));
-							
-							// Copy existing pages if any
-							if (vma->pages) {
-									memcpy(new_pages, vma->pages, 
-											 old_npages * sizeof(struct page *));
-									kfree(vma->pages);
-							}
-							
-							vma->pages = new_pages;
-							vma->page_count = new_npages;
-					}
 			}
 	}
 	/* HEAP CONTRACTION */
 	else {
-			// Find the VMA that contains the area to be unmapped
-			struct vm_area_struct *vma = find_vma(mm, new_brk);
-			
-			if (vma && vma->vm_start < new_brk && vma->vm_type == VMA_HEAP) {
-					// Free the pages in the contracted region
-					uint64 page_size = PAGE_SIZE;
-					for (uint64 addr = ROUNDUP(new_brk, page_size); 
-							 addr < old_brk; 
-							 addr += page_size) {
-							
-							int32 page_idx = (addr - vma->vm_start) / page_size;
-							if (page_idx >= 0 && page_idx < vma->page_count && vma->pages[page_idx]) {
-									// Unmap and free this page
-									pgt_unmap(mm->pagetable, addr, page_size, 1);
-									put_page(vma->pages[page_idx]);
-									vma->pages[page_idx] = NULL;
-							}
-					}
-					
-					// Shrink the VMA
-					vma->vm_end = new_brk;
-					
-					// Optionally reallocate the pages array to save memory
-					// This is less critical and could be omitted for simplicity
-			}
-			// If there's no VMA at the new_brk point, nothing special to do
+			// Expansion refuses overlaps, so [new_brk, old_brk) only holds heap VMAs;
+			// do_unmap splits the heap VMA at new_brk and frees the pages above it
+			int32 ret = do_unmap(mm, new_brk, old_brk - new_brk);
+			if (ret)
+					return ret;
 	}
 	
 	// Update the brk value in mm_struct
@@ -460,4 +342,55 @@ int32 do_protect(struct mm_struct *mm, __page_aligned uint64 start, size_t len,
 	flush_tlb();
 	
 	return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * do_msync - Write back shared file mappings in a range
+ * @mm: The memory descriptor
+ * @start: Start address (must be page-aligned)
+ * @len: Length of the range
+ * @flags: MS_ASYNC, MS_SYNC and/or MS_INVALIDATE
+ *
+ * Only the dirty page cache pages of MAP_SHARED file VMAs are written; private
+ * and anonymous VMAs in the range are skipped. Pages stay coherent with the
+ * page cache, so MS_INVALIDATE has nothing to drop.
+ *
+ * Return: 0 on success, negative error code on failure
+ */
+int32 do_msync(struct mm_struct *mm, __page_aligned uint64 start, size_t len, int32 flags) {
+	struct vm_area_struct *vma;
+	uint64 end, addr;
+	int32 ret = 0;
+
+	if (unlikely(!mm))
+			return -EINVAL;
+	if (start & (PAGE_SIZE - 1))
+			return -EINVAL;
+	if (flags & ~(MS_ASYNC | MS_INVALIDATE | MS_SYNC))
+			return -EINVAL;
+	if ((flags & MS_ASYNC) && (flags & MS_SYNC))
+			return -EINVAL;
+
+	end = start + ROUNDUP(len, PAGE_SIZE);
+	if (end < start)
+			return -ENOMEM;
+
+	for (addr = start; addr < end; ) {
+			vma = find_vma(mm, addr);
+			/* Holes in the range are an error, like Linux */
+			if (!vma)
+					return -ENOMEM;
+
+			uint64 sync_end = MIN(end, vma->vm_end);
+			if (vma->vm_file && (vma->vm_flags & VM_SHARED)) {
+					loff_t fstart = ((loff_t)vma->vm_pgoff << PAGE_SHIFT) + (addr - vma->vm_start);
+					int32 err = filemap_write_range(vma->vm_file, fstart, fstart + (sync_end - addr),
+					                                (flags & MS_SYNC) ? WB_SYNC_ALL : WB_SYNC_NONE);
+					if (err && !ret)
+							ret = err;
+			}
+			addr = sync_end;
+	}
+
+	return ret;
+}
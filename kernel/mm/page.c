@@ -84,6 +84,7 @@ void init_page_manager() {
 
 	INIT_LIST_HEAD(&free_page_list);
 	spinlock_init(&free_page_lock);
+	lock_set_class(&free_page_lock, "free_page_lock");
 	INIT_LIST_HEAD(&page_lru_list);
 	spinlock_init(&page_lru_lock);
 
@@ -144,10 +145,7 @@ struct page* pfn_to_page(uint64 pfn) {
 struct page* addr_to_page(paddr_t addr) {
 	paddr_t pa;
 	if (addr >= mem_base_addr + mem_size) {
-		kprintf("addr_to_page: original kva 0x%lx\n",addr);
 		pa = lookup_pa(g_kernel_pagetable, addr);
-		kprintf("addr_to_page: translate kpa 0x%lx\n",addr);
-
 	}else{
 		pa = addr;
 	}
@@ -155,7 +153,6 @@ struct page* addr_to_page(paddr_t addr) {
 		kprintf("addr_to_page: invalid address 0x%lx\n",addr);
 		return NULL;
 	}
-	kprintf("addr_to_page: pa 0x%lx\n",pa);
 	uint64 pfn = get_pfn(pa);
 	// kprintf("addr_to_page: pfn=%lx\n",pfn);
 	return pfn_to_page(pfn);
@@ -190,14 +187,12 @@ struct page* alloc_page(void) {
 void put_page(struct page* page) {
 	if (!page) return;
 
-	// 确保引用计数为0
-	if (atomic_read(&page->_refcount) != 0) {
-		// 引用计数不为0，不能释放
-		return;
-	}
+	// 引用计数降为0时才真正释放
+	if (!atomic_dec_and_test(&page->_refcount)) return;
 
-	init_page_struct(page);     // 重置页结构
-	put_free_page(page->paddr); // 释放物理页
+	paddr_t pa = page->paddr; // init_page_struct会清掉paddr，先保存
+	init_page_struct(page);   // 重置页结构
+	put_free_page(pa);        // 释放物理页
 }
 
 // 增加页引用计数
@@ -22,6 +22,7 @@ void pagetable_server_init(void) {
 	// 初始化页表统计信息
 	atomic_set(&pt_stats.mapped_pages, 0);
 	atomic_set(&pt_stats.page_tables, 0);
+	lock_set_class(&pagetable_lock, "pagetable_lock");
 }
 
 /**
@@ -68,6 +69,19 @@ static void _pagetable_free_level(pagetable_t pagetable, int32 level) {
 	}
 }
 
+/**
+ * 共享内核的根页表项（只复制根页表项，下级页表与内核页表是同一份）
+ */
+void pagetable_share_kernel(pagetable_t pagetable) {
+	if (pagetable == NULL || g_kernel_pagetable == NULL) {
+		return;
+	}
+
+	for (int32 i = PX(2, TASK_SIZE); i < PT_ENTRIES; i++) {
+		pagetable[i] = g_kernel_pagetable[i];
+	}
+}
+
 /**
  * 释放整个页表结构
  */
@@ -76,6 +90,15 @@ void free_pagetable(pagetable_t pagetable) {
 		return;
 	}
 
+	// 共享自内核页表的下级页表不属于这张页表，先摘掉
+	if (pagetable != g_kernel_pagetable) {
+		for (int32 i = PX(2, TASK_SIZE); i < PT_ENTRIES; i++) {
+			if (pagetable[i] == g_kernel_pagetable[i]) {
+				pagetable[i] = 0;
+			}
+		}
+	}
+
 	// 递归释放所有级别的页表
 	_pagetable_free_level(pagetable, 0);
 
@@ -118,7 +141,8 @@ pte_t* page_walk(pagetable_t pagetable, uint64 va, int32 alloc) {
 
 				*pte = PA2PPN(pt) | PTE_V;
 			} else {
-				kprintf("pgt_walk: invalid pte! va = %lx\n", va);
+				// alloc == 0 时查不到是正常情况（缺页处理会频繁探测），只在分配失败时报错
+				if (alloc) kprintf("pgt_walk: invalid pte! va = %lx\n", va);
 
 				return 0;
 
@@ -169,8 +193,6 @@ int32 pgt_map_page(pagetable_t pagetable, vaddr_t va, paddr_t pa, int32 perm) {
 		if (PTE2PA(*pte) == aligned_pa) {
 			// 同一物理页，只更新权限
 			*pte = PA2PPN(aligned_pa) | perm | PTE_V;
-			kprintf("update page=%lx perm: %lx\n", aligned_pa, perm);
-
 		} else {
 			// 映射到不同物理页，报错
 			spinlock_unlock_irqrestore(&pagetable_lock, flags);
@@ -184,6 +206,8 @@ int32 pgt_map_page(pagetable_t pagetable, vaddr_t va, paddr_t pa, int32 perm) {
 	}
 
 	spinlock_unlock_irqrestore(&pagetable_lock, flags);
+	// 回用户态时不再整个刷TLB，改过的PTE要在这里刷掉；无效项也可能被缓存过
+	flush_tlb_page(aligned_va);
 	return 0;
 }
 
@@ -236,7 +260,8 @@ int32 pgt_unmap(pagetable_t pagetable, uint64 va, uint64 size, int32 free_phys)
 		// 查找页表项，不分配新页表
 		pte_t* pte = page_walk(pagetable, va_page, 0);
 		if (pte == NULL) {
-			// 页表不存在，跳过
+			// 整张叶子页表都不存在，直接跳到下一个2MB边界，稀疏区域不必逐页探测
+			va_page = ROUNDDOWN(va_page, 1UL << PXSHIFT(1)) + (1UL << PXSHIFT(1)) - PAGE_SIZE;
 			continue;
 		}
 
@@ -400,6 +425,8 @@ pagetable_t pagetable_copy(pagetable_t src, uint64 start, uint64 end, int32 shar
 	}
 
 	spinlock_unlock_irqrestore(&pagetable_lock, flags);
+	// 源页表去掉了写权限，父进程回用户态前TLB里不能还留着可写的表项
+	flush_tlb();
 	return dst;
 }
 
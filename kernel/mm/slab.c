@@ -228,6 +228,7 @@ void slab_init(void) {
     struct kmem_cache *cache = &slab_caches[i];
 
     spinlock_init(&cache->lock);
+    lock_set_class(&cache->lock, "slab_cache");
     cache->obj_size = slab_sizes[i];
     INIT_LIST_HEAD(&cache->slabs_full);
     INIT_LIST_HEAD(&cache->slabs_partial);
@@ -1,8 +1,35 @@
 #include <kernel/mmu.h>
 #include <kernel/sched.h>
+#include <kernel/trapframe.h>
 #include <kernel/types.h>
 #include <kernel/util.h>
 
+/*
+ * 用户内存访问走直接路径：打开sstatus.SUM后用用户虚拟地址直接读写，
+ * 缺页由kernel_trap_handler按需分配，无法处理的访问经异常表返回-EFAULT。
+ */
+
+extern struct exception_table_entry __start___ex_table[], __stop___ex_table[];
+
+/**
+ * fixup_exception - Redirect a faulting uaccess instruction to its fixup
+ * @tf: Kernel trap frame; tf->epc is the faulting instruction
+ *
+ * Returns 1 if an entry was found and tf->epc was updated, 0 otherwise.
+ */
+int32 fixup_exception(struct trapframe *tf)
+{
+    struct exception_table_entry *e;
+
+    for (e = __start___ex_table; e < __stop___ex_table; e++) {
+        if (e->insn == tf->epc) {
+            tf->epc = e->fixup;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 
 /**
  * copy_to_user - Copy a block of data into user space
@@ -15,41 +42,134 @@
  */
 uint64 copy_to_user(void __user *to, const void *from, uint64 n)
 {
-    if (!current || !current->mm)
-        return n;
-        
-    ssize_t ret = mm_copy_to_user(current->mm, (uint64)to, from, n);
-    if (ret < 0)
+    if (!n)
+        return 0;
+    if (!current || !current->mm || !access_ok(to, n))
         return n;
-        
-    return n - ret;
+
+    uint64 satp = user_access_begin();
+    uint64 left = __asm_copy_to_user(to, from, n);
+    user_access_end(satp);
+
+    return left;
+}
+
+/*
+ * word-at-a-time：对齐的8字节读不会跨页，可以放心读到结束符之后；
+ * has_zero()在某个字节为0时置位该字节的最高位，最低的那个置位就是第一个0字节。
+ */
+#define REPEAT_BYTE(x) ((~0UL / 0xff) * (x))
+
+static inline uint64 has_zero(uint64 word)
+{
+    return (word - REPEAT_BYTE(0x01)) & ~word & REPEAT_BYTE(0x80);
+}
+
+// has_zero()结果中第一个0字节的下标（小端）
+static inline int64 zero_byte_index(uint64 mask)
+{
+    int64 idx = 0;
+    while (!(mask & 0x80)) {
+        mask >>= 8;
+        idx++;
+    }
+    return idx;
 }
 
 /**
- * strlen_user - Get string length in user space
- * @str: The string to measure
+ * do_strncpy_from_user - Core of strncpy_from_user/strnlen_user
+ * @dst: Destination buffer, or NULL to only measure
+ * @src: Source address in user space, already checked by access_ok()
+ * @max: Maximum number of bytes to look at, src + max <= TASK_SIZE
  *
- * Returns string length including null byte on success,
- * 0 on exception.
+ * Must be called inside user_access_begin()/user_access_end().
+ * Returns the index of the NUL byte, max if there is none, or -EFAULT.
  */
-int64 strlen_user(const char __user *str)
+static int64 do_strncpy_from_user(char *dst, const char __user *src, int64 max)
 {
     int64 res = 0;
+    uint64 word;
     char c;
-    
-    while (1) {
-        if (copy_from_user(&c, str + res, 1) != 0)
-            return 0;
-            
+
+    // 先逐字节走到8字节对齐处
+    while (res < max && ((uint64)(src + res) & 7)) {
+        if (__get_user(c, src + res))
+            return -EFAULT;
+        if (dst)
+            dst[res] = c;
         if (c == '\0')
-            return res + 1; // 包含null字节
-            
+            return res;
+        res++;
+    }
+
+    while (max - res >= 8) {
+        if (__get_user(word, (const uint64 __user *)(src + res)))
+            return -EFAULT;
+        if (dst)
+            memcpy(dst + res, &word, 8);
+
+        uint64 zero = has_zero(word);
+        if (zero)
+            return res + zero_byte_index(zero);
+        res += 8;
+    }
+
+    // 剩下不足一个字的尾巴
+    while (res < max) {
+        if (__get_user(c, src + res))
+            return -EFAULT;
+        if (dst)
+            dst[res] = c;
+        if (c == '\0')
+            return res;
         res++;
-        
-        // 安全检查，避免无限循环
-        if (res > 4096) // 合理的字符串长度上限
-            return 0;
     }
+
+    return res;
+}
+
+/**
+ * strnlen_user - Get the size of a user space string, bounded
+ * @str: The string to measure
+ * @n: The maximum valid length
+ *
+ * Returns the size of the string including the trailing NUL on success,
+ * 0 on exception, or a value greater than @n if the string is too long.
+ */
+int64 strnlen_user(const char __user *str, int64 n)
+{
+    int64 max, res;
+
+    if (n <= 0)
+        return 0;
+    if (!current || !current->mm || !access_ok(str, 1))
+        return 0;
+
+    max = MIN((uint64)n, TASK_SIZE - (uint64)str);
+
+    uint64 satp = user_access_begin();
+    res = do_strncpy_from_user(NULL, str, max);
+    user_access_end(satp);
+
+    if (res < 0)
+        return 0;
+    if (res == max && max < n)
+        return 0; // 一直读到TASK_SIZE都没有结束符
+    return res + 1; // 没有结束符时为n + 1
+}
+
+/**
+ * strlen_user - Get string length in user space
+ * @str: The string to measure
+ *
+ * Returns string length including null byte on success,
+ * 0 on exception.
+ */
+int64 strlen_user(const char __user *str)
+{
+    // 合理的字符串长度上限，避免无限扫描
+    int64 res = strnlen_user(str, 4096);
+    return res > 4096 ? 0 : res;
 }
 
 /**
@@ -99,14 +219,20 @@ char *user_to_kernel_str(const char *user_ptr) {
  */
 uint64 copy_from_user(void *to, const void __user *from, uint64 n)
 {
-    if (!current || !current->mm)
-        return n;
-        
-    ssize_t ret = mm_copy_from_user(current->mm, (uint64)to, from, n);
-    if (ret < 0)
+    if (!n)
+        return 0;
+    if (!current || !current->mm || !access_ok(from, n))
         return n;
-        
-    return n - ret;
+
+    uint64 satp = user_access_begin();
+    uint64 left = __asm_copy_from_user(to, from, n);
+    user_access_end(satp);
+
+    // 和Linux一样，未能复制的部分清零，避免泄露内核数据
+    if (left)
+        memset((char *)to + (n - left), 0, left);
+
+    return left;
 }
 
 
@@ -121,32 +247,26 @@ uint64 copy_from_user(void *to, const void __user *from, uint64 n)
  */
 int64 strncpy_from_user(char *dst, const char __user *src, int64 count)
 {
-    int64 res = 0;
-    
+    int64 max, res;
+
     if (count <= 0)
         return 0;
-        
-    while (res < count - 1) {
-        if (copy_from_user(dst + res, src + res, 1) != 0)
-            return -EFAULT;
-            
-        if (dst[res] == '\0')
-            return res;
-            
-        res++;
-    }
-    
-    dst[res] = '\0'; // 确保字符串结束
-    
-    // 检查源字符串是否真的结束
-    char tmp;
-    if (copy_from_user(&tmp, src + res, 1) != 0)
+    if (!current || !current->mm || !access_ok(src, 1))
         return -EFAULT;
-        
-    if (tmp != '\0')
-        return -ENAMETOOLONG; // 字符串太长
-        
-    return res; // 返回不包括结束符的长度
+
+    max = MIN((uint64)count, TASK_SIZE - (uint64)src);
+
+    uint64 satp = user_access_begin();
+    res = do_strncpy_from_user(dst, src, max);
+    user_access_end(satp);
+
+    if (res < 0 || res < max)
+        return res; // -EFAULT，或不包括结束符的长度
+
+    dst[count - 1] = '\0'; // 确保字符串结束
+    if (max < count)
+        return -EFAULT;
+    return -ENAMETOOLONG; // 字符串太长
 }
 
 
@@ -160,22 +280,16 @@ int64 strncpy_from_user(char *dst, const char __user *src, int64 count)
  */
 uint64 clear_user(void __user *to, uint64 n)
 {
-    char zeros[64];
-    uint64 chunk, ret = 0;
-    
-    memset(zeros, 0, sizeof(zeros));
-    
-    while (n > 0) {
-        chunk = (n > sizeof(zeros)) ? sizeof(zeros) : n;
-        ret = copy_to_user(to, zeros, chunk);
-        if (ret)
-            break;
-            
-        to += chunk;
-        n -= chunk;
-    }
-    
-    return n; // 返回未能清零的字节数
+    if (!n)
+        return 0;
+    if (!current || !current->mm || !access_ok(to, n))
+        return n;
+
+    uint64 satp = user_access_begin();
+    uint64 left = __asm_clear_user(to, n);
+    user_access_end(satp);
+
+    return left; // 返回未能清零的字节数
 }
 
 
@@ -188,13 +302,8 @@ uint64 clear_user(void __user *to, uint64 n)
  */
 int32 access_ok(const void __user *addr, uint64 size)
 {
-    if (!current || !current->mm){
-        return 1;
-	}
-	
-	return 0;
-    // // 简单的边界检查，实际实现应该更完善
-    // uint64 uaddr = (uint64)addr;
-    // return (uaddr < TASK_SIZE) && (size <= TASK_SIZE - uaddr);
+    // 内核映射与用户页表共享，SUM打开时同样可以访问，必须挡在TASK_SIZE以下
+    uint64 uaddr = (uint64)addr;
+    return (uaddr < TASK_SIZE) && (size <= TASK_SIZE - uaddr);
 }
 
@@ -1,20 +1,25 @@
+#include <kernel/mm/filemap.h>
 #include <kernel/mm/kmalloc.h>
 #include <kernel/mm/vma.h>
 #include <kernel/util.h>
+#include <kernel/vfs.h>
 
 static int32 insert_vm_struct(struct mm_struct* mm, struct vm_area_struct* vma);
-static int32 vma_alloc_page_array(struct vm_area_struct* vma);
 static void vma_init(struct vm_area_struct* vma, struct mm_struct* mm, uint64 start, uint64 end, enum vma_type type, int32 prot, uint64 flags);
 static struct vm_area_struct* alloc_vma();
 
+/**
+ * free_vma - Unmap and free a VMA
+ * @vma: The VMA, still linked on its mm
+ *
+ * 页只记录在页表中，这里按PTE逐个释放；没有页表的空洞直接跳过，
+ * 因此稀疏的大VMA释放代价只和实际映射的页数有关。
+ */
 void free_vma(struct vm_area_struct* vma) {
-	if (vma->pages) {
-		for (int32 i = 0; i < vma->page_count; i++) {
-			if (vma->pages[i]) {
-				put_page(vma->pages[i]);
-			}
-		}
-		kfree(vma->pages);
+	vm_zap_range(vma, vma->vm_start, vma->vm_end);
+	if (vma->vm_file) {
+		filemap_unlink_vma(vma);
+		file_unref(vma->vm_file);
 	}
 	list_del(&vma->vm_list);
 	kfree(vma);
@@ -43,15 +48,8 @@ struct vm_area_struct* vm_area_setup(struct mm_struct* mm, uint64 addr, uint64 l
 	// Initialize VMA
 	vma_init(vma, mm, addr, addr + len, type, prot, flags);
 
-	// Allocate page tracking array
-	if (vma_alloc_page_array(vma) != 0) {
-		kfree(vma);
-		return NULL;
-	}
-
 	// Insert VMA
 	if (insert_vm_struct(mm, vma) != 0) {
-		if (vma->pages) kfree(vma->pages);
 		kfree(vma);
 		return NULL;
 	}
@@ -74,9 +72,9 @@ struct vm_area_struct* vm_area_setup(struct mm_struct* mm, uint64 addr, uint64 l
  * 也可以只填充vma的部分页
  */
 int32 populate_vma(struct vm_area_struct* vma, vaddr_t va, size_t length, int32 prot) {
-	kprintf("populate_vma: start with vma = %lx, va = %lx, length = &lx, prot = %lx\n, ", vma, va, length, prot);
-	for (size_t offset = 0, page_idx = offset / PAGE_SIZE; offset < length; offset += PAGE_SIZE, page_idx++) {
-		if (vma->pages[page_idx]) {
+	for (size_t offset = 0; offset < length; offset += PAGE_SIZE) {
+		pte_t* pte = page_walk(vma->vm_mm->pagetable, va + offset, 0);
+		if (pte && (*pte & PTE_V)) {
 			continue;
 		}
 		struct page* page = alloc_page();
@@ -84,9 +82,6 @@ int32 populate_vma(struct vm_area_struct* vma, vaddr_t va, size_t length, int32
 			do_unmap(vma->vm_mm, va, offset);
 			return -ENOMEM;
 		}
-		vma->pages[page_idx] = page;
-		kprintf("populate_vma: calling pgt_map_page with va = %lx, pa = %lx, prot = %lx\n", va + offset, page->paddr, prot);
-
 		int32 ret = pgt_map_page(vma->vm_mm->pagetable, va + offset, page->paddr, prot_to_type(prot, vma->vm_flags & VM_USER));
 		if (unlikely(ret)) {
 			put_page(page);
@@ -98,6 +93,220 @@ int32 populate_vma(struct vm_area_struct* vma, vaddr_t va, size_t length, int32
 	return 0;
 }
 
+/**
+ * vma_page_prot - PTE permission bits for pages mapped into @vma
+ * @vma: The VMA
+ *
+ * 文件映射直接映射页缓存中的页，因此一律先只读：私有映射首次写入时COW，
+ * 共享映射首次写入时记录脏页（见filemap_page_mkwrite）。
+ */
+static uint64 vma_page_prot(struct vm_area_struct* vma) {
+	uint64 perm = vm_flags_to_type(vma->vm_flags);
+
+	if (vma->vm_file) perm &= ~(PTE_W | PTE_D);
+	return perm;
+}
+
+/**
+ * __vm_map_page - Install @page at @addr, consuming the caller's reference
+ * @vma: The VMA
+ * @addr: Page aligned user virtual address
+ * @page: The page to map; its reference is handed over to the VMA
+ * @perm: PTE permission bits
+ *
+ * 若该地址原先映射了别的页（COW替换），旧页的引用会被释放。
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+static int32 __vm_map_page(struct vm_area_struct* vma, uint64 addr, struct page* page, uint64 perm) {
+	struct page* old = vm_lookup_page(vma, addr);
+
+	if (old == page) {
+		// 同一页只更新权限，PTE已经持有引用
+		if (pgt_map_page(vma->vm_mm->pagetable, addr, page->paddr, perm) != 0) return -ENOMEM;
+		put_page(page);
+		return 0;
+	}
+	if (old) pgt_unmap(vma->vm_mm->pagetable, addr, PAGE_SIZE, 0);
+
+	if (pgt_map_page(vma->vm_mm->pagetable, addr, page->paddr, perm) != 0) return -ENOMEM;
+
+	if (old) put_page(old);
+	return 0;
+}
+
+/**
+ * vm_lookup_page - Find the page currently mapped at @addr
+ * @vma: The VMA
+ * @addr: User virtual address inside @vma
+ *
+ * Returns: The mapped page (no reference taken), or NULL if not present
+ */
+struct page* vm_lookup_page(struct vm_area_struct* vma, uint64 addr) {
+	pte_t* pte = page_walk(vma->vm_mm->pagetable, ROUNDDOWN(addr, PAGE_SIZE), 0);
+
+	if (!pte || !(*pte & PTE_V)) return NULL;
+	return addr_to_page(PTE2PA(*pte));
+}
+
+/**
+ * vm_zap_range - Unmap [start, end) of @vma and drop the PTEs' page references
+ * @vma: The VMA
+ * @start: Page aligned start address
+ * @end: End address (exclusive)
+ */
+void vm_zap_range(struct vm_area_struct* vma, uint64 start, uint64 end) {
+	start = MAX(start, vma->vm_start);
+	end = MIN(ROUNDUP(end, PAGE_SIZE), vma->vm_end);
+	if (start >= end || !vma->vm_mm->pagetable) return;
+
+	// VM_IO映射的不是页池中的页，不能释放
+	pgt_unmap(vma->vm_mm->pagetable, start, end - start, !(vma->vm_flags & VM_IO));
+}
+
+/**
+ * vma_split - Split @vma at @addr
+ * @vma: The VMA to split
+ * @addr: Page aligned address strictly inside @vma
+ *
+ * 页表不需要改动，只复制描述符并调整边界和文件偏移，代价与VMA大小无关。
+ *
+ * Returns: The new VMA covering [addr, old vm_end), or NULL on failure
+ */
+struct vm_area_struct* vma_split(struct vm_area_struct* vma, uint64 addr) {
+	struct vm_area_struct* new;
+
+	if (addr <= vma->vm_start || addr >= vma->vm_end || (addr & (PAGE_SIZE - 1))) return NULL;
+
+	new = alloc_vma();
+	if (!new) return NULL;
+
+	new->vm_start = addr;
+	new->vm_end = vma->vm_end;
+	new->vm_prot = vma->vm_prot;
+	new->vm_type = vma->vm_type;
+	new->vm_flags = vma->vm_flags;
+	new->vm_mm = vma->vm_mm;
+	new->vm_pgoff = vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT);
+	if (vma->vm_file) {
+		new->vm_file = file_ref(vma->vm_file);
+		filemap_link_vma(new);
+	}
+	vma->vm_end = addr;
+
+	list_add(&new->vm_list, &vma->vm_list);
+	vma->vm_mm->map_count++;
+	return new;
+}
+
+/**
+ * vm_insert_page - Map an existing page (e.g. a page cache page) into a VMA
+ * @vma: The VMA
+ * @addr: User virtual address inside @vma
+ * @page: The page to map; the VMA takes its own reference
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int32 vm_insert_page(struct vm_area_struct* vma, uint64 addr, struct page* page) {
+	int32 ret;
+
+	if (!vma || !page) return -EINVAL;
+	addr = ROUNDDOWN(addr, PAGE_SIZE);
+	if (addr < vma->vm_start || addr >= vma->vm_end) return -EFAULT;
+
+	get_page(page);
+	ret = __vm_map_page(vma, addr, page, vma_page_prot(vma));
+	if (ret) put_page(page);
+	return ret;
+}
+
+/**
+ * vm_cow_page - Give @vma a private, writable copy of @src at @addr
+ * @vma: The VMA
+ * @addr: User virtual address inside @vma
+ * @src: The page whose contents are copied
+ *
+ * 匿名页如果只剩这一个引用，直接恢复写权限即可，不需要复制。
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int32 vm_cow_page(struct vm_area_struct* vma, uint64 addr, struct page* src) {
+	uint64 perm = vm_flags_to_type(vma->vm_flags);
+	struct page* page;
+	int32 ret;
+
+	addr = ROUNDDOWN(addr, PAGE_SIZE);
+	if (!src->mapping && vm_lookup_page(vma, addr) == src &&
+	    atomic_read(&src->_refcount) == 1) {
+		ret = pgt_map_page(vma->vm_mm->pagetable, addr, src->paddr, perm) ? -ENOMEM : 0;
+		flush_tlb();
+		return ret;
+	}
+
+	page = alloc_page();
+	if (unlikely(!page)) return -ENOMEM;
+	memcpy((void*)page->paddr, (void*)src->paddr, PAGE_SIZE);
+
+	ret = __vm_map_page(vma, addr, page, perm);
+	if (ret) put_page(page);
+	return ret;
+}
+
+/**
+ * do_anonymous_fault - Back a not-present anonymous page with a zeroed page
+ */
+static vm_fault_t do_anonymous_fault(struct vm_area_struct* vma, struct vm_fault* vmf) {
+	struct page* page = alloc_page();
+	if (unlikely(!page)) return VM_FAULT_OOM;
+
+	if (__vm_map_page(vma, ROUNDDOWN(vmf->address, PAGE_SIZE), page, vma_page_prot(vma))) {
+		put_page(page);
+		return VM_FAULT_OOM;
+	}
+	vmf->page = page;
+	return 0;
+}
+
+/**
+ * handle_vm_fault - Resolve a page fault inside @vma
+ * @vma: The VMA containing vmf->address
+ * @vmf: Fault description; pgoff and pte are filled in here
+ *
+ * 不存在的页：文件映射交给inode的page_fault，其余按匿名页处理；
+ * 已存在但只读的页被写：写时复制。访问权限由调用者检查。
+ *
+ * Returns: 0 on success, VM_FAULT_* error bits on failure
+ */
+vm_fault_t handle_vm_fault(struct vm_area_struct* vma, struct vm_fault* vmf) {
+	uint64 page_va = ROUNDDOWN(vmf->address, PAGE_SIZE);
+	pte_t* pte = page_walk(vma->vm_mm->pagetable, page_va, 0);
+
+	vmf->pte = pte;
+	vmf->pgoff = vma->vm_pgoff + ((page_va - vma->vm_start) >> PAGE_SHIFT);
+
+	if (pte && (*pte & PTE_V)) {
+		if ((vmf->flags & FAULT_FLAG_WRITE) && !(*pte & PTE_W) && (vma->vm_flags & VM_WRITE)) {
+			struct page* src = addr_to_page(PTE2PA(*pte));
+			if (!src) return VM_FAULT_SIGBUS;
+			// 共享文件页不复制，只记录脏页并放开写权限
+			if (vma->vm_file && (vma->vm_flags & VM_SHARED)) return filemap_page_mkwrite(vma, vmf, src);
+			if (vm_cow_page(vma, page_va, src)) return VM_FAULT_OOM;
+			return VM_FAULT_DONE_COW;
+		}
+		// 其他核已经处理过（或者TLB陈旧），刷新后重试即可
+		flush_tlb();
+		return 0;
+	}
+
+	if (vma->vm_file) {
+		struct inode* inode = vma->vm_file->f_inode;
+		if (!inode || !inode->i_op || !inode->i_op->page_fault) return VM_FAULT_SIGBUS;
+		return inode->i_op->page_fault(vma, vmf);
+	}
+
+	return do_anonymous_fault(vma, vmf);
+}
+
 /**
  * alloc_vma - Allocate a VMA structure
  * @mm: The memory descriptor
@@ -111,6 +320,7 @@ static struct vm_area_struct* alloc_vma() {
 	if (!vma) return NULL;
 
 	memset(vma, 0, sizeof(struct vm_area_struct));
+	INIT_LIST_HEAD(&vma->vm_shared);
 	spinlock_init(&vma->vma_lock);
 
 	return vma;
@@ -123,16 +333,14 @@ static struct vm_area_struct* alloc_vma() {
  * @end: End address
  * @flags: VMA flags
  *
- * This sets up common fields but doesn't allocate page arrays.
+ * This sets up common fields only; pages are mapped lazily on fault.
  */
 static void vma_init(struct vm_area_struct* vma, struct mm_struct* mm, uint64 start, uint64 end, enum vma_type type, int32 prot, uint64 flags) {
 	vma->vm_start = start;
 	vma->vm_end = end;
 	vma->vm_flags = flags;
+	vma->vm_prot = prot;
 	vma->vm_mm = mm;
-
-	// Calculate page count - moved to a separate step
-	vma->page_count = (end - start + PAGE_SIZE - 1) / PAGE_SIZE;
 	vma->vm_type = type;
 
 	// Set protection bits
@@ -141,22 +349,6 @@ static void vma_init(struct vm_area_struct* vma, struct mm_struct* mm, uint64 st
 	if (prot & PROT_EXEC) vma->vm_flags |= VM_EXEC | VM_MAYEXEC;
 }
 
-/**
- * vma_alloc_page_array - Allocate page tracking array for VMA
- * @vma: The VMA to allocate pages for
- *
- * Returns: 0 on success, -ENOMEM on failure
- */
-static int32 vma_alloc_page_array(struct vm_area_struct* vma) {
-	if (vma->page_count > 0) {
-		vma->pages = kmalloc(vma->page_count * sizeof(struct page*));
-		if (!vma->pages) return -ENOMEM;
-
-		memset(vma->pages, 0, vma->page_count * sizeof(struct page*));
-	}
-	return 0;
-}
-
 /**
  * insert_vm_struct - Insert a VMA into the mm's VMA list
  * @mm: The memory descriptor
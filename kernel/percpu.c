@@ -0,0 +1,118 @@
+/*
+ * percpu.c - 每个hart一份的变量
+ *
+ * 每个hart的一份（unit）是.data..percpu模板的副本，后面接着
+ * PERCPU_DYNAMIC_SIZE字节给alloc_percpu()用：
+ *
+ *   | 静态变量（模板的副本） | 动态分配区 |
+ *   ^ __per_cpu_start + __per_cpu_offset[cpu]
+ *
+ * 各份分开kmalloc，起点按cacheline对齐，大小也取整到cacheline。
+ * setup_per_cpu_areas()之前偏移都是0，只有启动hart在运行，用的就是模板；
+ * 这期间写进去的值会被复制到每一份里，但不能留着那时取到的地址。
+ *
+ * 动态分配区按8字节的小块管理，每块记一个状态：空闲、一次分配的第一块、
+ * 后续块。alloc_percpu()返回的和静态变量一样是"模板里的地址"，只能经过
+ * per_cpu_ptr()/this_cpu_ptr()访问。
+ */
+
+#include <kernel/mm/kmalloc.h>
+#include <kernel/percpu.h>
+#include <kernel/util.h>
+#include <kernel/util/spinlock.h>
+#include <kernel/util/string.h>
+
+uint64 __per_cpu_offset[NCPU];
+
+#define PCPU_MIN_ALLOC 8
+#define PCPU_NR_UNITS (PERCPU_DYNAMIC_SIZE / PCPU_MIN_ALLOC)
+
+enum { PCPU_FREE, PCPU_HEAD, PCPU_BODY };
+
+static uint8 pcpu_map[PCPU_NR_UNITS];
+static spinlock_t pcpu_lock = SPINLOCK_INIT;
+static uint64 pcpu_dyn_base; // 动态分配区在模板地址里的起点，0表示还没建好
+
+/**
+ * setup_per_cpu_areas - Give every hart its copy of the per-cpu section
+ *
+ * Called once on the boot hart after kmem_init(), before the other harts
+ * are started.
+ */
+void setup_per_cpu_areas(void) {
+	uint64 static_size = ROUNDUP((uint64)(__per_cpu_end - __per_cpu_start), SMP_CACHE_BYTES);
+	uint64 unit_size = static_size + PERCPU_DYNAMIC_SIZE;
+
+	for_each_possible_cpu(cpu) {
+		uint64 area = (uint64)kmalloc(unit_size + SMP_CACHE_BYTES);
+
+		if (!area) panic("setup_per_cpu_areas: out of memory for hart %d\n", cpu);
+		area = ROUNDUP(area, SMP_CACHE_BYTES);
+		memcpy((void*)area, __per_cpu_start, __per_cpu_end - __per_cpu_start);
+		memset((void*)(area + (__per_cpu_end - __per_cpu_start)), 0,
+		       unit_size - (__per_cpu_end - __per_cpu_start));
+		__per_cpu_offset[cpu] = area - (uint64)__per_cpu_start;
+	}
+	__sync_synchronize();
+	pcpu_dyn_base = (uint64)__per_cpu_start + static_size;
+	kprintf("percpu: %ld bytes static, %d bytes dynamic per hart\n", __per_cpu_end - __per_cpu_start,
+	        PERCPU_DYNAMIC_SIZE);
+}
+
+/**
+ * __alloc_percpu - Allocate a zeroed variable in every hart's copy
+ * @size: Size in bytes
+ * @align: Alignment, at most SMP_CACHE_BYTES
+ *
+ * Returns a per-cpu pointer for per_cpu_ptr()/this_cpu_ptr(), or NULL when
+ * the dynamic area is full or the per-cpu areas are not set up yet.
+ */
+void* __alloc_percpu(size_t size, size_t align) {
+	int32 units = (size + PCPU_MIN_ALLOC - 1) / PCPU_MIN_ALLOC;
+	int32 step = MAX(align, PCPU_MIN_ALLOC) / PCPU_MIN_ALLOC;
+	void* ptr = NULL;
+	int64 flags;
+
+	if (!pcpu_dyn_base || !size || align > SMP_CACHE_BYTES) return NULL;
+
+	flags = spinlock_lock_irqsave(&pcpu_lock);
+	for (int32 start = 0; start + units <= PCPU_NR_UNITS; start += step) {
+		int32 n = 0;
+
+		while (n < units && pcpu_map[start + n] == PCPU_FREE) n++;
+		if (n < units) continue;
+
+		pcpu_map[start] = PCPU_HEAD;
+		for (int32 i = 1; i < units; i++) pcpu_map[start + i] = PCPU_BODY;
+		ptr = (void*)(pcpu_dyn_base + start * PCPU_MIN_ALLOC);
+		break;
+	}
+	spinlock_unlock_irqrestore(&pcpu_lock, flags);
+
+	// 释放时不清零，分配时把每份都清掉
+	if (ptr)
+		for_each_possible_cpu(cpu) memset(per_cpu_ptr(ptr, cpu), 0, size);
+	return ptr;
+}
+
+/**
+ * free_percpu - Free a variable from __alloc_percpu()
+ * @ptr: The per-cpu pointer, may be NULL
+ */
+void free_percpu(void __percpu* ptr) {
+	int32 start;
+	int64 flags;
+
+	if (!ptr) return;
+	start = ((uint64)ptr - pcpu_dyn_base) / PCPU_MIN_ALLOC;
+
+	flags = spinlock_lock_irqsave(&pcpu_lock);
+	if ((uint64)ptr < pcpu_dyn_base || start >= PCPU_NR_UNITS || pcpu_map[start] != PCPU_HEAD) {
+		spinlock_unlock_irqrestore(&pcpu_lock, flags);
+		kprintf("free_percpu: bad pointer %p\n", ptr);
+		return;
+	}
+	pcpu_map[start] = PCPU_FREE;
+	for (int32 i = start + 1; i < PCPU_NR_UNITS && pcpu_map[i] == PCPU_BODY; i++) pcpu_map[i] = PCPU_FREE;
+	spinlock_unlock_irqrestore(&pcpu_lock, flags);
+}
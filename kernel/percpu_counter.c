@@ -0,0 +1,92 @@
+/*
+ * percpu_counter.c - 分散到每个hart上的计数器
+ *
+ * 每个hart的差值是一个int32，放在alloc_percpu()分配的per-cpu空间里。
+ * 改它时关中断，中断处理里的加减不会和任务里的交错；绝对值到了batch
+ * 就用一次原子加并进count再清零。整个过程不拿锁。
+ *
+ * 并进count和清零本hart的差值之间，别的hart上的percpu_counter_sum()
+ * 可能把这部分数算两次或者漏掉，所以sum也只是在没有并行更新时才准确。
+ */
+
+#include <kernel/percpu.h>
+#include <kernel/percpu_counter.h>
+#include <kernel/util.h>
+
+// 至少32；hart越多各份攒下的总误差越大，batch也放宽一点
+int32 percpu_counter_batch = MAX(32, NCPU * 2);
+
+/**
+ * percpu_counter_init - Set up a counter
+ * @fbc: The counter
+ * @amount: Initial value
+ *
+ * Needs the per-cpu areas, so not before setup_per_cpu_areas().
+ *
+ * Returns 0 on success or -ENOMEM.
+ */
+int32 percpu_counter_init(struct percpu_counter* fbc, int64 amount) {
+	atomic64_set(&fbc->count, amount);
+	fbc->counters = alloc_percpu(int32);
+	if (!fbc->counters) return -ENOMEM;
+	return 0;
+}
+
+void percpu_counter_destroy(struct percpu_counter* fbc) {
+	free_percpu(fbc->counters);
+	fbc->counters = NULL;
+}
+
+/**
+ * percpu_counter_add_batch - Add to a counter
+ * @fbc: The counter
+ * @amount: The value to add, may be negative
+ * @batch: Fold into the shared count once this hart's delta reaches this
+ */
+void percpu_counter_add_batch(struct percpu_counter* fbc, int64 amount, int32 batch) {
+	uint64 flags = disable_irqsave();
+	int32* pcount = this_cpu_ptr(fbc->counters);
+	int64 count = *pcount + amount;
+
+	if (count >= batch || count <= -batch) {
+		atomic64_add(count, &fbc->count);
+		WRITE_ONCE(*pcount, 0);
+	} else {
+		WRITE_ONCE(*pcount, (int32)count);
+	}
+	enable_irqrestore(flags);
+}
+
+/**
+ * percpu_counter_sum - Add up the shared count and every hart's delta
+ * @fbc: The counter
+ */
+int64 percpu_counter_sum(struct percpu_counter* fbc) {
+	int64 ret = atomic64_read(&fbc->count);
+
+	for_each_possible_cpu(cpu) ret += READ_ONCE(*per_cpu_ptr(fbc->counters, cpu));
+	return ret;
+}
+
+/**
+ * __percpu_counter_compare - Compare a counter with a value
+ * @fbc: The counter
+ * @rhs: The value to compare with
+ * @batch: The batch the counter is updated with
+ *
+ * Uses the cheap read when it is far enough from @rhs to tell, and the
+ * full sum otherwise.
+ *
+ * Returns 1 if the counter is greater, -1 if less, 0 if equal.
+ */
+int32 __percpu_counter_compare(struct percpu_counter* fbc, int64 rhs, int32 batch) {
+	int64 count = percpu_counter_read(fbc);
+
+	if (count - rhs > (int64)batch * NCPU) return 1;
+	if (rhs - count > (int64)batch * NCPU) return -1;
+
+	count = percpu_counter_sum(fbc);
+	if (count > rhs) return 1;
+	if (count < rhs) return -1;
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * 完成量，建立在等待队列上
+ *
+ * done和等待队列共用wait.lock，所以检查done和挂上队列是原子的。
+ */
+
+#include <kernel/sched.h>
+#include <kernel/sched/completion.h>
+#include <kernel/util.h>
+
+/*
+ * 睡眠直到done不为0，然后消耗一次。被信号打断时返回-EINTR，
+ * 此时done不变。
+ */
+static int32 do_wait_for_common(struct completion* x, uint32 state) {
+	struct wait_queue_entry wait;
+	int64 flags;
+
+	init_wait_entry(&wait, WQ_FLAG_EXCLUSIVE);
+	flags = spinlock_lock_irqsave(&x->wait.lock);
+	while (!x->done) {
+		if ((state & TASK_INTERRUPTIBLE) && signal_pending(current_task())) {
+			list_del_init(&wait.entry);
+			spinlock_unlock_irqrestore(&x->wait.lock, flags);
+			return -EINTR;
+		}
+		if (list_empty(&wait.entry)) list_add_tail(&wait.entry, &x->wait.head);
+		current_task()->state = state;
+		spinlock_unlock_irqrestore(&x->wait.lock, flags);
+		schedule();
+		flags = spinlock_lock_irqsave(&x->wait.lock);
+	}
+	list_del_init(&wait.entry);
+	current_task()->state = TASK_RUNNING;
+	if (x->done != COMPLETION_DONE_ALL) x->done--;
+	spinlock_unlock_irqrestore(&x->wait.lock, flags);
+	return 0;
+}
+
+/**
+ * wait_for_completion - Sleep until @x is completed
+ * @x: The completion
+ */
+void wait_for_completion(struct completion* x) {
+	do_wait_for_common(x, TASK_UNINTERRUPTIBLE);
+}
+
+/**
+ * wait_for_completion_interruptible - Like wait_for_completion(), but a
+ * signal ends the wait
+ * @x: The completion
+ *
+ * Returns 0 once completed, or -EINTR.
+ */
+int32 wait_for_completion_interruptible(struct completion* x) {
+	return do_wait_for_common(x, TASK_INTERRUPTIBLE);
+}
+
+/**
+ * try_wait_for_completion - Consume a completion without sleeping
+ * @x: The completion
+ *
+ * Returns 1 if one was consumed, 0 if the caller would have to wait.
+ */
+int32 try_wait_for_completion(struct completion* x) {
+	int32 ret = 1;
+	int64 flags = spinlock_lock_irqsave(&x->wait.lock);
+
+	if (!x->done)
+		ret = 0;
+	else if (x->done != COMPLETION_DONE_ALL)
+		x->done--;
+	spinlock_unlock_irqrestore(&x->wait.lock, flags);
+	return ret;
+}
+
+// 有没有还没被消耗的complete()，即现在等待会不会立刻返回
+int32 completion_done(struct completion* x) {
+	int64 flags = spinlock_lock_irqsave(&x->wait.lock);
+	int32 ret = x->done != 0;
+
+	spinlock_unlock_irqrestore(&x->wait.lock, flags);
+	return ret;
+}
+
+/**
+ * complete - Wake one waiter, or let the next wait pass if nobody waits yet
+ * @x: The completion
+ */
+void complete(struct completion* x) {
+	struct wait_queue_entry* wait;
+	int64 flags = spinlock_lock_irqsave(&x->wait.lock);
+
+	if (x->done != COMPLETION_DONE_ALL) x->done++;
+	// 等待者被唤醒后自己摘下等待项并消耗done，这里只叫醒排在最前的一个
+	list_for_each_entry(wait, &x->wait.head, entry) {
+		if (default_wake_function(wait, TASK_NORMAL)) break;
+	}
+	spinlock_unlock_irqrestore(&x->wait.lock, flags);
+}
+
+/**
+ * complete_all - Wake every waiter and let all later waits pass
+ * @x: The completion
+ */
+void complete_all(struct completion* x) {
+	struct wait_queue_entry* wait;
+	int64 flags = spinlock_lock_irqsave(&x->wait.lock);
+
+	x->done = COMPLETION_DONE_ALL;
+	list_for_each_entry(wait, &x->wait.head, entry) default_wake_function(wait, TASK_NORMAL);
+	spinlock_unlock_irqrestore(&x->wait.lock, flags);
+}
@@ -0,0 +1,322 @@
+/*
+ * fair.c - 公平调度类
+ *
+ * 就绪任务按vruntime（按权重折算的运行时间）放在红黑树里，每次运行
+ * vruntime最小的任务。nice值决定权重，权重决定vruntime增长的速度，
+ * 于是长期来看每个任务得到的CPU时间与它的权重成正比。
+ *
+ * 一个调度周期（sysctl_sched_latency）内每个就绪任务都应该运行一次，
+ * 任务在周期中的份额按权重分配，但不少于sysctl_sched_min_granularity。
+ * 抢占只发生在时钟中断和唤醒时，时钟tick比份额长时，实际时间片按tick取整。
+ *
+ * 睡眠醒来的任务vruntime被提到min_vruntime - sysctl_sched_latency / 2：
+ * 交互任务醒来后能很快运行，但睡得再久也攒不下更多的额度。
+ */
+
+#include <kernel/config.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/util.h>
+
+#define MS_TO_TIME(ms) ((uint64)(ms) * (TIMEBASE_FREQ / 1000))
+
+// 与Linux在4个CPU上的默认值相同（基准值乘以1 + log2(4)）
+uint64 sysctl_sched_latency = MS_TO_TIME(18);
+uint64 sysctl_sched_min_granularity = MS_TO_TIME(9) / 4;
+uint64 sysctl_sched_wakeup_granularity = MS_TO_TIME(3);
+
+/*
+ * nice值到权重的映射，与Linux的sched_prio_to_weight相同。
+ * 相邻两级相差约1.25倍，所以nice差1的两个CPU密集任务大约分得55%和45%。
+ */
+static const uint32 sched_prio_to_weight[NICE_WIDTH] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548,  7620,  6100,  4904,  3906,
+	/*  -5 */ 3121,  2501,  1991,  1586,  1277,
+	/*   0 */ 1024,  820,   655,   526,   423,
+	/*   5 */ 335,   272,   215,   172,   137,
+	/*  10 */ 110,   87,    70,    56,    45,
+	/*  15 */ 36,    29,    23,    18,    15,
+};
+
+void set_load_weight(struct task_struct *p) {
+	p->se.load_weight = sched_prio_to_weight[p->static_prio - MAX_RT_PRIO];
+}
+
+void init_cfs_rq(struct cfs_rq *cfs_rq) {
+	cfs_rq->tasks_timeline = RB_ROOT_CACHED;
+	cfs_rq->min_vruntime = 0;
+	cfs_rq->load = 0;
+	cfs_rq->nr_running = 0;
+}
+
+static inline struct task_struct *task_of(struct sched_entity *se) {
+	return container_of(se, struct task_struct, se);
+}
+
+// rq上正在运行的公平调度类任务，没有时返回NULL。
+// 被抢占、已经放回队列但还没切换走的任务不再记账，它的vruntime是树的排序键。
+static inline struct sched_entity *cfs_curr(struct rq *rq) {
+	struct task_struct *curr = per_cpu(current_percpu, rq->cpu);
+	if (!curr || curr == rq->idle || curr->sched_class != &fair_sched_class || curr->on_rq) return NULL;
+	return &curr->se;
+}
+
+// delta * NICE_0_LOAD / weight
+static inline uint64 calc_delta_fair(uint64 delta, struct sched_entity *se) {
+	if (se->load_weight == NICE_0_LOAD) return delta;
+	return delta * NICE_0_LOAD / se->load_weight;
+}
+
+// vruntime会回绕，比较时看差值的符号
+static inline int64 vruntime_diff(uint64 a, uint64 b) {
+	return (int64)(a - b);
+}
+
+static inline uint64 max_vruntime(uint64 a, uint64 b) {
+	return vruntime_diff(a, b) > 0 ? a : b;
+}
+
+static inline uint64 min_vruntime(uint64 a, uint64 b) {
+	return vruntime_diff(a, b) < 0 ? a : b;
+}
+
+static struct sched_entity *pick_first_entity(struct cfs_rq *cfs_rq) {
+	struct rb_node *left = rb_first_cached(&cfs_rq->tasks_timeline);
+	return left ? rb_entry(left, struct sched_entity, run_node) : NULL;
+}
+
+/*
+ * min_vruntime跟着正在运行的任务和树中最左边的任务走，但只增不减
+ */
+static void update_min_vruntime(struct rq *rq) {
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *curr = cfs_curr(rq);
+	struct sched_entity *left = pick_first_entity(cfs_rq);
+	uint64 vruntime = cfs_rq->min_vruntime;
+
+	if (curr) vruntime = curr->vruntime;
+	if (left) vruntime = curr ? min_vruntime(vruntime, left->vruntime) : left->vruntime;
+	cfs_rq->min_vruntime = max_vruntime(cfs_rq->min_vruntime, vruntime);
+}
+
+/*
+ * 把正在运行的任务从上次记账到现在的时间记到它的vruntime上
+ */
+static void update_curr(struct rq *rq) {
+	struct sched_entity *curr = cfs_curr(rq);
+	uint64 now = read_time();
+
+	if (!curr) return;
+	if (now > curr->exec_start) {
+		uint64 delta_exec = now - curr->exec_start;
+		curr->sum_exec_runtime += delta_exec;
+		curr->vruntime += calc_delta_fair(delta_exec, curr);
+	}
+	curr->exec_start = now;
+	update_min_vruntime(rq);
+}
+
+/*
+ * 一个调度周期的长度：任务多到每个都分不到最小粒度时按任务数拉长
+ */
+static uint64 sched_period(uint32 nr_running) {
+	uint32 nr_latency = sysctl_sched_latency / sysctl_sched_min_granularity;
+
+	if (nr_running > nr_latency) return nr_running * sysctl_sched_min_granularity;
+	return sysctl_sched_latency;
+}
+
+/*
+ * se在一个调度周期中应得的运行时间，按权重分配周期
+ */
+static uint64 sched_slice(struct rq *rq, struct sched_entity *se) {
+	struct sched_entity *curr = cfs_curr(rq);
+	uint64 load = rq->cfs.load + (curr ? curr->load_weight : 0);
+	uint32 nr = rq->cfs.nr_running + (curr != NULL);
+	uint64 slice;
+
+	if (se != curr) {
+		load += se->load_weight;
+		nr++;
+	}
+	slice = sched_period(nr) * se->load_weight / load;
+	return MAX(slice, sysctl_sched_min_granularity);
+}
+
+/*
+ * 决定se入队时的vruntime
+ * @initial: 新任务从min_vruntime之后一个时间片开始，不能靠反复fork
+ *           挤掉已有任务；否则是醒来的任务，给予至多半个周期的睡眠补偿
+ */
+static void place_entity(struct rq *rq, struct sched_entity *se, int32 initial) {
+	uint64 vruntime = rq->cfs.min_vruntime;
+
+	if (initial) {
+		vruntime += calc_delta_fair(sched_slice(rq, se), se);
+	} else {
+		vruntime -= sysctl_sched_latency / 2;
+	}
+	// 刚睡了一小会儿的任务保留原来的vruntime，不会因此得到额外的时间
+	se->vruntime = initial ? vruntime : max_vruntime(se->vruntime, vruntime);
+}
+
+static void __enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se) {
+	struct rb_node **link = &cfs_rq->tasks_timeline.rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	int32 leftmost = 1;
+
+	while (*link) {
+		parent = *link;
+		// vruntime相同时排在后面，同权重的任务之间仍是先来先服务
+		if (vruntime_diff(se->vruntime, rb_entry(parent, struct sched_entity, run_node)->vruntime) < 0) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+	rb_link_node(&se->run_node, parent, link);
+	rb_insert_color_cached(&se->run_node, &cfs_rq->tasks_timeline, leftmost);
+}
+
+static void __dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se) {
+	rb_erase_cached(&se->run_node, &cfs_rq->tasks_timeline);
+	RB_CLEAR_NODE(&se->run_node);
+}
+
+static void enqueue_task_fair(struct rq *rq, struct task_struct *p, int32 flags) {
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *se = &p->se;
+
+	update_curr(rq);
+	if (flags & ENQUEUE_MIGRATE) se->vruntime += cfs_rq->min_vruntime;
+	if (flags & ENQUEUE_INITIAL)
+		place_entity(rq, se, 1);
+	else if (flags & ENQUEUE_WAKEUP)
+		place_entity(rq, se, 0);
+
+	__enqueue_entity(cfs_rq, se);
+	cfs_rq->load += se->load_weight;
+	cfs_rq->nr_running++;
+}
+
+static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int32 flags) {
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *se = &p->se;
+
+	update_curr(rq);
+	__dequeue_entity(cfs_rq, se);
+	cfs_rq->load -= se->load_weight;
+	cfs_rq->nr_running--;
+	update_min_vruntime(rq);
+	if (flags & DEQUEUE_MIGRATE) se->vruntime -= cfs_rq->min_vruntime;
+}
+
+static struct task_struct *pick_next_task_fair(struct rq *rq) {
+	struct sched_entity *se = pick_first_entity(&rq->cfs);
+
+	if (!se) return NULL;
+	dequeue_task_fair(rq, task_of(se), 0);
+	return task_of(se);
+}
+
+static void set_next_task_fair(struct rq *rq, struct task_struct *p) {
+	p->se.exec_start = read_time();
+	p->se.prev_sum_exec_runtime = p->se.sum_exec_runtime;
+}
+
+static void put_prev_task_fair(struct rq *rq, struct task_struct *p) {
+	update_curr(rq);
+}
+
+/*
+ * 时间片用完，或者已经运行了最小粒度而落后最左边的任务超过一个时间片，就让出CPU
+ */
+static void task_tick_fair(struct rq *rq, struct task_struct *curr) {
+	struct sched_entity *se = &curr->se, *left;
+	uint64 ideal_runtime, delta_exec;
+
+	update_curr(rq);
+	if (!rq->cfs.nr_running) return;
+
+	ideal_runtime = sched_slice(rq, se);
+	delta_exec = se->sum_exec_runtime - se->prev_sum_exec_runtime;
+	if (delta_exec > ideal_runtime) {
+		resched_curr(rq);
+		return;
+	}
+	if (delta_exec < sysctl_sched_min_granularity) return;
+
+	left = pick_first_entity(&rq->cfs);
+	if (vruntime_diff(se->vruntime, left->vruntime) > (int64)ideal_runtime) resched_curr(rq);
+}
+
+/*
+ * 醒来的任务vruntime比正在运行的任务小出一个唤醒粒度以上时抢占它。
+ * 唤醒粒度避免了两个任务为一点点vruntime差距来回切换。
+ */
+static void check_preempt_wakeup(struct rq *rq, struct task_struct *p) {
+	struct sched_entity *curr = cfs_curr(rq);
+
+	if (!curr) return;
+	update_curr(rq);
+	if (vruntime_diff(curr->vruntime, p->se.vruntime) >
+	    (int64)calc_delta_fair(sysctl_sched_wakeup_granularity, &p->se))
+		resched_curr(rq);
+}
+
+// 从vruntime最大的一端找：它们离运行最远，迁走对本队列的影响最小
+static struct task_struct *pick_migrate_task_fair(struct rq *rq, int32 cpu) {
+	struct rb_node *node;
+
+	for (node = rb_last(&rq->cfs.tasks_timeline.rb_root); node; node = rb_prev(node)) {
+		struct task_struct *p = task_of(rb_entry(node, struct sched_entity, run_node));
+		if ((p->cpus_allowed >> cpu) & 1) return p;
+	}
+	return NULL;
+}
+
+/*
+ * 各hart的min_vruntime互不相关，换hart时vruntime先改成相对值，
+ * 入队时再加上新队列的min_vruntime（见ENQUEUE_MIGRATE）
+ */
+static void migrate_task_rq_fair(struct task_struct *p, int32 new_cpu) {
+	p->se.vruntime -= cpu_rq(p->cpu)->cfs.min_vruntime;
+}
+
+static void prio_changed_fair(struct rq *rq, struct task_struct *p) {
+	// 正在运行的任务权重变了，重新比较一次，vruntime仍然最小的话会被再次选中
+	if (per_cpu(current_percpu, rq->cpu) == p && rq->cfs.nr_running) resched_curr(rq);
+}
+
+// 在别的调度类里时vruntime没有增长，至少从min_vruntime开始，不能靠它插队
+static void switched_to_fair(struct rq *rq, struct task_struct *p) {
+	p->se.vruntime = max_vruntime(p->se.vruntime, rq->cfs.min_vruntime);
+}
+
+// 放回树里以后按vruntime重新比较，仍然最小就会被再次选中
+static void yield_task_fair(struct rq *rq, struct task_struct *p) {
+}
+
+static uint64 get_rr_interval_fair(struct rq *rq, struct task_struct *p) {
+	return sched_slice(rq, &p->se);
+}
+
+const struct sched_class fair_sched_class = {
+	.next = NULL,
+	.enqueue_task = enqueue_task_fair,
+	.dequeue_task = dequeue_task_fair,
+	.pick_next_task = pick_next_task_fair,
+	.set_next_task = set_next_task_fair,
+	.put_prev_task = put_prev_task_fair,
+	.task_tick = task_tick_fair,
+	.check_preempt_curr = check_preempt_wakeup,
+	.pick_migrate_task = pick_migrate_task_fair,
+	.migrate_task_rq = migrate_task_rq_fair,
+	.prio_changed = prio_changed_fair,
+	.switched_to = switched_to_fair,
+	.yield_task = yield_task_fair,
+	.get_rr_interval = get_rr_interval_fair,
+};
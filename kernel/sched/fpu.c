@@ -0,0 +1,79 @@
+/*
+ * fpu.c - 浮点状态的延迟切换，见include/kernel/sched/fpu.h
+ *
+ * per_cpu(fpu_owner, cpu)是最近把状态装进这个hart寄存器的任务。只有它的fpu_cpu
+ * 也指回这个hart，寄存器里的才是它当前的状态：它在别的hart上装过之后，
+ * 这里的就过时了。新任务的fpu_cpu是-1，即使task_struct复用了旧地址也
+ * 不会被误认。
+ */
+
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/sched/fpu.h>
+#include <kernel/util/string.h>
+
+static DEFINE_PER_CPU(struct task_struct*, fpu_owner);
+
+static inline uint64 fpu_fs(void) {
+	return read_csr(sstatus) & SSTATUS_FS;
+}
+
+static inline void fpu_set_fs(uint64 fs) {
+	write_csr(sstatus, (read_csr(sstatus) & ~SSTATUS_FS) | fs);
+}
+
+/**
+ * fpu_save - Save the FP registers of a task leaving the cpu, if it changed them
+ * @p: The task, which must be the current one
+ *
+ * Only a task that ran in user mode since its registers were loaded can
+ * find FS Dirty here. The registers stay loaded, so FS becomes Clean.
+ */
+void fpu_save(struct task_struct* p) {
+	if (fpu_fs() != SSTATUS_FS_DIRTY) return;
+	__fstate_save(&p->fpstate);
+	fpu_set_fs(SSTATUS_FS_CLEAN);
+}
+
+/**
+ * fpu_prepare_return - Set FS for the return to user mode
+ * @p: The task about to return
+ *
+ * FS is left alone while the registers still hold @p's state (it may be
+ * Dirty and not saved yet), otherwise it is turned off.
+ */
+void fpu_prepare_return(struct task_struct* p) {
+	int32 cpu = read_tp();
+
+	if (per_cpu(fpu_owner, cpu) == p && p->fpu_cpu == cpu) {
+		if (fpu_fs() == SSTATUS_FS_OFF) fpu_set_fs(SSTATUS_FS_CLEAN);
+	} else {
+		fpu_set_fs(SSTATUS_FS_OFF);
+	}
+}
+
+/**
+ * fpu_handle_trap - Load the FP state on an illegal instruction from user mode
+ * @p: The current task
+ *
+ * With FS off the instruction is taken to be the task's first FP
+ * instruction since it came to this hart; it is retried once the registers
+ * are loaded. A task that never used FP starts from zeroed registers.
+ *
+ * Returns 1 if handled, 0 if this is a real illegal instruction.
+ */
+int32 fpu_handle_trap(struct task_struct* p) {
+	int32 cpu = read_tp();
+
+	if (fpu_fs() != SSTATUS_FS_OFF) return 0;
+	if (!(p->flags & PF_USED_MATH)) {
+		memset(&p->fpstate, 0, sizeof(p->fpstate));
+		p->flags |= PF_USED_MATH;
+	}
+	fpu_set_fs(SSTATUS_FS_INITIAL);
+	__fstate_restore(&p->fpstate);
+	per_cpu(fpu_owner, cpu) = p;
+	p->fpu_cpu = cpu;
+	fpu_set_fs(SSTATUS_FS_CLEAN);
+	return 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * futex.c - 散列等待队列上的futex
+ *
+ * 锁的顺序：桶的锁（两个桶时按地址从小到大） -> 就绪队列。
+ * 桶的锁要关中断拿，唤醒是在锁里做的。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/mm/mm_struct.h>
+#include <kernel/mm/uaccess.h>
+#include <kernel/sched.h>
+#include <kernel/sched/futex.h>
+#include <kernel/util.h>
+
+#define FUTEX_HASH_BITS 8
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+struct futex_hash_bucket {
+	spinlock_t lock;
+	struct list_head chain;
+};
+
+// 一个等待者，在它自己的内核栈上
+struct futex_q {
+	struct list_head list; // 被唤醒时摘下
+	struct task_struct* task;
+	struct futex_key key;
+	uint32 bitset;
+	struct futex_hash_bucket* hb; // 所在的桶，requeue会改它
+};
+
+static struct futex_hash_bucket futex_queues[FUTEX_HASH_SIZE];
+
+static struct futex_hash_bucket* hash_futex(struct futex_key* key) {
+	uint64 h = ((uint64)key->ptr >> 4) ^ (key->offset >> 2) ^ (key->offset << 7);
+
+	h *= 0x9e3779b97f4a7c15UL;
+	return &futex_queues[h >> (64 - FUTEX_HASH_BITS)];
+}
+
+static inline int32 match_futex(struct futex_key* a, struct futex_key* b) {
+	return a->ptr == b->ptr && a->offset == b->offset && a->shared == b->shared;
+}
+
+static inline void get_futex_key_refs(struct futex_key* key) {
+	if (key->shared) get_page(key->ptr);
+}
+
+static inline void drop_futex_key_refs(struct futex_key* key) {
+	if (key->shared) put_page(key->ptr);
+}
+
+/*
+ * 算出uaddr的key。共享映射上的共享futex取物理页，页还没有映射时先
+ * 读一次把它换进来。
+ */
+static int32 get_futex_key(uint32 __user* uaddr, int32 shared, struct futex_key* key) {
+	struct mm_struct* mm = current_task()->mm;
+	uint64 addr = (uint64)uaddr;
+	struct vm_area_struct* vma;
+	paddr_t pa;
+	uint32 val;
+
+	if (addr & (sizeof(uint32) - 1)) return -EINVAL;
+	key->ptr = mm;
+	key->offset = addr;
+	key->shared = 0;
+	if (!shared) return 0;
+
+	for (int32 tries = 0;; tries++) {
+		down_read(&mm->mmap_lock);
+		vma = find_vma(mm, addr);
+		if (!vma) {
+			up_read(&mm->mmap_lock);
+			return -EFAULT;
+		}
+		if (!(vma->vm_flags & VM_SHARED)) {
+			up_read(&mm->mmap_lock);
+			return 0;
+		}
+		pa = lookup_pa(mm->pagetable, addr);
+		if (pa) {
+			key->ptr = addr_to_page(pa);
+			key->offset = addr & ~PAGE_MASK;
+			key->shared = 1;
+			get_page(key->ptr);
+			up_read(&mm->mmap_lock);
+			return 0;
+		}
+		up_read(&mm->mmap_lock);
+		if (tries || copy_from_user(&val, uaddr, sizeof(val))) return -EFAULT;
+	}
+}
+
+/*
+ * 在桶锁里读futex字。锁里不能处理缺页（可能睡眠），页不在时返回-EFAULT，
+ * 由调用者放开锁、在锁外读一次把页换进来以后重试。
+ */
+static int32 get_futex_value_locked(uint32* dest, uint32 __user* from) {
+	uint64 ret;
+
+	pagefault_disable();
+	ret = copy_from_user(dest, from, sizeof(*dest));
+	pagefault_enable();
+	return ret ? -EFAULT : 0;
+}
+
+static void double_lock_hb(struct futex_hash_bucket* hb1, struct futex_hash_bucket* hb2) {
+	if (hb1 > hb2) {
+		struct futex_hash_bucket* tmp = hb1;
+		hb1 = hb2;
+		hb2 = tmp;
+	}
+	spinlock_lock(&hb1->lock);
+	if (hb1 != hb2) spinlock_lock(&hb2->lock);
+}
+
+static void double_unlock_hb(struct futex_hash_bucket* hb1, struct futex_hash_bucket* hb2) {
+	spinlock_unlock(&hb1->lock);
+	if (hb1 != hb2) spinlock_unlock(&hb2->lock);
+}
+
+// 把q摘下并唤醒它的任务。q在等待者的栈上，解锁以后就不能再碰
+static void wake_futex(struct futex_q* q) {
+	struct task_struct* p = q->task;
+
+	list_del_init(&q->list);
+	try_to_wake_up(p, TASK_NORMAL);
+}
+
+/*
+ * 还在桶里说明不是被FUTEX_WAKE唤醒的，自己摘下来。requeue可能已经把
+ * q挪到别的桶，拿到锁之后要确认q->hb没有变。
+ * 返回1表示q还在队列上。
+ */
+static int32 unqueue_me(struct futex_q* q) {
+	struct futex_hash_bucket* hb;
+	int32 ret = 0;
+	int64 flags;
+
+	for (;;) {
+		hb = q->hb;
+		flags = spinlock_lock_irqsave(&hb->lock);
+		if (hb == q->hb) break;
+		spinlock_unlock_irqrestore(&hb->lock, flags);
+	}
+	if (!list_empty(&q->list)) {
+		list_del_init(&q->list);
+		ret = 1;
+	}
+	spinlock_unlock_irqrestore(&hb->lock, flags);
+	return ret;
+}
+
+/**
+ * futex_wait - Sleep on a futex while it holds an expected value
+ * @uaddr: The futex word
+ * @shared: Zero for a process-private futex
+ * @val: Value *@uaddr must still have
+ * @expires: Absolute deadline in time CSR ticks, CLOCKEVENT_NONE for none
+ * @bitset: Wakers whose bitset shares a bit with this one wake us
+ *
+ * The value is checked under the bucket lock, so a FUTEX_WAKE that follows
+ * a change of the word cannot be missed.
+ *
+ * Returns 0 when woken, -EAGAIN if the value differed, -ETIMEDOUT, -EINTR
+ * or -EFAULT.
+ */
+int32 futex_wait(uint32 __user* uaddr, int32 shared, uint32 val, uint64 expires, uint32 bitset) {
+	struct task_struct* cur = current_task();
+	struct futex_q q;
+	int32 ret, timedout = 0;
+	uint32 uval;
+	int64 flags;
+
+	if (!bitset) return -EINVAL;
+retry:
+	ret = get_futex_key(uaddr, shared, &q.key);
+	if (ret) return ret;
+	q.task = cur;
+	q.bitset = bitset;
+	q.hb = hash_futex(&q.key);
+	INIT_LIST_HEAD(&q.list);
+
+	flags = spinlock_lock_irqsave(&q.hb->lock);
+	if (get_futex_value_locked(&uval, uaddr)) {
+		// 页不在：锁外读一次，缺页处理把它换进来，再从头来
+		spinlock_unlock_irqrestore(&q.hb->lock, flags);
+		drop_futex_key_refs(&q.key);
+		if (copy_from_user(&uval, uaddr, sizeof(uval))) return -EFAULT;
+		goto retry;
+	} else if (uval != val) {
+		ret = -EAGAIN;
+	} else {
+		list_add_tail(&q.list, &q.hb->chain);
+		cur->state = TASK_INTERRUPTIBLE;
+	}
+	spinlock_unlock_irqrestore(&q.hb->lock, flags);
+	if (ret) goto out;
+
+	if (!signal_pending(cur)) timedout = !schedule_hrtimeout(expires);
+	cur->state = TASK_RUNNING;
+
+	// 不在队列上了就是被FUTEX_WAKE唤醒的，哪怕同时也超时了
+	if (!unqueue_me(&q))
+		ret = 0;
+	else if (timedout)
+		ret = -ETIMEDOUT;
+	else
+		ret = -EINTR;
+out:
+	drop_futex_key_refs(&q.key);
+	return ret;
+}
+
+/**
+ * futex_wake - Wake tasks waiting on a futex
+ * @uaddr: The futex word
+ * @shared: Zero for a process-private futex
+ * @nr_wake: Most tasks to wake
+ * @bitset: Only waiters whose bitset shares a bit with this one are woken
+ *
+ * Returns the number of tasks woken.
+ */
+int32 futex_wake(uint32 __user* uaddr, int32 shared, int32 nr_wake, uint32 bitset) {
+	struct futex_hash_bucket* hb;
+	struct futex_q *q, *tmp;
+	struct futex_key key;
+	int32 ret = 0;
+	int64 flags;
+
+	if (!bitset) return -EINVAL;
+	if (get_futex_key(uaddr, shared, &key)) return 0;
+	hb = hash_futex(&key);
+
+	flags = spinlock_lock_irqsave(&hb->lock);
+	list_for_each_entry_safe(q, tmp, &hb->chain, list) {
+		if (!match_futex(&q->key, &key) || !(q->bitset & bitset)) continue;
+		wake_futex(q);
+		if (++ret >= nr_wake) break;
+	}
+	spinlock_unlock_irqrestore(&hb->lock, flags);
+	drop_futex_key_refs(&key);
+	return ret;
+}
+
+/**
+ * futex_requeue - Wake some waiters of a futex and move the rest to another
+ * @uaddr: The futex whose waiters are woken or moved
+ * @shared: Zero for process-private futexes
+ * @uaddr2: The futex the remaining waiters are moved to
+ * @nr_wake: Most tasks to wake
+ * @nr_requeue: Most tasks to move
+ * @cmpval: For FUTEX_CMP_REQUEUE, the value *@uaddr must still have; or NULL
+ *
+ * Moving waiters saves waking a crowd that would only block again on
+ * @uaddr2, e.g. condition variable waiters on the mutex.
+ *
+ * Returns the number of tasks woken plus moved, or -EAGAIN if *@uaddr did
+ * not match @cmpval.
+ */
+int32 futex_requeue(uint32 __user* uaddr, int32 shared, uint32 __user* uaddr2, int32 nr_wake, int32 nr_requeue,
+                    uint32* cmpval) {
+	struct futex_hash_bucket *hb1, *hb2;
+	struct futex_key key1, key2;
+	struct futex_q *q, *tmp;
+	int32 woken = 0, moved = 0, ret;
+	int64 flags;
+	uint32 uval;
+
+	if (nr_wake < 0 || nr_requeue < 0) return -EINVAL;
+retry:
+	ret = get_futex_key(uaddr, shared, &key1);
+	if (ret) return ret;
+	ret = get_futex_key(uaddr2, shared, &key2);
+	if (ret) {
+		drop_futex_key_refs(&key1);
+		return ret;
+	}
+	hb1 = hash_futex(&key1);
+	hb2 = hash_futex(&key2);
+
+	flags = disable_irqsave();
+	double_lock_hb(hb1, hb2);
+	if (cmpval && get_futex_value_locked(&uval, uaddr)) {
+		// 和futex_wait()一样，锁外把页换进来再重试
+		double_unlock_hb(hb1, hb2);
+		enable_irqrestore(flags);
+		drop_futex_key_refs(&key1);
+		drop_futex_key_refs(&key2);
+		if (copy_from_user(&uval, uaddr, sizeof(uval))) return -EFAULT;
+		goto retry;
+	}
+	if (cmpval && uval != *cmpval) {
+		ret = -EAGAIN;
+		goto out_unlock;
+	}
+	list_for_each_entry_safe(q, tmp, &hb1->chain, list) {
+		if (!match_futex(&q->key, &key1)) continue;
+		if (woken < nr_wake) {
+			wake_futex(q);
+			woken++;
+			continue;
+		}
+		if (moved >= nr_requeue) break;
+		// q的key换成key2，引用也跟着换
+		if (hb1 != hb2) {
+			list_del(&q->list);
+			list_add_tail(&q->list, &hb2->chain);
+			q->hb = hb2;
+		}
+		get_futex_key_refs(&key2);
+		drop_futex_key_refs(&q->key);
+		q->key = key2;
+		moved++;
+	}
+	ret = woken + moved;
+out_unlock:
+	double_unlock_hb(hb1, hb2);
+	enable_irqrestore(flags);
+	drop_futex_key_refs(&key1);
+	drop_futex_key_refs(&key2);
+	return ret;
+}
+
+void futex_init(void) {
+	for (int32 i = 0; i < FUTEX_HASH_SIZE; i++) {
+		spinlock_init(&futex_queues[i].lock);
+		INIT_LIST_HEAD(&futex_queues[i].chain);
+	}
+}
@@ -13,27 +13,51 @@
 //#include <linux/init.h>         // __init 宏
 #include <kernel/mmu.h>
 #include <kernel/util.h>
+#include <kernel/clockevent.h>
 
 /* 外部声明 */
 extern void schedule(void);
 extern void scheduler_register_task(struct task_struct *tsk);
 
+/*
+ * 每个 hart 一个 idle 进程，放在per-cpu区里。
+ * 注意：为了简单起见，只展示了关键字段的初始化，
+ * 实际实现中还会有更多字段和 CPU 上下文信息。
+ * 它们的pid都是0
+ */
+DEFINE_PER_CPU(struct task_struct, idle_tasks);
 
 static inline void halt_cpu(void) {
 	__asm__ volatile ("wfi" ::: "memory");
 }
 
 /*
- * idle_loop - Idle 进程的主循环
+ * cpu_idle - 就绪队列为空时，在本 hart 的 idle 栈上等待
+ *
+ * idle 任务和别的任务一样由 schedule() 用 __switch_to() 切换过来，
+ * 第一次从这里开始，之后每次都从它自己调用的 schedule() 返回。
  *
- * 当系统中没有其他可运行的进程时，idle_loop 将被调度执行，
- * 它会不断调用 schedule() 尝试切换到其他任务，
- * 若无任务可运行，则调用 halt_cpu() 让 CPU 进入低功耗等待状态。
+ * 关中断检查就绪队列，为空则停掉周期 tick、只为最近的定时器截止时间
+ * 编程后 wfi；有中断挂起时 wfi 返回，开中断让它被处理，再关中断重新检查。
+ * 这样检查和睡眠之间不会丢失唤醒。别的 hart 给本 hart 排入任务时发 IPI
+ * 唤醒 wfi；每次醒来也会尝试从别的队列偷任务。
  */
-void idle_loop(void) {
-  while (1) {
-    schedule(); // 尝试切换到更高优先级任务
-    halt_cpu(); // 没有任务时进入低功耗等待（如 HLT 指令）
+static void __attribute__((noreturn)) cpu_idle(struct task_struct *prev) {
+  struct rq *rq = this_rq();
+
+  finish_task_switch(prev);
+  for (;;) {
+    intr_off();
+    tick_nohz_idle_enter();
+    while (!rq->nr_running && !idle_balance(rq)) {
+      halt_cpu(); // 没有任务时进入低功耗等待（如 HLT 指令）
+      intr_on();
+      intr_off();
+    }
+    tick_nohz_idle_exit();
+    intr_on();
+    // 队列可能又被偷空了，那样schedule()直接返回，接着等
+    schedule();
   }
 }
 
@@ -42,55 +66,48 @@ void idle_loop(void) {
 /* 内核全局内存管理结构和内核页表（假设已在其他地方初始化） */
 //extern pgd_t swapper_pg_dir[]; // 内核页目录
 
-/*
- * 静态定义 idle_task，全局唯一的 idle 进程。
- * 注意：为了简单起见，只展示了关键字段的初始化，
- * 实际实现中还会有更多字段和 CPU 上下文信息。
- * 这里特指0号idle_task
- */
-struct task_struct idle_task;
 //struct proc_file_management kernel_file_management;
 /*
  * init_idle_task - 初始化并注册 idle 进程
  *
- * 在内核启动过程中，此函数将被调用来完成 idle 进程的 CPU 上下文初始化，
- * 并将 idle 进程注册到调度器中，使其在必要时被调度执行。
- * 每个cpu都需要自己的idle任务
+ * 在内核启动过程中，此函数将被调用来完成 idle 进程的初始化，
+ * 就绪队列为空时 schedule() 切换到它，在 cpu_idle() 中等待。
+ * 每个cpu都需要自己的idle任务，由各 hart 启动时自己调用
  * 
  */
-void init_idle_task(void) {
-	kprintf("Initializing idle process (PID 0)...\n");
-	idle_task.kstack = (uint64)alloc_kernel_stack();
-	idle_task.trapframe = NULL;
+void init_idle_task(int32 hartid) {
+	struct task_struct *idle = per_cpu_ptr(&idle_tasks, hartid);
+	kprintf("Initializing idle process (PID 0) on hart %d...\n", hartid);
+	idle->kstack = (uint64)alloc_kernel_stack();
+	idle->trapframe = NULL;
 
-	idle_task.ktrapframe = kmalloc(sizeof(struct trapframe));
-	kprintf("idle_task.ktrapframe: %p\n",idle_task.ktrapframe);
-	memset(idle_task.ktrapframe,0,sizeof(struct trapframe));
-  idle_task.ktrapframe->epc = (uint64)idle_loop;
+	// 第一次被切换过来时从 cpu_idle() 开始
+	idle->thread.ra = (uint64)cpu_idle;
+	idle->thread.sp = idle->kstack;
 
 	extern struct mm_struct init_mm;
-	idle_task.mm = &init_mm;
-  //idle_task.pfiles = alloc_pfm();
+	idle->mm = &init_mm;
+  //idle->pfiles = alloc_pfm();
 
 
 
 
-	idle_task.pid = 0;
+	idle->pid = 0;
 
-	idle_task.state = TASK_RUNNING; // Idle 进程始终处于可运行状态
-	idle_task.flags = PF_KTHREAD;
-	idle_task.parent;
-	INIT_LIST_HEAD(&idle_task.children);
-	INIT_LIST_HEAD(&idle_task.sibling);
-	INIT_LIST_HEAD(&idle_task.ready_queue_node);
-  idle_task.tick_count = 0;
+	idle->state = TASK_RUNNING; // Idle 进程始终处于可运行状态
+	idle->flags = PF_KTHREAD;
+	idle->parent;
+	INIT_LIST_HEAD(&idle->children);
+	INIT_LIST_HEAD(&idle->sibling);
+  idle->sched_class = NULL; // idle 不属于任何调度类，只在队列为空时运行
+  idle->cpu = hartid;
+  idle->cpus_allowed = 1UL << hartid;
 
   //ps->sem_index = sem_new(0);	//这个信号量需要重写
 
-  /* 将 idle 进程注册到调度器中 */
-  insert_to_ready_queue(&idle_task);
-
-  kprintf("Idle process (PID 0) initialized and registered.\n");
+  /* idle 不进就绪队列，否则就绪队列永远不空，也就永远不会进入空闲 */
+  cpu_rq(hartid)->idle = idle;
+  kprintf("Idle process (PID 0) initialized.\n");
 }
 
 
@@ -0,0 +1,166 @@
+/*
+ * kthread.c - 内核线程
+ *
+ * 内核线程没有用户地址空间和trapframe，用init_mm，只在自己的内核栈上
+ * 运行。第一次被选中时__switch_to()在它的新栈上从kthread()开始，
+ * 之后和别的任务一样从它自己调用的schedule()返回。
+ */
+
+#include <kernel/mm/kmalloc.h>
+#include <kernel/mm/mm_struct.h>
+#include <kernel/sched.h>
+#include <kernel/util.h>
+#include <kernel/util/string.h>
+
+static void __attribute__((noreturn)) kthread(struct task_struct* prev) {
+	struct kthread* kt = current_task()->kthread;
+	int32 ret = -EINTR;
+
+	finish_task_switch(prev);
+	intr_on();
+
+	// 第一次运行之前就被kthread_stop()了，不调用线程函数
+	if (!kt->should_stop) ret = kt->threadfn(kt->data);
+	kthread_exit(ret);
+}
+
+/**
+ * kthread_create - Create a kernel thread, left asleep
+ * @threadfn: Function the thread runs; its return value ends the thread
+ * @data: Argument for @threadfn
+ * @namefmt: printf-style name of the thread
+ *
+ * The thread runs SCHED_NORMAL at nice 0 whoever creates it. It does not
+ * run until it is woken up, see kthread_run().
+ *
+ * Returns the new task, ERR_PTR(-ENOMEM) or ERR_PTR(-EAGAIN) when out of PIDs.
+ */
+struct task_struct* kthread_create(int32 (*threadfn)(void* data), void* data, const char* namefmt, ...) {
+	extern struct mm_struct init_mm;
+	struct task_struct* p;
+	struct kthread* kt;
+	va_list ap;
+	pid_t pid;
+
+	kt = kmalloc(sizeof(*kt));
+	if (!kt) return ERR_PTR(-ENOMEM);
+	pid = pid_alloc();
+	if (pid < 0) {
+		kfree(kt);
+		return ERR_PTR(pid);
+	}
+	kt->threadfn = threadfn;
+	kt->data = data;
+	kt->should_stop = 0;
+	kt->result = 0;
+	init_completion(&kt->exited);
+
+	p = alloc_empty_process();
+	if (!p) {
+		pid_free(pid);
+		kfree(kt);
+		return ERR_PTR(-ENOMEM);
+	}
+	p->kstack = (uint64)alloc_kernel_stack();
+	if (!p->kstack) {
+		free_empty_process(p);
+		pid_free(pid);
+		kfree(kt);
+		return ERR_PTR(-ENOMEM);
+	}
+	p->trapframe = NULL;
+	p->thread.ra = (uint64)kthread;
+	p->thread.sp = p->kstack;
+	p->mm = &init_mm;
+	p->pid = pid;
+	p->tgid = pid;
+	p->flags = PF_KTHREAD;
+	p->parent = NULL;
+	p->kthread = kt;
+	INIT_LIST_HEAD(&p->children);
+	INIT_LIST_HEAD(&p->sibling);
+	init_waitqueue_head(&p->wait_chldexit);
+	// 内核线程不处理信号
+	memset(&p->blocked, 0xff, sizeof(p->blocked));
+
+	// 不继承创建者的调度策略
+	if (p->policy != SCHED_NORMAL || task_nice(p) != 0) {
+		p->policy = SCHED_NORMAL;
+		p->static_prio = DEFAULT_PRIO;
+		p->rt_priority = 0;
+		p->prio = p->static_prio;
+		p->sched_class = &fair_sched_class;
+		set_load_weight(p);
+	}
+
+	va_start(ap, namefmt);
+	vsnprintf(p->comm, sizeof(p->comm), namefmt, ap);
+	va_end(ap);
+
+	// 和睡眠中的任务一样，wake_up_process()把它放进就绪队列
+	p->state = TASK_UNINTERRUPTIBLE;
+	p->sleeping = 1;
+	attach_pid(p);
+	return p;
+}
+
+/**
+ * kthread_bind - Pin a kernel thread that has not run yet to one hart
+ * @p: The thread, fresh from kthread_create()
+ * @cpu: The hart
+ */
+void kthread_bind(struct task_struct* p, int32 cpu) {
+	p->cpus_allowed = 1UL << cpu;
+	p->cpu = cpu;
+	p->flags |= PF_NO_SETAFFINITY;
+}
+
+int32 kthread_should_stop(void) {
+	struct task_struct* cur = current_task();
+	return cur->kthread && cur->kthread->should_stop;
+}
+
+/**
+ * kthread_exit - End the calling kernel thread
+ * @result: Value kthread_stop() returns
+ */
+void kthread_exit(int32 result) {
+	struct task_struct* cur = current_task();
+	struct kthread* kt = cur->kthread;
+
+	kt->result = result;
+	cur->flags |= PF_EXITING;
+	cur->state = TASK_DEAD;
+	complete_all(&kt->exited);
+	schedule();
+	panic("kthread_exit: dead kthread %s was scheduled again\n", cur->comm);
+	__builtin_unreachable();
+}
+
+/**
+ * kthread_stop - Make a kernel thread exit and free it
+ * @p: The thread
+ *
+ * Sets kthread_should_stop() for @p, wakes it and waits until it has
+ * exited. The thread has to check kthread_should_stop() in its loop.
+ *
+ * Returns the thread function's return value, or -EINTR if it never ran.
+ */
+int32 kthread_stop(struct task_struct* p) {
+	struct kthread* kt = p->kthread;
+	int32 ret;
+
+	kt->should_stop = 1;
+	__sync_synchronize();
+	wake_up_process(p);
+	wait_for_completion(&kt->exited);
+	// 它还在自己的栈上走完schedule()
+	while (p->on_cpu) cpu_relax();
+
+	ret = kt->result;
+	kfree(kt);
+	kfree((void*)ROUNDDOWN(p->kstack, PAGE_SIZE));
+	detach_pid(p);
+	free_empty_process(p);
+	return ret;
+}
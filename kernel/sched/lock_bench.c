@@ -0,0 +1,131 @@
+/*
+ * lock_bench.c - 自旋锁竞争测试
+ *
+ * 所有hart上线后同时抢同一把锁，每种锁测BENCH_TICKS，比较总吞吐量和
+ * 各hart拿到锁的次数：test-and-set锁谁先看到锁空闲谁拿走，次数会明显
+ * 不均；排号锁和MCS锁按先来后到，各hart的次数应该接近。
+ *
+ * 测试期间关中断，避免时钟中断打断持锁的hart。在config.h里打开
+ * CONFIG_LOCK_BENCH后，启动时在进入调度前运行一次。
+ */
+
+#include <kernel/config.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/util.h>
+#include <kernel/util/mcs_spinlock.h>
+#include <kernel/util/sync_utils.h>
+
+#ifdef CONFIG_LOCK_BENCH
+
+// 每种锁测0.1秒
+#define BENCH_TICKS (TIMEBASE_FREQ / 10)
+// 临界区内和临界区外各做多少次空转，模拟很短的持锁时间
+#define BENCH_HOLD_LOOPS 16
+#define BENCH_IDLE_LOOPS 32
+
+enum { BENCH_TAS, BENCH_TICKET, BENCH_MCS, BENCH_NR_LOCKS };
+
+static const char *bench_names[BENCH_NR_LOCKS] = {"tas", "ticket", "mcs"};
+
+static volatile int32 bench_go;
+static volatile int32 bench_nr_harts;
+// 每种锁开始和结束各一个同步点
+static volatile int32 bench_barrier[2 * BENCH_NR_LOCKS];
+static DEFINE_PER_CPU(uint64, bench_ops[BENCH_NR_LOCKS]);
+// 只在临界区里递增，最后应该等于各hart次数之和
+static volatile uint64 bench_shared;
+
+// 改成排号锁之前spinlock_t的实现，作为对照
+static volatile int32 tas_lock;
+static spinlock_t ticket_lock = SPINLOCK_INIT;
+static mcs_lock_t mcs_lock = MCS_LOCK_INIT;
+
+static inline void bench_spin(int32 loops) {
+	for (int32 i = 0; i < loops; i++) cpu_relax();
+}
+
+static inline void bench_critical(void) {
+	bench_shared++;
+	bench_spin(BENCH_HOLD_LOOPS);
+}
+
+static void bench_one(int32 type, int32 hartid) {
+	struct mcs_spinlock node;
+	uint64 ops = 0, end;
+
+	sync_barrier(&bench_barrier[2 * type], bench_nr_harts);
+	end = read_time() + BENCH_TICKS;
+	while (read_time() < end) {
+		switch (type) {
+		case BENCH_TAS:
+			while (__atomic_test_and_set(&tas_lock, __ATOMIC_ACQUIRE))
+				;
+			bench_critical();
+			__atomic_clear(&tas_lock, __ATOMIC_RELEASE);
+			break;
+		case BENCH_TICKET:
+			spinlock_lock(&ticket_lock);
+			bench_critical();
+			spinlock_unlock(&ticket_lock);
+			break;
+		case BENCH_MCS:
+			mcs_spin_lock(&mcs_lock, &node);
+			bench_critical();
+			mcs_spin_unlock(&mcs_lock, &node);
+			break;
+		}
+		ops++;
+		bench_spin(BENCH_IDLE_LOOPS);
+	}
+	per_cpu(bench_ops[type], hartid) = ops;
+	sync_barrier(&bench_barrier[2 * type + 1], bench_nr_harts);
+}
+
+static void bench_report(int32 type) {
+	uint64 total = 0, min = (uint64)-1, max = 0;
+
+	for_each_possible_cpu(cpu) {
+		if (!cpu_online(cpu)) continue;
+		uint64 ops = per_cpu(bench_ops[type], cpu);
+		total += ops;
+		if (ops < min) min = ops;
+		if (ops > max) max = ops;
+	}
+	kprintf("lock_bench: %-6s %ld ops/s, per hart min %ld max %ld, fairness %ld%%\n", bench_names[type],
+	        total * (TIMEBASE_FREQ / BENCH_TICKS), min, max, max ? min * 100 / max : 0);
+	if (bench_shared != total)
+		kprintf("lock_bench: %s lost updates: counter %ld, expected %ld\n", bench_names[type], bench_shared,
+		        total);
+}
+
+/**
+ * lock_bench_run - Run the spinlock contention benchmark on every online hart
+ *
+ * Every hart that came online has to call this; the boot hart starts the
+ * run once smp_boot_secondary_harts() returns and prints the results.
+ */
+void lock_bench_run(void) {
+	extern int32 boot_hartid;
+	int32 hartid = read_tp();
+	int64 flags;
+
+	if (hartid == boot_hartid) {
+		bench_nr_harts = __builtin_popcountl(cpu_online_mask);
+		__sync_synchronize();
+		bench_go = 1;
+		kprintf("lock_bench: %d harts, %d ms per lock\n", bench_nr_harts, BENCH_TICKS * 1000 / TIMEBASE_FREQ);
+	} else {
+		while (!bench_go) cpu_relax();
+	}
+
+	flags = disable_irqsave();
+	for (int32 type = 0; type < BENCH_NR_LOCKS; type++) {
+		if (hartid == boot_hartid) bench_shared = 0;
+		bench_one(type, hartid);
+		if (hartid == boot_hartid) bench_report(type);
+	}
+	enable_irqrestore(flags);
+}
+
+#endif
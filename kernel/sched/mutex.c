@@ -0,0 +1,182 @@
+/*
+ * 睡眠互斥锁
+ *
+ * 快路径只有一次cmpxchg。拿不到锁时先乐观自旋，持有者不在运行才睡眠；
+ * 解锁时看到MUTEX_FLAG_WAITERS才去唤醒wait_list上的第一个任务。
+ * 被唤醒的任务重新去抢锁，可能被正在自旋的任务抢先，抢不到就再睡。
+ */
+
+#include <kernel/sched.h>
+#include <kernel/sched/mutex.h>
+#include <kernel/util.h>
+
+struct mutex_waiter {
+	struct list_head list;
+	struct task_struct* task;
+};
+
+// 锁空闲时把owner设成当前任务，保留标志位
+static inline int32 __mutex_trylock(struct mutex* lock) {
+	uint64 curr = (uint64)current_task();
+	uint64 owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+
+	while (!(owner & ~MUTEX_FLAGS)) {
+		if (__atomic_compare_exchange_n(&lock->owner, &owner, curr | (owner & MUTEX_FLAGS), 0, __ATOMIC_ACQUIRE,
+		                                __ATOMIC_RELAXED))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * 持有者在别的hart上运行时自旋等它释放。持有者不在运行、或者当前任务
+ * 需要让出CPU时放弃，返回0。
+ */
+static int32 mutex_optimistic_spin(struct mutex* lock) {
+	struct task_struct* curr = current_task();
+	struct task_struct* owner;
+
+	for (;;) {
+		if (__mutex_trylock(lock)) return 1;
+		owner = mutex_owner(lock);
+		if (owner && !owner->on_cpu) return 0;
+		if (curr->need_resched) return 0;
+		cpu_relax();
+	}
+}
+
+static int32 __mutex_lock_slowpath(struct mutex* lock, uint32 state) {
+	struct task_struct* curr = current_task();
+	struct mutex_waiter waiter;
+	int32 ret = 0;
+	int64 flags;
+
+	if (mutex_optimistic_spin(lock)) return 0;
+
+	// 启动阶段的boot任务和idle任务没有调度类，不能睡眠，只能一直自旋
+	if (!curr->sched_class) {
+		while (!__mutex_trylock(lock))
+			cpu_relax();
+		return 0;
+	}
+
+	flags = spinlock_lock_irqsave(&lock->wait_lock);
+	waiter.task = curr;
+	list_add_tail(&waiter.list, &lock->wait_list);
+	for (;;) {
+		// 先置上等待位再试：解锁者要么看到它来唤醒我们，要么我们看到锁已释放
+		__atomic_fetch_or(&lock->owner, MUTEX_FLAG_WAITERS, __ATOMIC_ACQ_REL);
+		if (__mutex_trylock(lock)) break;
+		if ((state & TASK_INTERRUPTIBLE) && signal_pending(curr)) {
+			ret = -EINTR;
+			break;
+		}
+		curr->state = state;
+		spinlock_unlock_irqrestore(&lock->wait_lock, flags);
+		schedule();
+		flags = spinlock_lock_irqsave(&lock->wait_lock);
+	}
+	curr->state = TASK_RUNNING;
+	list_del(&waiter.list);
+	if (list_empty(&lock->wait_list))
+		__atomic_fetch_and(&lock->owner, ~MUTEX_FLAG_WAITERS, __ATOMIC_RELAXED);
+	else if (ret && !mutex_is_locked(lock))
+		// 放弃时可能已经被解锁者选中，把唤醒传给下一个
+		wake_up_process(list_first_entry(&lock->wait_list, struct mutex_waiter, list)->task);
+	spinlock_unlock_irqrestore(&lock->wait_lock, flags);
+	return ret;
+}
+
+static inline void mutex_debug_lock(struct mutex* lock) {
+#ifdef CONFIG_DEBUG_LOCKS
+	if (mutex_owner(lock) == current_task()) panic("mutex_lock: %s already held by the caller\n", lock->name);
+#endif
+}
+
+// 睡眠等待的时间也算作等待时间，mutex的等待可能长达一次磁盘I/O
+static inline void mutex_stat_acquired(struct mutex* lock, uint64 wait_start) {
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_acquired(lock->lock_class, wait_start, &lock->held_since);
+#endif
+}
+
+/**
+ * mutex_lock - Acquire a mutex, sleeping until it is free
+ * @lock: The mutex
+ */
+void mutex_lock(struct mutex* lock) {
+	uint64 zero = 0;
+	uint64 wait_start = 0;
+
+	mutex_debug_lock(lock);
+	if (!__atomic_compare_exchange_n(&lock->owner, &zero, (uint64)current_task(), 0, __ATOMIC_ACQUIRE,
+	                                 __ATOMIC_RELAXED)) {
+#ifdef CONFIG_LOCK_STAT
+		wait_start = lock_stat_wait_start();
+#endif
+		__mutex_lock_slowpath(lock, TASK_UNINTERRUPTIBLE);
+	}
+	mutex_stat_acquired(lock, wait_start);
+}
+
+/**
+ * mutex_lock_interruptible - Acquire a mutex, giving up on a signal
+ * @lock: The mutex
+ *
+ * Returns 0 with the mutex held, or -EINTR without it.
+ */
+int32 mutex_lock_interruptible(struct mutex* lock) {
+	uint64 zero = 0;
+	uint64 wait_start = 0;
+	int32 ret = 0;
+
+	mutex_debug_lock(lock);
+	if (!__atomic_compare_exchange_n(&lock->owner, &zero, (uint64)current_task(), 0, __ATOMIC_ACQUIRE,
+	                                 __ATOMIC_RELAXED)) {
+#ifdef CONFIG_LOCK_STAT
+		wait_start = lock_stat_wait_start();
+#endif
+		ret = __mutex_lock_slowpath(lock, TASK_INTERRUPTIBLE);
+	}
+	if (!ret) mutex_stat_acquired(lock, wait_start);
+	return ret;
+}
+
+/**
+ * mutex_trylock - Acquire a mutex if it is free, without waiting
+ * @lock: The mutex
+ *
+ * Returns 1 if the mutex was acquired, 0 otherwise.
+ */
+int32 mutex_trylock(struct mutex* lock) {
+	if (!__mutex_trylock(lock)) return 0;
+	mutex_stat_acquired(lock, 0);
+	return 1;
+}
+
+/**
+ * mutex_unlock - Release a mutex
+ * @lock: The mutex, held by the caller
+ */
+void mutex_unlock(struct mutex* lock) {
+	uint64 owner = (uint64)current_task();
+	struct mutex_waiter* waiter;
+	int64 flags;
+
+#ifdef CONFIG_DEBUG_LOCKS
+	if (mutex_owner(lock) != current_task()) panic("mutex_unlock: %s not held by the caller\n", lock->name);
+#endif
+#ifdef CONFIG_LOCK_STAT
+	lock_stat_released(lock->lock_class, lock->held_since);
+#endif
+	if (__atomic_compare_exchange_n(&lock->owner, &owner, 0, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+
+	// 有人在睡眠等待：放掉锁但保留等待位，再叫醒排在最前的一个
+	__atomic_fetch_and(&lock->owner, MUTEX_FLAGS, __ATOMIC_RELEASE);
+	flags = spinlock_lock_irqsave(&lock->wait_lock);
+	if (!list_empty(&lock->wait_list)) {
+		waiter = list_first_entry(&lock->wait_list, struct mutex_waiter, list);
+		wake_up_process(waiter->task);
+	}
+	spinlock_unlock_irqrestore(&lock->wait_lock, flags);
+}
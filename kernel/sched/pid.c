@@ -1,40 +1,82 @@
+#include <kernel/sched.h>
 #include <kernel/sched/pid.h>
 #include <kernel/util/string.h>
 #include <kernel/util/print.h>
 
 struct pid_manager manager;
 
+// PID到任务；读者是kill、setpriority之类的查找，写者只有创建和回收
+static struct list_head pid_hash[PIDHASH_SIZE];
+static rwlock_t pid_hash_lock = RWLOCK_INIT;
+
+static inline struct list_head* pid_hashfn(pid_t pid) {
+  // PID大多是连续分配的，取低位就能均匀分布
+  return &pid_hash[pid & (PIDHASH_SIZE - 1)];
+}
+
+static inline void pidmap_set(int32 pid) {
+  int32 w = pid / 64;
+
+  manager.map[w] |= 1UL << (pid % 64);
+  if (manager.map[w] == ~0UL) manager.full[w / 64] |= 1UL << (w % 64);
+}
+
+static inline void pidmap_clear(int32 pid) {
+  int32 w = pid / 64;
+
+  manager.map[w] &= ~(1UL << (pid % 64));
+  manager.full[w / 64] &= ~(1UL << (w % 64));
+}
+
+// 不小于start的第一个空闲PID，没有时返回-1
+static int32 pidmap_find_from(int32 start) {
+  int32 w = start / 64;
+  uint64 bits;
+
+  bits = ~manager.map[w] & (~0UL << (start % 64));
+  if (bits) return w * 64 + __builtin_ctzl(bits);
+
+  // 在第二层里找w之后第一个没满的字
+  for (int32 l = (w + 1) / 64; l < PID_FULL_WORDS; l++) {
+    bits = ~manager.full[l];
+    if (l == (w + 1) / 64) bits &= ~0UL << ((w + 1) % 64);
+    if (bits) {
+      w = l * 64 + __builtin_ctzl(bits);
+      return w * 64 + __builtin_ctzl(~manager.map[w]);
+    }
+  }
+  return -1;
+}
+
 // 初始化PID管理器
 void pid_init() {
   spinlock_init(&manager.lock);
 
-  manager.next_pid = 1;
-  memset(manager.pid_map, 0, sizeof(manager.pid_map));
+  manager.next_pid = INIT_PID + 1;
+  memset(manager.map, 0, sizeof(manager.map));
+  memset(manager.full, 0, sizeof(manager.full));
+  pidmap_set(0);        // idle
+  pidmap_set(INIT_PID); // init由create_init_process()换过去
+
+  for (int32 i = 0; i < PIDHASH_SIZE; i++) INIT_LIST_HEAD(&pid_hash[i]);
 }
 
 // PID分配核心逻辑
 pid_t pid_alloc(void) {
-
   int64 irq_flags = spinlock_lock_irqsave(&manager.lock);
+  int32 pid;
 
-  for (int32 i = 0; i < PID_MAX; i++) {
-    int32_t current_pid = (manager.next_pid + i) % PID_MAX;
-    if (current_pid == 0)
-      continue; // 跳过保留PID 0
-
-    int32 byte_idx = current_pid / 8;
-    int32 bit_idx = current_pid % 8;
-
-    if (!(manager.pid_map[byte_idx] & (1 << bit_idx))) {
-      manager.pid_map[byte_idx] |= (1 << bit_idx);
-      manager.next_pid = (current_pid + 1) % PID_MAX;
-      spinlock_unlock_irqrestore(&manager.lock, irq_flags); // 解锁
-      return current_pid;                                   // 成功
-    }
+  pid = pidmap_find_from(manager.next_pid);
+  if (pid < 0) pid = pidmap_find_from(INIT_PID + 1); // 到头了，从开头再找
+  if (pid < 0) {
+    spinlock_unlock_irqrestore(&manager.lock, irq_flags);
+    return (-EAGAIN); // 资源耗尽
   }
+  pidmap_set(pid);
+  manager.next_pid = pid + 1 < PID_MAX ? pid + 1 : INIT_PID + 1;
 
   spinlock_unlock_irqrestore(&manager.lock, irq_flags);
-  return (-EAGAIN); // 资源耗尽
+  return pid;
 }
 
 // PID释放
@@ -43,10 +85,62 @@ void pid_free(pid_t pid) {
     panic("pid_free: wrong pid\n");
 
   int64 irq_flags = spinlock_lock_irqsave(&manager.lock);
+  pidmap_clear(pid);
+  spinlock_unlock_irqrestore(&manager.lock, irq_flags);
+}
 
-  int32 byte_idx = pid / 8;
-  int32 bit_idx = pid % 8;
-  manager.pid_map[byte_idx] &= ~(1 << bit_idx);
+void attach_pid(struct task_struct* p) {
+  write_lock(&pid_hash_lock);
+  list_add(&p->pid_chain, pid_hashfn(p->pid));
+  write_unlock(&pid_hash_lock);
+}
 
-  spinlock_unlock_irqrestore(&manager.lock, irq_flags);
-}
\ No newline at end of file
+void detach_pid(struct task_struct* p) {
+  write_lock(&pid_hash_lock);
+  list_del_init(&p->pid_chain);
+  write_unlock(&pid_hash_lock);
+  pid_free(p->pid);
+}
+
+/**
+ * change_pid - Give a task another PID
+ * @p: The task, already attached
+ * @pid: The new PID; the caller must already own it, e.g. INIT_PID
+ *
+ * The old PID is released. A group leader's tgid follows its PID.
+ */
+void change_pid(struct task_struct* p, pid_t pid) {
+  pid_t old = p->pid;
+
+  write_lock(&pid_hash_lock);
+  list_del_init(&p->pid_chain);
+  p->pid = pid;
+  if (p->tgid == old) p->tgid = pid;
+  list_add(&p->pid_chain, pid_hashfn(pid));
+  write_unlock(&pid_hash_lock);
+  pid_free(old);
+}
+
+/**
+ * pid_task - Look a task up by PID
+ * @pid: The PID
+ *
+ * Returns the task with a reference held, or NULL. The reference keeps the
+ * task_struct from being freed under the caller if the task is reaped;
+ * drop it with put_task_struct(). Only one hash chain is walked; it holds
+ * about nr_tasks / PIDHASH_SIZE tasks.
+ */
+struct task_struct* pid_task(pid_t pid) {
+  struct task_struct* p;
+
+  read_lock(&pid_hash_lock);
+  list_for_each_entry(p, pid_hashfn(pid), pid_chain) {
+    if (p->pid == pid) {
+      get_task_struct(p);
+      read_unlock(&pid_hash_lock);
+      return p;
+    }
+  }
+  read_unlock(&pid_hash_lock);
+  return NULL;
+}
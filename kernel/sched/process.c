@@ -25,33 +25,41 @@ static void free_kernel_stack(void* kstack);
 // switch to a user-mode process
 //
 
-extern void return_to_user(struct trapframe*, uint64 satp);
+extern void return_to_user(struct trapframe*);
 
 //
 // allocate an empty process, init its vm space. returns the pointer to
 // process strcuture. added @lab3_1
 //
 struct task_struct* alloc_process() {
+	pid_t pid = pid_alloc();
+	if (pid < 0) return NULL;
+
 	// locate the first usable process structure
 	struct task_struct* ps = alloc_empty_process();
+	if (!ps) {
+		pid_free(pid);
+		return NULL;
+	}
 	ps->kstack = (uint64)alloc_kernel_stack();
 	ps->trapframe = (struct trapframe*)kmalloc(sizeof(struct trapframe));
-	ps->ktrapframe = NULL;
+	// 第一次被调度时从ret_from_fork()返回用户态
+	ps->thread.ra = (uint64)ret_from_fork;
+	ps->thread.sp = ps->kstack;
 	ps->mm = user_alloc_mm();
 	ps->fs = fs_struct_create();
 	ps->fdtable = fdtable_acquire(NULL);
 	// ps->active_mm =ps->mm;
-	// 分配内核栈
-	ps->pid = pid_alloc();
+	ps->pid = pid;
+	ps->tgid = pid;
 	ps->state;
 	ps->flags;
 	ps->parent;
-	// ps->pagefault_disabled = 0;
+	ps->pagefault_disabled = 0;
 
 	INIT_LIST_HEAD(&ps->children);
 	INIT_LIST_HEAD(&ps->sibling);
-	INIT_LIST_HEAD(&ps->ready_queue_node);
-	ps->tick_count = 0;
+	init_waitqueue_head(&ps->wait_chldexit);
 
 	// 创建信号量和初始化文件管理
 	// ps->sem_index = sem_new(0);	//这个信号量需要重写
@@ -63,58 +71,91 @@ struct task_struct* alloc_process() {
 	// Default signal actions
 	for (int32 i = 0; i < _NSIG; i++) { ps->sighand[i].sa_handler = SIG_DFL; }
 
+	attach_pid(ps);
 	kprintf("alloc_process: end.\n");
 	return ps;
 }
 
 int32 free_process(struct task_struct* proc) {
-	// 在exit中把进程的状态设成ZOMBIE，然后在父进程wait中调用这个函数，用于释放子进程的资源（待实现）
-	// 由于代理内核的特殊机制，不做也不会造成内存泄漏（代填）
-
+	// 在exit中把进程的状态设成ZOMBIE，然后在父进程wait中调用这个函数，用于释放子进程的资源
+	// 线程组里的其他线程没有人wait，由kernel/syscall/exit.c里的work调用这里
+	// fd表和fs_struct按引用计数放掉，和别的线程共用时只是少一个引用
+	// itimer在这之前一直有效，不能让它在释放后再触发
+	hrtimer_cancel(&proc->real_timer);
+	if (proc->fdtable) fdtable_unref(proc->fdtable);
+	if (proc->fs) fs_struct_unref(proc->fs);
+	// 地址空间也按引用计数放掉：每个任务各持有一个mm_users和一个mm_count，
+	// free_mm()放掉后者，最后一个用户走的时候释放VMA和页表。hart在
+	// finish_task_switch()里总是换到当前任务的页表，不会还停在这个mm上
+	if (proc->mm && !proc->mm->is_kernel_mm) {
+		atomic_dec(&proc->mm->mm_users);
+		free_mm(proc->mm);
+	}
+	detach_pid(proc);
+	kfree(proc->trapframe);
+	free_kernel_stack((void*)proc->kstack);
+	free_empty_process(proc);
 	return 0;
 }
 
-ssize_t do_wait(int32 pid) {
-	// kprintf("DEBUG LINE, pid = %d\n",pid);
-	extern struct task_struct* procs[NPROC];
-	int32 hartid = read_tp();
-	// int32 child_found_flag = 0;
-	if (pid == -1) {
-		while (1) {
-			for (int32 i = 0; i < NPROC; i++) {
-				// kprintf("DEBUG LINE\n");
-
-				struct task_struct* p = procs[i];
-				// kprintf("p = 0x%lx,\n",p);
-				if (p->parent != NULL && p->parent->pid == CURRENT->pid && p->state & TASK_DEAD) {
-					// kprintf("DEBUG LINE\n");
-
-					free_process(p);
-					return i;
-				}
-			}
-			// kprintf("current->sem_index = %d\n",current->sem_index);
-			//sem_P(CURRENT->sem_index);
-			// kprintf("wait:return from blocking!\n");
+/*
+ * 在children中找一个可以回收的子进程，pid为-1时任意一个都行。
+ * 找到返回1，*dead带着一个引用；有符合条件的子进程但都还没退出返回0；
+ * 一个都没有返回-ECHILD。children由clone()在tasklist_lock的写锁下修改。
+ */
+static int32 find_dead_child(struct task_struct* parent, int32 pid, struct task_struct** dead) {
+	struct task_struct* child;
+	int32 found = 0;
+
+	read_lock(&tasklist_lock);
+	list_for_each_entry(child, &parent->children, sibling) {
+		if (pid != -1 && child->pid != pid) continue;
+		found = 1;
+		// 线程组的leader要等其他线程都退出后才能回收
+		if ((child->state & TASK_DEAD) && thread_group_empty(child)) {
+			get_task_struct(child);
+			*dead = child;
+			read_unlock(&tasklist_lock);
+			return 1;
 		}
 	}
-	if (0 < pid && pid < NPROC) {
-		// kprintf("DEBUG LINE\n");
-
-		struct task_struct* p = procs[pid];
-		if (p->parent != CURRENT) {
-			return -1;
-		} else if (p->state & TASK_DEAD) {
-			free_process(p);
-			return pid;
-		} else {
-			//sem_P(p->sem_index);
-			// kprintf("return from blocking!\n");
-
-			return pid;
-		}
+	read_unlock(&tasklist_lock);
+	return found ? 0 : -ECHILD;
+}
+
+/*
+ * 等待子进程退出并回收它，返回它的pid。父进程睡在自己的wait_chldexit上，
+ * 由子进程的do_exit()唤醒，等待期间不占用CPU。
+ */
+ssize_t do_wait(int32 pid) {
+	struct task_struct* p = current_task();
+	struct task_struct* dead = NULL;
+	struct task_cputime times;
+	int32 ret = 0, err;
+
+	for (;;) {
+		err = wait_event_interruptible(p->wait_chldexit, (ret = find_dead_child(p, pid, &dead)) != 0);
+		if (err) return err;
+		if (ret < 0) return ret;
+
+		// 放开读锁以后别的等待者可能先把它摘走了，摘下来的才由自己回收
+		write_lock(&tasklist_lock);
+		ret = !list_empty(&dead->sibling);
+		list_del_init(&dead->sibling);
+		write_unlock(&tasklist_lock);
+		put_task_struct(dead);
+		if (ret) break;
 	}
-	return -1;
+
+	// 子进程在schedule()里离开自己的内核栈之后才能释放
+	while (dead->on_cpu) cpu_relax();
+	pid = dead->pid;
+	// getrusage(RUSAGE_CHILDREN)和times()的子进程时间，包括子进程回收过的
+	thread_group_cputime(dead, &times);
+	task_cputime_add(&times, &dead->children_cputime);
+	task_cputime_add(&p->group_leader->children_cputime, &times);
+	free_process(dead);
+	return pid;
 }
 
 static void free_kernel_stack(void* kstack) { kfree((void*)(ROUNDDOWN((uint64)kstack, PAGE_SIZE))); }
@@ -167,7 +208,7 @@ void print_proc_memory_layout(struct task_struct* proc) {
 		if (vma->vm_prot & PROT_WRITE) strcat(prot_str, "w");
 		if (vma->vm_prot & PROT_EXEC) strcat(prot_str, "x");
 
-		kprintf("    %s: 0x%lx - 0x%lx [%s] pages:%d\n", type_str, vma->vm_start, vma->vm_end, prot_str, vma->page_count);
+		kprintf("    %s: 0x%lx - 0x%lx [%s] pages:%ld\n", type_str, vma->vm_start, vma->vm_end, prot_str, vma_pages(vma));
 	}
 }
 
@@ -0,0 +1,219 @@
+/*
+ * rt.c - 实时调度类（SCHED_FIFO / SCHED_RR）
+ *
+ * 100个优先级，每个优先级一个FIFO链表，再用一个位图记录哪些链表非空。
+ * 内部优先级prio越小越优先，位图中最低的置位就是最高优先级，
+ * 选下一个任务只要一次ctz，与就绪任务的数量无关。
+ *
+ * 实时任务总是先于公平调度类的任务运行。同一优先级中，SCHED_FIFO任务
+ * 一直运行到它阻塞、让出CPU或被更高优先级抢占；SCHED_RR任务用完
+ * sched_timeslice个tick后排到同优先级的队尾。被更高优先级抢占的任务
+ * 回到队首，恢复时仍然是同优先级中第一个运行的。
+ */
+
+#include <kernel/config.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+
+// 每秒中实时任务最多运行0.95秒，与Linux的默认值相同
+uint64 sysctl_sched_rt_period = TIMEBASE_FREQ;
+uint64 sysctl_sched_rt_runtime = TIMEBASE_FREQ / 100 * 95;
+
+void init_rt_rq(struct rt_rq *rt_rq) {
+	struct rt_prio_array *array = &rt_rq->active;
+
+	for (int32 i = 0; i < MAX_RT_PRIO; i++) INIT_LIST_HEAD(&array->queue[i]);
+	memset(array->bitmap, 0, sizeof(array->bitmap));
+	rt_rq->rt_nr_running = 0;
+	rt_rq->rt_time = 0;
+	rt_rq->rt_period_start = 0;
+	rt_rq->rt_throttled = 0;
+}
+
+static inline struct task_struct *rt_task_of(struct sched_rt_entity *rt_se) {
+	return container_of(rt_se, struct task_struct, rt);
+}
+
+// 最高优先级的非空链表，没有时返回MAX_RT_PRIO
+static inline int32 rt_first_prio(struct rt_prio_array *array) {
+	for (int32 i = 0; i < RT_BITMAP_WORDS; i++)
+		if (array->bitmap[i]) return i * 64 + __builtin_ctzl(array->bitmap[i]);
+	return MAX_RT_PRIO;
+}
+
+// rq上正在运行的实时任务，没有时返回NULL
+static inline struct task_struct *rt_curr(struct rq *rq) {
+	struct task_struct *curr = per_cpu(current_percpu, rq->cpu);
+	if (!curr || curr == rq->idle || curr->sched_class != &rt_sched_class || curr->on_rq) return NULL;
+	return curr;
+}
+
+// 节流后如果还有普通任务在等，实时任务先不运行
+static inline int32 rt_rq_throttled(struct rq *rq) {
+	return rq->rt.rt_throttled && rq->cfs.nr_running;
+}
+
+static void update_curr_rt(struct rq *rq) {
+	struct task_struct *curr = rt_curr(rq);
+	struct rt_rq *rt_rq = &rq->rt;
+	uint64 now = read_time(), delta_exec;
+
+	if (!curr) return;
+	delta_exec = now > curr->se.exec_start ? now - curr->se.exec_start : 0;
+	curr->se.exec_start = now;
+	curr->se.sum_exec_runtime += delta_exec;
+
+	rt_rq->rt_time += delta_exec;
+	if (!rt_rq->rt_throttled && rt_rq->rt_time > sysctl_sched_rt_runtime) {
+		static int32 warned;
+		rt_rq->rt_throttled = 1;
+		if (!warned) {
+			warned = 1;
+			kprintf("sched: RT throttling activated on hart %d\n", rq->cpu);
+		}
+		if (rq->cfs.nr_running) resched_curr(rq);
+	}
+}
+
+/**
+ * sched_rt_period_tick - Start a new RT bandwidth period when one is over
+ * @rq: The run queue of the calling hart, locked
+ *
+ * Called on every tick whatever is running, so that a throttled hart gets
+ * its real-time tasks back once the period ends.
+ */
+void sched_rt_period_tick(struct rq *rq) {
+	struct rt_rq *rt_rq = &rq->rt;
+	uint64 now = read_time();
+
+	update_curr_rt(rq);
+	if (now - rt_rq->rt_period_start < sysctl_sched_rt_period) return;
+
+	// 没有普通任务时被节流的实时任务照常运行，超出的时间不带到下一个周期
+	rt_rq->rt_period_start = now;
+	rt_rq->rt_time = 0;
+	if (rt_rq->rt_throttled) {
+		rt_rq->rt_throttled = 0;
+		if (rt_rq->rt_nr_running && !rt_curr(rq)) resched_curr(rq);
+	}
+}
+
+/*
+ * 醒来、新建和迁移来的任务排在队尾。正在运行的任务被放回时，
+ * 时间片还没用完（被抢占）就回到队首，用完了或主动让出就去队尾。
+ */
+static void enqueue_task_rt(struct rq *rq, struct task_struct *p, int32 flags) {
+	struct rt_prio_array *array = &rq->rt.active;
+	struct sched_rt_entity *rt_se = &p->rt;
+	int32 requeue = !(flags & (ENQUEUE_WAKEUP | ENQUEUE_INITIAL | ENQUEUE_MIGRATE));
+
+	update_curr_rt(rq);
+	if (requeue && rt_se->time_slice) {
+		list_add(&rt_se->run_list, &array->queue[p->prio]);
+	} else {
+		list_add_tail(&rt_se->run_list, &array->queue[p->prio]);
+		if (!rt_se->time_slice) rt_se->time_slice = sched_timeslice;
+	}
+	array->bitmap[p->prio / 64] |= 1UL << (p->prio % 64);
+	rq->rt.rt_nr_running++;
+}
+
+static void dequeue_task_rt(struct rq *rq, struct task_struct *p, int32 flags) {
+	struct rt_prio_array *array = &rq->rt.active;
+
+	update_curr_rt(rq);
+	list_del_init(&p->rt.run_list);
+	if (list_empty(&array->queue[p->prio])) array->bitmap[p->prio / 64] &= ~(1UL << (p->prio % 64));
+	rq->rt.rt_nr_running--;
+}
+
+static struct task_struct *pick_next_task_rt(struct rq *rq) {
+	struct rt_prio_array *array = &rq->rt.active;
+	struct task_struct *p;
+	int32 idx;
+
+	if (!rq->rt.rt_nr_running || rt_rq_throttled(rq)) return NULL;
+	idx = rt_first_prio(array);
+	p = rt_task_of(list_first_entry(&array->queue[idx], struct sched_rt_entity, run_list));
+	dequeue_task_rt(rq, p, 0);
+	return p;
+}
+
+static void set_next_task_rt(struct rq *rq, struct task_struct *p) {
+	p->se.exec_start = read_time();
+	// 让出后没有经过入队就接着运行（队列里只有它自己），在这里补上新的时间片
+	if (!p->rt.time_slice) p->rt.time_slice = sched_timeslice;
+}
+
+static void put_prev_task_rt(struct rq *rq, struct task_struct *p) {
+	update_curr_rt(rq);
+}
+
+static void task_tick_rt(struct rq *rq, struct task_struct *p) {
+	update_curr_rt(rq);
+	if (p->policy != SCHED_RR || !p->rt.time_slice || --p->rt.time_slice) return;
+
+	// 时间片用完：同优先级有别的任务才轮转，否则重新开始计时
+	if (!list_empty(&rq->rt.active.queue[p->prio]))
+		resched_curr(rq);
+	else
+		p->rt.time_slice = sched_timeslice;
+}
+
+static void check_preempt_curr_rt(struct rq *rq, struct task_struct *p) {
+	struct task_struct *curr = rt_curr(rq);
+
+	if (curr && p->prio < curr->prio && !rt_rq_throttled(rq)) resched_curr(rq);
+}
+
+// 最低优先级一端的任务离运行最远，迁走它们
+static struct task_struct *pick_migrate_task_rt(struct rq *rq, int32 cpu) {
+	struct rt_prio_array *array = &rq->rt.active;
+	struct sched_rt_entity *rt_se;
+
+	for (int32 idx = MAX_RT_PRIO - 1; idx >= 0; idx--) {
+		if (!(array->bitmap[idx / 64] & (1UL << (idx % 64)))) continue;
+		list_for_each_entry_reverse(rt_se, &array->queue[idx], run_list) {
+			if ((rt_task_of(rt_se)->cpus_allowed >> cpu) & 1) return rt_task_of(rt_se);
+		}
+	}
+	return NULL;
+}
+
+static void migrate_task_rq_rt(struct task_struct *p, int32 new_cpu) {
+}
+
+static void prio_changed_rt(struct rq *rq, struct task_struct *p) {
+}
+
+static void switched_to_rt(struct rq *rq, struct task_struct *p) {
+	p->rt.time_slice = sched_timeslice;
+}
+
+// 让出CPU等同于时间片用完，放回同优先级的队尾
+static void yield_task_rt(struct rq *rq, struct task_struct *p) {
+	p->rt.time_slice = 0;
+}
+
+static uint64 get_rr_interval_rt(struct rq *rq, struct task_struct *p) {
+	return p->policy == SCHED_RR ? (uint64)sched_timeslice * timer_interval : 0;
+}
+
+const struct sched_class rt_sched_class = {
+	.next = &fair_sched_class,
+	.enqueue_task = enqueue_task_rt,
+	.dequeue_task = dequeue_task_rt,
+	.pick_next_task = pick_next_task_rt,
+	.set_next_task = set_next_task_rt,
+	.put_prev_task = put_prev_task_rt,
+	.task_tick = task_tick_rt,
+	.check_preempt_curr = check_preempt_curr_rt,
+	.pick_migrate_task = pick_migrate_task_rt,
+	.migrate_task_rq = migrate_task_rq_rt,
+	.prio_changed = prio_changed_rt,
+	.switched_to = switched_to_rt,
+	.yield_task = yield_task_rt,
+	.get_rr_interval = get_rr_interval_rt,
+};
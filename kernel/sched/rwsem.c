@@ -0,0 +1,173 @@
+/*
+ * 读写信号量
+ *
+ * 所有状态都在wait_lock下修改。释放时由释放者把锁交给等待者
+ * （count在交出时就已经算上了它们），被唤醒的任务醒来就已经持有锁，
+ * 不需要再去竞争。
+ */
+
+#include <kernel/sched.h>
+#include <kernel/sched/rwsem.h>
+#include <kernel/util.h>
+
+enum rwsem_waiter_type {
+	RWSEM_WAITING_FOR_WRITE,
+	RWSEM_WAITING_FOR_READ,
+};
+
+struct rwsem_waiter {
+	struct list_head list;
+	struct task_struct* task;
+	enum rwsem_waiter_type type;
+	volatile int32 granted;
+};
+
+// 把锁交给一个等待者。granted置位后等待者随时可能返回，它的栈不能再碰
+static void rwsem_grant(struct rwsem_waiter* waiter) {
+	struct task_struct* task = waiter->task;
+
+	list_del(&waiter->list);
+	__sync_synchronize();
+	waiter->granted = 1;
+	wake_up_process(task);
+}
+
+// wait_lock已持有。按队列顺序把锁交给能拿到它的等待者
+static void rwsem_wake(struct rw_semaphore* sem) {
+	struct rwsem_waiter* waiter;
+
+	if (list_empty(&sem->wait_list)) return;
+	waiter = list_first_entry(&sem->wait_list, struct rwsem_waiter, list);
+	if (waiter->type == RWSEM_WAITING_FOR_WRITE) {
+		if (sem->count == 0) {
+			sem->count = -1;
+			sem->owner = waiter->task;
+			rwsem_grant(waiter);
+		}
+		return;
+	}
+	if (sem->count < 0) return;
+	while (!list_empty(&sem->wait_list)) {
+		waiter = list_first_entry(&sem->wait_list, struct rwsem_waiter, list);
+		if (waiter->type != RWSEM_WAITING_FOR_READ) break;
+		sem->count++;
+		rwsem_grant(waiter);
+	}
+}
+
+// wait_lock已持有，返回时已释放。睡眠直到释放者把锁交过来
+static void rwsem_wait(struct rw_semaphore* sem, enum rwsem_waiter_type type, int64 flags) {
+	struct task_struct* curr = current_task();
+	struct rwsem_waiter waiter;
+
+	waiter.task = curr;
+	waiter.type = type;
+	waiter.granted = 0;
+	list_add_tail(&waiter.list, &sem->wait_list);
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+
+	for (;;) {
+		curr->state = TASK_UNINTERRUPTIBLE;
+		__sync_synchronize();
+		if (waiter.granted) break;
+		// 没有调度类的boot任务不能睡眠，只能等
+		if (curr->sched_class) schedule();
+	}
+	curr->state = TASK_RUNNING;
+}
+
+/**
+ * down_read - Acquire a rw_semaphore for reading
+ * @sem: The semaphore
+ */
+void down_read(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+
+	if (sem->count >= 0 && list_empty(&sem->wait_list)) {
+		sem->count++;
+		spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+		return;
+	}
+	rwsem_wait(sem, RWSEM_WAITING_FOR_READ, flags);
+}
+
+int32 down_read_trylock(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+	int32 ret = 0;
+
+	if (sem->count >= 0 && list_empty(&sem->wait_list)) {
+		sem->count++;
+		ret = 1;
+	}
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+	return ret;
+}
+
+void up_read(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+
+#ifdef CONFIG_DEBUG_LOCKS
+	if (sem->count <= 0) panic("up_read: rwsem not read-held\n");
+#endif
+	if (--sem->count == 0) rwsem_wake(sem);
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+}
+
+/**
+ * down_write - Acquire a rw_semaphore for writing
+ * @sem: The semaphore
+ */
+void down_write(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+
+#ifdef CONFIG_DEBUG_LOCKS
+	if (sem->count < 0 && sem->owner == current_task()) panic("down_write: rwsem already held by the caller\n");
+#endif
+	if (sem->count == 0 && list_empty(&sem->wait_list)) {
+		sem->count = -1;
+		sem->owner = current_task();
+		spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+		return;
+	}
+	rwsem_wait(sem, RWSEM_WAITING_FOR_WRITE, flags);
+}
+
+int32 down_write_trylock(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+	int32 ret = 0;
+
+	if (sem->count == 0 && list_empty(&sem->wait_list)) {
+		sem->count = -1;
+		sem->owner = current_task();
+		ret = 1;
+	}
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+	return ret;
+}
+
+void up_write(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+
+#ifdef CONFIG_DEBUG_LOCKS
+	if (sem->count != -1 || sem->owner != current_task()) panic("up_write: rwsem not write-held by the caller\n");
+#endif
+	sem->count = 0;
+	sem->owner = NULL;
+	rwsem_wake(sem);
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+}
+
+/**
+ * downgrade_write - Turn a held write lock into a read lock
+ * @sem: The semaphore, write-held by the caller
+ *
+ * Readers queued at the front get in at once; a queued writer still waits.
+ */
+void downgrade_write(struct rw_semaphore* sem) {
+	int64 flags = spinlock_lock_irqsave(&sem->wait_lock);
+
+	sem->count = 1;
+	sem->owner = NULL;
+	rwsem_wake(sem);
+	spinlock_unlock_irqrestore(&sem->wait_lock, flags);
+}
@@ -2,53 +2,678 @@
  * implementing the scheduler
  */
 
+#include <kernel/boot/dtb.h>
 #include <kernel/mm/kmalloc.h>
 #include <kernel/mm/mm_struct.h>
+#include <kernel/sched/fpu.h>
+#include <kernel/sched/kthread.h>
 #include <kernel/sched/pid.h>
 #include <kernel/sched/sched.h>
 #include <kernel/sched/process.h>
+#include <kernel/time.h>
 #include <kernel/trapframe.h>
 #include <kernel/util.h>
 #include <kernel/util/list.h>
 #include <kernel/util/string.h>
 
-struct list_head ready_queue;
-struct task_struct *procs[NPROC];
-struct task_struct *current_percpu[NCPU];
+DEFINE_PER_CPU(struct task_struct *, current_percpu);
+DEFINE_PER_CPU(struct rq, runqueues);
+volatile cpumask_t cpu_online_mask;
+uint32 sched_timeslice = TIME_SLICE_LEN;
+
+// every task but the idle tasks, see for_each_process()
+struct list_head task_list = LIST_HEAD_INIT(task_list);
+rwlock_t tasklist_lock = RWLOCK_INIT;
+
+// fork/exit在各hart上都很频繁，计数按hart分散，不抢同一条cacheline
+struct percpu_counter nr_threads;
+int32 max_threads;
+
+//
+// a task_struct is over 10KB, so every kmalloc of one goes to the page
+// allocator. freed ones are kept here, linked by their tasks entry, and
+// handed out again before asking kmalloc.
+//
+#define TASK_CACHE_MAX 64
+static struct list_head task_cache = LIST_HEAD_INIT(task_cache);
+static int32 task_cache_count;
+static spinlock_t task_cache_lock = SPINLOCK_INIT;
 
 //
-// initialize process pool (the procs[] array). added @lab3_1
+// initialize the run queues, the task count and the pid allocator. must
+// run after setup_per_cpu_areas(). added @lab3_1
 //
 void init_scheduler() {
   // kprintf("init_scheduler: start\n");
-  INIT_LIST_HEAD(&ready_queue);
+  for_each_possible_cpu(cpu) {
+    struct rq *rq = cpu_rq(cpu);
+    spinlock_init(&rq->lock);
+    init_rt_rq(&rq->rt);
+    init_cfs_rq(&rq->cfs);
+    rq->cpu = cpu;
+  }
+  // task_struct加内核栈最多用掉1/8的内存，和Linux的set_max_threads()一样
+  max_threads = memInfo.size / (8 * (sizeof(struct task_struct) + PAGE_SIZE));
+  max_threads = MAX(MIN(max_threads, PID_MAX), 20);
+  if (percpu_counter_init(&nr_threads, 0)) panic("init_scheduler: cannot allocate nr_threads\n");
   pid_init();
-  memset(procs, 0, sizeof(struct task_struct *) * NPROC);
+  kprintf("Scheduler initiated\n");
+}
 
-  for (int32 i = 0; i < NPROC; ++i) {
-    procs[i] = NULL;
+static struct task_struct *task_cache_alloc(void) {
+  struct task_struct *p = NULL;
+
+  spinlock_lock(&task_cache_lock);
+  if (!list_empty(&task_cache)) {
+    p = list_first_entry(&task_cache, struct task_struct, tasks);
+    list_del(&p->tasks);
+    task_cache_count--;
   }
-  kprintf("Scheduler initiated\n");
+  spinlock_unlock(&task_cache_lock);
+  if (!p) p = kmalloc(sizeof(struct task_struct));
+  return p;
 }
 
+static void task_cache_free(struct task_struct *p) {
+  spinlock_lock(&task_cache_lock);
+  if (task_cache_count < TASK_CACHE_MAX) {
+    list_add(&p->tasks, &task_cache);
+    task_cache_count++;
+    p = NULL;
+  }
+  spinlock_unlock(&task_cache_lock);
+  if (p) kfree(p);
+}
+
+//
+// allocate a zeroed task_struct and put it on the task list. it gets its
+// pid and everything else from the caller. returns NULL when out of memory.
+//
 struct task_struct *alloc_empty_process() {
-  for (int32 i = 0; i < NPROC; i++) {
-    if (procs[i] == NULL) {
-      procs[i] = (struct task_struct *)kmalloc(sizeof(struct task_struct));
-      memset(procs[i], 0, sizeof(struct task_struct));
-      return procs[i];
+  struct task_struct *p = task_cache_alloc();
+
+  if (!p) return NULL;
+  memset(p, 0, sizeof(struct task_struct));
+  atomic_set(&p->usage, 1);
+  p->cpus_allowed = CPU_MASK_ALL;
+  p->cpu = read_tp();
+  p->fpu_cpu = -1;
+  INIT_LIST_HEAD(&p->pid_chain);
+  // a thread group of its own until clone() says otherwise
+  p->group_leader = p;
+  INIT_LIST_HEAD(&p->thread_group);
+  hrtimer_init(&p->real_timer, it_real_fn);
+  sched_fork(p);
+  percpu_counter_inc(&nr_threads);
+
+  write_lock(&tasklist_lock);
+  list_add_tail(&p->tasks, &task_list);
+  write_unlock(&tasklist_lock);
+  return p;
+}
+
+//
+// give back a task_struct from alloc_empty_process(). the caller has
+// already released everything it points to, including its pid. the
+// struct itself stays until the last pid_task() user puts it.
+//
+void free_empty_process(struct task_struct *p) {
+  write_lock(&tasklist_lock);
+  list_del(&p->tasks);
+  write_unlock(&tasklist_lock);
+  percpu_counter_dec(&nr_threads);
+  put_task_struct(p);
+}
+
+void put_task_struct(struct task_struct *p) {
+  if (atomic_dec_and_test(&p->usage)) task_cache_free(p);
+}
+
+static inline int32 cpu_allowed(struct task_struct *p, int32 cpu) {
+  return (p->cpus_allowed >> cpu) & 1;
+}
+
+// runnable tasks on a hart, counting the one it is running
+static inline uint32 rq_load(struct rq *rq) {
+  return rq->nr_running + (per_cpu(current_percpu, rq->cpu) != rq->idle);
+}
+
+// the class and effective priority that follow from a task's policy
+static void __setscheduler_prio(struct task_struct *p) {
+  if (rt_policy(p->policy)) {
+    p->prio = MAX_RT_PRIO - 1 - p->rt_priority;
+    p->sched_class = &rt_sched_class;
+  } else {
+    p->prio = p->static_prio;
+    p->sched_class = &fair_sched_class;
+  }
+}
+
+//
+// set up the scheduling state of a new task. it inherits the policy and
+// priorities of the task that creates it; tasks created during boot are
+// SCHED_NORMAL at nice 0.
+//
+void sched_fork(struct task_struct *p) {
+  struct task_struct *parent = CURRENT;
+
+  if (parent && parent->sched_class) {
+    p->policy = parent->policy;
+    p->static_prio = parent->static_prio;
+    p->rt_priority = parent->rt_priority;
+  } else {
+    p->policy = SCHED_NORMAL;
+    p->static_prio = DEFAULT_PRIO;
+    p->rt_priority = 0;
+  }
+  __setscheduler_prio(p);
+  p->on_rq = 0;
+  memset(&p->se, 0, sizeof(p->se));
+  RB_CLEAR_NODE(&p->se.run_node);
+  set_load_weight(p);
+  INIT_LIST_HEAD(&p->rt.run_list);
+  p->rt.time_slice = sched_timeslice;
+}
+
+// rq->lock must be held
+static void enqueue_task(struct rq *rq, struct task_struct *p, int32 flags) {
+  sched_info_enqueue(p);
+  p->cpu = rq->cpu;
+  p->sched_class->enqueue_task(rq, p, flags);
+  p->on_rq = 1;
+  rq->nr_running++;
+}
+
+// rq->lock must be held
+static void dequeue_task(struct rq *rq, struct task_struct *p, int32 flags) {
+  p->sched_class->dequeue_task(rq, p, flags);
+  p->on_rq = 0;
+  rq->nr_running--;
+}
+
+// take the best task off the queue, trying classes from the highest.
+// rq->lock must be held and rq->nr_running must be non-zero.
+static struct task_struct *pick_next_task(struct rq *rq) {
+  const struct sched_class *class;
+  struct task_struct *p;
+
+  for_each_class(class) {
+    p = class->pick_next_task(rq);
+    if (p) {
+      p->on_rq = 0;
+      rq->nr_running--;
+      return p;
     }
   }
-  
-  panic("cannot find any free process structure.\n");
+  panic("pick_next_task: nr_running is %d but no class has a task\n", rq->nr_running);
   return NULL;
 }
+
+//
+// ask the task running on rq to give up the cpu at its next return to user
+// mode. a remote hart gets an IPI so that it does not wait for its next tick.
+// rq->lock must be held.
+//
+void resched_curr(struct rq *rq) {
+  struct task_struct *curr = per_cpu(current_percpu, rq->cpu);
+
+  if (!curr || curr == rq->idle) return;
+  curr->need_resched = 1;
+  if (rq->cpu != read_tp()) smp_send_reschedule(rq->cpu);
+}
+
+//
+// p was just queued on rq: preempt the running task if p should run first.
+// a task of a higher class always wins; within a class the class decides.
+//
+static void check_preempt_curr(struct rq *rq, struct task_struct *p) {
+  struct task_struct *curr = per_cpu(current_percpu, rq->cpu);
+  const struct sched_class *class;
+
+  // idle harts are woken by insert_to_ready_queue(); the boot task is not
+  // a real task and is never preempted
+  if (!curr || curr == rq->idle || !curr->sched_class) return;
+  if (p->sched_class == curr->sched_class) {
+    curr->sched_class->check_preempt_curr(rq, p);
+    return;
+  }
+  for_each_class(class) {
+    if (class == curr->sched_class) break;
+    if (class == p->sched_class) {
+      resched_curr(rq);
+      break;
+    }
+  }
+}
+
+//
+// lock the run queue p is on. p->cpu may change while we wait for the lock,
+// so check it again once we hold it.
+//
+static struct rq *task_rq_lock(struct task_struct *p, int64 *flags) {
+  struct rq *rq;
+
+  for (;;) {
+    rq = cpu_rq(p->cpu);
+    *flags = spinlock_lock_irqsave(&rq->lock);
+    if (rq == cpu_rq(p->cpu)) return rq;
+    spinlock_unlock_irqrestore(&rq->lock, *flags);
+  }
+}
+
+static void task_rq_unlock(struct rq *rq, int64 flags) {
+  spinlock_unlock_irqrestore(&rq->lock, flags);
+}
+
+//
+// pick a hart for a task that became ready: stay on the hart it last ran on
+// (its cache is still warm) unless that is not allowed or clearly busier
+// than the least loaded allowed hart.
+//
+static int32 select_task_rq(struct task_struct *p) {
+  int32 best = -1;
+  uint32 best_load = ~0U;
+
+  for (int32 cpu = 0; cpu < NCPU; cpu++) {
+    if (!cpu_online(cpu) || !cpu_allowed(p, cpu)) continue;
+    uint32 load = rq_load(cpu_rq(cpu));
+    if (load < best_load) {
+      best = cpu;
+      best_load = load;
+    }
+  }
+  if (best < 0) return read_tp();  // secondary harts not up yet
+  if (cpu_online(p->cpu) && cpu_allowed(p, p->cpu) && rq_load(cpu_rq(p->cpu)) <= best_load)
+    return p->cpu;
+  return best;
+}
+
+//
+// put a task that became ready on a run queue chosen by select_task_rq().
+// the task running there is preempted if the new one should run first, and
+// an idle remote hart is woken from wfi with an IPI.
 //
-// insert a process, proc, into the END of ready queue.
+static void activate_task(struct task_struct *proc, int32 enqueue_flags) {
+  int32 cpu = select_task_rq(proc);
+  struct rq *rq = cpu_rq(cpu);
+
+  if (cpu != proc->cpu && !(enqueue_flags & ENQUEUE_INITIAL)) {
+    proc->sched_class->migrate_task_rq(proc, cpu);
+    enqueue_flags |= ENQUEUE_MIGRATE;
+  }
+
+  int64 flags = spinlock_lock_irqsave(&rq->lock);
+  enqueue_task(rq, proc, enqueue_flags);
+  check_preempt_curr(rq, proc);
+  spinlock_unlock_irqrestore(&rq->lock, flags);
+
+  // 与finish_task_switch()中的屏障配对：要么对方看到新任务，要么我们看到它在空闲
+  __sync_synchronize();
+  if (cpu != read_tp() && per_cpu(current_percpu, cpu) == rq->idle) smp_send_reschedule(cpu);
+}
+
+//
+// put a task that was taken off its queue without sleeping, because it
+// may no longer run on that hart, on an allowed one. it was never asleep,
+// so it gets no sleeper placement: activate_task() marks the hart change
+// ENQUEUE_MIGRATE. try_to_wake_up() is the only ENQUEUE_WAKEUP path.
 //
 void insert_to_ready_queue(struct task_struct *proc) {
-  kprintf("going to insert process %d to ready queue.\n", proc->pid);
-  list_add(&proc->ready_queue_node, &ready_queue);
+  activate_task(proc, 0);
+}
+
+//
+// make a newly created task runnable for the first time.
+//
+void wake_up_new_task(struct task_struct *p) {
+  activate_task(p, ENQUEUE_INITIAL);
+}
+
+/**
+ * try_to_wake_up - Make a sleeping task runnable
+ * @p: The task
+ * @state: Sleep states to wake it from, e.g. TASK_NORMAL
+ *
+ * The task may not have reached schedule() yet. Setting TASK_RUNNING is
+ * enough then: schedule() checks the state under the same rq lock and
+ * returns without sleeping. Only a task schedule() has already taken off
+ * the hart is put back on a run queue.
+ *
+ * Returns 1 if @p was woken, 0 if it was not in one of @state.
+ */
+int32 try_to_wake_up(struct task_struct *p, uint32 state) {
+  int64 flags;
+  struct rq *rq = task_rq_lock(p, &flags);
+
+  if (!(p->state & state)) {
+    task_rq_unlock(rq, flags);
+    return 0;
+  }
+  p->state = TASK_RUNNING;
+  if (!p->sleeping) {
+    task_rq_unlock(rq, flags);
+    return 1;
+  }
+  p->sleeping = 0;
+  sched_info_wakeup(p);
+  task_rq_unlock(rq, flags);
+  activate_task(p, ENQUEUE_WAKEUP);
+  return 1;
+}
+
+int32 wake_up_process(struct task_struct *p) {
+  return try_to_wake_up(p, TASK_NORMAL);
+}
+
+// take both locks in hart order so that two harts balancing against each
+// other cannot deadlock. interrupts must be off.
+static void double_rq_lock(struct rq *a, struct rq *b) {
+  if (a->cpu < b->cpu) {
+    spinlock_lock(&a->lock);
+    spinlock_lock(&b->lock);
+  } else {
+    spinlock_lock(&b->lock);
+    spinlock_lock(&a->lock);
+  }
+}
+
+static void double_rq_unlock(struct rq *a, struct rq *b) {
+  spinlock_unlock(&a->lock);
+  spinlock_unlock(&b->lock);
+}
+
+//
+// pull one task that may run here from the busiest other queue, if that
+// queue holds at least min_queued ready tasks more than ours.
+// returns 1 if a task was moved.
+//
+static int32 pull_task(struct rq *this_rq, uint32 min_imbalance) {
+  struct rq *busiest = NULL;
+  struct task_struct *moved = NULL;
+  const struct sched_class *class;
+  uint32 max_queued = 0;
+
+  for (int32 cpu = 0; cpu < NCPU; cpu++) {
+    struct rq *rq = cpu_rq(cpu);
+    if (rq == this_rq || !cpu_online(cpu)) continue;
+    if (rq->nr_running > max_queued) {
+      busiest = rq;
+      max_queued = rq->nr_running;
+    }
+  }
+  if (!busiest || max_queued < this_rq->nr_running + min_imbalance) return 0;
+
+  int64 flags = disable_irqsave();
+  double_rq_lock(this_rq, busiest);
+  if (busiest->nr_running >= this_rq->nr_running + min_imbalance) {
+    // 几个调度类都有可迁的任务时取最低的那个
+    for_each_class(class) {
+      struct task_struct *p = class->pick_migrate_task(busiest, this_rq->cpu);
+      if (p) moved = p;
+    }
+    if (moved) {
+      dequeue_task(busiest, moved, DEQUEUE_MIGRATE);
+      enqueue_task(this_rq, moved, ENQUEUE_MIGRATE);
+      this_rq->nr_migrations++;
+    }
+  }
+  double_rq_unlock(this_rq, busiest);
+  enable_irqrestore(flags);
+  return moved != NULL;
+}
+
+//
+// work stealing: called when this hart's queue is empty.
+//
+int32 idle_balance(struct rq *rq) {
+  return pull_task(rq, 1);
+}
+
+//
+// charge the time since the last tick to the running process; its class
+// sets need_resched when it should give way. called from the timer
+// interrupt; the switch itself is done by rrsched() on the way back to user.
+//
+void scheduler_tick(void) {
+  struct task_struct *cur = CURRENT;
+  struct rq *rq = this_rq();
+  if (!cur) return;
+  spinlock_lock(&rq->lock);
+  sched_rt_period_tick(rq);
+  if (cur != rq->idle && cur->sched_class) cur->sched_class->task_tick(rq, cur);
+  spinlock_unlock(&rq->lock);
+  if (++rq->balance_ticks >= LOAD_BALANCE_TICKS) {
+    rq->balance_ticks = 0;
+    pull_task(rq, 2);
+  }
+}
+
+//
+// preemption point. added @lab3_3
+// called at the user/kernel return boundary: if the current process was
+// asked to give up the cpu and someone else is ready, put it back on the
+// queue and switch; its class decides whether it is picked again.
+// a process no longer allowed on this hart is moved even if nobody waits.
+//
+void rrsched(void) {
+  struct task_struct *cur = CURRENT;
+  struct rq *rq = this_rq();
+  if (!cur->need_resched) return;
+  cur->need_resched = 0;
+
+  int64 flags = spinlock_lock_irqsave(&rq->lock);
+  cur->sched_class->put_prev_task(rq, cur);
+  if (!cpu_allowed(cur, rq->cpu)) {
+    spinlock_unlock_irqrestore(&rq->lock, flags);
+    insert_to_ready_queue(cur);
+  } else if (rq->nr_running == 0) {
+    // 没有别的任务，接着运行并开始新的时间片
+    cur->sched_class->set_next_task(rq, cur);
+    spinlock_unlock_irqrestore(&rq->lock, flags);
+    return;
+  } else {
+    enqueue_task(rq, cur, 0);
+    spinlock_unlock_irqrestore(&rq->lock, flags);
+  }
+  schedule();
+}
+
+//
+// change the SCHED_RR time slice length (in timer interrupts) at runtime.
+//
+int32 sched_set_timeslice(uint32 ticks) {
+  if (ticks == 0) return -EINVAL;
+  sched_timeslice = ticks;
+  return 0;
+}
+
+//
+// restrict a process to a set of harts. a queued process is moved right
+// away; a running one is sent through rrsched() at once, with an IPI if it
+// runs on another hart. like setpriority(), only root or the owner may.
+//
+int32 sched_setaffinity(pid_t pid, cpumask_t mask) {
+  struct task_struct *cur = CURRENT;
+  int32 queued = 0;
+  int64 flags;
+
+  mask &= cpu_online_mask;
+  if (!mask) return -EINVAL;
+
+  struct task_struct *p = find_process_by_pid(pid);
+  if (!p) return -ESRCH;
+  if (cur->euid != 0 && cur->euid != p->uid && cur->euid != p->euid) {
+    put_task_struct(p);
+    return -EPERM;
+  }
+
+  // rrsched()和try_to_wake_up()在就绪队列的锁下读cpus_allowed
+  struct rq *rq = task_rq_lock(p, &flags);
+  p->cpus_allowed = mask;
+  if (!cpu_allowed(p, rq->cpu)) {
+    queued = p->on_rq;
+    if (queued)
+      dequeue_task(rq, p, 0);
+    else if (per_cpu(current_percpu, rq->cpu) == p)
+      resched_curr(rq);
+  }
+  task_rq_unlock(rq, flags);
+
+  if (queued) insert_to_ready_queue(p);
+  put_task_struct(p);
+  return 0;
+}
+
+int32 sched_getaffinity(pid_t pid, cpumask_t *mask) {
+  struct task_struct *p = find_process_by_pid(pid);
+  if (!p) return -ESRCH;
+  *mask = p->cpus_allowed & cpu_online_mask;
+  put_task_struct(p);
+  return 0;
+}
+
+//
+// length of the time slice p gets when it runs, in time CSR ticks.
+//
+uint64 sched_task_timeslice(struct task_struct *p) {
+  int64 flags;
+  struct rq *rq = task_rq_lock(p, &flags);
+  uint64 slice = p->sched_class->get_rr_interval(rq, p);
+  task_rq_unlock(rq, flags);
+  return slice;
+}
+
+//
+// change the nice value of a task. a queued task is requeued with its new
+// weight; a running one is charged at the old weight first.
+//
+void set_user_nice(struct task_struct *p, int32 nice) {
+  int64 flags;
+  struct rq *rq;
+  int32 queued;
+
+  nice = MIN(MAX(nice, MIN_NICE), MAX_NICE);
+  if (task_nice(p) == nice) return;
+
+  rq = task_rq_lock(p, &flags);
+  // 实时任务的nice值只在它回到SCHED_NORMAL后才起作用
+  if (rt_task(p)) {
+    p->static_prio = NICE_TO_PRIO(nice);
+    set_load_weight(p);
+    task_rq_unlock(rq, flags);
+    return;
+  }
+
+  queued = p->on_rq;
+  if (queued)
+    dequeue_task(rq, p, 0);
+  else if (per_cpu(current_percpu, rq->cpu) == p)
+    p->sched_class->put_prev_task(rq, p);
+
+  p->static_prio = NICE_TO_PRIO(nice);
+  set_load_weight(p);
+
+  if (queued) enqueue_task(rq, p, 0);
+  p->sched_class->prio_changed(rq, p);
+  task_rq_unlock(rq, flags);
+}
+
+//
+// change the policy and real-time priority of a task, moving it to the
+// matching class. a queued task is requeued in its new class; a running
+// one is charged to the old class and asked to reschedule, so that a
+// demoted task gives way and a promoted one is picked again at once.
+//
+int32 sched_setscheduler(struct task_struct *p, int32 policy, int32 rt_priority) {
+  const struct sched_class *prev_class;
+  int64 flags;
+  struct rq *rq;
+  int32 queued, running;
+
+  if (policy != SCHED_NORMAL && policy != SCHED_BATCH && policy != SCHED_IDLE && !rt_policy(policy))
+    return -EINVAL;
+  if (rt_policy(policy) ? (rt_priority < 1 || rt_priority > MAX_USER_RT_PRIO - 1) : rt_priority != 0)
+    return -EINVAL;
+  // 提升为实时任务或提高实时优先级需要root
+  if (CURRENT->euid != 0 && rt_policy(policy) &&
+      (!rt_policy(p->policy) || rt_priority > p->rt_priority))
+    return -EPERM;
+
+  rq = task_rq_lock(p, &flags);
+  queued = p->on_rq;
+  running = per_cpu(current_percpu, rq->cpu) == p;
+  if (queued)
+    dequeue_task(rq, p, 0);
+  else if (running)
+    p->sched_class->put_prev_task(rq, p);
+
+  prev_class = p->sched_class;
+  p->policy = policy;
+  p->rt_priority = rt_priority;
+  __setscheduler_prio(p);
+  if (p->sched_class != prev_class) p->sched_class->switched_to(rq, p);
+
+  if (queued) {
+    enqueue_task(rq, p, 0);
+    check_preempt_curr(rq, p);
+  } else if (running) {
+    p->sched_class->set_next_task(rq, p);
+    resched_curr(rq);
+  }
+  task_rq_unlock(rq, flags);
+  return 0;
+}
+
+//
+// give up the cpu at the next return to user mode. the class decides where
+// the task goes back in its queue.
+//
+void sched_yield(void) {
+  struct task_struct *cur = CURRENT;
+  struct rq *rq = this_rq();
+
+  int64 flags = spinlock_lock_irqsave(&rq->lock);
+  cur->sched_class->yield_task(rq, cur);
+  cur->need_resched = 1;
+  spinlock_unlock_irqrestore(&rq->lock, flags);
+}
+
+//
+// raising the nice value is always allowed; lowering it needs root.
+//
+int32 can_nice(struct task_struct *p, int32 nice) {
+  return nice >= task_nice(p) || CURRENT->euid == 0;
+}
+
+//
+// finish a switch on the new task's side: the hart has left prev's kernel
+// stack, so another hart may run prev from now on.
+//
+void finish_task_switch(struct task_struct *prev) {
+  struct mm_struct *mm = CURRENT->mm;
+
+  // the hart runs on the page table of its current task, the kernel's one
+  // for kernel threads and idle (init_mm). it must not stay on prev's: once
+  // on_cpu is clear prev may be freed, and with it the last user of its mm
+  if (mm && read_csr(satp) != MAKE_SATP(mm->pagetable)) {
+    write_csr(satp, MAKE_SATP(mm->pagetable));
+    flush_tlb();
+  }
+  // pairs with the on_cpu spin in schedule(): prev's saved context is
+  // complete before on_cpu is seen clear. also pairs with activate_task()
+  // when we have just become the idle task.
+  __sync_synchronize();
+  if (prev && prev != CURRENT) prev->on_cpu = 0;
+}
+
+//
+// first run of a user process: __switch_to() "returns" here on its fresh
+// kernel stack, and it goes to user mode with its trapframe.
+//
+void ret_from_fork(struct task_struct *prev) {
+  finish_task_switch(prev);
+  switch_to(CURRENT);
+  __builtin_unreachable();
 }
 
 //
@@ -57,79 +682,125 @@ void insert_to_ready_queue(struct task_struct *proc) {
 // current process is still runnable, you should place it into the ready queue
 // (by calling ready_queue_insert), and then call schedule().
 //
+// a task that set itself TASK_INTERRUPTIBLE/UNINTERRUPTIBLE goes to sleep
+// here. every task gives up the cpu through __switch_to(), which leaves its
+// callee-saved registers in task->thread and its stack frames on its own
+// kernel stack; the hart that later picks it returns from schedule() on its
+// behalf. with an empty queue the hart switches to its idle task.
+//
 void schedule() {
-  kprintf("schedule: start\n");
-  extern struct task_struct *procs[NPROC];
-  int32 hartid = read_tp();
   struct task_struct *cur = CURRENT;
-  // kprintf("debug\n");
-  if (cur &&
-      ((cur->state == TASK_INTERRUPTIBLE) |
-       (cur->state == TASK_UNINTERRUPTIBLE)) &&
-      cur->ktrapframe == NULL) {
-    cur->ktrapframe = (struct trapframe *)kmalloc(sizeof(struct trapframe));
-    store_all_registers(cur->ktrapframe);
-    // kprintf("cur->ktrapframe->regs.ra=0x%x\n",cur->ktrapframe->regs.ra);
-  }
-  if (list_empty(&ready_queue)) {
-    // by default, if there are no ready process, and all processes are in the
-    // state of FREE and ZOMBIE, we should shutdown the emulated RISC-V
-    // machine.
-    int32 should_shutdown = 1;
-
-    // for (int32 i = 0; i < NPROC; i++)
-    //   if ((procs[i]) && (procs[i]->exit_state != EXIT_TRACE)) {
-    //     should_shutdown = 0;
-    //     kprintf("ready queue empty, but process %d is not in free/zombie "
-    //            "state:%d\n",
-    //            i, procs[i]->exit_state);
-    //   }
-
-    // // 如果所有进程都在 FREE 或 ZOMBIE 状态，允许关机
-    // if (should_shutdown) {
-    //   // 确保只有 hartid == 0 的核心执行 shutdown
-    //   if (hartid == 0) {
-    //     kprintf("no more ready processes, system shutdown now.\n");
-    //     shutdown(0); // 只有核心 0 执行关机
-    //   }
-    //   // 否则，其他核心等待关机标志
-    //   else {
-    //     while (1) {
-    //       // 自旋等待，直到 hartid == 0 核心完成 shutdown
-    //     }
-    //   }
-    // } else {
-    //   panic(
-    //       "Not handled: we should let system wait for unfinished processes.\n");
-    // }
-  }
-
-  CURRENT = container_of(ready_queue.next, struct task_struct, ready_queue_node);
-  list_del_init(ready_queue.next);
-  if (cur->ktrapframe != NULL) {
-    kprintf("going to schedule process %d to run in s-mode.\n", CURRENT->pid);
-
-    restore_all_registers(cur->ktrapframe);
-    kfree(cur->ktrapframe);
-    cur->ktrapframe = NULL;
-    return;
+  struct rq *rq = this_rq();
+  struct task_struct *next, *prev;
+  struct thread_struct boot_thread;
+  int32 voluntary = 0;
+  uint64 sum;
+
+  // interrupts stay off until the switch is done; the task we return to
+  // restores its own flags below
+  int64 flags = spinlock_lock_irqsave(&rq->lock);
+  if (cur && cur != rq->idle && cur->sched_class && !cur->on_rq) {
+    // woken between prepare_to_wait() and here: keep running
+    if (cur->state == TASK_RUNNING) {
+      spinlock_unlock_irqrestore(&rq->lock, flags);
+      return;
+    }
+    // a task that goes to sleep stops being charged here; a preempted one
+    // was already charged when rrsched() put it back on the queue
+    cur->sched_class->put_prev_task(rq, cur);
+    cur->sleeping = 1;
+    voluntary = 1;
+  }
+
+  // nothing to run here: the idle task steals from other harts or waits
+  // with the tick stopped, and calls schedule() again once there is work
+  if (rq->nr_running) {
+    next = pick_next_task(rq);
+    next->sched_class->set_next_task(rq, next);
+    rq->nr_switches++;
   } else {
-    kprintf("going to schedule process %d to run in u-mode.\n", CURRENT->pid);
-    switch_to(cur);
+    next = rq->idle;
   }
+  if (cur && cur->sched_class) sched_info_switch(rq, cur, next);
+  spinlock_unlock(&rq->lock);
+
+  next->need_resched = 0;
+  if (next == cur) {
+    enable_irqrestore(flags);
+    return;
+  }
+  // a task put back on the queue by rrsched() was preempted
+  if (cur && cur != rq->idle) {
+    if (voluntary)
+      cur->cputime.nvcsw++;
+    else
+      cur->cputime.nivcsw++;
+  }
+
+  // next may have been queued by a hart that is still on its kernel stack
+  while (next->on_cpu)
+    cpu_relax();
+  __sync_synchronize();
+
+  // FP registers are saved only if cur changed them in user mode; they
+  // are loaded again lazily, see fpu.c
+  if (cur) fpu_save(cur);
+  next->on_cpu = 1;
+  CURRENT = next;
+  // sstatus.SUM belongs to the task: a page fault in a user access window
+  // may sleep in do_page_fault(). the next task must not inherit it, and
+  // cur gets it back wherever it resumes
+  sum = read_csr(sstatus) & SSTATUS_SUM;
+  if (sum) clear_csr(sstatus, SSTATUS_SUM);
+  // only the callee-saved registers are switched: everything else is dead
+  // across this call. we come back here when cur is picked again, maybe on
+  // another hart; tp is not switched and keeps that hart's id.
+  prev = __switch_to(cur ? &cur->thread : &boot_thread, &next->thread, cur);
+  finish_task_switch(prev);
+  if (sum) set_csr(sstatus, SSTATUS_SUM);
+  enable_irqrestore(flags);
 }
 
-void switch_to(struct task_struct *proc) {
+//
+// voluntary preemption point for kernel threads. the kernel is not
+// preempted, so a kernel thread that runs for long must call this where
+// it holds no spinlock; it gives up the cpu if its time slice is over.
+//
+void cond_resched(void) {
+  struct task_struct *cur = CURRENT;
+  if ((cur->flags & PF_KTHREAD) && cur->sched_class && cur->need_resched) rrsched();
+}
 
+//
+// the page table for going back to user mode. the kernel runs on the
+// process's page table (it shares the kernel half), so satp is written and
+// the TLB flushed only when another address space was loaded since, e.g.
+// by user_access_begin() in a kernel thread. there
+// is no cross-hart TLB shootdown: a process whose mm is shared with threads
+// on other harts still flushes on every return, which is where their
+// munmap()s take effect here.
+//
+static void activate_user_mm(struct mm_struct *mm) {
+  uint64 satp = MAKE_SATP(mm->pagetable);
+
+  if (read_csr(satp) != satp)
+    write_csr(satp, satp);
+  else if (atomic_read(&mm->mm_users) <= 1)
+    return;
+  flush_tlb();
+}
+
+//
+// return to user mode as the current process.
+//
+void switch_to(struct task_struct *proc) {
   assert(proc);
-  CURRENT = proc;
 
-  extern char smode_trap_vector[];
-  write_csr(stvec, (uint64)smode_trap_vector);
   // set up trapframe values (in process structure) that smode_trap_vector will
-  // need when the process next re-enters the kernel.
+  // need when the process next re-enters the kernel. stvec and sscratch
+  // never change: the vector finds the trapframe through trap_scratch.
   proc->trapframe->kernel_sp = proc->kstack;     // process's kernel stack
-  proc->trapframe->kernel_satp = read_csr(satp); // kernel page table
+  trap_scratch[read_tp()].tf = proc->trapframe;
 
   extern char smode_trap_handler[];
   //proc->trapframe->kernel_trap = (uint64)smode_trap_handler;	//这个字段现在硬编码了
@@ -140,35 +811,74 @@ void switch_to(struct task_struct *proc) {
   // User mode,to to enable interrupts, and sret destination.
 
   write_csr(sstatus, ((read_csr(sstatus) & ~SSTATUS_SPP) | SSTATUS_SPIE));
+  // FS off unless the FP registers still hold this process's state
+  fpu_prepare_return(proc);
 
   // set S Exception Program Counter (sepc register) to the elf entry pc.
   write_csr(sepc, proc->trapframe->epc);
-  kprintf("return to user\n");
 
-  extern void return_to_user(struct trapframe *, uint64);
-  return_to_user(proc->trapframe, MAKE_SATP(proc->mm->pagetable));
+  activate_user_mm(proc->mm);
+  vtime_user_enter(proc);
+  extern void return_to_user(struct trapframe *);
+  return_to_user(proc->trapframe);
+}
+
+//
+// fast return from a syscall. when nothing is left to do on the way out
+// (no reschedule, no signal) the process goes back without switch_to():
+// user_trap_handler() returns into smode_trap_vector, which reloads only
+// the registers the C code may have clobbered and does sret. s0-s11 come
+// back through the calling convention and gp is never written by the
+// kernel; tp holds the hart id in the kernel and is reloaded from the
+// trapframe. a syscall may change only a0 and epc in the trapframe for this.
+//
+// returns 1 with interrupts off and the CSRs set for sret, or 0 with
+// nothing changed if switch_to() must be used.
+//
+int32 prepare_syscall_return(struct task_struct *proc) {
+  // the timer sets need_resched from the interrupt: look with it off
+  uint64 flags = disable_irqsave();
+
+  if (proc->need_resched || signal_pending(proc) || signal_group_exit(proc)) {
+    enable_irqrestore(flags);
+    return 0;
+  }
+
+  // the trapframe fields are the same as when this process last left
+  // through switch_to(). it may have slept in the syscall and woken up on
+  // another hart, whose trap_scratch points at someone else's trapframe
+  if (trap_scratch[read_tp()].tf != proc->trapframe)
+    trap_scratch[read_tp()].tf = proc->trapframe;
+  write_csr(sstatus, ((read_csr(sstatus) & ~SSTATUS_SPP) | SSTATUS_SPIE));
+  fpu_prepare_return(proc);
+  write_csr(sepc, proc->trapframe->epc);
+
+  activate_user_mm(proc->mm);
+  vtime_user_enter(proc);
+  return 1;
 }
 
 
 
 /**
  * find_process_by_pid - Find a process by its PID
- * @pid: Process ID to search for
+ * @pid: Process ID to search for, 0 for the calling task
  *
- * Searches the process table for a process with the given PID.
- * 
- * Returns: Pointer to the task_struct if found, NULL if not found
+ * Looks the PID up in the PID hash.
+ *
+ * Returns: Pointer to the task_struct with a reference held, NULL if not
+ * found. Drop the reference with put_task_struct().
  */
 struct task_struct *find_process_by_pid(pid_t pid) {
-    if (pid <= 0)
+    struct task_struct *p;
+
+    if (pid < 0)
         return NULL;
-    
-    // Search the process table
-    for (int32 i = 0; i < NPROC; i++) {
-        if (procs[i] && procs[i]->pid == pid) {
-            return procs[i];
-        }
+    if (pid == 0) {
+        p = CURRENT;
+        if (p)
+            get_task_struct(p);
+        return p;
     }
-    
-    return NULL;  // Process not found
-}
\ No newline at end of file
+    return pid_task(pid);
+}
@@ -104,16 +104,10 @@ int32 do_send_signal(pid_t pid, int32 sig)
     if (sig <= 0 || sig >= NSIG)
         return -EINVAL;
 
-    // Special case: pid 0 means current process
-    if (pid == 0) {
-        p = current_task();
-        if (!p)
-            return -ESRCH;
-    } else {
-        p = find_process_by_pid(pid);
-        if (!p)
-            return -ESRCH;
-    }
+    // pid 0 means current process; the lookup holds a reference either way
+    p = find_process_by_pid(pid);
+    if (!p)
+        return -ESRCH;
     
     // Handle SIGKILL and SIGSTOP specially
     if (sig == SIGKILL || sig == SIGSTOP) {
@@ -124,6 +118,7 @@ int32 do_send_signal(pid_t pid, int32 sig)
             kprintf("Process %d killed by signal %d\n", p->pid, sig);
             // Implement process termination logic
             // do_exit(p, sig);
+            put_task_struct(p);
             return 0;
         }
         
@@ -132,6 +127,7 @@ int32 do_send_signal(pid_t pid, int32 sig)
             kprintf("Process %d stopped by signal %d\n", p->pid, sig);
             // Implement process stop logic
             // p->state = TASK_STOPPED;
+            put_task_struct(p);
             return 0;
         }
     }
@@ -140,8 +136,8 @@ int32 do_send_signal(pid_t pid, int32 sig)
     sigaddset(&p->pending, sig);
     
     // Wake up if sleeping
-    // if (p->state == TASK_INTERRUPTIBLE)
-    //     wake_up_process(p);
+    try_to_wake_up(p, TASK_INTERRUPTIBLE);
+    put_task_struct(p);
     
     return 0;
 }
@@ -269,6 +265,21 @@ int32 do_kill(pid_t pid, int32 sig)
     }
 }
 
+/**
+ * signal_pending - Check whether a task has a signal it would act on
+ * @p: The task
+ *
+ * Interruptible sleeps end early when this is true.
+ */
+int32 signal_pending(struct task_struct *p)
+{
+    for (int32 sig = 1; sig < NSIG; sig++) {
+        if (sigismember(&p->pending, sig) && !sigismember(&p->blocked, sig))
+            return 1;
+    }
+    return 0;
+}
+
 /**
  * do_signal_delivery - Check and handle any pending signals
  *
@@ -366,9 +377,16 @@ int32 do_sigsuspend(const sigset_t *mask)
     sigdelset(&p->blocked, SIGKILL);
     sigdelset(&p->blocked, SIGSTOP);
     
-    // Now wait for a signal
-    // set_current_state(TASK_INTERRUPTIBLE);
-    // schedule();
+    // Now wait for a signal. The state is set before the check, so a signal
+    // sent in between finds us TASK_INTERRUPTIBLE and wakes us.
+    for (;;) {
+        p->state = TASK_INTERRUPTIBLE;
+        __sync_synchronize();
+        if (signal_pending(p))
+            break;
+        schedule();
+    }
+    p->state = TASK_RUNNING;
     
     // Restore the original mask
     p->blocked = old_blocked;
@@ -0,0 +1,65 @@
+/*
+ * smp.c - 多核启动与核间中断
+ *
+ * OpenSBI只让一个boot hart进入内核，其余hart停在SBI里等待HSM的hart_start。
+ * boot hart完成全局初始化后用hart_start把它们从_secondary_entry拉起来，
+ * 每个hart初始化自己的陷入入口、定时器和idle任务后上线参与调度。
+ *
+ * 核间中断只用来把空闲hart从wfi中唤醒：S态软件中断到达后，如果本hart
+ * 队列里有任务，让当前任务在返回用户态时让出CPU。
+ */
+
+#include <kernel/device/sbi.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/util.h>
+
+int32 boot_hartid;
+
+/*
+ * smp_boot_secondary_harts - 启动除boot hart之外的hart
+ *
+ * hart id不小于NCPU的hart没有内核栈和per-hart数据，留在SBI里。
+ * 每个hart上线前都会置位cpu_online_mask，这里等所有成功启动的hart上线后返回。
+ */
+void smp_boot_secondary_harts(void) {
+	extern char _secondary_entry[];
+	cpumask_t expected = 1UL << boot_hartid;
+
+	for (int32 hartid = 0; hartid < NCPU; hartid++) {
+		if (hartid == boot_hartid) continue;
+
+		// 不存在的hart返回SBI_ERR_INVALID_PARAM
+		struct sbiret status = SBI_HART_GET_STATUS(hartid);
+		if (status.error || status.value != STOPPED) continue;
+
+		struct sbiret ret = SBI_HART_START(hartid, (uint64)_secondary_entry, 0);
+		if (ret.error) {
+			kprintf("smp: failed to start hart %d, error %ld\n", hartid, (int64)ret.error);
+			continue;
+		}
+		expected |= 1UL << hartid;
+	}
+
+	while ((cpu_online_mask & expected) != expected)
+		;
+	kprintf("smp: %d harts online (mask 0x%lx)\n", __builtin_popcountl(cpu_online_mask), cpu_online_mask);
+}
+
+/*
+ * smp_send_reschedule - 让另一个hart重新检查它的运行队列
+ */
+void smp_send_reschedule(int32 cpu) {
+	SBI_SEND_IPI(1UL << cpu, 0);
+}
+
+/*
+ * handle_ipi - S态软件中断处理
+ */
+void handle_ipi(void) {
+	struct task_struct *cur = CURRENT;
+
+	clear_csr(sip, SIP_SSIP);
+	// 空闲时cpu_idle()自己会重新检查队列
+	if (cur && cur != this_rq()->idle && this_rq()->nr_running) cur->need_resched = 1;
+}
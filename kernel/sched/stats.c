@@ -0,0 +1,211 @@
+/*
+ * stats.c - 调度统计和CPU时间记账
+ *
+ * 记账点：
+ *   - 进出用户态（user_trap_handler()和switch_to()）：两次之间的时间记到
+ *     utime或stime；
+ *   - 切换任务（schedule()）：换下的任务把上次记账以来的时间记到stime，
+ *     换上的任务从这时开始重新计；
+ *   - 进就绪队列到上CPU：这段等待记到run_delay并计入延迟直方图，任务和
+ *     它所在hart的就绪队列各记一份；
+ *   - 唤醒：带in_iowait睡下的任务把这次睡眠记到iowait。
+ *
+ * 除了持rq->lock更新的延迟和iowait，字段都只由任务自己改。读的时候不加锁，
+ * 数字可能差一点，统计用足够了。
+ */
+
+#include <kernel/sched.h>
+#include <kernel/sched/stats.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+#include <kernel/util/string.h>
+
+static inline int32 lat_bucket(uint64 delay) {
+	uint64 us = ticks_to_ns(delay) / NSEC_PER_USEC;
+
+	if (!us) return 0;
+	return MIN(64 - __builtin_clzl(us), SCHED_LAT_BUCKETS - 1);
+}
+
+/**
+ * sched_info_enqueue - Note when a task starts waiting for a hart
+ * @p: The task being put on a run queue
+ *
+ * A task moved between queues keeps its original time.
+ */
+void sched_info_enqueue(struct task_struct* p) {
+	if (!p->sched_info.last_queued) p->sched_info.last_queued = read_time();
+}
+
+/**
+ * sched_info_switch - Account a pick by schedule()
+ * @rq: The run queue, locked
+ * @prev: The task giving up the hart, may be NULL during boot
+ * @next: The task picked, may be @prev
+ */
+void sched_info_switch(struct rq* rq, struct task_struct* prev, struct task_struct* next) {
+	uint64 now = read_time();
+
+	if (prev && prev != rq->idle) {
+		prev->cputime.stime += now - prev->vtime_start;
+		if (prev->sleeping && prev->in_iowait) prev->sched_info.sleep_start = now;
+	}
+	if (next == rq->idle) return;
+
+	if (next->sched_info.last_queued) {
+		uint64 delay = now - next->sched_info.last_queued;
+		int32 b = lat_bucket(delay);
+
+		next->sched_info.last_queued = 0;
+		next->sched_info.run_delay += delay;
+		next->sched_info.lat_hist[b]++;
+		rq->sched_info.run_delay += delay;
+		rq->sched_info.lat_hist[b]++;
+		if (delay > rq->sched_info.max_delay) rq->sched_info.max_delay = delay;
+	}
+	next->sched_info.pcount++;
+	next->vtime_start = now;
+}
+
+/**
+ * sched_info_wakeup - Account the end of a sleep
+ * @p: The task being woken, its run queue locked
+ */
+void sched_info_wakeup(struct task_struct* p) {
+	if (p->sched_info.sleep_start) {
+		p->cputime.iowait += read_time() - p->sched_info.sleep_start;
+		p->sched_info.sleep_start = 0;
+	}
+}
+
+// trap进内核：从上次回到用户态起是用户态时间
+void vtime_user_exit(struct task_struct* p) {
+	uint64 now = read_time();
+
+	p->cputime.utime += now - p->vtime_start;
+	p->vtime_start = now;
+}
+
+// 回到用户态：从上次进内核或上CPU起是内核态时间
+void vtime_user_enter(struct task_struct* p) {
+	uint64 now = read_time();
+
+	p->cputime.stime += now - p->vtime_start;
+	p->vtime_start = now;
+}
+
+int32 io_schedule_prepare(void) {
+	struct task_struct* cur = current_task();
+	int32 old = cur->in_iowait;
+
+	cur->in_iowait = 1;
+	return old;
+}
+
+void io_schedule_finish(int32 token) {
+	current_task()->in_iowait = token;
+}
+
+void task_cputime_add(struct task_cputime* sum, const struct task_cputime* t) {
+	sum->utime += t->utime;
+	sum->stime += t->stime;
+	sum->iowait += t->iowait;
+	sum->nvcsw += t->nvcsw;
+	sum->nivcsw += t->nivcsw;
+}
+
+/**
+ * task_cputime - CPU time of one thread
+ * @p: The thread
+ * @times: Filled in
+ *
+ * For the calling thread the time since its last accounting point counts
+ * as system time, since it is in the kernel right now.
+ */
+void task_cputime(struct task_struct* p, struct task_cputime* times) {
+	*times = p->cputime;
+	if (p == current_task()) times->stime += read_time() - p->vtime_start;
+}
+
+/**
+ * thread_group_cputime - CPU time of a whole thread group
+ * @p: Any thread of the group
+ * @times: Filled in, including threads that have already exited
+ */
+void thread_group_cputime(struct task_struct* p, struct task_cputime* times) {
+	struct task_struct* leader = p->group_leader;
+	struct task_struct* t;
+	struct task_cputime tt;
+
+	read_lock(&tasklist_lock);
+	*times = leader->dead_cputime;
+	task_cputime(leader, &tt);
+	task_cputime_add(times, &tt);
+	list_for_each_entry(t, &leader->thread_group, thread_group) {
+		task_cputime(t, &tt);
+		task_cputime_add(times, &tt);
+	}
+	read_unlock(&tasklist_lock);
+}
+
+static int64 dump_hist(char* buf, size_t len, const uint64* hist) {
+	int64 n = snprintf(buf, len, "  latency-us");
+
+	for (int32 i = 0; i < SCHED_LAT_BUCKETS && n < len; i++)
+		n += snprintf(buf + n, len - n, " %ld+:%ld", i ? 1L << (i - 1) : 0L, hist[i]);
+	if (n < len) n += snprintf(buf + n, len - n, "\n");
+	return n;
+}
+
+static int64 dump_thread(char* buf, size_t len, struct task_struct* t, uint64* hist) {
+	struct task_cputime tt;
+
+	task_cputime(t, &tt);
+	for (int32 i = 0; i < SCHED_LAT_BUCKETS; i++) hist[i] += t->sched_info.lat_hist[i];
+	return snprintf(buf, len, "%-6d %-16s %12ld %12ld %12ld %8ld %8ld %8ld %12ld\n", t->pid, t->comm, tt.utime,
+	                tt.stime, tt.iowait, tt.nvcsw, tt.nivcsw, t->sched_info.pcount, t->sched_info.run_delay);
+}
+
+/**
+ * sched_stat_dump - Format scheduling statistics as text
+ * @pid: A thread group to show, 0 for the caller's, negative for the run queues
+ * @buf: Output buffer
+ * @len: Size of @buf
+ *
+ * Times are in time CSR ticks. Returns the number of bytes written without
+ * the terminating NUL, or -ESRCH.
+ */
+int64 sched_stat_dump(pid_t pid, char* buf, size_t len) {
+	uint64 hist[SCHED_LAT_BUCKETS] = {0};
+	struct task_struct *p, *t, *leader;
+	int64 n;
+
+	if (pid < 0) {
+		n = snprintf(buf, len, "%-4s %12s %14s %12s\n", "cpu", "switches", "run_delay", "max_delay");
+		for (int32 cpu = 0; cpu < NCPU && n < len; cpu++) {
+			struct rq* rq = cpu_rq(cpu);
+			if (!rq->idle) continue;
+			n += snprintf(buf + n, len - n, "%-4d %12ld %14ld %12ld\n", cpu, rq->nr_switches,
+			              rq->sched_info.run_delay, rq->sched_info.max_delay);
+			if (n < len) n += dump_hist(buf + n, len - n, rq->sched_info.lat_hist);
+		}
+		return n < len ? n : len - 1;
+	}
+
+	p = find_process_by_pid(pid);
+	if (!p) return -ESRCH;
+
+	n = snprintf(buf, len, "%-6s %-16s %12s %12s %12s %8s %8s %8s %12s\n", "tid", "comm", "utime", "stime", "iowait",
+	             "nvcsw", "nivcsw", "pcount", "run_delay");
+	read_lock(&tasklist_lock);
+	leader = p->group_leader;
+	if (n < len) n += dump_thread(buf + n, len - n, leader, hist);
+	list_for_each_entry(t, &leader->thread_group, thread_group) {
+		if (n >= len) break;
+		n += dump_thread(buf + n, len - n, t, hist);
+	}
+	read_unlock(&tasklist_lock);
+	put_task_struct(p);
+	if (n < len) n += dump_hist(buf + n, len - n, hist);
+	return n < len ? n : len - 1;
+}
@@ -0,0 +1,78 @@
+/*
+ * switch_bench.c - 上下文切换测试
+ *
+ * 两个内核线程绑在同一个hart上轮流等待对方：每一轮都是一次真正的睡眠、
+ * 唤醒和切换，和两个进程通过管道传一个字节来回的路径相同（等待队列、
+ * try_to_wake_up()、schedule()），只是少了系统调用和拷贝。结果是每次
+ * 切换的平均时间。
+ *
+ * 在config.h里打开CONFIG_SWITCH_BENCH后，启动时创建一个内核线程做这个
+ * 测试，调度开始后运行一次。
+ */
+
+#include <kernel/config.h>
+#include <kernel/riscv.h>
+#include <kernel/sched.h>
+#include <kernel/util.h>
+
+#ifdef CONFIG_SWITCH_BENCH
+
+// 每个方向的轮数
+#define BENCH_ROUNDS 100000
+#define BENCH_CPU 0
+
+static volatile int32 bench_turn;
+static DECLARE_WAIT_QUEUE_HEAD(bench_wait0);
+static DECLARE_WAIT_QUEUE_HEAD(bench_wait1);
+static wait_queue_head_t* bench_wait[2] = {&bench_wait0, &bench_wait1};
+static DECLARE_COMPLETION(bench_done);
+
+// 等轮到自己，再把球交给对方
+static int32 bench_pingpong(void* data) {
+	int32 self = (int32)(uint64)data;
+
+	for (int32 i = 0; i < BENCH_ROUNDS; i++) {
+		wait_event(*bench_wait[self], bench_turn == self);
+		bench_turn = !self;
+		wake_up(bench_wait[!self]);
+	}
+	complete(&bench_done);
+	return 0;
+}
+
+static int32 switch_bench(void* data) {
+	struct task_struct* t[2];
+	uint64 start, ticks, switches;
+
+	bench_turn = 0;
+	for (int32 i = 0; i < 2; i++) {
+		t[i] = kthread_create(bench_pingpong, (void*)(uint64)i, "switch_bench/%d", i);
+		if (PTR_IS_ERROR(t[i])) return PTR_ERR(t[i]);
+		kthread_bind(t[i], BENCH_CPU);
+	}
+
+	start = read_time();
+	wake_up_process(t[0]);
+	wake_up_process(t[1]);
+	wait_for_completion(&bench_done);
+	wait_for_completion(&bench_done);
+	ticks = read_time() - start;
+	kthread_stop(t[0]);
+	kthread_stop(t[1]);
+
+	switches = 2 * BENCH_ROUNDS;
+	kprintf("switch_bench: %ld switches in %ld ms, %ld ns per switch\n", switches,
+	        ticks * 1000 / TIMEBASE_FREQ, ticks * (1000000000 / TIMEBASE_FREQ) / switches);
+	return 0;
+}
+
+/**
+ * switch_bench_start - Queue the context switch benchmark
+ *
+ * Creates the thread that runs it; it starts with the scheduler.
+ */
+void switch_bench_start(void) {
+	kthread_run(switch_bench, NULL, "switch_bench");
+}
+
+#endif
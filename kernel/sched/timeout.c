@@ -0,0 +1,59 @@
+/*
+ * timeout.c - 带超时的睡眠
+ *
+ * 睡眠者在自己的栈上放一个hrtimer，到期时在定时器中断里唤醒它；
+ * 先被别的原因唤醒时自己把定时器撤掉。hrtimer_cancel()会等正在运行的
+ * 回调结束，返回后栈上的定时器就没人再碰了。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/hrtimer.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+
+struct hrtimer_sleeper {
+	struct hrtimer timer;
+	struct task_struct* task; // 到期后清空
+};
+
+static enum hrtimer_restart hrtimer_wakeup(struct hrtimer* timer) {
+	struct hrtimer_sleeper* t = container_of(timer, struct hrtimer_sleeper, timer);
+	struct task_struct* task = t->task;
+
+	WRITE_ONCE(t->task, NULL);
+	if (task) try_to_wake_up(task, TASK_NORMAL);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * schedule_hrtimeout - Sleep until woken up or until a deadline passes
+ * @expires: Absolute deadline in time CSR ticks; CLOCKEVENT_NONE for none
+ *
+ * Like schedule(), the caller sets its sleep state first and checks its
+ * wake-up condition afterwards.
+ *
+ * Returns 0 if the deadline passed, -EINTR if the task was woken earlier.
+ */
+int32 schedule_hrtimeout(uint64 expires) {
+	struct task_struct* cur = current_task();
+	struct hrtimer_sleeper t;
+
+	if (expires == CLOCKEVENT_NONE) {
+		schedule();
+		return -EINTR;
+	}
+	if (expires <= read_time()) {
+		cur->state = TASK_RUNNING;
+		return 0;
+	}
+
+	hrtimer_init(&t.timer, hrtimer_wakeup);
+	t.task = cur;
+	hrtimer_start(&t.timer, expires, HRTIMER_MODE_ABS);
+
+	schedule();
+
+	hrtimer_cancel(&t.timer);
+	return READ_ONCE(t.task) ? -EINTR : 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * 等待队列
+ *
+ * 队列上的每一项对应一个睡眠的任务，唤醒时调用它的func。默认的func
+ * 通过try_to_wake_up()把任务放回就绪队列；睡眠中的任务不在任何就绪
+ * 队列里，不占用CPU。
+ */
+
+#include <kernel/sched.h>
+#include <kernel/util.h>
+
+int32 default_wake_function(struct wait_queue_entry* wq_entry, uint32 mode) {
+	return try_to_wake_up(wq_entry->private, mode);
+}
+
+// 唤醒成功就把等待项摘下来，同一个任务不会被重复唤醒
+int32 autoremove_wake_function(struct wait_queue_entry* wq_entry, uint32 mode) {
+	int32 ret = default_wake_function(wq_entry, mode);
+
+	if (ret) list_del_init(&wq_entry->entry);
+	return ret;
+}
+
+void init_wait_entry(struct wait_queue_entry* wq_entry, uint32 flags) {
+	wq_entry->flags = flags;
+	wq_entry->private = current_task();
+	wq_entry->func = autoremove_wake_function;
+	INIT_LIST_HEAD(&wq_entry->entry);
+}
+
+void add_wait_queue(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry) {
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	wq_entry->flags &= ~WQ_FLAG_EXCLUSIVE;
+	list_add(&wq_entry->entry, &wq_head->head);
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+// 独占的等待者排在队尾，非独占的排在队首，__wake_up()先唤醒所有非独占的
+void add_wait_queue_exclusive(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry) {
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	wq_entry->flags |= WQ_FLAG_EXCLUSIVE;
+	list_add_tail(&wq_entry->entry, &wq_head->head);
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+void remove_wait_queue(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry) {
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	list_del_init(&wq_entry->entry);
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/**
+ * prepare_to_wait - Queue the current task and set its sleep state
+ * @wq_head: The queue to wait on
+ * @wq_entry: The caller's entry, see DEFINE_WAIT()
+ * @state: TASK_INTERRUPTIBLE or TASK_UNINTERRUPTIBLE
+ *
+ * The state is set under the queue lock, after the entry is linked, so a
+ * wake_up() that comes after the caller's condition check always sees it.
+ */
+void prepare_to_wait(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state) {
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	wq_entry->flags &= ~WQ_FLAG_EXCLUSIVE;
+	if (list_empty(&wq_entry->entry)) list_add(&wq_entry->entry, &wq_head->head);
+	current_task()->state = state;
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+void prepare_to_wait_exclusive(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state) {
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	wq_entry->flags |= WQ_FLAG_EXCLUSIVE;
+	if (list_empty(&wq_entry->entry)) list_add_tail(&wq_entry->entry, &wq_head->head);
+	current_task()->state = state;
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/**
+ * prepare_to_wait_event - prepare_to_wait() for the wait_event() macros
+ *
+ * Returns -EINTR instead of queueing when an interruptible sleep would be
+ * cut short by a pending signal anyway.
+ */
+int32 prepare_to_wait_event(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry, uint32 state) {
+	struct task_struct* p = current_task();
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+	int32 ret = 0;
+
+	if ((state & TASK_INTERRUPTIBLE) && signal_pending(p)) {
+		list_del_init(&wq_entry->entry);
+		ret = -EINTR;
+	} else {
+		if (list_empty(&wq_entry->entry)) {
+			if (wq_entry->flags & WQ_FLAG_EXCLUSIVE)
+				list_add_tail(&wq_entry->entry, &wq_head->head);
+			else
+				list_add(&wq_entry->entry, &wq_head->head);
+		}
+		p->state = state;
+	}
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+	return ret;
+}
+
+/**
+ * finish_wait - Undo prepare_to_wait() once the wait is over
+ * @wq_head: The queue waited on
+ * @wq_entry: The caller's entry
+ *
+ * The entry may already be off the queue if the wake-up removed it; checking
+ * without the lock is fine then because nobody else touches it any more.
+ */
+void finish_wait(struct wait_queue_head* wq_head, struct wait_queue_entry* wq_entry) {
+	current_task()->state = TASK_RUNNING;
+	if (!list_empty(&wq_entry->entry)) {
+		int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+		list_del_init(&wq_entry->entry);
+		spinlock_unlock_irqrestore(&wq_head->lock, flags);
+	}
+}
+
+/**
+ * __wake_up - Wake tasks sleeping on a wait queue
+ * @wq_head: The queue
+ * @mode: Which sleep states to wake, e.g. TASK_NORMAL
+ * @nr_exclusive: How many exclusive waiters to wake, 0 for all of them
+ *
+ * Every non-exclusive waiter is woken, then exclusive ones until
+ * @nr_exclusive of them have actually been woken.
+ */
+void __wake_up(struct wait_queue_head* wq_head, uint32 mode, int32 nr_exclusive) {
+	struct wait_queue_entry *curr, *next;
+	int64 flags = spinlock_lock_irqsave(&wq_head->lock);
+
+	list_for_each_entry_safe(curr, next, &wq_head->head, entry) {
+		uint32 wq_flags = curr->flags;
+		int32 ret = curr->func(curr, mode);
+
+		if (ret && (wq_flags & WQ_FLAG_EXCLUSIVE) && !--nr_exclusive) break;
+	}
+	spinlock_unlock_irqrestore(&wq_head->lock, flags);
+}
@@ -0,0 +1,265 @@
+/*
+ * workqueue.c - 工作队列和延迟工作
+ *
+ * 锁的顺序：pool->lock -> 等待队列 -> 就绪队列。
+ * pool->lock要关中断拿，定时器中断里也会排work。
+ */
+
+#include <kernel/mm/kmalloc.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/timer.h>
+#include <kernel/util.h>
+
+struct workqueue_struct* system_wq;
+
+// flush_workqueue()排在每个pool末尾的标记
+struct wq_barrier {
+	struct work_struct work;
+	struct completion done;
+};
+
+// 设置PENDING，返回设置之前是否已经在排队
+static inline int32 work_test_and_set_pending(struct work_struct* work) {
+	return __sync_fetch_and_or(&work->data, WORK_STRUCT_PENDING) & WORK_STRUCT_PENDING;
+}
+
+static inline void work_clear_pending(struct work_struct* work) {
+	__sync_fetch_and_and(&work->data, ~WORK_STRUCT_PENDING);
+}
+
+// 没有worker的hart（还没上线）上的work交给第一个在线的hart
+static struct worker_pool* wq_select_pool(struct workqueue_struct* wq, int32 cpu) {
+	if (cpu >= 0 && cpu < NCPU && per_cpu_ptr(wq->pools, cpu)->worker) return per_cpu_ptr(wq->pools, cpu);
+	for_each_possible_cpu(i)
+		if (per_cpu_ptr(wq->pools, i)->worker) return per_cpu_ptr(wq->pools, i);
+	return NULL;
+}
+
+// work已经带上PENDING，把它挂到pool上并叫醒worker
+static void __queue_work(int32 cpu, struct workqueue_struct* wq, struct work_struct* work) {
+	struct worker_pool* pool = wq_select_pool(wq, cpu);
+	int64 flags;
+
+	if (!pool) {
+		panic("__queue_work: workqueue %s has no worker\n", wq->name);
+		work_clear_pending(work);
+		return;
+	}
+	flags = spinlock_lock_irqsave(&pool->lock);
+	work->pool = pool;
+	list_add_tail(&work->entry, &pool->worklist);
+	spinlock_unlock_irqrestore(&pool->lock, flags);
+	wake_up(&pool->wait);
+}
+
+/**
+ * queue_work_on - Queue work to run on a given hart
+ * @cpu: The hart whose worker runs it
+ * @wq: The workqueue
+ * @work: The work
+ *
+ * Returns 1 if the work was queued, 0 if it was already pending.
+ */
+int32 queue_work_on(int32 cpu, struct workqueue_struct* wq, struct work_struct* work) {
+	if (work_test_and_set_pending(work)) return 0;
+	__queue_work(cpu, wq, work);
+	return 1;
+}
+
+// 排到当前hart上
+int32 queue_work(struct workqueue_struct* wq, struct work_struct* work) {
+	return queue_work_on(read_tp(), wq, work);
+}
+
+/**
+ * cancel_work - Take queued work off its worklist
+ * @work: The work
+ *
+ * Does not wait for a run that has already started. Returns 1 if the work
+ * was pending and has been removed.
+ */
+int32 cancel_work(struct work_struct* work) {
+	struct worker_pool* pool = work->pool;
+	int32 ret = 0;
+	int64 flags;
+
+	if (!work_pending(work) || !pool) return 0;
+	flags = spinlock_lock_irqsave(&pool->lock);
+	// 还在pool上并且没有开始执行；worker在同一把锁下摘下work、清PENDING
+	if (work->pool == pool && work_pending(work) && !list_empty(&work->entry)) {
+		list_del_init(&work->entry);
+		work_clear_pending(work);
+		ret = 1;
+	}
+	spinlock_unlock_irqrestore(&pool->lock, flags);
+	return ret;
+}
+
+void delayed_work_timer_fn(struct timer_list* timer) {
+	struct delayed_work* dwork = container_of(timer, struct delayed_work, timer);
+
+	__queue_work(dwork->cpu, dwork->wq, &dwork->work);
+}
+
+/**
+ * queue_delayed_work_on - Queue work after a delay
+ * @cpu: The hart whose worker runs it
+ * @wq: The workqueue
+ * @dwork: The delayed work
+ * @delay: Delay in jiffies; 0 queues it right away
+ *
+ * The timer is kept on the calling hart's wheel. Returns 1 if the work was
+ * queued, 0 if it was already pending.
+ */
+int32 queue_delayed_work_on(int32 cpu, struct workqueue_struct* wq, struct delayed_work* dwork, uint64 delay) {
+	if (work_test_and_set_pending(&dwork->work)) return 0;
+	if (!delay) {
+		__queue_work(cpu, wq, &dwork->work);
+		return 1;
+	}
+
+	dwork->wq = wq;
+	dwork->cpu = cpu;
+	mod_timer(&dwork->timer, READ_ONCE(jiffies) + delay);
+	return 1;
+}
+
+int32 queue_delayed_work(struct workqueue_struct* wq, struct delayed_work* dwork, uint64 delay) {
+	return queue_delayed_work_on(read_tp(), wq, dwork, delay);
+}
+
+/**
+ * cancel_delayed_work - Stop a delayed work from running
+ * @dwork: The delayed work
+ *
+ * Works both while the timer is pending and after it has queued the work.
+ * Returns 1 if the work was pending and has been cancelled.
+ */
+int32 cancel_delayed_work(struct delayed_work* dwork) {
+	// 定时器已经到期的话work可能已经排上了，交给cancel_work()
+	if (del_timer(&dwork->timer)) {
+		work_clear_pending(&dwork->work);
+		return 1;
+	}
+	return cancel_work(&dwork->work);
+}
+
+static void wq_barrier_func(struct work_struct* work) {
+	complete(&container_of(work, struct wq_barrier, work)->done);
+}
+
+/**
+ * flush_workqueue - Wait until all work queued so far has run
+ * @wq: The workqueue
+ *
+ * Delayed work whose timer has not expired yet is not waited for. Must not
+ * be called from a work function of @wq.
+ */
+void flush_workqueue(struct workqueue_struct* wq) {
+	struct wq_barrier barr;
+
+	for_each_possible_cpu(cpu) {
+		if (!per_cpu_ptr(wq->pools, cpu)->worker) continue;
+		INIT_WORK(&barr.work, wq_barrier_func);
+		init_completion(&barr.done);
+		work_test_and_set_pending(&barr.work);
+		__queue_work(cpu, wq, &barr.work);
+		wait_for_completion(&barr.done);
+	}
+}
+
+// 每个pool一个worker，按顺序执行worklist上的work
+static int32 worker_thread(void* data) {
+	struct worker_pool* pool = data;
+	struct work_struct* work;
+	int64 flags;
+
+	while (!kthread_should_stop()) {
+		wait_event(pool->wait, !list_empty(&pool->worklist) || kthread_should_stop());
+
+		flags = spinlock_lock_irqsave(&pool->lock);
+		while (!list_empty(&pool->worklist)) {
+			work = list_first_entry(&pool->worklist, struct work_struct, entry);
+			list_del_init(&work->entry);
+			work_clear_pending(work);
+			pool->current_work = work;
+			spinlock_unlock_irqrestore(&pool->lock, flags);
+
+			work->func(work);
+
+			pool->current_work = NULL;
+			cond_resched();
+			flags = spinlock_lock_irqsave(&pool->lock);
+		}
+		spinlock_unlock_irqrestore(&pool->lock, flags);
+	}
+	return 0;
+}
+
+/**
+ * alloc_workqueue - Create a workqueue with a worker on every online hart
+ * @name: Name of the workqueue; the workers are called "name/cpu"
+ *
+ * Returns the workqueue or NULL.
+ */
+struct workqueue_struct* alloc_workqueue(const char* name) {
+	struct workqueue_struct* wq = kmalloc(sizeof(*wq));
+
+	if (!wq) return NULL;
+	wq->name = name;
+	wq->pools = alloc_percpu(struct worker_pool);
+	if (!wq->pools) {
+		kfree(wq);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu) {
+		struct worker_pool* pool = per_cpu_ptr(wq->pools, cpu);
+		struct task_struct* worker;
+
+		spinlock_init(&pool->lock);
+		INIT_LIST_HEAD(&pool->worklist);
+		init_waitqueue_head(&pool->wait);
+		pool->worker = NULL;
+		pool->current_work = NULL;
+		pool->cpu = cpu;
+		if (!cpu_online(cpu)) continue;
+
+		worker = kthread_create(worker_thread, pool, "%s/%d", name, cpu);
+		if (PTR_IS_ERROR(worker)) {
+			destroy_workqueue(wq);
+			return NULL;
+		}
+		kthread_bind(worker, cpu);
+		pool->worker = worker;
+		wake_up_process(worker);
+	}
+	return wq;
+}
+
+/**
+ * destroy_workqueue - Run the remaining work, stop the workers, free @wq
+ * @wq: The workqueue; no new work may be queued on it
+ */
+void destroy_workqueue(struct workqueue_struct* wq) {
+	flush_workqueue(wq);
+	for_each_possible_cpu(cpu) {
+		struct worker_pool* pool = per_cpu_ptr(wq->pools, cpu);
+		if (!pool->worker) continue;
+		kthread_stop(pool->worker);
+		pool->worker = NULL;
+	}
+	free_percpu(wq->pools);
+	kfree(wq);
+}
+
+/**
+ * workqueue_init - Set up system_wq
+ *
+ * Called once the secondary harts are online, so that system_wq gets a
+ * worker on each of them.
+ */
+void workqueue_init(void) {
+	system_wq = alloc_workqueue("events");
+	kprintf("workqueue: system_wq started\n");
+}
@@ -2,7 +2,7 @@
 
 
 
-#include <kernel/sched/sched.h>
+#include <kernel/sched.h>
 #include <kernel/util/print.h>
 //信号灯库
 semaphore sem_pool[NSEM];
@@ -14,7 +14,7 @@ int32 sem_new(int32 initial_value) {
       sem_pool[i].value = initial_value;
 			//kprintf("sem %d initialvalue %d\n",i,initial_value);
       // sem_pool[i].pid = pid;
-      sem_pool[i].wait_queue = NULL;
+      init_waitqueue_head(&sem_pool[i].wait_queue);
       return i;
     }
   }
@@ -30,48 +30,48 @@ void sem_free(int32 sem_index) {
   return;
 }
 
+// 资源不足时睡眠，直到sem_V()留出资源。成功返回0，被信号打断返回-EINTR
 int32 sem_P(int32 sem_index) {
-  // //kprintf("Received calling sem_P index = %d\n", sem_index);
-  // if (sem_index < 0 || sem_index >= NSEM || !sem_pool[sem_index].isActive) {
-  //   panic("invalid sem_index!");
-  // }
-
-  // semaphore *sem = &sem_pool[sem_index];
-  // if (sem->value > 0) {
-  //   return sem->value--;
-  // } else {
-  //   // kprintf("BLOCK!\n");
-  //   int32 hartid = read_tp();
-  //   struct task_struct *cur = CURRENT;
-  //   cur->state = TASK_INTERRUPTIBLE;
-  //   cur->ready_queue_node = sem->wait_queue;
-  //   sem->wait_queue = cur;
-
-  //   schedule();
+  if (sem_index < 0 || sem_index >= NSEM || !sem_pool[sem_index].isActive) {
+    panic("invalid sem_index!");
+  }
 
-  //   // kprintf("return from blocking!\n");
-  //   return 0;
-  //   // 直接嵌入保存内核上下文到process->ktrapframe的汇编代码
-  // }
-	return 0;
+  semaphore *sem = &sem_pool[sem_index];
+  DEFINE_WAIT(wait);
+  int64 flags = spinlock_lock_irqsave(&sem->wait_queue.lock);
+  // value的增减都在等待队列的锁里进行
+  while (sem->value <= 0) {
+    if (signal_pending(current_task())) {
+      list_del_init(&wait.entry);
+      spinlock_unlock_irqrestore(&sem->wait_queue.lock, flags);
+      return -EINTR;
+    }
+    if (list_empty(&wait.entry)) list_add_tail(&wait.entry, &sem->wait_queue.head);
+    current_task()->state = TASK_INTERRUPTIBLE;
+    spinlock_unlock_irqrestore(&sem->wait_queue.lock, flags);
+    schedule();
+    flags = spinlock_lock_irqsave(&sem->wait_queue.lock);
+  }
+  list_del_init(&wait.entry);
+  current_task()->state = TASK_RUNNING;
+  sem->value--;
+  spinlock_unlock_irqrestore(&sem->wait_queue.lock, flags);
+  return 0;
 }
 
-// 我们这里为了实现简单，直接把信号队列当成信号栈使了。
-// 如果说有进程等待信号量，返回0，不然返回增加后的信号资源量sem->value
+// 增加一个资源，有进程在等就唤醒一个。返回增加后的信号资源量sem->value
 int32 sem_V(int32 sem_index) {
-  // if (sem_index < 0 || sem_index >= NSEM || !sem_pool[sem_index].isActive) {
-  //   panic("invalid sem_index!");
-  // }
-  // semaphore *sem = &sem_pool[sem_index];
+  if (sem_index < 0 || sem_index >= NSEM || !sem_pool[sem_index].isActive) {
+    panic("invalid sem_index!");
+  }
+  semaphore *sem = &sem_pool[sem_index];
+  int64 flags = spinlock_lock_irqsave(&sem->wait_queue.lock);
+  int32 value = ++sem->value;
+  struct wait_queue_entry *wait;
 
-  // if (sem->value == 0 && sem->wait_queue != NULL) {
-  //   insert_to_ready_queue(sem->wait_queue);
-	// 	//insert_to_ready_queue(current);
-  //   // sem->wait_queue->state = READY;
-  //   sem->wait_queue = sem->wait_queue->queue_next;
-  //   //schedule();
-  //   return 0;
-  // }
-	// return sem->value++;
-	return 0;
-}
\ No newline at end of file
+  list_for_each_entry(wait, &sem->wait_queue.head, entry) {
+    if (default_wake_function(wait, TASK_INTERRUPTIBLE)) break;
+  }
+  spinlock_unlock_irqrestore(&sem->wait_queue.lock, flags);
+  return value;
+}
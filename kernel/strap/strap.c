@@ -9,6 +9,7 @@
 #include <kernel/util.h>
 #include <kernel/syscall/syscall.h>
 #include <kernel/time.h>
+#include <kernel/clockevent.h>
 
 //
 // handling the syscalls. will call do_syscall() defined in kernel/syscall.c
@@ -24,144 +25,97 @@ static void handle_syscall(struct trapframe *tf) {
 
 //
 // added @lab1_3
+// jiffies, time slice accounting and expired timers are all handled by the
+// clock event layer, which also programs the next deadline.
 //
 void handle_mtimer_trap() {
-  kprintf("Ticks %d\n", jiffies);
-  int32 hartid = read_tp();
-  if(hartid == 0){
-	jiffies++;
-  }
-  CURRENT->tick_count++;
+  clockevent_handle_event();
+}
+
+/**
+ * 在mm中解决一次缺页：检查VMA访问权限后交给handle_vm_fault，
+ * 匿名页按需分配，文件页由页缓存提供，只读页被写时做COW
+ *
+ * @return 成功返回0，地址非法或处理失败返回-1
+ */
+static int32 do_page_fault(struct mm_struct *mm, uint64 mcause, uint64 addr, uint32 flags) {
+	struct vm_area_struct *vma;
+	struct vm_fault vmf;
+	vm_fault_t ret;
+
+	// 标记访问类型
+	uint64 need = VM_READ;
+	if (mcause == CAUSE_STORE_PAGE_FAULT)
+			need = VM_WRITE;
+	else if (mcause == CAUSE_FETCH_PAGE_FAULT)
+			need = VM_EXEC;
 
-  write_csr(sip, read_csr(sip) & ~SIP_SSIP);
+	if (!mm || addr >= TASK_SIZE)
+			return -1;
+
+	// 查找地址所在的VMA。持有mmap_lock时不能访问用户内存，否则这里会死锁
+	down_read(&mm->mmap_lock);
+	vma = find_vma(mm, addr);
+	if (!vma) {
+			up_read(&mm->mmap_lock);
+			return -1;
+	}
+
+	// 确认访问权限
+	if (!(vma->vm_flags & need)) {
+			up_read(&mm->mmap_lock);
+			return -1;
+	}
+
+	memset(&vmf, 0, sizeof(vmf));
+	vmf.address = addr;
+	vmf.flags = flags;
+	if (mcause == CAUSE_STORE_PAGE_FAULT)
+			vmf.flags |= FAULT_FLAG_WRITE;
+
+	ret = handle_vm_fault(vma, &vmf);
+	up_read(&mm->mmap_lock);
+	if (ret & VM_FAULT_ERROR) {
+			kprintf("handle_vm_fault failed: %x\n", ret);
+			return -1;
+	}
+	return 0;
 }
 
 /**
  * 处理用户空间页错误
- * 包含了原有的栈自动增长和COW功能，以及新的VMA管理功能
  * 
  * @param mcause 错误原因
  * @param sepc 错误发生时的程序计数器
  * @param stval 访问时导致页错误的虚拟地址
  */
 void handle_user_page_fault(uint64 mcause, uint64 sepc, uint64 stval) {
-	struct task_struct *proc = CURRENT;
-	uint64 addr = stval;
-	
-	kprintf("sepc=%lx, handle_page_fault: %lx\n", sepc, addr);
-	
-	// 标记访问类型
-	int32 fault_prot = 0;
-	if (mcause == CAUSE_LOAD_PAGE_FAULT)
-			fault_prot |= PROT_READ;
-	else if (mcause == CAUSE_STORE_PAGE_FAULT)
-			fault_prot |= PROT_WRITE;
-	else if (mcause == CAUSE_FETCH_PAGE_FAULT)
-			fault_prot |= PROT_EXEC;
-	
-	// 处理基于 VMA 的内存管理
-	if (proc->mm) {
-			// 查找地址所在的VMA
-			struct vm_area_struct *vma = find_vma(proc->mm, addr);
-			
-			if (vma) {
-					// 确认访问权限
-					if ((fault_prot & vma->vm_prot) != fault_prot) {
-							kprintf("权限不足: 需要 %d, VMA允许 %d\n", fault_prot, vma->vm_prot);
-							goto error;
-					}
-					
-					// 页地址对齐
-					uint64 page_va = ROUNDDOWN(addr, PAGE_SIZE);
-					
-					// 计算页索引
-					int32 page_idx = (page_va - vma->vm_start) / PAGE_SIZE;
-					if (page_idx < 0 || page_idx >= vma->page_count) {
-							kprintf("页索引越界: %d\n", page_idx);
-							goto error;
-					}
-					
-					// // 如果页已存在，检查是否需要COW
-					// if (vma->pages[page_idx]) {
-					// 		// 检查是否是COW页
-					// 		pte_t *pte = page_walk(proc->pagetable, page_va, 0);
-					// 		if (pte && (*pte & PTE_V) && ((*pte & PTE_W) == 0) && (*pte & PTE_R) && mcause == CAUSE_STORE_PAGE_FAULT) {
-					// 				// 写时复制
-					// 				struct page *old_page = vma->pages[page_idx];
-					// 				struct page *new_page = alloc_page();
-					// 				if (!new_page) goto error;
-									
-					// 				// 复制页内容
-					// 				uint64 old_pa = page_to_addr(old_page);
-					// 				uint64 new_pa = page_to_addr(new_page);
-					// 				memcpy(new_pa, old_pa, PAGE_SIZE);
-									
-					// 				// 更新映射
-					// 				user_vm_unmap(proc->pagetable, page_va, PAGE_SIZE, 0);
-					// 				user_vm_map(proc->pagetable, page_va, PAGE_SIZE, (uint64)new_pa, 
-					// 									 prot_to_type(vma->vm_prot, 1));
-									
-					// 				// 更新页结构
-					// 				vma->pages[page_idx] = new_page;
-					// 				new_page->paddr = (uint64)page_va;
-					// 				put_page(old_page);
-									
-					// 				return;
-					// 		} else {
-					// 				// 页已分配但可能未映射，确保映射正确
-					// 				uint64 pa = page_to_addr(vma->pages[page_idx]);
-					// 				user_vm_map(proc->pagetable, page_va, PAGE_SIZE, (uint64)pa,
-					// 									prot_to_type(vma->vm_prot, 1));
-					// 				return;
-					// 		}
-					// }
-					
-					// // 分配新页并映射
-					// uint64 page_addr = mm_alloc_page(proc, page_va, vma->vm_prot);
-					// if (page_addr) return;
-			}
-	}
-	
-	// // 如果没有找到VMA或VMA处理失败，回退到原有处理逻辑
-	// if (mcause == CAUSE_STORE_PAGE_FAULT) {
-	// 		// 检查是否是栈扩展
-	// 		if (stval >= proc->user_stack_bottom - PAGE_SIZE) {
-	// 				proc->user_stack_bottom -= PAGE_SIZE;
-	// 				uint64 pa = Alloc_page();
-	// 				user_vm_map(proc->pagetable, proc->user_stack_bottom, PAGE_SIZE,
-	// 									(uint64)pa, prot_to_type(PROT_WRITE | PROT_READ, 1));
-	// 				proc->mapped_info[STACK_SEGMENT].va = proc->user_stack_bottom;
-	// 				proc->mapped_info[STACK_SEGMENT].npages++;
-	// 				return;
-	// 		}
-			
-	// 		// 检查是否是COW页
-	// 		pte_t *pte = page_walk(proc->pagetable, stval, 0);
-	// 		if (pte && ((uint64)*pte & PTE_W) == 0 && (*pte & PTE_X) == 0) {
-	// 				uint64 page_va = stval & (~0xfff);
-	// 				uint64 newpa = (uint64)Alloc_page();
-	// 				memcpy((uint64 )newpa, (uint64 )PTE2PA(*pte), PAGE_SIZE);
-	// 				user_vm_unmap(proc->pagetable, page_va, PAGE_SIZE, 0);
-	// 				user_vm_map(proc->pagetable, page_va, PAGE_SIZE, newpa, 
-	// 									 prot_to_type(PROT_WRITE | PROT_READ, 1));
-	// 				return;
-	// 		}
-	// }
-	
-error:
+	if (do_page_fault(CURRENT->mm, mcause, stval, FAULT_FLAG_USER) == 0)
+			return;
+
 	// 不能处理的页错误
-	kprintf("无法处理的页错误: addr=%lx, mcause=%lx\n", stval, mcause);
+	kprintf("无法处理的页错误: addr=%lx, mcause=%lx, sepc=%lx\n", stval, mcause, sepc);
 	panic("This address is not available!");
 }
 
-//
-// implements round-robin scheduling. added @lab3_3
-//
-void rrsched() {
-  int32 hartid = read_tp();
-  if (CURRENT->tick_count >= TIME_SLICE_LEN) {
-    CURRENT->tick_count = 0;
-  }
+/**
+ * 内核态访问用户内存时的页错误
+ * 只有uaccess窗口内（sstatus.SUM置位）才可能合法：先按需调页，
+ * 失败时查异常表跳到修复代码，让copy_*_user返回错误而不是panic
+ *
+ * @return 已处理返回1，否则返回0
+ */
+static int32 handle_kernel_page_fault(struct trapframe *tf, uint64 cause, uint64 stval) {
+	if (cause != CAUSE_LOAD_PAGE_FAULT && cause != CAUSE_STORE_PAGE_FAULT)
+			return 0;
+
+	// 陷入不会修改SUM，此时读到的就是出错时的值。
+	// pagefault_disable()期间不能睡眠，不处理缺页，直接修复
+	if ((read_csr(sstatus) & SSTATUS_SUM) && CURRENT && !CURRENT->pagefault_disabled &&
+	    do_page_fault(CURRENT->mm, cause, stval, 0) == 0)
+			return 1;
+
+	return fixup_exception(tf);
 }
 
 /**
@@ -172,7 +126,10 @@ void kernel_trap_handler(struct trapframe *tf) {
 	uint64 cause = read_csr(scause);
 	uint64 epc = read_csr(sepc);
 	uint64 stval = read_csr(stval);
-	printReg(tf);
+
+	if (!(cause & (1ULL << 63)) && handle_kernel_page_fault(tf, cause, stval))
+	  return;
+
 	// 检查是否是中断（最高位为1表示中断）
 	if (cause & (1ULL << 63)) {
 	  uint64 interrupt_cause = cause & ~(1ULL << 63); // 去掉最高位获取中断类型
@@ -180,12 +137,12 @@ void kernel_trap_handler(struct trapframe *tf) {
 	  // 处理不同类型的中断
 	  switch (interrupt_cause) {
 		case IRQ_S_TIMER:
-		  kprintf("内核中断: IRQ_S_TIMER (S模式计时器中断)\n");
+		  // 内核态不抢占，只记账；真正的切换留到返回用户态时
 		  handle_mtimer_trap();
 		  break;
 		case IRQ_S_SOFT:
-		  kprintf("内核中断: IRQ_S_SOFT (S模式软件中断)\n");
-		  // 处理软件中断
+		  // 核间中断，只用来唤醒wfi中的空闲hart
+		  handle_ipi();
 		  break;
 		case IRQ_S_EXT:
 		  kprintf("内核中断: IRQ_S_EXT (S模式外部中断)\n");
@@ -196,6 +153,7 @@ void kernel_trap_handler(struct trapframe *tf) {
 		  break;
 	  }
 	} else {
+	  printReg(tf);
 	  // 处理异常（非中断）
 	  switch (cause) {
 		case CAUSE_MISALIGNED_FETCH:
@@ -293,6 +251,7 @@ void user_trap_handler(struct trapframe *tf) {
 
 
   assert(CURRENT);
+  vtime_user_exit(CURRENT);
   // save user process counter.
   CURRENT->trapframe->epc = read_csr(sepc);
 
@@ -306,13 +265,22 @@ void user_trap_handler(struct trapframe *tf) {
     handle_syscall(CURRENT->trapframe);
     // kprintf("coming back from syscall\n");
     break;
-  case CAUSE_MTIMER_S_TRAP:
+  case CAUSE_SSOFT_S_TRAP:
+    handle_ipi();
+    break;
+  case CAUSE_STIMER_S_TRAP:
     handle_mtimer_trap();
-    // invoke round-robin scheduler. added @lab3_3
-    rrsched();
+    break;
+  case CAUSE_ILLEGAL_INSTRUCTION:
+    // the first FP instruction since the process came to this hart, with
+    // sstatus.FS off: load its FP registers and retry the instruction
+    if (fpu_handle_trap(CURRENT)) break;
+    kprintf("smode_trap_handler(): illegal instruction, sepc=%p stval=%p\n", read_csr(sepc), read_csr(stval));
+    panic("illegal instruction in user mode.\n");
     break;
   case CAUSE_STORE_PAGE_FAULT:
   case CAUSE_LOAD_PAGE_FAULT:
+  case CAUSE_FETCH_PAGE_FAULT:
     // the address of missing page is stored in stval
     // call handle_user_page_fault to process page faults
     handle_user_page_fault(cause, read_csr(sepc), read_csr(stval));
@@ -325,6 +293,19 @@ void user_trap_handler(struct trapframe *tf) {
   }
   write_csr(sstatus, read_csr(sstatus) | SSTATUS_SIE);
 
+  // another thread of the group called exit_group(): leave with it
+  if (signal_group_exit(CURRENT)) do_exit(0);
+
+#ifndef CONFIG_NO_FAST_SYSCALL_RETURN
+  // nothing left to do on the way out: smode_trap_vector returns to the
+  // process itself, see prepare_syscall_return()
+  if (cause == CAUSE_USER_ECALL && prepare_syscall_return(CURRENT)) return;
+#endif
+
+  // time slice used up (set by the timer, possibly while we were in the
+  // kernel): give the cpu away before going back. added @lab3_3
+  rrsched();
+
   // kprintf("calling switch_to, current = 0x%x\n", current);
   // continue (come back to) the execution of current process.
   switch_to(CURRENT);
@@ -335,6 +316,7 @@ void smode_trap_handler(struct trapframe *tf) {
 	if ((read_csr(sstatus) & SSTATUS_SPP) != 0){
 		kernel_trap_handler(tf);
 	}else{
+		// 处理用户陷入期间再发生的陷入，smode_trap_vector按SPP转到kernel_trap_vector，stvec不用换
 		user_trap_handler(tf);
 	}
 }
\ No newline at end of file
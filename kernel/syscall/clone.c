@@ -1,6 +1,7 @@
 #include <kernel/sched.h>
 #include <kernel/vfs.h>
 #include <kernel/syscall/syscall.h>
+#include <kernel/mm/uaccess.h>
 #include <kernel/mmu.h>
 #include <kernel/util.h>
 
@@ -10,9 +11,159 @@ int64 sys_clone(uint64 flags, uint64 stack, uint64 ptid, uint64 tls, uint64 ctid
 	return do_clone(flags, stack, ptid, tls, ctid);
 }
 
-int64 do_clone(uint64 flags, uint64 stack, uint64 ptid, uint64 tls, uint64 ctid){
+/*
+ * 新任务和调用者共用还是各有一份资源。地址空间目前只能共用：还没有复制
+ * 地址空间的代码，不带CLONE_VM的fork由调用者返回-ENOSYS。
+ */
+static int32 copy_resources(uint64 flags, struct task_struct* p, struct task_struct* parent) {
+	struct mm_struct* mm = parent->mm;
 
+	atomic_inc(&mm->mm_users);
+	atomic_inc(&mm->mm_count);
+	p->mm = mm;
 
-	// TODO: clone
+	p->fdtable = (flags & CLONE_FILES) ? fdtable_acquire(parent->fdtable) : fdtable_copy(parent->fdtable);
+	if (!p->fdtable) return -ENOMEM;
+
+	if (flags & CLONE_FS) {
+		atomic_inc(&parent->fs->count);
+		p->fs = parent->fs;
+	} else {
+		p->fs = copy_fs_struct(parent->fs);
+		if (!p->fs) return -ENOMEM;
+	}
 	return 0;
 }
+
+/**
+ * do_clone - Create a thread or a process sharing the caller's address space
+ * @flags: CLONE_* flags and, in the low byte, the exit signal
+ * @stack: User stack of the new task; 0 keeps the caller's sp
+ * @ptid: Where CLONE_PARENT_SETTID stores the new tid
+ * @tls: New tp for CLONE_SETTLS
+ * @ctid: Where CLONE_CHILD_SETTID stores the new tid and CLONE_CHILD_CLEARTID
+ *        clears it at exit
+ *
+ * The new task gets its own kernel stack and a copy of the caller's
+ * trapframe, and returns 0 to user mode from the clone call. With
+ * CLONE_THREAD it joins the caller's thread group: it is never waited for
+ * and is freed as soon as it exits.
+ *
+ * Returns the new tid or a negative errno.
+ */
+int64 do_clone(uint64 flags, uint64 stack, uint64 ptid, uint64 tls, uint64 ctid) {
+	struct task_struct* parent = current_task();
+	struct task_struct* p;
+	int32 ret;
+	pid_t pid;
+
+	// 和Linux的copy_process()一样的组合检查
+	if ((flags & CLONE_THREAD) && !(flags & CLONE_SIGHAND)) return -EINVAL;
+	if ((flags & CLONE_SIGHAND) && !(flags & CLONE_VM)) return -EINVAL;
+	if (!(flags & CLONE_VM)) return -ENOSYS;
+	// 离上限远的时候只读一次共享的count，不用把各hart的份加起来
+	if (percpu_counter_compare(&nr_threads, max_threads) >= 0) return -EAGAIN;
+
+	pid = pid_alloc();
+	if (pid < 0) return pid;
+
+	p = alloc_empty_process();
+	if (!p) {
+		pid_free(pid);
+		return -ENOMEM;
+	}
+	p->kstack = (uint64)alloc_kernel_stack();
+	p->trapframe = (struct trapframe*)kmalloc(sizeof(struct trapframe));
+	if (!p->kstack || !p->trapframe) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+	p->thread.ra = (uint64)ret_from_fork;
+	p->thread.sp = p->kstack;
+	p->pid = pid;
+
+	ret = copy_resources(flags, p, parent);
+	if (ret) goto fail;
+
+	// 从clone返回到用户态，子任务里返回值是0
+	*p->trapframe = *parent->trapframe;
+	p->trapframe->regs.a0 = 0;
+	if (stack) p->trapframe->regs.sp = stack;
+	if (flags & CLONE_SETTLS) p->trapframe->regs.tp = tls;
+
+	// 浮点寄存器可能还只在硬件里，先存下来再复制
+	fpu_save(parent);
+	p->fpstate = parent->fpstate;
+	p->flags = parent->flags & PF_USED_MATH;
+
+	memcpy(p->comm, parent->comm, sizeof(p->comm));
+	p->cpus_allowed = parent->cpus_allowed;
+	p->uid = parent->uid;
+	p->euid = parent->euid;
+	p->gid = parent->gid;
+	p->egid = parent->egid;
+	// 处理函数表是每个任务一份，CLONE_SIGHAND时也只是复制
+	memcpy(p->sighand, parent->sighand, sizeof(p->sighand));
+	p->blocked = parent->blocked;
+
+	INIT_LIST_HEAD(&p->children);
+	INIT_LIST_HEAD(&p->sibling);
+	init_waitqueue_head(&p->wait_chldexit);
+	p->set_child_tid = (flags & CLONE_CHILD_SETTID) ? (int32 __user*)ctid : NULL;
+	p->clear_child_tid = (flags & CLONE_CHILD_CLEARTID) ? (int32 __user*)ctid : NULL;
+
+	// 地址空间是共用的，两个tid在这里就能写好，子线程一开始就能看到
+	if ((flags & CLONE_PARENT_SETTID) && copy_to_user((void __user*)ptid, &pid, sizeof(pid))) {
+		ret = -EFAULT;
+		goto fail;
+	}
+	if (p->set_child_tid && copy_to_user(p->set_child_tid, &pid, sizeof(pid))) {
+		ret = -EFAULT;
+		goto fail;
+	}
+
+	write_lock(&tasklist_lock);
+	if (flags & CLONE_THREAD) {
+		p->tgid = parent->tgid;
+		p->group_leader = parent->group_leader;
+		p->exit_signal = -1;
+		p->parent = parent->parent;
+		list_add_tail(&p->thread_group, &p->group_leader->thread_group);
+	} else {
+		p->tgid = pid;
+		p->exit_signal = flags & CSIGNAL;
+		p->parent = (flags & CLONE_PARENT) ? parent->parent : parent;
+		if (p->parent) list_add_tail(&p->sibling, &p->parent->children);
+	}
+	write_unlock(&tasklist_lock);
+
+	attach_pid(p);
+	wake_up_new_task(p);
+	return pid;
+
+fail:
+	if (p->fdtable) fdtable_unref(p->fdtable);
+	if (p->fs) fs_struct_unref(p->fs);
+	if (p->mm) {
+		atomic_dec(&p->mm->mm_users);
+		free_mm(p->mm);
+	}
+	kfree(p->trapframe);
+	if (p->kstack) kfree((void*)ROUNDDOWN(p->kstack, PAGE_SIZE));
+	pid_free(pid);
+	free_empty_process(p);
+	return ret;
+}
+
+/**
+ * sys_set_tid_address - Set where the calling thread's tid is cleared at exit
+ * @tidptr: User address, or NULL
+ *
+ * Returns the caller's tid.
+ */
+int64 sys_set_tid_address(int32 __user* tidptr) {
+	struct task_struct* cur = current_task();
+
+	cur->clear_child_tid = tidptr;
+	return cur->pid;
+}
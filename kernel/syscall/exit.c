@@ -1,18 +1,125 @@
 #include <kernel/sched.h>
 #include <kernel/vfs.h>
 #include <kernel/syscall/syscall.h>
+#include <kernel/mm/uaccess.h>
 #include <kernel/mmu.h>
 #include <kernel/util.h>
 
+/*
+ * 线程组里除leader以外的线程退出后没有人wait它们，挂到这里由system_wq
+ * 回收。退出的线程还在自己的内核栈上，不能自己释放。
+ */
+static struct list_head dead_threads = LIST_HEAD_INIT(dead_threads);
+static spinlock_t dead_threads_lock = SPINLOCK_INIT;
 
+static void reap_dead_threads(struct work_struct* work) {
+	struct task_struct* p;
+	int64 flags;
 
+	flags = spinlock_lock_irqsave(&dead_threads_lock);
+	while (!list_empty(&dead_threads)) {
+		p = list_first_entry(&dead_threads, struct task_struct, sibling);
+		list_del_init(&p->sibling);
+		spinlock_unlock_irqrestore(&dead_threads_lock, flags);
+
+		// 等它在schedule()里离开自己的内核栈
+		while (p->on_cpu) cpu_relax();
+		free_process(p);
+
+		flags = spinlock_lock_irqsave(&dead_threads_lock);
+	}
+	spinlock_unlock_irqrestore(&dead_threads_lock, flags);
+}
+
+static DECLARE_WORK(reap_work, reap_dead_threads);
+
+// 非leader的线程离开线程组；组里只剩已经退出的leader时叫醒它的父进程来回收
+static void release_thread(struct task_struct* p) {
+	struct task_struct* leader = p->group_leader;
+	int32 empty;
+	int64 flags;
+
+	write_lock(&tasklist_lock);
+	// 离开线程组后它的CPU时间算在leader上，最后一次切走的那一点不算
+	task_cputime_add(&leader->dead_cputime, &p->cputime);
+	list_del_init(&p->thread_group);
+	empty = list_empty(&leader->thread_group);
+	write_unlock(&tasklist_lock);
+	if (empty && (leader->state & TASK_DEAD) && leader->parent) wake_up_interruptible(&leader->parent->wait_chldexit);
+
+	flags = spinlock_lock_irqsave(&dead_threads_lock);
+	list_add_tail(&p->sibling, &dead_threads);
+	spinlock_unlock_irqrestore(&dead_threads_lock, flags);
+	schedule_work(&reap_work);
+}
 
 int64 sys_exit(int32 status) {
 	/* Implementation here */
 	return do_exit(status);
 }
 
+int64 sys_exit_group(int32 status) {
+	return do_group_exit(status);
+}
+
+/*
+ * 进程退出：记下退出码，变成TASK_DEAD后唤醒在wait中睡眠的父进程。
+ * TASK_DEAD不会被任何唤醒选中，schedule()不会再回到这里。
+ *
+ * 只是线程组里的一个线程时，其他线程照常运行；leader要等到组里的线程
+ * 都退出后才被回收，其他线程由reap_dead_threads()回收。
+ */
 int64 do_exit(int32 status) {
-	// TODO: Implement the exit logic
+	struct task_struct* p = current_task();
+
+	// CLONE_CHILD_CLEARTID：清零并唤醒在join的线程
+	if (p->clear_child_tid) {
+		int32 zero = 0;
+		if (!copy_to_user(p->clear_child_tid, &zero, sizeof(zero)))
+			futex_wake((uint32 __user*)p->clear_child_tid, 1, 1, FUTEX_BITSET_MATCH_ANY);
+		p->clear_child_tid = NULL;
+	}
+
+	p->exit_code = signal_group_exit(p) ? p->group_leader->group_exit_code : status;
+	p->flags |= PF_EXITING;
+	p->state = TASK_DEAD;
+	if (!thread_group_leader(p))
+		release_thread(p);
+	else if (p->parent)
+		wake_up_interruptible(&p->parent->wait_chldexit);
+	schedule();
+	panic("do_exit: dead task %d was scheduled again\n", p->pid);
 	return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * do_group_exit - End every thread of the calling thread group
+ * @status: Exit status of the group
+ *
+ * The other threads get SIGKILL so that interruptible sleeps end, and
+ * leave through do_exit() before they next return to user mode.
+ */
+int64 do_group_exit(int32 status) {
+	struct task_struct* cur = current_task();
+	struct task_struct* leader = cur->group_leader;
+	struct task_struct* t;
+
+	if (!thread_group_empty(cur)) {
+		read_lock(&tasklist_lock);
+		if (!signal_group_exit(cur)) {
+			leader->group_exit_code = status;
+			leader->signal_flags |= SIGNAL_GROUP_EXIT;
+		}
+		list_for_each_entry(t, &leader->thread_group, thread_group) {
+			if (t == cur) continue;
+			sigaddset(&t->pending, SIGKILL);
+			try_to_wake_up(t, TASK_INTERRUPTIBLE);
+		}
+		if (leader != cur && !(leader->state & TASK_DEAD)) {
+			sigaddset(&leader->pending, SIGKILL);
+			try_to_wake_up(leader, TASK_INTERRUPTIBLE);
+		}
+		read_unlock(&tasklist_lock);
+	}
+	return do_exit(status);
+}
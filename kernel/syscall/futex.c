@@ -0,0 +1,62 @@
+#include <kernel/clockevent.h>
+#include <kernel/sched.h>
+#include <kernel/sched/futex.h>
+#include <kernel/syscall/syscall.h>
+#include <kernel/mm/uaccess.h>
+#include <kernel/time.h>
+#include <kernel/util.h>
+
+/*
+ * 把futex的超时换算成time CSR上的绝对时刻。FUTEX_WAIT的超时是相对的；
+ * FUTEX_WAIT_BITSET的是绝对时刻，默认按CLOCK_MONOTONIC（time CSR从
+ * 上电开始的计数），带FUTEX_CLOCK_REALTIME时按CLOCK_REALTIME。
+ */
+static int32 futex_deadline(const struct timespec __user* utime, int32 cmd, int32 op, uint64* expires) {
+	struct timespec ts;
+
+	*expires = CLOCKEVENT_NONE;
+	if (!utime) return 0;
+	if (copy_from_user(&ts, utime, sizeof(ts))) return -EFAULT;
+	if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= NSEC_PER_SEC) return -EINVAL;
+	// 远到换算会溢出的时刻当作不超时
+	if (ts.tv_sec >= TIME_T_MAX / NSEC_PER_SEC) return 0;
+
+	if (cmd == FUTEX_WAIT) {
+		*expires = read_time() + ns_to_ticks(timespec_to_ns(&ts));
+	} else {
+		*expires = clock_to_ticks(op & FUTEX_CLOCK_REALTIME ? CLOCK_REALTIME : CLOCK_MONOTONIC, timespec_to_ns(&ts));
+	}
+	return 0;
+}
+
+int64 sys_futex(uint32 __user* uaddr, int32 op, uint32 val, const struct timespec __user* utime, uint32 __user* uaddr2,
+                uint32 val3) {
+	int32 cmd = op & FUTEX_CMD_MASK;
+	int32 shared = !(op & FUTEX_PRIVATE_FLAG);
+	uint64 expires;
+	int32 ret;
+
+	if ((op & FUTEX_CLOCK_REALTIME) && cmd != FUTEX_WAIT_BITSET) return -ENOSYS;
+
+	switch (cmd) {
+	case FUTEX_WAIT:
+		val3 = FUTEX_BITSET_MATCH_ANY;
+		// fallthrough
+	case FUTEX_WAIT_BITSET:
+		ret = futex_deadline(utime, cmd, op, &expires);
+		if (ret) return ret;
+		return futex_wait(uaddr, shared, val, expires, val3);
+	case FUTEX_WAKE:
+		val3 = FUTEX_BITSET_MATCH_ANY;
+		// fallthrough
+	case FUTEX_WAKE_BITSET:
+		return futex_wake(uaddr, shared, val, val3);
+	// 这两个命令的第四个参数不是超时，而是最多挪走几个等待者
+	case FUTEX_REQUEUE:
+		return futex_requeue(uaddr, shared, uaddr2, val, (int32)(uint64)utime, NULL);
+	case FUTEX_CMP_REQUEUE:
+		return futex_requeue(uaddr, shared, uaddr2, val, (int32)(uint64)utime, &val3);
+	default:
+		return -ENOSYS;
+	}
+}
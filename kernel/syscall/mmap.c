@@ -9,14 +9,32 @@ int64 sys_mmap(void* addr, size_t length, int32 prot, int32 flags, int32 fd, off
 	return do_mmap(addr, length, prot, flags, fd, offset);
 }
 
+int64 sys_msync(void* addr, size_t length, int32 flags) {
+	struct mm_struct* mm = current_task()->mm;
+	int64 ret;
+
+	// 写回要做磁盘I/O，持读锁，不挡住其他线程缺页
+	down_read(&mm->mmap_lock);
+	ret = do_msync(mm, (uint64)addr, length, flags);
+	up_read(&mm->mmap_lock);
+	return ret;
+}
+
 int64 do_mmap(void* addr, size_t length, int32 prot, int32 flags, int32 fd, off_t offset) {
 	struct mm_struct* mm = current_task()->mm;
-	struct file* file = fdtable_getFile(current->fdtable, fd);
-	CHECK_PTR_VALID(file,-EBADF);
+	struct file* file = NULL;
 
+	if (!(flags & MAP_ANONYMOUS)) {
+		file = fdtable_getFile(current->fdtable, fd);
+		CHECK_PTR_VALID(file, -EBADF);
+	}
 
-	/* Implementation here */
-	return mmap_file(mm, (uint64)addr, length, prot, flags,file,  offset);
+	/* mmap_file takes its own reference for the VMA */
+	down_write(&mm->mmap_lock);
+	int64 ret = mmap_file(mm, (uint64)addr, length, prot, flags, file, offset);
+	up_write(&mm->mmap_lock);
+	if (file) file_unref(file);
+	return ret;
 }
 
 
@@ -31,11 +49,16 @@ int64 do_mmap(void* addr, size_t length, int32 prot, int32 flags, int32 fd, off_
  * @param prot Protection flags (PROT_READ/WRITE/EXEC)
  * @param flags Mapping flags (MAP_PRIVATE/SHARED/FIXED/etc)
  * @param file Optional file for file-backed mapping (NULL for anonymous)
- * @param pgoff File offset in pages or physical address for direct mapping
+ * @param offset File offset in bytes, must be page aligned
  * @return Mapped virtual address or negative error code
  */
-uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, uint64 flags, struct file* file, off_t pgoff) {
+uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, uint64 flags, struct file* file, off_t offset) {
 	if (!mm || length == 0) return -EINVAL;
+	if (offset & (PAGE_SIZE - 1)) return -EINVAL;
+	// 文件页由页缓存提供，inode必须带有address space
+	if (file && (!file->f_inode || !file->f_inode->i_mapping)) return -ENODEV;
+	// 可写的共享映射会把数据写回文件
+	if (file && (flags & MAP_SHARED) && (prot & PROT_WRITE) && !(file->f_mode & FMODE_WRITE)) return -EACCES;
 
 	// Round length to page boundary
 	length = ROUNDUP(length, PAGE_SIZE);
@@ -61,6 +84,7 @@ uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, u
 	if (flags & MAP_SHARED) vm_flags |= VM_SHARED;
 	if (flags & MAP_PRIVATE) vm_flags |= VM_PRIVATE;
 	if (flags & MAP_GROWSDOWN) vm_flags |= VM_GROWSDOWN;
+	if (!mm->is_kernel_mm) vm_flags |= VM_USER;
 
 	// Find suitable address if needed
 	if (addr == 0) {
@@ -68,19 +92,22 @@ uint64 mmap_file(struct mm_struct* mm, uint64 addr, size_t length, int32 prot, u
 	} else if (flags & MAP_FIXED) {
 		if (find_vma_intersection(mm, addr, addr + length)) return -EINVAL;
 	}
+	// 用户映射不能越过TASK_SIZE，上面是共享的内核页表
+	if (!mm->is_kernel_mm && (addr + length > TASK_SIZE || addr + length < addr)) return -ENOMEM;
 
 	// Create the VMA
 	struct vm_area_struct* vma = vm_area_setup(mm, addr, length, type, prot, vm_flags);
 	if (!vma) return -ENOMEM;
 
-	// Handle file-backed mapping
+	// Handle file-backed mapping: pages come from the page cache on fault
 	if (file) {
-		vma->vm_file = file;
-		vma->vm_pgoff = pgoff;
+		vma->vm_file = file_ref(file);
+		vma->vm_pgoff = offset >> PAGE_SHIFT;
+		filemap_link_vma(vma);
 	}
 
-	// Pre-populate pages if requested
-	if (flags & MAP_POPULATE) {
+	// Pre-populate pages if requested (anonymous memory only)
+	if ((flags & MAP_POPULATE) && !file) {
 		populate_vma(vma, addr, length, prot);
 	}
 
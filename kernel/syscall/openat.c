@@ -6,20 +6,13 @@
 
 /* Syscall implementation for openat */
 int64 sys_openat(int32 dirfd, const char* pathname, int32 flags, mode_t mode) {
-	if (!pathname) return -EFAULT;
-
-	/* Copy pathname from user space */
-	char* kpathname = kmalloc(PATH_MAX);
-	if (!kpathname) return -ENOMEM;
-
-	if (copy_from_user(kpathname, pathname, PATH_MAX)) {
-		kfree(kpathname);
-		return -EFAULT;
-	}
+	/* Copy pathname from user space, only up to its terminator */
+	struct filename* name = getname(pathname);
+	if (PTR_IS_ERROR(name)) return PTR_ERR(name);
 
 	/* Call internal implementation */
-	int32 ret = do_openat(dirfd, kpathname, flags, mode);
-	kfree(kpathname);
+	int32 ret = do_openat(dirfd, name->name, flags, mode);
+	putname(name);
 	return ret;
 }
 
@@ -34,7 +27,7 @@ int64 sys_openat(int32 dirfd, const char* pathname, int32 flags, mode_t mode) {
  */
 int32 do_openat(int32 dirfd, const char* pathname, int32 flags, mode_t mode) {
 
-#define DO_OPENAT_DEBUG 1
+// #define DO_OPENAT_DEBUG 1
 	struct file* filp = NULL;
 
 	int32 ret;
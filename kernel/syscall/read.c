@@ -53,9 +53,21 @@ ssize_t file_read(struct file *filp, char *buf, size_t count, loff_t *ppos) {
     if (!(filp->f_mode & FMODE_READ))
         return -EBADF;
     
-    // If the file has a read method, call it
-    if (filp->f_op->read)
-        return filp->f_op->read(filp, buf, count, ppos);
+    // If the file has a read method, call it. Readers of a regular file
+    // share i_rwsem and only wait for writers.
+    if (filp->f_op->read) {
+        struct inode *inode = filp->f_inode;
+        ssize_t ret;
+
+        if (inode && S_ISREG(inode->i_mode)) {
+            inode_lock_shared(inode);
+            ret = filp->f_op->read(filp, buf, count, ppos);
+            inode_unlock_shared(inode);
+        } else {
+            ret = filp->f_op->read(filp, buf, count, ppos);
+        }
+        return ret;
+    }
     // Otherwise, try using read_iter if available
     else {
 		return -ENOSYS;
@@ -0,0 +1,282 @@
+#include <kernel/mm/kmalloc.h>
+#include <kernel/sched.h>
+#include <kernel/syscall/syscall.h>
+#include <kernel/mmu.h>
+#include <kernel/util.h>
+#include <kernel/time.h>
+
+
+int64 sys_sched_yield(void) {
+	// 交给返回用户态时的rrsched()，就绪队列为空时直接返回
+	sched_yield();
+	return 0;
+}
+
+int64 sys_sched_rr_get_interval(pid_t pid, struct timespec __user* interval) {
+	struct timespec ts;
+	struct task_struct* p;
+	uint64 ticks;
+
+	if (pid < 0) return -EINVAL;
+	p = find_process_by_pid(pid);
+	if (!p) return -ESRCH;
+	ticks = sched_task_timeslice(p);
+	put_task_struct(p);
+
+	ts.tv_sec = ticks / timebase_freq;
+	ts.tv_nsec = ticks_to_ns(ticks % timebase_freq);
+	if (copy_to_user(interval, &ts, sizeof(ts)) != 0) return -EFAULT;
+	return 0;
+}
+
+int64 sys_sched_setaffinity(pid_t pid, size_t len, const cpumask_t __user* user_mask) {
+	cpumask_t mask = 0;
+
+	if (pid < 0) return -EINVAL;
+	if (copy_from_user(&mask, user_mask, MIN(len, sizeof(mask))) != 0) return -EFAULT;
+	return sched_setaffinity(pid, mask);
+}
+
+int64 sys_sched_getaffinity(pid_t pid, size_t len, cpumask_t __user* user_mask) {
+	cpumask_t mask;
+	int32 ret;
+
+	if (pid < 0) return -EINVAL;
+	if (len < sizeof(mask) || (len & (sizeof(uint64) - 1))) return -EINVAL;
+	ret = sched_getaffinity(pid, &mask);
+	if (ret) return ret;
+	if (copy_to_user(user_mask, &mask, sizeof(mask)) != 0) return -EFAULT;
+	// 和Linux一样返回写入的字节数
+	return sizeof(mask);
+}
+
+/*
+ * 调度策略。sched_param只有实时优先级一个字段，
+ * 普通任务的优先级必须为0，用setpriority()调整nice值。
+ */
+static int64 do_sched_setscheduler(pid_t pid, int32 policy, const struct sched_param __user* uparam) {
+	struct sched_param param;
+	struct task_struct *p, *cur = current_task();
+	int64 ret;
+
+	if (pid < 0 || !uparam) return -EINVAL;
+	if (copy_from_user(&param, uparam, sizeof(param)) != 0) return -EFAULT;
+	p = find_process_by_pid(pid);
+	if (!p) return -ESRCH;
+	if (cur->euid != 0 && cur->euid != p->uid && cur->euid != p->euid) {
+		ret = -EPERM;
+	} else {
+		// sched_setparam()：保持原来的策略
+		if (policy < 0) policy = p->policy;
+		ret = sched_setscheduler(p, policy, param.sched_priority);
+	}
+	put_task_struct(p);
+	return ret;
+}
+
+int64 sys_sched_setscheduler(pid_t pid, int32 policy, const struct sched_param __user* param) {
+	if (policy < 0) return -EINVAL;
+	return do_sched_setscheduler(pid, policy, param);
+}
+
+int64 sys_sched_setparam(pid_t pid, const struct sched_param __user* param) {
+	return do_sched_setscheduler(pid, -1, param);
+}
+
+int64 sys_sched_getscheduler(pid_t pid) {
+	struct task_struct* p;
+	int32 policy;
+
+	if (pid < 0) return -EINVAL;
+	p = find_process_by_pid(pid);
+	if (!p) return -ESRCH;
+	policy = p->policy;
+	put_task_struct(p);
+	return policy;
+}
+
+int64 sys_sched_getparam(pid_t pid, struct sched_param __user* uparam) {
+	struct sched_param param;
+	struct task_struct* p;
+
+	if (pid < 0 || !uparam) return -EINVAL;
+	p = find_process_by_pid(pid);
+	if (!p) return -ESRCH;
+	param.sched_priority = p->rt_priority;
+	put_task_struct(p);
+	if (copy_to_user(uparam, &param, sizeof(param)) != 0) return -EFAULT;
+	return 0;
+}
+
+int64 sys_sched_get_priority_max(int32 policy) {
+	if (rt_policy(policy)) return MAX_USER_RT_PRIO - 1;
+	if (policy == SCHED_NORMAL || policy == SCHED_BATCH || policy == SCHED_IDLE) return 0;
+	return -EINVAL;
+}
+
+int64 sys_sched_get_priority_min(int32 policy) {
+	if (rt_policy(policy)) return 1;
+	if (policy == SCHED_NORMAL || policy == SCHED_BATCH || policy == SCHED_IDLE) return 0;
+	return -EINVAL;
+}
+
+#define PRIO_PROCESS 0
+#define PRIO_PGRP 1
+#define PRIO_USER 2
+
+/*
+ * 对which/who选中的每个进程调用fn，返回选中的进程数。
+ * 还没有进程组，PRIO_PGRP返回-EINVAL。
+ */
+static int32 for_each_prio_target(int32 which, int32 who, int32 (*fn)(struct task_struct*, void*), void* arg) {
+	struct task_struct* p;
+	int32 n = 0, ret;
+
+	switch (which) {
+	case PRIO_PROCESS:
+		p = find_process_by_pid(who);
+		if (!p) return -ESRCH;
+		ret = fn(p, arg);
+		put_task_struct(p);
+		return ret ? ret : 1;
+	case PRIO_USER:
+		if (!who) who = current_task()->uid;
+		ret = 0;
+		read_lock(&tasklist_lock);
+		for_each_process(p) {
+			if (p->uid != who) continue;
+			ret = fn(p, arg);
+			if (ret) break;
+			n++;
+		}
+		read_unlock(&tasklist_lock);
+		if (ret) return ret;
+		return n ? n : -ESRCH;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int32 setprio_one(struct task_struct* p, void* arg) {
+	int32 nice = *(int32*)arg;
+	struct task_struct* cur = current_task();
+
+	if (cur->euid != 0 && cur->euid != p->uid && cur->euid != p->euid) return -EPERM;
+	if (!can_nice(p, nice)) return -EACCES;
+	set_user_nice(p, nice);
+	return 0;
+}
+
+static int32 getprio_one(struct task_struct* p, void* arg) {
+	int32* best = arg;
+	*best = MIN(*best, task_nice(p));
+	return 0;
+}
+
+int64 sys_setpriority(int32 which, int32 who, int32 niceval) {
+	int32 ret;
+
+	niceval = MIN(MAX(niceval, MIN_NICE), MAX_NICE);
+	ret = for_each_prio_target(which, who, setprio_one, &niceval);
+	return ret < 0 ? ret : 0;
+}
+
+int64 sys_getpriority(int32 which, int32 who) {
+	int32 nice = MAX_NICE;
+	int32 ret = for_each_prio_target(which, who, getprio_one, &nice);
+
+	if (ret < 0) return ret;
+	// 和Linux的系统调用一样返回20 - nice，保证成功时不是负数，由libc换回nice
+	return 20 - nice;
+}
+
+static void ticks_to_timeval(uint64 ticks, struct timeval* tv) {
+	uint64 ns = ticks_to_ns(ticks);
+
+	tv->tv_sec = ns / NSEC_PER_SEC;
+	tv->tv_usec = ns % NSEC_PER_SEC / NSEC_PER_USEC;
+}
+
+static long ticks_to_clock_t(uint64 ticks) {
+	return ticks_to_ns(ticks) / (NSEC_PER_SEC / USER_HZ);
+}
+
+int64 sys_getrusage(int32 who, struct rusage __user* ru) {
+	struct task_struct* cur = current_task();
+	struct task_cputime times;
+	struct rusage r;
+
+	switch (who) {
+	case RUSAGE_SELF:
+		thread_group_cputime(cur, &times);
+		break;
+	case RUSAGE_THREAD:
+		task_cputime(cur, &times);
+		break;
+	case RUSAGE_CHILDREN:
+		times = cur->group_leader->children_cputime;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	memset(&r, 0, sizeof(r));
+	ticks_to_timeval(times.utime, &r.ru_utime);
+	ticks_to_timeval(times.stime, &r.ru_stime);
+	r.ru_nvcsw = times.nvcsw;
+	r.ru_nivcsw = times.nivcsw;
+	if (copy_to_user(ru, &r, sizeof(r)) != 0) return -EFAULT;
+	return 0;
+}
+
+// 返回开机以来的USER_HZ计数，和Linux一样不会是负数
+int64 sys_times(struct tms __user* tbuf) {
+	struct task_struct* cur = current_task();
+	struct task_cputime times;
+	struct tms t;
+
+	if (tbuf) {
+		thread_group_cputime(cur, &times);
+		t.tms_utime = ticks_to_clock_t(times.utime);
+		t.tms_stime = ticks_to_clock_t(times.stime);
+		t.tms_cutime = ticks_to_clock_t(cur->group_leader->children_cputime.utime);
+		t.tms_cstime = ticks_to_clock_t(cur->group_leader->children_cputime.stime);
+		if (copy_to_user(tbuf, &t, sizeof(t)) != 0) return -EFAULT;
+	}
+	return ticks_to_clock_t(read_time());
+}
+
+// 把调度统计以文本形式读到buf，返回写入的字节数
+int64 sys_sched_stat(pid_t pid, char __user* buf, size_t len) {
+	char* kbuf;
+	int64 n;
+
+	if (!buf || !len) return -EINVAL;
+	if (len > PAGE_SIZE) len = PAGE_SIZE;
+	kbuf = kmalloc(len);
+	if (!kbuf) return -ENOMEM;
+	n = sched_stat_dump(pid, kbuf, len);
+	if (n >= 0 && copy_to_user(buf, kbuf, n + 1) != 0) n = -EFAULT;
+	kfree(kbuf);
+	return n;
+}
+
+/*
+ * 读出和修改调度参数。old不为空时先写回当前的值；new里为0的字段不改，
+ * 改要root。两个值都检查过才生效，不会只改一半。
+ */
+int64 sys_sched_tune(const struct sched_tunables __user* unew, struct sched_tunables __user* uold) {
+	struct sched_tunables old = {.timeslice = sched_timeslice, .timer_interval = timer_interval};
+	struct sched_tunables new;
+	int32 ret;
+
+	if (uold && copy_to_user(uold, &old, sizeof(old)) != 0) return -EFAULT;
+	if (!unew) return 0;
+	if (current_task()->euid != 0) return -EPERM;
+	if (copy_from_user(&new, unew, sizeof(new)) != 0) return -EFAULT;
+	if (new.timeslice > (uint32)-1) return -EINVAL;
+
+	if (new.timer_interval && (ret = timer_set_interval(new.timer_interval))) return ret;
+	if (new.timeslice) sched_set_timeslice(new.timeslice);
+	return 0;
+}
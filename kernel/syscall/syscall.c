@@ -25,6 +25,15 @@ int64 sys_lseek(int32 fd, off_t offset, int32 whence) {
 	return do_lseek(fd, offset, whence);
 }
 
+int64 sys_fsync(int32 fd) {
+	struct file* file = fdtable_getFile(current_task()->fdtable, fd);
+	CHECK_PTR_VALID(file, -EBADF);
+
+	int64 ret = file_sync(file, 0);
+	file_unref(file);
+	return ret;
+}
+
 int64 sys_mount(const char* source, const char* target, const char* fstype, uint64 flags, const void* data) {
 	/* Implementation here */
 	return do_mount(source, target, fstype, flags, data);
@@ -32,11 +41,65 @@ int64 sys_mount(const char* source, const char* target, const char* fstype, uint
 
 
 
+// 线程组里的线程getpid()都得到leader的pid，各自的pid用gettid()取
 int64 sys_getpid(void) {
 	/* Implementation here */
+	return current_task()->tgid;
+}
+
+int64 sys_gettid(void) {
 	return current_task()->pid;
 }
 
+// 只管调用的这个任务，没有saved uid：root可以换成任何用户，其他人只能把euid改回uid
+int64 sys_setuid(uid_t uid) {
+	struct task_struct* p = current_task();
+
+	if (p->euid == 0) {
+		p->uid = uid;
+		p->euid = uid;
+		return 0;
+	}
+	if (uid != p->uid) return -EPERM;
+	p->euid = uid;
+	return 0;
+}
+
+int64 sys_getuid(void) {
+	return current_task()->uid;
+}
+
+int64 sys_geteuid(void) {
+	return current_task()->euid;
+}
+
+// 调用时所在的hart；没有NUMA，node总是0
+int64 sys_getcpu(uint32* cpu, uint32* node, void* unused) {
+	uint32 c = read_tp(), n = 0;
+
+	if (cpu && copy_to_user(cpu, &c, sizeof(c)) != 0) return -EFAULT;
+	if (node && copy_to_user(node, &n, sizeof(n)) != 0) return -EFAULT;
+	return 0;
+}
+
+#ifdef CONFIG_LOCK_STAT
+// 把各锁类的竞争统计以文本形式读到buf，返回写入的字节数
+int64 sys_lock_stat(char* buf, size_t len, int32 flags) {
+	char* kbuf;
+	int64 n;
+
+	if (!buf || !len) return -EINVAL;
+	if (len > PAGE_SIZE) len = PAGE_SIZE;
+	kbuf = kmalloc(len);
+	if (!kbuf) return -ENOMEM;
+	n = lock_stat_dump(kbuf, len);
+	if (copy_to_user(buf, kbuf, n + 1) != 0) n = -EFAULT;
+	kfree(kbuf);
+	if (n >= 0 && (flags & LOCK_STAT_RESET)) lock_stat_reset();
+	return n;
+}
+#endif
+
 
 
 
@@ -53,19 +116,55 @@ static struct syscall_entry syscall_table[] = {
     [SYS_lseek] = {(syscall_fn_t)sys_lseek, "lseek", 3},
     [SYS_mount] = {(syscall_fn_t)sys_mount, "mount", 5},
     [SYS_getdents64] = {(syscall_fn_t)sys_getdents64, "getdents", 3},
+    [SYS_fsync] = {(syscall_fn_t)sys_fsync, "fsync", 1},
 
     /* Process operations */
     [SYS_exit] = {(syscall_fn_t)sys_exit, "exit", 1},
+    [SYS_exit_group] = {(syscall_fn_t)sys_exit_group, "exit_group", 1},
     [SYS_getpid] = {(syscall_fn_t)sys_getpid, "getpid", 0},
+    [SYS_gettid] = {(syscall_fn_t)sys_gettid, "gettid", 0},
+    [SYS_setuid] = {(syscall_fn_t)sys_setuid, "setuid", 1},
+    [SYS_getuid] = {(syscall_fn_t)sys_getuid, "getuid", 0},
+    [SYS_geteuid] = {(syscall_fn_t)sys_geteuid, "geteuid", 0},
+    [SYS_getcpu] = {(syscall_fn_t)sys_getcpu, "getcpu", 3},
+    [SYS_set_tid_address] = {(syscall_fn_t)sys_set_tid_address, "set_tid_address", 1},
+    [SYS_futex] = {(syscall_fn_t)sys_futex, "futex", 6},
     [SYS_getppid] = {NULL, "getppid", 0}, // Not implemented yet
     [SYS_clone] = {(syscall_fn_t)sys_clone, "clone", 5},
+    [SYS_sched_yield] = {(syscall_fn_t)sys_sched_yield, "sched_yield", 0},
+    [SYS_sched_rr_get_interval] = {(syscall_fn_t)sys_sched_rr_get_interval, "sched_rr_get_interval", 2},
+    [SYS_sched_setaffinity] = {(syscall_fn_t)sys_sched_setaffinity, "sched_setaffinity", 3},
+    [SYS_sched_getaffinity] = {(syscall_fn_t)sys_sched_getaffinity, "sched_getaffinity", 3},
+    [SYS_sched_setscheduler] = {(syscall_fn_t)sys_sched_setscheduler, "sched_setscheduler", 3},
+    [SYS_sched_setparam] = {(syscall_fn_t)sys_sched_setparam, "sched_setparam", 2},
+    [SYS_sched_getscheduler] = {(syscall_fn_t)sys_sched_getscheduler, "sched_getscheduler", 1},
+    [SYS_sched_getparam] = {(syscall_fn_t)sys_sched_getparam, "sched_getparam", 2},
+    [SYS_sched_get_priority_max] = {(syscall_fn_t)sys_sched_get_priority_max, "sched_get_priority_max", 1},
+    [SYS_sched_get_priority_min] = {(syscall_fn_t)sys_sched_get_priority_min, "sched_get_priority_min", 1},
+    [SYS_setpriority] = {(syscall_fn_t)sys_setpriority, "setpriority", 3},
+    [SYS_getpriority] = {(syscall_fn_t)sys_getpriority, "getpriority", 2},
 
     /* Memory operations */
     [SYS_mmap] = {(syscall_fn_t)sys_mmap, "mmap", 6},
+    [SYS_msync] = {(syscall_fn_t)sys_msync, "msync", 3},
     [SYS_brk] = {NULL, "brk", 1}, // Not implemented yet
 
     /* Time operations */
     //[SYS_time] = {(syscall_fn_t)sys_time, "time", 1},
+    [SYS_clock_gettime] = {(syscall_fn_t)sys_clock_gettime, "clock_gettime", 2},
+    [SYS_gettimeofday] = {(syscall_fn_t)sys_gettimeofday, "gettimeofday", 2},
+    [SYS_nanosleep] = {(syscall_fn_t)sys_nanosleep, "nanosleep", 2},
+    [SYS_clock_nanosleep] = {(syscall_fn_t)sys_clock_nanosleep, "clock_nanosleep", 4},
+    [SYS_getitimer] = {(syscall_fn_t)sys_getitimer, "getitimer", 2},
+    [SYS_setitimer] = {(syscall_fn_t)sys_setitimer, "setitimer", 3},
+    [SYS_times] = {(syscall_fn_t)sys_times, "times", 1},
+    [SYS_getrusage] = {(syscall_fn_t)sys_getrusage, "getrusage", 2},
+
+    [SYS_sched_stat] = {(syscall_fn_t)sys_sched_stat, "sched_stat", 3},
+    [SYS_sched_tune] = {(syscall_fn_t)sys_sched_tune, "sched_tune", 2},
+#ifdef CONFIG_LOCK_STAT
+    [SYS_lock_stat] = {(syscall_fn_t)sys_lock_stat, "lock_stat", 3},
+#endif
 
     /* Add more syscalls as needed */
 };
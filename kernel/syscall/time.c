@@ -1,3 +1,4 @@
+#include <kernel/clockevent.h>
 #include <kernel/sched.h>
 #include <kernel/vfs.h>
 #include <kernel/syscall/syscall.h>
@@ -24,3 +25,139 @@ int64 sys_time(time_t __user* tloc) {
 
     return ktime;  // 返回时间值（兼容 tloc==NULL 的场景）
 }
+
+// 用户态一般走vDSO，这里是vDSO处理不了的时钟和没有vDSO时的退路
+int64 sys_clock_gettime(clockid_t clk_id, struct timespec __user* tp) {
+    struct timespec ts;
+    int32 ret = do_clock_gettime(clk_id, &ts);
+
+    if (ret < 0) {
+        return ret;
+    }
+    if (copy_to_user(tp, &ts, sizeof(ts)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+int64 sys_gettimeofday(struct timeval __user* tv, struct timezone __user* tz) {
+    struct timeval ktv;
+
+    if (tv) {
+        do_gettimeofday(&ktv);
+        if (copy_to_user(tv, &ktv, sizeof(ktv)) != 0) {
+            return -EFAULT;
+        }
+    }
+    // 没有时区，一律UTC
+    if (tz) {
+        struct timezone ktz = {0, 0};
+        if (copy_to_user(tz, &ktz, sizeof(ktz)) != 0) {
+            return -EFAULT;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 睡到which_clock上的某个时刻，定时器是睡眠者栈上的hrtimer。
+ * 被信号打断时返回-EINTR，相对的睡眠把没睡完的时间写回rem
+ */
+int64 sys_clock_nanosleep(clockid_t which_clock, int32 flags, const struct timespec __user* req,
+                          struct timespec __user* rem) {
+    struct task_struct* cur = current_task();
+    struct timespec ts;
+    uint64 expires, now;
+
+    switch (which_clock) {
+    case CLOCK_REALTIME:
+    case CLOCK_MONOTONIC:
+    case CLOCK_BOOTTIME:
+        break;
+    default:
+        return -EINVAL;
+    }
+    if (copy_from_user(&ts, req, sizeof(ts)) != 0) {
+        return -EFAULT;
+    }
+    if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= NSEC_PER_SEC) {
+        return -EINVAL;
+    }
+
+    // 远到换算会溢出的时刻当作永远
+    if (ts.tv_sec >= TIME_T_MAX / NSEC_PER_SEC) {
+        expires = CLOCKEVENT_NONE;
+    } else if (flags & TIMER_ABSTIME) {
+        expires = clock_to_ticks(which_clock, timespec_to_ns(&ts));
+    } else {
+        expires = read_time() + ns_to_ticks(timespec_to_ns(&ts));
+    }
+
+    // 没有信号却提前醒了就接着睡
+    for (;;) {
+        cur->state = TASK_INTERRUPTIBLE;
+        if (signal_pending(cur)) {
+            cur->state = TASK_RUNNING;
+            break;
+        }
+        if (schedule_hrtimeout(expires) == 0) {
+            return 0;
+        }
+    }
+
+    if (!(flags & TIMER_ABSTIME) && rem) {
+        now = read_time();
+        ts.tv_sec = 0;
+        ts.tv_nsec = 0;
+        if (expires > now) {
+            uint64 ns = ticks_to_ns(expires - now);
+            ts.tv_sec = ns / NSEC_PER_SEC;
+            ts.tv_nsec = ns % NSEC_PER_SEC;
+        }
+        if (copy_to_user(rem, &ts, sizeof(ts)) != 0) {
+            return -EFAULT;
+        }
+    }
+    return -EINTR;
+}
+
+int64 sys_nanosleep(const struct timespec __user* req, struct timespec __user* rem) {
+    return sys_clock_nanosleep(CLOCK_MONOTONIC, 0, req, rem);
+}
+
+int64 sys_getitimer(int32 which, struct itimerval __user* value) {
+    struct itimerval kval;
+    int32 ret = do_getitimer(which, &kval);
+
+    if (ret < 0) {
+        return ret;
+    }
+    if (copy_to_user(value, &kval, sizeof(kval)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+// value为NULL时和全零一样，停掉定时器
+int64 sys_setitimer(int32 which, const struct itimerval __user* value, struct itimerval __user* ovalue) {
+    struct itimerval kval, kold;
+    int32 ret;
+
+    memset(&kval, 0, sizeof(kval));
+    if (value && copy_from_user(&kval, value, sizeof(kval)) != 0) {
+        return -EFAULT;
+    }
+    if (kval.it_value.tv_sec < 0 || kval.it_value.tv_usec < 0 || kval.it_value.tv_usec >= USEC_PER_SEC ||
+        kval.it_interval.tv_sec < 0 || kval.it_interval.tv_usec < 0 || kval.it_interval.tv_usec >= USEC_PER_SEC) {
+        return -EINVAL;
+    }
+
+    ret = do_setitimer(which, &kval, ovalue ? &kold : NULL);
+    if (ret < 0) {
+        return ret;
+    }
+    if (ovalue && copy_to_user(ovalue, &kold, sizeof(kold)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
@@ -46,10 +46,16 @@ ssize_t file_write(struct file *filp, const char *buf, size_t count, loff_t *ppo
 	if (!(filp->f_mode & FMODE_WRITE))
 		return -EBADF;
 
-	// If the file has a write method, call it
-	if (filp->f_op->write)
+	// If the file has a write method, call it. Regular files are written
+	// under i_rwsem so that concurrent writers do not interleave.
+	if (filp->f_op->write) {
+		struct inode *inode = filp->f_inode;
+		int32 locked = inode && S_ISREG(inode->i_mode);
+
+		if (locked) inode_lock(inode);
 		ret = filp->f_op->write(filp, buf, count, ppos);
-	else {
+		if (locked) inode_unlock(inode);
+	} else {
 		ret = -EINVAL;
 	}
 
@@ -1,10 +1,32 @@
 #include <kernel/time.h>
+#include <kernel/boot/dtb.h>
 #include <kernel/fs/vfs/superblock.h>
+#include <kernel/clockevent.h>
+#include <kernel/riscv.h>
+#include <kernel/util/atomic.h>
+#include <kernel/util/spinlock.h>
+#include <kernel/vdso.h>
+
+/*
+ * 计时核心：所有时钟都由time CSR换算而来。
+ *
+ * CLOCK_MONOTONIC是time CSR从上电起的计数换成纳秒，和futex、睡眠超时
+ * 用的是同一个时间轴；没有挂起，CLOCK_BOOTTIME与它相同；CLOCK_REALTIME
+ * 再加上一个墙上时间偏移。
+ *
+ * 状态放在vDSO的数据页里，用seqcount发布，内核和用户态按同一个公式读：
+ * 上次更新时刻的纳秒数精确算出，之后的增量用mult/shift乘法换算。增量
+ * 乘上mult不能溢出，所以boot hart每秒更新一次。
+ */
 
-/* System time variables */
-static struct timespec system_time;
 uint64 jiffies;
 
+/* time CSR的频率，设备树里有timebase-frequency时用它 */
+uint64 timebase_freq = TIMEBASE_FREQ;
+
+static spinlock_t timekeeper_lock = SPINLOCK_INIT;
+static uint64 timekeeping_interval;
+
 /**
  * current_time - Get current system time
  * @sb: Superblock (optional, can be NULL)
@@ -77,6 +99,86 @@ struct timespec current_fs_time(struct superblock *sb)
     return timespec_trunc(now, granularity);
 }
 
+/**
+ * timekeeping_read_ns - Read a clock as nanoseconds
+ * @which_clock: CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME
+ *
+ * Same algorithm as __vdso_clock_gettime() in kernel/arch/riscv/vdso.S,
+ * so the syscall and the vDSO never disagree.
+ */
+static uint64 timekeeping_read_ns(clockid_t which_clock)
+{
+    struct vdso_data *vd = vdso_data;
+    uint64 now, ns;
+    int64 wall;
+    uint32 seq;
+
+    do {
+        while ((seq = READ_ONCE(vd->seq)) & 1)
+            cpu_relax();
+        smp_rmb();
+        now = read_time();
+        ns = vd->mono_ns + (((now - vd->cycle_last) * vd->mult) >> vd->shift);
+        wall = vd->wall_offset;
+        smp_rmb();
+    } while (READ_ONCE(vd->seq) != seq);
+
+    return which_clock == CLOCK_REALTIME ? ns + wall : ns;
+}
+
+/*
+ * 在boot hart上把cycle_last推进到now。seq为奇数期间读者会重读
+ */
+static void timekeeping_update(uint64 now)
+{
+    struct vdso_data *vd = vdso_data;
+    int64 flags;
+
+    flags = spinlock_lock_irqsave(&timekeeper_lock);
+    WRITE_ONCE(vd->seq, vd->seq + 1);
+    smp_wmb();
+    vd->cycle_last = now;
+    vd->mono_ns = ticks_to_ns(now);
+    smp_wmb();
+    WRITE_ONCE(vd->seq, vd->seq + 1);
+    spinlock_unlock_irqrestore(&timekeeper_lock, flags);
+}
+
+static uint64 timekeeping_next_deadline(void)
+{
+    extern int32 boot_hartid;
+
+    if (read_tp() != boot_hartid)
+        return CLOCKEVENT_NONE;
+    return vdso_data->cycle_last + timekeeping_interval;
+}
+
+static void timekeeping_expire(uint64 now)
+{
+    timekeeping_update(now);
+}
+
+static struct clock_event_source timekeeping_source = {
+    .name = "timekeeping",
+    .next_deadline = timekeeping_next_deadline,
+    .expire = timekeeping_expire,
+};
+
+/**
+ * clock_to_ticks - Convert a time on a clock to a time CSR value
+ * @which_clock: CLOCK_REALTIME, CLOCK_MONOTONIC or CLOCK_BOOTTIME
+ * @ns: Nanoseconds on that clock
+ *
+ * CLOCK_REALTIME is taken against the current wall offset. Returns 0 for
+ * times before boot, which have already passed.
+ */
+uint64 clock_to_ticks(clockid_t which_clock, int64 ns)
+{
+    if (which_clock == CLOCK_REALTIME)
+        ns -= READ_ONCE(vdso_data->wall_offset);
+    return ns > 0 ? ns_to_ticks(ns) : 0;
+}
+
 /**
  * do_gettimeofday - Get current time
  * @tv: Timeval to fill with current time
@@ -90,9 +192,7 @@ int32 do_gettimeofday(struct timeval *tv)
     if (!tv)
         return -EINVAL;
     
-    /* In a real system, we would read the hardware clock */
-    /* For now, just return the stored system time */
-    ts = system_time;
+    do_clock_gettime(CLOCK_REALTIME, &ts);
     
     /* Convert to timeval */
     timespec_to_timeval(tv, &ts);
@@ -109,57 +209,83 @@ int32 do_gettimeofday(struct timeval *tv)
  */
 int32 do_clock_gettime(clockid_t which_clock, struct timespec *tp)
 {
+    uint64 ns;
+
     if (!tp)
         return -EINVAL;
     
     switch (which_clock) {
     case CLOCK_REALTIME:
-        /* Copy the current system time */
-        *tp = system_time;
-        break;
     case CLOCK_MONOTONIC:
     case CLOCK_BOOTTIME:
-        /* In a real system, these would be different */
-        /* For now, just use system time */
-        *tp = system_time;
+        ns = timekeeping_read_ns(which_clock);
         break;
     default:
         return -EINVAL;
     }
     
+    tp->tv_sec = ns / NSEC_PER_SEC;
+    tp->tv_nsec = ns % NSEC_PER_SEC;
     return 0;
 }
 
 /**
  * time_init - Initialize the time subsystem
+ *
+ * Picks up the time CSR frequency from the device tree, chooses the
+ * mult/shift pair and starts the once-a-second update on the boot hart.
  */
 void time_init(void)
 {
-    /* Initialize system time to Unix epoch (1970-01-01) */
-    system_time.tv_sec = 0;
-    system_time.tv_nsec = 0;
-    
+    struct vdso_data *vd = vdso_data;
+    uint64 mult;
+    uint32 shift;
+
+    if (timebaseFreq)
+        timebase_freq = timebaseFreq;
+
+    /* 精度尽量高，mult仍要放得进32位 */
+    for (shift = 32; shift > 0; shift--) {
+        mult = (NSEC_PER_SEC << shift) / timebase_freq;
+        if (mult <= 0xffffffffUL)
+            break;
+    }
+    vd->mult = mult;
+    vd->shift = shift;
+
+    /* 增量乘mult不溢出的最长间隔的一半，最多一秒 */
+    timekeeping_interval = MIN(timebase_freq, ~0UL / mult / 2);
+
+    timekeeping_update(read_time());
+
     /* Read initial time from hardware clock */
     update_sys_time_from_hw();
-    
+
     /* Initialize system jiffies */
     jiffies = 0;
+
+    clockevent_register_source(&timekeeping_source);
 }
 
 /**
  * update_sys_time_from_hw - Update system time from hardware
  *
- * Reads the hardware clock and updates the system time.
+ * Sets the offset of CLOCK_REALTIME from CLOCK_MONOTONIC.
  * In a real system, this would interact with an RTC.
  */
 void update_sys_time_from_hw(void)
 {
-    /* In a real system, we would read from the RTC */
-    /* For a simplistic simulation, set time to a recent date */
-    
-    /* Set to January 1, 2023 00:00:00 UTC */
-    system_time.tv_sec = 1672531200;
-    system_time.tv_nsec = 0;
+    struct vdso_data *vd = vdso_data;
+    int64 flags;
+
+    /* 没有RTC，把开机时刻当作January 1, 2023 00:00:00 UTC */
+    flags = spinlock_lock_irqsave(&timekeeper_lock);
+    WRITE_ONCE(vd->seq, vd->seq + 1);
+    smp_wmb();
+    vd->wall_offset = 1672531200L * NSEC_PER_SEC - vd->mono_ns;
+    smp_wmb();
+    WRITE_ONCE(vd->seq, vd->seq + 1);
+    spinlock_unlock_irqrestore(&timekeeper_lock, flags);
 }
 
 // ...existing code...
@@ -173,7 +299,7 @@ void update_sys_time_from_hw(void)
  */
 time_t do_time(time_t *timer)
 {
-    time_t current = system_time.tv_sec;
+    time_t current = timekeeping_read_ns(CLOCK_REALTIME) / NSEC_PER_SEC;
     
     /* Store the result in timer if it's not NULL */
     if (timer)
@@ -233,3 +359,41 @@ static inline void timespec_to_timeval(struct timeval *tv, const struct timespec
     tv->tv_sec = ts->tv_sec;
     tv->tv_usec = ts->tv_nsec / NSEC_PER_USEC;
 }
+
+/* time CSR ticks between two timer interrupts */
+uint64 timer_interval = TIMER_INTERVAL;
+
+/* 间隔太小时中断处理本身就会占满CPU，这里限制为不低于100us */
+#define TIMER_INTERVAL_MIN (timebase_freq / 10000)
+/* 也不超过1秒，jiffies和时间片都按它计 */
+#define TIMER_INTERVAL_MAX (timebase_freq)
+
+/**
+ * timerinit - Start the timer on this hart
+ * @hartid: The calling hart
+ *
+ * Lets user mode read the time CSR directly and hands the SBI timer to
+ * the clock event layer, which arms the first tick.
+ */
+void timerinit(uint64 hartid)
+{
+    write_csr(scounteren, read_csr(scounteren) | SCOUNTEREN_TM);
+    write_csr(sie, read_csr(sie) | SIE_STIE);
+    clockevent_init(hartid);
+}
+
+/**
+ * timer_set_interval - Change the timer interrupt interval
+ * @ticks: New interval in time CSR ticks
+ *
+ * Takes effect from the next tick on.
+ *
+ * Returns: 0 on success, -EINVAL if the interval is out of range
+ */
+int32 timer_set_interval(uint64 ticks)
+{
+    if (ticks < TIMER_INTERVAL_MIN || ticks > TIMER_INTERVAL_MAX)
+        return -EINVAL;
+    timer_interval = ticks;
+    return 0;
+}
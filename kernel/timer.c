@@ -0,0 +1,347 @@
+/*
+ * timer.c - 分层时间轮
+ *
+ * 每个hart一个轮，LVL_DEPTH层，每层64个桶，第n层一个桶是8^n个jiffy。
+ * 定时器按离到期还有多远选层，落进能放下它的最细的一层，到期时刻向上
+ * 取整到这一层的粒度。定时器放进去以后不再搬动（不做级联）：离得远的
+ * 本来就不需要很准，换来加入、删除都是O(1)。
+ *
+ * 每层有一个64位的pending_map，桶非空时对应的位置1，找下一次到期只要
+ * 逐层做一次ctz。
+ *
+ * 作为"timer"定时源接到时钟事件层，截止时刻落在tick网格上。回调在定时器
+ * 中断里、放开轮的锁后调用。
+ *
+ * 加定时器后重新编程时已经放开了timer_base->lock，时钟事件层遍历定时源
+ * 不拿锁，这里没有跨层的锁顺序。
+ */
+
+#include <kernel/clockevent.h>
+#include <kernel/sched.h>
+#include <kernel/time.h>
+#include <kernel/timer.h>
+#include <kernel/util.h>
+
+#define LVL_CLK_SHIFT 3
+#define LVL_CLK_DIV (1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK (LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n) ((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n) (1UL << LVL_SHIFT(n))
+
+#define LVL_BITS 6
+#define LVL_SIZE (1UL << LVL_BITS)
+#define LVL_MASK (LVL_SIZE - 1)
+#define LVL_OFFS(n) ((n) * LVL_SIZE)
+
+// 离到期至少这么远的定时器放在第n层
+#define LVL_START(n) ((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+// 100Hz时8层能放下约15天以内到期的定时器，更远的按最远的算
+#define LVL_DEPTH 8
+#define WHEEL_SIZE (LVL_SIZE * LVL_DEPTH)
+#define WHEEL_TIMEOUT_CUTOFF LVL_START(LVL_DEPTH)
+#define WHEEL_TIMEOUT_MAX (WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+
+#define NEXT_TIMER_MAX_DELTA ((1UL << 30) - 1)
+
+struct timer_base {
+	spinlock_t lock;
+	struct timer_list* running_timer; // 正在执行回调的定时器
+	uint64 clk;                       // 轮走到的jiffy
+	uint64 next_expiry;               // 最早的非空桶的到期时刻
+	int32 next_expiry_recalc;         // 删过定时器，next_expiry可能偏早
+	int32 timers_pending;             // 轮上有定时器
+	uint64 pending_map[LVL_DEPTH];
+	struct list_head vectors[WHEEL_SIZE];
+};
+
+static DEFINE_PER_CPU(struct timer_base, timer_bases);
+
+// 向上取整到第lvl层的粒度，保证不会提前到期
+static inline uint32 calc_index(uint64 expires, uint32 lvl, uint64* bucket_expiry) {
+	expires = (expires >> LVL_SHIFT(lvl)) + 1;
+	*bucket_expiry = expires << LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+static uint32 calc_wheel_index(uint64 expires, uint64 clk, uint64* bucket_expiry) {
+	uint64 delta = expires - clk;
+	uint32 lvl;
+
+	// 已经过期的放进当前的桶，下一次处理
+	if ((int64)delta < 0) {
+		*bucket_expiry = clk;
+		return clk & LVL_MASK;
+	}
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) expires = clk + WHEEL_TIMEOUT_MAX;
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++)
+		if (delta < LVL_START(lvl + 1)) break;
+	return calc_index(expires, lvl, bucket_expiry);
+}
+
+// 返回1表示轮上最早的到期时刻提前了
+static int32 enqueue_timer(struct timer_base* base, struct timer_list* timer) {
+	uint64 bucket_expiry;
+	uint32 idx = calc_wheel_index(timer->expires, base->clk, &bucket_expiry);
+
+	list_add_tail(&timer->entry, &base->vectors[idx]);
+	base->pending_map[idx / LVL_SIZE] |= 1UL << (idx % LVL_SIZE);
+	timer->idx = idx;
+	base->timers_pending = 1;
+	if (bucket_expiry < base->next_expiry) {
+		base->next_expiry = bucket_expiry;
+		return 1;
+	}
+	return 0;
+}
+
+static int32 detach_if_pending(struct timer_list* timer, struct timer_base* base) {
+	struct list_head* bucket = &base->vectors[timer->idx];
+	uint32 idx = timer->idx;
+
+	if (!timer_pending(timer)) return 0;
+	// 桶里只剩它一个，摘掉后桶就空了；已经被摘到到期链表上的不算
+	if (timer->entry.next == bucket && timer->entry.prev == bucket) {
+		base->pending_map[idx / LVL_SIZE] &= ~(1UL << (idx % LVL_SIZE));
+		base->next_expiry_recalc = 1;
+	}
+	list_del_init(&timer->entry);
+	return 1;
+}
+
+// 从第clk个桶（含）往后找最近的非空桶，返回隔了几个桶；没有返回-1
+static int32 next_pending_bucket(uint64 map, uint32 clk) {
+	if (!map) return -1;
+	if (clk) map = (map >> clk) | (map << (LVL_SIZE - clk));
+	return __builtin_ctzl(map);
+}
+
+static uint64 __next_timer_interrupt(struct timer_base* base) {
+	uint64 clk = base->clk, next = base->clk + NEXT_TIMER_MAX_DELTA;
+	int32 pending = 0;
+
+	for (uint32 lvl = 0; lvl < LVL_DEPTH; lvl++) {
+		int32 pos = next_pending_bucket(base->pending_map[lvl], clk & LVL_MASK);
+		uint64 lvl_clk = clk & LVL_CLK_MASK;
+
+		if (pos >= 0) {
+			uint64 tmp = (clk + pos) << LVL_SHIFT(lvl);
+			pending = 1;
+			if (tmp < next) next = tmp;
+			// 在上一层的下一个桶之前就到期，上面各层不会更早
+			if (pos <= (int32)((LVL_CLK_DIV - lvl_clk) & LVL_CLK_MASK)) break;
+		}
+		// 上一层的桶从下一个开始算，除非这一层正好对齐
+		clk >>= LVL_CLK_SHIFT;
+		clk += lvl_clk ? 1 : 0;
+	}
+	base->next_expiry_recalc = 0;
+	base->timers_pending = pending;
+	return next;
+}
+
+// 空闲时clk停着不走，加定时器前先追上来，免得按过时的clk选到太粗的层
+static void forward_timer_base(struct timer_base* base) {
+	uint64 jnow = READ_ONCE(jiffies);
+
+	if (jnow <= base->clk) return;
+	if (base->next_expiry_recalc) base->next_expiry = __next_timer_interrupt(base);
+	base->clk = MIN(jnow, base->next_expiry);
+}
+
+/*
+ * 定时器所在的轮随时可能换（mod_timer()把它挪到本hart），拿到锁后
+ * flags没变才算锁对了。返回时关着中断。
+ */
+static struct timer_base* lock_timer_base(struct timer_list* timer, int64* flags) {
+	for (;;) {
+		uint32 tf = READ_ONCE(timer->flags);
+
+		if (!(tf & TIMER_MIGRATING)) {
+			struct timer_base* base = per_cpu_ptr(&timer_bases, tf & TIMER_CPUMASK);
+			*flags = spinlock_lock_irqsave(&base->lock);
+			if (READ_ONCE(timer->flags) == tf) return base;
+			spinlock_unlock_irqrestore(&base->lock, *flags);
+		}
+		cpu_relax();
+	}
+}
+
+/**
+ * mod_timer - Modify a timer's timeout
+ * @timer: The timer
+ * @expires: New timeout in jiffies
+ *
+ * Activates the timer if it was inactive, and moves it to the calling
+ * hart's wheel unless its callback is running elsewhere.
+ *
+ * Returns 1 if the timer was pending, 0 otherwise.
+ */
+int32 mod_timer(struct timer_list* timer, uint64 expires) {
+	struct timer_base *base, *new_base;
+	int32 ret, earlier;
+	int64 flags;
+
+	base = lock_timer_base(timer, &flags);
+	ret = detach_if_pending(timer, base);
+
+	new_base = this_cpu_ptr(&timer_bases);
+	// 回调还在跑的定时器留在原来的轮上，del_timer_sync()靠running_timer等它
+	if (base != new_base && base->running_timer != timer) {
+		WRITE_ONCE(timer->flags, timer->flags | TIMER_MIGRATING);
+		spinlock_unlock(&base->lock);
+		base = new_base;
+		spinlock_lock(&base->lock);
+		WRITE_ONCE(timer->flags, (uint32)read_tp());
+	}
+
+	forward_timer_base(base);
+	timer->expires = expires;
+	earlier = enqueue_timer(base, timer);
+	spinlock_unlock(&base->lock);
+	// 别的hart上的轮在它下一次定时器中断后重新编程
+	if (earlier && base == new_base) clockevent_reprogram();
+	enable_irqrestore(flags);
+	return ret;
+}
+
+/**
+ * add_timer - Start a timer
+ * @timer: The timer, with ->expires and ->function set
+ */
+void add_timer(struct timer_list* timer) {
+	mod_timer(timer, timer->expires);
+}
+
+/**
+ * del_timer - Deactivate a timer
+ * @timer: The timer
+ *
+ * Does not wait for a callback that is already running.
+ *
+ * Returns 1 if the timer was pending, 0 otherwise.
+ */
+int32 del_timer(struct timer_list* timer) {
+	struct timer_base* base;
+	int32 ret;
+	int64 flags;
+
+	if (!timer_pending(timer)) return 0;
+	base = lock_timer_base(timer, &flags);
+	ret = detach_if_pending(timer, base);
+	spinlock_unlock_irqrestore(&base->lock, flags);
+	return ret;
+}
+
+/**
+ * del_timer_sync - Deactivate a timer and wait for its callback to finish
+ * @timer: The timer
+ *
+ * Must not be called from the timer's own callback, nor while holding a
+ * lock the callback takes.
+ *
+ * Returns 1 if the timer was pending, 0 otherwise.
+ */
+int32 del_timer_sync(struct timer_list* timer) {
+	struct timer_base* base;
+	int32 ret = 0;
+	int64 flags;
+
+	for (;;) {
+		base = lock_timer_base(timer, &flags);
+		ret |= detach_if_pending(timer, base);
+		if (base->running_timer != timer) break;
+		spinlock_unlock_irqrestore(&base->lock, flags);
+		cpu_relax();
+	}
+	spinlock_unlock_irqrestore(&base->lock, flags);
+	return ret;
+}
+
+// 把各层当前桶里的定时器摘到heads上，返回摘了几层
+static int32 collect_expired_timers(struct timer_base* base, struct list_head* heads) {
+	uint64 clk = base->clk;
+	int32 levels = 0;
+
+	for (uint32 lvl = 0; lvl < LVL_DEPTH; lvl++) {
+		uint64 bit = 1UL << (clk & LVL_MASK);
+
+		if (base->pending_map[lvl] & bit) {
+			base->pending_map[lvl] &= ~bit;
+			list_splice_init(&base->vectors[LVL_OFFS(lvl) + (clk & LVL_MASK)], &heads[levels++]);
+		}
+		// 上一层的桶只在这一层转完一个粒度时才轮到
+		if (clk & LVL_CLK_MASK) break;
+		clk >>= LVL_CLK_SHIFT;
+	}
+	return levels;
+}
+
+static void expire_timers(struct timer_base* base, struct list_head* head) {
+	while (!list_empty(head)) {
+		struct timer_list* timer = list_first_entry(head, struct timer_list, entry);
+		void (*fn)(struct timer_list*) = timer->function;
+
+		base->running_timer = timer;
+		list_del_init(&timer->entry);
+		spinlock_unlock(&base->lock);
+		fn(timer);
+		spinlock_lock(&base->lock);
+		base->running_timer = NULL;
+	}
+}
+
+static uint64 timer_next_deadline(void) {
+	struct timer_base* base = this_cpu_ptr(&timer_bases);
+	uint64 next = CLOCKEVENT_NONE;
+
+	spinlock_lock(&base->lock);
+	if (base->next_expiry_recalc) base->next_expiry = __next_timer_interrupt(base);
+	if (base->timers_pending) next = base->next_expiry;
+	spinlock_unlock(&base->lock);
+	return next == CLOCKEVENT_NONE ? next : jiffies_deadline(next);
+}
+
+static void timer_expire(uint64 now) {
+	struct timer_base* base = this_cpu_ptr(&timer_bases);
+	struct list_head heads[LVL_DEPTH];
+	uint64 jnow = READ_ONCE(jiffies);
+	int32 levels;
+
+	spinlock_lock(&base->lock);
+	while (base->timers_pending && jnow >= base->next_expiry) {
+		// 空闲过后clk可能落后很多，直接跳到最早的非空桶
+		base->clk = MAX(base->clk, base->next_expiry);
+		for (int32 i = 0; i < LVL_DEPTH; i++) INIT_LIST_HEAD(&heads[i]);
+		levels = collect_expired_timers(base, heads);
+		base->clk++;
+		base->next_expiry = __next_timer_interrupt(base);
+		while (levels--) expire_timers(base, &heads[levels]);
+	}
+	spinlock_unlock(&base->lock);
+}
+
+static struct clock_event_source timer_source = {
+    .name = "timer",
+    .next_deadline = timer_next_deadline,
+    .expire = timer_expire,
+};
+
+/**
+ * timers_init - Set up the per-hart timer wheels
+ */
+void timers_init(void) {
+	for_each_possible_cpu(cpu) {
+		struct timer_base* base = per_cpu_ptr(&timer_bases, cpu);
+
+		spinlock_init(&base->lock);
+		base->running_timer = NULL;
+		base->clk = jiffies;
+		base->next_expiry = base->clk + NEXT_TIMER_MAX_DELTA;
+		base->next_expiry_recalc = 0;
+		base->timers_pending = 0;
+		for (int32 i = 0; i < LVL_DEPTH; i++) base->pending_map[i] = 0;
+		for (int32 i = 0; i < WHEEL_SIZE; i++) INIT_LIST_HEAD(&base->vectors[i]);
+	}
+	clockevent_register_source(&timer_source);
+}
@@ -3,8 +3,18 @@
 #include <kernel/util/hashtable.h>
 #include <kernel/util/string.h>
 
+static inline void hash_bucket_init(struct hashtable* ht, struct hash_bucket* bucket) {
+	INIT_LIST_HEAD(&bucket->head);
+	rwlock_init(&bucket->lock);
+#ifdef CONFIG_LOCK_STAT
+	bucket->lock.lock_class = ht->lock_class;
+#endif
+}
+
 /**
  * 初始化预先静态分配的哈希表
+ *
+ * 要统计桶锁的竞争，在调用之前用lock_set_class(ht, name)给表设置锁类
  */
 int32 hashtable_setup(struct hashtable* ht, uint32 initial_size, uint32 max_load, uint32 (*hash_func)(const void* key), void* (*get_key)(struct list_head* node),
                    int32 (*key_equals)(const void* key1, const void* key2)) {
@@ -28,10 +38,7 @@ int32 hashtable_setup(struct hashtable* ht, uint32 initial_size, uint32 max_load
 
 	check_address_mapping(g_kernel_pagetable, (vaddr_t)ht->buckets);
 	/* 初始化每个桶的链表头 */
-	for (i = 0; i < initial_size; i++) {
-		INIT_LIST_HEAD(&ht->buckets[i].head);
-		spinlock_init(&ht->buckets[i].lock);
-	}
+	for (i = 0; i < initial_size; i++) hash_bucket_init(ht, &ht->buckets[i]);
 
 	/* 初始化表参数 */
 	ht->size = initial_size;
@@ -76,10 +83,7 @@ static int32 hashtable_try_expand(struct hashtable* ht) {
 		}
 
 		/* 初始化新桶 */
-		for (uint32 i = 0; i < new_size; i++) {
-			INIT_LIST_HEAD(&new_buckets[i].head);
-			spinlock_init(&new_buckets[i].lock);
-		}
+		for (uint32 i = 0; i < new_size; i++) hash_bucket_init(ht, &new_buckets[i]);
 
 		transfer_index = 0;
 		expansion_in_progress = 1;
@@ -96,7 +100,7 @@ static int32 hashtable_try_expand(struct hashtable* ht) {
 		struct list_head *node, *tmp;
 
 		/* 锁定当前桶 */
-		spinlock_lock(&old_bucket->lock);
+		write_lock(&old_bucket->lock);
 
 		list_for_each_safe(node, tmp, &old_bucket->head) {
 			void* key = ht->get_key(node);
@@ -126,12 +130,12 @@ static int32 hashtable_try_expand(struct hashtable* ht) {
 			list_del(node);
 
 			/* 锁定目标桶并添加节点 */
-			spinlock_lock(&new_buckets[new_idx].lock);
+			write_lock(&new_buckets[new_idx].lock);
 			list_add(node, &new_buckets[new_idx].head);
-			spinlock_unlock(&new_buckets[new_idx].lock);
+			write_unlock(&new_buckets[new_idx].lock);
 		}
 
-		spinlock_unlock(&old_bucket->lock);
+		write_unlock(&old_bucket->lock);
 	}
 
 	transfer_index = end_index;
@@ -183,13 +187,13 @@ int32 hashtable_insert(struct hashtable* ht, struct list_head* node) {
 		/* 重新计算索引，因为大小已经改变 */
 		idx = hash & (ht->size - 1);
 	}
-	spinlock_lock(&ht->buckets[idx].lock);
+	write_lock(&ht->buckets[idx].lock);
 	/* 检查键是否已存在 */
 	list_for_each(pos, &ht->buckets[idx].head) {
 		void* existing_key = ht->get_key(pos);
 		if (ht->key_equals(existing_key, key)) {
 			/* 键已存在，这里我们不替换，只返回错误 */
-			spinlock_unlock(&ht->buckets[idx].lock);
+			write_unlock(&ht->buckets[idx].lock);
 			return -EEXIST;
 		}
 	}
@@ -198,7 +202,7 @@ int32 hashtable_insert(struct hashtable* ht, struct list_head* node) {
 	list_add(node, &ht->buckets[idx].head);
 	atomic_inc(&ht->items);
 
-	spinlock_unlock(&ht->buckets[idx].lock);
+	write_unlock(&ht->buckets[idx].lock);
 	return 0;
 }
 
@@ -217,7 +221,7 @@ struct list_head* hashtable_lookup(struct hashtable* ht, const void* key) {
 	hash = ht->hash_func(key);
 	idx = hash & (ht->size - 1);
 
-	spinlock_lock(&ht->buckets[idx].lock);
+	read_lock(&ht->buckets[idx].lock);
 
 	/* 在链表中查找 */
 	list_for_each(pos, &ht->buckets[idx].head) {
@@ -228,7 +232,7 @@ struct list_head* hashtable_lookup(struct hashtable* ht, const void* key) {
 		}
 	}
 
-	spinlock_unlock(&ht->buckets[idx].lock);
+	read_unlock(&ht->buckets[idx].lock);
 	return result;
 }
 
@@ -245,17 +249,17 @@ int32 hashtable_remove(struct hashtable* ht, struct list_head* node) {
 	/* 计算哈希值和索引 */
 	uint32 hash = ht->hash_func(key);
 	uint32 idx = hash & (ht->size - 1);
-	spinlock_lock(&ht->buckets[idx].lock);
+	write_lock(&ht->buckets[idx].lock);
 
 	/* 检查节点是否在链表中(通过检查是否被正确链接) */
 	if (!list_empty(node)) {
 		list_del_init(node);
 		atomic_dec(&ht->items);
-		spinlock_unlock(&ht->buckets[idx].lock);
+		write_unlock(&ht->buckets[idx].lock);
 		return 0;
 	}
 
-	spinlock_unlock(&ht->buckets[idx].lock);
+	write_unlock(&ht->buckets[idx].lock);
 	return -ENOENT; /* 节点不在哈希表中 */
 }
 
@@ -274,7 +278,7 @@ int32 hashtable_remove_by_key(struct hashtable* ht, const void* key) {
 	hash = ht->hash_func(key);
 	idx = hash & (ht->size - 1);
 
-	spinlock_lock(&ht->buckets[idx].lock);
+	write_lock(&ht->buckets[idx].lock);
 
 	/* 在链表中查找并删除 */
 	list_for_each_safe(pos, tmp, &ht->buckets[idx].head) {
@@ -282,12 +286,12 @@ int32 hashtable_remove_by_key(struct hashtable* ht, const void* key) {
 		if (ht->key_equals(node_key, key)) {
 			list_del_init(pos);
 			atomic_dec(&ht->items);
-			spinlock_unlock(&ht->buckets[idx].lock);
+			write_unlock(&ht->buckets[idx].lock);
 			return 0;
 		}
 	}
 
-	spinlock_unlock(&ht->buckets[idx].lock);
+	write_unlock(&ht->buckets[idx].lock);
 
 	return -ENOENT;
 }
@@ -0,0 +1,111 @@
+/*
+ * lock_stat.c - 锁类注册和竞争统计的汇总
+ *
+ * 锁类放在一个静态数组里，kmalloc还不能用的时候就可以注册。注册只在
+ * 初始化时发生，数量很少，按名字线性查找即可。计数在per-cpu的
+ * lock_class_stats里，setup_per_cpu_areas()之前记在模板上。
+ */
+
+#include <kernel/config.h>
+
+#ifdef CONFIG_LOCK_STAT
+
+#include <kernel/sched/mutex.h>
+#include <kernel/util.h>
+#include <kernel/util/lock_stat.h>
+#include <kernel/util/string.h>
+
+static struct lock_class lock_classes[LOCK_CLASS_MAX];
+DEFINE_PER_CPU(struct lock_class_stats, lock_class_stats[LOCK_CLASS_MAX]);
+static int32 nr_lock_classes;
+// 只保护注册；它自己不属于任何锁类
+static spinlock_t lock_class_lock = SPINLOCK_INIT;
+
+/**
+ * lock_class_register - Look up a lock class by name, creating it if needed
+ * @name: Class name shown in the statistics
+ *
+ * Returns NULL when the table is full; locks in a NULL class are simply not
+ * counted.
+ */
+struct lock_class* lock_class_register(const char* name) {
+	struct lock_class* cls = NULL;
+
+	spinlock_lock(&lock_class_lock);
+	for (int32 i = 0; i < nr_lock_classes; i++) {
+		if (!strncmp(lock_classes[i].name, name, LOCK_CLASS_NAME_LEN - 1)) {
+			cls = &lock_classes[i];
+			goto out;
+		}
+	}
+	if (nr_lock_classes < LOCK_CLASS_MAX) {
+		cls = &lock_classes[nr_lock_classes];
+		cls->id = nr_lock_classes++;
+		strncpy(cls->name, name, LOCK_CLASS_NAME_LEN - 1);
+	}
+out:
+	spinlock_unlock(&lock_class_lock);
+	return cls;
+}
+
+void lock_stat_reset(void) {
+	for_each_possible_cpu(cpu) memset(per_cpu_ptr(&lock_class_stats, cpu), 0, sizeof(lock_class_stats));
+}
+
+/**
+ * lock_stat_percpu_init - Keep the boot-time counts on the boot hart only
+ *
+ * Called right after setup_per_cpu_areas(). Locks taken before it were
+ * counted in the template, which has just been copied to every hart.
+ */
+void lock_stat_percpu_init(void) {
+	for_each_possible_cpu(cpu)
+		if (cpu != read_tp()) memset(per_cpu_ptr(&lock_class_stats, cpu), 0, sizeof(lock_class_stats));
+}
+
+/**
+ * lock_stat_dump - Format the per-class totals as text
+ * @buf: Output buffer
+ * @len: Size of @buf
+ *
+ * The per-hart counters are summed, maxima are the maximum over all harts.
+ * Times are in time CSR ticks (TIMEBASE_FREQ per second). Returns the
+ * number of bytes written, without the terminating NUL.
+ */
+int64 lock_stat_dump(char* buf, size_t len) {
+	int64 n;
+
+	n = snprintf(buf, len, "%-20s %10s %10s %12s %10s %12s %10s\n", "class", "acquired", "contended", "wait-total",
+	             "wait-max", "hold-total", "hold-max");
+	for (int32 i = 0; i < nr_lock_classes && n < len; i++) {
+		struct lock_class_stats sum = {0};
+
+		for_each_possible_cpu(cpu) {
+			struct lock_class_stats* st = per_cpu_ptr(&lock_class_stats[i], cpu);
+			sum.acquisitions += st->acquisitions;
+			sum.contended += st->contended;
+			sum.wait_total += st->wait_total;
+			sum.hold_total += st->hold_total;
+			if (st->wait_max > sum.wait_max) sum.wait_max = st->wait_max;
+			if (st->hold_max > sum.hold_max) sum.hold_max = st->hold_max;
+		}
+		n += snprintf(buf + n, len - n, "%-20s %10ld %10ld %12ld %10ld %12ld %10ld\n", lock_classes[i].name,
+		              sum.acquisitions, sum.contended, sum.wait_total, sum.wait_max, sum.hold_total, sum.hold_max);
+	}
+	return n < len ? n : len - 1;
+}
+
+/**
+ * lock_stat_init - Put the global locks without an init function into classes
+ *
+ * Locks that do have one are classed right where they are initialised.
+ */
+void lock_stat_init(void) {
+	extern spinlock_t pr_lock;
+	extern struct mutex ext4_mutex;
+
+	lock_set_class(&pr_lock, "pr_lock");
+	lock_set_class(&ext4_mutex, "ext4_mutex");
+}
+
+#endif
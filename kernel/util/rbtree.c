@@ -0,0 +1,261 @@
+#include <kernel/util/rbtree.h>
+
+/*
+ * Red-black tree rebalancing, after CLRS chapter 13.
+ *
+ * Invariants: the root is black, a red node has no red child, and every
+ * path from a node down to a NULL leaf passes the same number of black
+ * nodes. NULL leaves count as black.
+ */
+
+static inline int32 rb_is_black(struct rb_node *node) {
+    return !node || node->rb_color == RB_COLOR_BLACK;
+}
+
+static inline int32 rb_is_red(struct rb_node *node) {
+    return node && node->rb_color == RB_COLOR_RED;
+}
+
+/* Make @new take @old's place under @old's parent */
+static void rb_replace_child(struct rb_node *old, struct rb_node *new,
+                             struct rb_node *parent, struct rb_root *root) {
+    if (!parent)
+        root->rb_node = new;
+    else if (parent->rb_left == old)
+        parent->rb_left = new;
+    else
+        parent->rb_right = new;
+}
+
+/*
+ *     x              y
+ *    / \            / \
+ *   a   y    =>    x   c
+ *      / \        / \
+ *     b   c      a   b
+ */
+static void rb_rotate_left(struct rb_node *x, struct rb_root *root) {
+    struct rb_node *y = x->rb_right;
+
+    x->rb_right = y->rb_left;
+    if (y->rb_left) y->rb_left->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    rb_replace_child(x, y, x->rb_parent, root);
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void rb_rotate_right(struct rb_node *x, struct rb_root *root) {
+    struct rb_node *y = x->rb_left;
+
+    x->rb_left = y->rb_right;
+    if (y->rb_right) y->rb_right->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    rb_replace_child(x, y, x->rb_parent, root);
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+/**
+ * rb_insert_color - Rebalance after rb_link_node() put a red node in
+ * @node: The node just linked
+ * @root: Its tree
+ */
+void rb_insert_color(struct rb_node *node, struct rb_root *root) {
+    struct rb_node *parent, *gparent, *uncle;
+
+    while ((parent = node->rb_parent) && parent->rb_color == RB_COLOR_RED) {
+        // 父节点是红色，所以不是根，祖父节点一定存在
+        gparent = parent->rb_parent;
+        if (parent == gparent->rb_left) {
+            uncle = gparent->rb_right;
+            if (rb_is_red(uncle)) {
+                // 叔节点也是红色：把红色推到祖父，继续向上
+                parent->rb_color = RB_COLOR_BLACK;
+                uncle->rb_color = RB_COLOR_BLACK;
+                gparent->rb_color = RB_COLOR_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_COLOR_BLACK;
+            gparent->rb_color = RB_COLOR_RED;
+            rb_rotate_right(gparent, root);
+        } else {
+            uncle = gparent->rb_left;
+            if (rb_is_red(uncle)) {
+                parent->rb_color = RB_COLOR_BLACK;
+                uncle->rb_color = RB_COLOR_BLACK;
+                gparent->rb_color = RB_COLOR_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_COLOR_BLACK;
+            gparent->rb_color = RB_COLOR_RED;
+            rb_rotate_left(gparent, root);
+        }
+    }
+    root->rb_node->rb_color = RB_COLOR_BLACK;
+}
+
+/*
+ * A black node was removed from under @parent on the side where @node
+ * (possibly NULL) now sits, so that side is one black short.
+ */
+static void rb_erase_color(struct rb_node *node, struct rb_node *parent,
+                           struct rb_root *root) {
+    struct rb_node *sibling;
+
+    while (node != root->rb_node && rb_is_black(node)) {
+        if (node == parent->rb_left) {
+            sibling = parent->rb_right;
+            if (rb_is_red(sibling)) {
+                sibling->rb_color = RB_COLOR_BLACK;
+                parent->rb_color = RB_COLOR_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->rb_right;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right)) {
+                sibling->rb_color = RB_COLOR_RED;
+                node = parent;
+                parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_right)) {
+                sibling->rb_left->rb_color = RB_COLOR_BLACK;
+                sibling->rb_color = RB_COLOR_RED;
+                rb_rotate_right(sibling, root);
+                sibling = parent->rb_right;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_COLOR_BLACK;
+            sibling->rb_right->rb_color = RB_COLOR_BLACK;
+            rb_rotate_left(parent, root);
+            node = root->rb_node;
+            break;
+        } else {
+            sibling = parent->rb_left;
+            if (rb_is_red(sibling)) {
+                sibling->rb_color = RB_COLOR_BLACK;
+                parent->rb_color = RB_COLOR_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->rb_left;
+            }
+            if (rb_is_black(sibling->rb_left) && rb_is_black(sibling->rb_right)) {
+                sibling->rb_color = RB_COLOR_RED;
+                node = parent;
+                parent = node->rb_parent;
+                continue;
+            }
+            if (rb_is_black(sibling->rb_left)) {
+                sibling->rb_right->rb_color = RB_COLOR_BLACK;
+                sibling->rb_color = RB_COLOR_RED;
+                rb_rotate_left(sibling, root);
+                sibling = parent->rb_left;
+            }
+            sibling->rb_color = parent->rb_color;
+            parent->rb_color = RB_COLOR_BLACK;
+            sibling->rb_left->rb_color = RB_COLOR_BLACK;
+            rb_rotate_right(parent, root);
+            node = root->rb_node;
+            break;
+        }
+    }
+    if (node) node->rb_color = RB_COLOR_BLACK;
+}
+
+/**
+ * rb_erase - Unlink a node and rebalance
+ * @node: The node, must be in @root
+ * @root: Its tree
+ *
+ * The node is left detached but not cleared; use RB_CLEAR_NODE() if callers
+ * test it with RB_EMPTY_NODE().
+ */
+void rb_erase(struct rb_node *node, struct rb_root *root) {
+    struct rb_node *child, *parent;
+    int32 color;
+
+    if (node->rb_left && node->rb_right) {
+        // 两个孩子：用后继节点顶替node的位置和颜色，实际删除的是后继原来的位置
+        struct rb_node *succ = node->rb_right;
+        while (succ->rb_left) succ = succ->rb_left;
+
+        child = succ->rb_right;
+        parent = succ->rb_parent;
+        color = succ->rb_color;
+
+        if (parent == node) {
+            parent = succ;
+        } else {
+            if (child) child->rb_parent = parent;
+            parent->rb_left = child;
+            succ->rb_right = node->rb_right;
+            node->rb_right->rb_parent = succ;
+        }
+        succ->rb_left = node->rb_left;
+        node->rb_left->rb_parent = succ;
+        succ->rb_parent = node->rb_parent;
+        succ->rb_color = node->rb_color;
+        rb_replace_child(node, succ, node->rb_parent, root);
+    } else {
+        child = node->rb_left ? node->rb_left : node->rb_right;
+        parent = node->rb_parent;
+        color = node->rb_color;
+
+        if (child) child->rb_parent = parent;
+        rb_replace_child(node, child, parent, root);
+    }
+
+    if (color == RB_COLOR_BLACK) rb_erase_color(child, parent, root);
+}
+
+struct rb_node *rb_first(const struct rb_root *root) {
+    struct rb_node *n = root->rb_node;
+
+    if (!n) return NULL;
+    while (n->rb_left) n = n->rb_left;
+    return n;
+}
+
+struct rb_node *rb_last(const struct rb_root *root) {
+    struct rb_node *n = root->rb_node;
+
+    if (!n) return NULL;
+    while (n->rb_right) n = n->rb_right;
+    return n;
+}
+
+struct rb_node *rb_next(const struct rb_node *node) {
+    struct rb_node *parent;
+
+    if (node->rb_right) {
+        node = node->rb_right;
+        while (node->rb_left) node = node->rb_left;
+        return (struct rb_node *)node;
+    }
+    // 向上找到第一个从左边上来的祖先
+    while ((parent = node->rb_parent) && node == parent->rb_right) node = parent;
+    return parent;
+}
+
+struct rb_node *rb_prev(const struct rb_node *node) {
+    struct rb_node *parent;
+
+    if (node->rb_left) {
+        node = node->rb_left;
+        while (node->rb_right) node = node->rb_right;
+        return (struct rb_node *)node;
+    }
+    while ((parent = node->rb_parent) && node == parent->rb_left) node = parent;
+    return parent;
+}
@@ -0,0 +1,46 @@
+/*
+ * vdso.c - 把vDSO的数据页和代码页映射进用户地址空间
+ *
+ * 两页都是内核镜像里的页，不属于页池：VMA带VM_IO，进程退出时
+ * vm_zap_range()只拆映射不释放页。
+ */
+
+#include <kernel/mm/mm_struct.h>
+#include <kernel/mm/vma.h>
+#include <kernel/mmu.h>
+#include <kernel/util.h>
+#include <kernel/vdso.h>
+
+// 单独占一页，映射给用户时不会带出别的内核数据
+static union {
+	struct vdso_data data;
+	uint8 page[PAGE_SIZE];
+} vdso_data_page __attribute__((aligned(PAGE_SIZE)));
+
+struct vdso_data* const vdso_data = &vdso_data_page.data;
+
+// kernel/arch/riscv/vdso.S，页对齐，不超过一页
+extern char vdso_start[], vdso_end[];
+
+/**
+ * vdso_map - Map the vDSO into a new address space
+ * @mm: The memory descriptor
+ *
+ * The data page is read-only to user mode; the ELF image is read/exec.
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int32 vdso_map(struct mm_struct* mm) {
+	struct vm_area_struct *data, *text;
+
+	data = vm_area_setup(mm, VDSO_DATA_BASE, PAGE_SIZE, VMA_VDSO, PROT_READ, VM_USER | VM_IO);
+	if (!data) return -ENOMEM;
+	text = vm_area_setup(mm, VDSO_TEXT_BASE, PAGE_SIZE, VMA_VDSO, PROT_READ | PROT_EXEC, VM_USER | VM_IO);
+	if (!text) return -ENOMEM;
+
+	// 内核是恒等映射，虚拟地址就是物理地址
+	if (pgt_map_page(mm->pagetable, VDSO_DATA_BASE, (paddr_t)vdso_data, prot_to_type(PROT_READ, 1)) ||
+	    pgt_map_page(mm->pagetable, VDSO_TEXT_BASE, (paddr_t)vdso_start, prot_to_type(PROT_READ | PROT_EXEC, 1)))
+		return -ENOMEM;
+	return 0;
+}
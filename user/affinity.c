@@ -0,0 +1,165 @@
+/*
+ * sched_setaffinity()测试。
+ *
+ * 迁移：一个线程在hart 1和hart 2之间被来回改绑，它一直在转圈，用getcpu()
+ * 报告自己所在的hart。正在运行的任务被改绑后应该马上被核间中断赶走，
+ * 而不是等到下一次时钟中断；每次从改绑到它出现在新hart上的时间都应该
+ * 远小于一个tick。主线程绑在hart 0上，需要至少3个hart。
+ *
+ * 权限：另一个线程setuid()成普通用户，改绑主线程（root的）应该得到
+ * -EPERM，改绑自己应该成功。
+ *
+ * 用法：affinity [改绑次数]，需要root
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spawn.h"
+
+#define SYS_setuid 146
+#define SYS_sched_setaffinity 122
+#define SYS_sched_getaffinity 123
+#define SYS_getcpu 168
+#define SYS_gettid 178
+#define SYS_sched_tune 502
+
+#define EPERM 1
+#define TEST_UID 1000
+
+struct sched_tunables {
+	unsigned long timeslice;
+	unsigned long timer_interval;
+};
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static inline unsigned long rdtime(void) {
+	unsigned long t;
+	asm volatile("rdtime %0" : "=r"(t));
+	return t;
+}
+
+static long set_affinity(long tid, unsigned long mask) {
+	return raw_syscall(SYS_sched_setaffinity, tid, sizeof(mask), (long)&mask);
+}
+
+struct spinner {
+	struct spawn thread;
+	int where;  // 最近一次getcpu()的结果
+	int stop;
+};
+
+static void spinner_main(void *arg) {
+	struct spinner *s = arg;
+	unsigned cpu;
+
+	while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+		raw_syscall(SYS_getcpu, (long)&cpu, 0, 0);
+		__atomic_store_n(&s->where, (int)cpu, __ATOMIC_RELEASE);
+	}
+}
+
+struct unprivileged {
+	struct spawn thread;
+	long main_tid;
+	long setuid_ret;
+	long other_ret;  // 改绑主线程
+	long self_ret;   // 改绑自己
+};
+
+static void unprivileged_main(void *arg) {
+	struct unprivileged *u = arg;
+
+	u->setuid_ret = raw_syscall(SYS_setuid, TEST_UID, 0, 0);
+	u->other_ret = set_affinity(u->main_tid, 1);
+	u->self_ret = set_affinity(0, 1);
+}
+
+// 把spinner改绑到hart，返回它出现在那里用的time CSR tick数，超时返回-1
+static long move_to(struct spinner *s, int hart, unsigned long timeout) {
+	unsigned long start = rdtime(), now;
+
+	set_affinity(s->thread.tid, 1UL << hart);
+	while (__atomic_load_n(&s->where, __ATOMIC_ACQUIRE) != hart) {
+		now = rdtime();
+		if (now - start > timeout) return -1;
+	}
+	return rdtime() - start;
+}
+
+static int test_migration(int rounds, unsigned long tick) {
+	static struct spinner s = {.where = -1};
+	long worst = 0, lat;
+	int failed = 0;
+
+	if (set_affinity(0, 2) < 0 || spawn_thread(&s.thread, spinner_main, &s) < 0) {
+		printf("affinity: cannot start the spinner\n");
+		return 1;
+	}
+	set_affinity(0, 1);
+	// spinner继承了hart 1，先等它转起来
+	if (move_to(&s, 1, 10 * tick) < 0) failed = 1;
+	for (int i = 0; i < rounds && !failed; i++) {
+		lat = move_to(&s, i & 1 ? 1 : 2, 10 * tick);
+		if (lat < 0) {
+			printf("affinity: spinner did not reach hart %d within 10 ticks\n", i & 1 ? 1 : 2);
+			failed = 1;
+		} else if (lat > worst) {
+			worst = lat;
+		}
+	}
+	__atomic_store_n(&s.stop, 1, __ATOMIC_RELEASE);
+	spawn_join(&s.thread);
+
+	printf("migration: worst %ld ticks over %d moves, one timer tick is %lu\n", worst, rounds, tick);
+	// 不发核间中断时每次平均要等半个tick，这么多次都不超过1/4个tick几乎不可能
+	if (!failed && (unsigned long)worst > tick / 4) failed = 1;
+	return failed;
+}
+
+static int test_permission(void) {
+	static struct unprivileged u;
+	int failed = 0;
+
+	u.main_tid = raw_syscall(SYS_gettid, 0, 0, 0);
+	if (spawn_thread(&u.thread, unprivileged_main, &u) < 0) {
+		printf("affinity: cannot start the unprivileged thread\n");
+		return 1;
+	}
+	spawn_join(&u.thread);
+
+	printf("permission: setuid %ld, repin root's thread %ld, repin itself %ld\n", u.setuid_ret, u.other_ret,
+	       u.self_ret);
+	if (u.setuid_ret < 0 || u.other_ret != -EPERM || u.self_ret < 0) failed = 1;
+	return failed;
+}
+
+int main(int argc, char *argv[]) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	unsigned long online = 0;
+	struct sched_tunables t;
+	int failed;
+
+	raw_syscall(SYS_sched_getaffinity, 0, sizeof(online), (long)&online);
+	if ((online & 7) != 7) {
+		printf("affinity: needs harts 0-2 online, mask is 0x%lx\n", online);
+		return 1;
+	}
+	if (raw_syscall(SYS_sched_tune, 0, (long)&t, 0) < 0) {
+		printf("affinity: cannot read the timer interval\n");
+		return 1;
+	}
+
+	failed = test_migration(rounds, t.timer_interval);
+	failed |= test_permission();
+	set_affinity(0, online);
+	printf("affinity: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
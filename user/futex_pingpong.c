@@ -0,0 +1,125 @@
+/*
+ * 用户态之间的切换开销：两个线程轮流翻转一个共享的字，每次翻转后
+ * FUTEX_WAKE对方，自己FUTEX_WAIT等它翻回来。一个来回是两次
+ * 用户态->内核->另一个线程的用户态的切换。
+ *
+ * 先把两个线程都绑在hart 0上，每次交接都是同一个hart上的一次上下文
+ * 切换；再让它们分在两个hart上，交接变成跨hart的唤醒。
+ *
+ * 同一个hart上对方不可能和自己同时运行，每个来回至少有一方的FUTEX_WAIT
+ * 真的睡下去（返回0而不是-EAGAIN）；唤醒时抢占了对方的话只有一方睡。
+ * 两边睡下去的次数加起来少于来回次数的90%就算失败：那样测到的不是
+ * 上下文切换。
+ *
+ * 用法：futex_pingpong [来回次数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "spawn.h"
+
+#define SYS_futex 98
+#define SYS_sched_setaffinity 122
+
+#define FUTEX_WAIT_PRIVATE 128
+#define FUTEX_WAKE_PRIVATE 129
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x13 asm("a3") = 0;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x13), "r"(x17) : "memory");
+	return x10;
+}
+
+struct pingpong {
+	int turn;  // 0轮到主线程，1轮到对方
+	unsigned long rounds;
+	unsigned long mask;  // 对方线程绑定的hart
+	long set_ret;
+	unsigned long sleeps;  // 对方FUTEX_WAIT真正睡下去的次数
+};
+
+// 等turn变成want，再把它交给对方；返回FUTEX_WAIT睡下去的次数
+static unsigned long wait_turn(int *turn, int want) {
+	unsigned long sleeps = 0;
+	int v;
+
+	while ((v = __atomic_load_n(turn, __ATOMIC_ACQUIRE)) != want)
+		if (raw_syscall(SYS_futex, (long)turn, FUTEX_WAIT_PRIVATE, v) == 0) sleeps++;
+	return sleeps;
+}
+
+static void pass_turn(int *turn, int to) {
+	__atomic_store_n(turn, to, __ATOMIC_RELEASE);
+	raw_syscall(SYS_futex, (long)turn, FUTEX_WAKE_PRIVATE, 1);
+}
+
+static void partner(void *arg) {
+	struct pingpong *pp = arg;
+
+	pp->set_ret = raw_syscall(SYS_sched_setaffinity, 0, sizeof(pp->mask), (long)&pp->mask);
+	for (unsigned long i = 0; i < pp->rounds; i++) {
+		pp->sleeps += wait_turn(&pp->turn, 1);
+		pass_turn(&pp->turn, 0);
+	}
+}
+
+static long ns_between(const struct timespec *a, const struct timespec *b) {
+	return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+// 主线程在hart 0上，对方在mask指定的hart上；返回每个来回的纳秒数，*sleeps是两边一共睡下去的次数
+static long run(unsigned long rounds, unsigned long mask, unsigned long *sleeps) {
+	static struct pingpong pp;
+	struct spawn thread;
+	struct timespec start, end;
+	unsigned long self = 1, main_sleeps = 0;
+
+	raw_syscall(SYS_sched_setaffinity, 0, sizeof(self), (long)&self);
+	pp.turn = 0;
+	pp.rounds = rounds;
+	pp.mask = mask;
+	pp.sleeps = 0;
+	long tid = spawn_thread(&thread, partner, &pp);
+	if (tid < 0) {
+		printf("clone failed: %ld\n", tid);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned long i = 0; i < rounds; i++) {
+		pass_turn(&pp.turn, 1);
+		main_sleeps += wait_turn(&pp.turn, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	spawn_join(&thread);
+
+	if (pp.set_ret < 0) printf("futex_pingpong: sched_setaffinity(0x%lx) failed: %ld\n", mask, pp.set_ret);
+	*sleeps = main_sleeps + pp.sleeps;
+	return ns_between(&start, &end) / rounds;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+	unsigned long sleeps;
+	int failed;
+	long ns;
+
+	if (!rounds) rounds = 1;
+	ns = run(rounds, 1, &sleeps);
+	if (ns < 0) return 1;
+	printf("same hart: %ld ns per round trip, %ld ns per switch, %lu sleeps in %lu round trips\n", ns, ns / 2, sleeps,
+	       rounds);
+	failed = sleeps < rounds / 10 * 9;
+
+	ns = run(rounds, 2, &sleeps);
+	if (ns < 0) return 1;
+	printf("two harts: %ld ns per round trip, %ld ns per wakeup, %lu sleeps in %lu round trips\n", ns, ns / 2, sleeps,
+	       rounds);
+	printf("futex_pingpong: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
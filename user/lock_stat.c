@@ -0,0 +1,34 @@
+/*
+ * 打印内核各锁类的竞争统计，需要内核打开CONFIG_LOCK_STAT。
+ *
+ * 时间单位是time CSR的tick，qemu virt上是0.1微秒。
+ * 用法：lock_stat [-r]，-r表示读出后清零，方便只统计接下来的一段负载
+ */
+#include <stdio.h>
+#include <string.h>
+
+#define SYS_lock_stat 500
+#define LOCK_STAT_RESET 0x1
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static char buf[4096];
+
+int main(int argc, char *argv[]) {
+	int flags = (argc > 1 && !strcmp(argv[1], "-r")) ? LOCK_STAT_RESET : 0;
+	long n = raw_syscall(SYS_lock_stat, (long)buf, sizeof(buf), flags);
+
+	if (n < 0) {
+		printf("lock_stat: error %ld (kernel built without CONFIG_LOCK_STAT?)\n", n);
+		return 1;
+	}
+	fputs(buf, stdout);
+	return 0;
+}
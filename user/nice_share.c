@@ -0,0 +1,112 @@
+/*
+ * 公平调度测试：在同一个hart上跑几个nice值不同的CPU密集线程，
+ * 每个固定跑一段墙钟时间，记录自己完成的迭代数。迭代数占总数的比例
+ * 应接近权重占总权重的比例（权重表和kernel/sched/fair.c一致），
+ * 例如nice 0和nice 5约为1024:335，即大约3:1。
+ *
+ * 用法：nice_share [运行秒数] [nice值...]，默认nice_share 3 0 5
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spawn.h"
+
+#define SYS_sched_setaffinity 122
+#define SYS_setpriority 140
+#define SYS_getpriority 141
+#define PRIO_PROCESS 0
+
+#define TIMEBASE_FREQ 10000000UL  // qemu virt
+#define MAX_WORKERS 8
+#define TOLERANCE 5  // 实测比例和权重比例最多差几个百分点
+
+static const unsigned long prio_to_weight[40] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548,  7620,  6100,  4904,  3906,
+	/*  -5 */ 3121,  2501,  1991,  1586,  1277,
+	/*   0 */ 1024,  820,   655,   526,   423,
+	/*   5 */ 335,   272,   215,   172,   137,
+	/*  10 */ 110,   87,    70,    56,    45,
+	/*  15 */ 36,    29,    23,    18,    15,
+};
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static inline unsigned long rdtime(void) {
+	unsigned long t;
+	asm volatile("rdtime %0" : "=r"(t));
+	return t;
+}
+
+struct worker {
+	struct spawn thread;
+	int nice;      // 要设的nice值
+	long set_ret;  // setpriority的返回值
+	long got;      // getpriority读回来的nice值
+	unsigned long end;
+	unsigned long iters;
+};
+
+static void worker_main(void *arg) {
+	struct worker *w = arg;
+	unsigned long iters = 0;
+
+	w->set_ret = raw_syscall(SYS_setpriority, PRIO_PROCESS, 0, w->nice);
+	while (rdtime() < w->end) iters++;
+	w->got = 20 - raw_syscall(SYS_getpriority, PRIO_PROCESS, 0, 0);
+	w->iters = iters;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long seconds = argc > 1 ? strtoul(argv[1], NULL, 10) : 3;
+	int default_nice[] = {0, 5};
+	int nworkers = argc > 2 ? argc - 2 : 2;
+	unsigned long mask = 1;  // 都放在hart 0上，才会互相竞争
+	static struct worker workers[MAX_WORKERS];
+	unsigned long total_iters = 0, total_weight = 0;
+	int failed = 0;
+
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+	if (raw_syscall(SYS_sched_setaffinity, 0, sizeof(mask), (long)&mask) < 0)
+		printf("nice_share: sched_setaffinity failed, workers may run in parallel\n");
+
+	unsigned long end = rdtime() + seconds * TIMEBASE_FREQ;
+	for (int i = 0; i < nworkers; i++) {
+		workers[i].nice = argc > 2 ? atoi(argv[i + 2]) : default_nice[i];
+		if (workers[i].nice < -20) workers[i].nice = -20;
+		if (workers[i].nice > 19) workers[i].nice = 19;
+		workers[i].end = end;
+		long tid = spawn_thread(&workers[i].thread, worker_main, &workers[i]);
+		if (tid < 0) {
+			printf("clone failed: %ld\n", tid);
+			return 1;
+		}
+	}
+	for (int i = 0; i < nworkers; i++) {
+		spawn_join(&workers[i].thread);
+		total_iters += workers[i].iters;
+		total_weight += prio_to_weight[workers[i].nice + 20];
+	}
+	if (!total_iters) return 1;
+
+	for (int i = 0; i < nworkers; i++) {
+		struct worker *w = &workers[i];
+		long share = w->iters * 100 / total_iters;
+		long expected = prio_to_weight[w->nice + 20] * 100 / total_weight;
+
+		if (w->set_ret < 0) printf("worker %d: setpriority(%d) failed: %ld\n", i, w->nice, w->set_ret);
+		printf("worker %d: nice %ld, %lu iterations, %ld%% of the cpu (weight says %ld%%)\n", i, w->got,
+		       w->iters, share, expected);
+		if (w->set_ret < 0 || share - expected > TOLERANCE || expected - share > TOLERANCE) failed = 1;
+	}
+	printf("nice_share: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
@@ -0,0 +1,129 @@
+/*
+ * 路径拷贝开销：反复openat+close打开"/"，分别用短路径、约2000字节的长路径
+ * （"/././..."）和不存在的路径（只走getname和查找），取平均和最小值。
+ * 以前openat不管路径多长都从用户空间拷PATH_MAX字节，短路径和长路径的
+ * 耗时差不多；现在只拷到结束符，短路径应该明显更快。内核里还没有stat，
+ * 不存在的路径那一项就是查找本身的开销。
+ *
+ * 另外检查getname()的边界情况：起始地址不对齐、结束符正好在页的最后
+ * 一个字节、空路径和PATH_MAX长的路径。
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#define NLOOPS 10000
+#define NROUNDS 5
+
+#define AT_FDCWD -100
+#define O_RDONLY 0
+#define ENOENT 2
+#define ENAMETOOLONG 36
+#define PATH_MAX 4096
+#define PAGE_SIZE 4096
+#define LONG_PATH_LEN 2000
+
+static char long_path[LONG_PATH_LEN + 1];
+static char too_long[PATH_MAX + 1];
+static char pages[2][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static long ns_between(const struct timespec *a, const struct timespec *b) {
+	return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static long open_close(const char *path) {
+	long fd = raw_syscall(SYS_openat, AT_FDCWD, (long)path, O_RDONLY);
+	if (fd >= 0) raw_syscall(SYS_close, fd, 0, 0);
+	return fd;
+}
+
+// "/"后面接"./"直到len个字节，解析出来还是根目录
+static void fill_dots(char *buf, int len) {
+	buf[0] = '/';
+	for (int i = 1; i < len; i++) buf[i] = i & 1 ? '.' : '/';
+	buf[len] = '\0';
+}
+
+static void bench(const char *what, const char *path) {
+	struct timespec start, end;
+	long best = -1, total = 0;
+
+	for (int r = 0; r < NROUNDS; r++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < NLOOPS; i++) open_close(path);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		long ns = ns_between(&start, &end);
+		total += ns;
+		if (best < 0 || ns < best) best = ns;
+	}
+	printf("%-14s %4zu bytes: %ld ns per open average, %ld ns best round\n", what, strlen(path),
+	       total / (NROUNDS * NLOOPS), best / NLOOPS);
+}
+
+static int expect(const char *what, long got, int ok) {
+	printf("%s: %s (%ld)\n", ok ? "PASS" : "FAIL", what, got);
+	return !ok;
+}
+
+static int check_edges(void) {
+	char buf[32];
+	char *end = pages[0] + PAGE_SIZE;
+	long ret;
+	int bad = 0;
+
+	// 每个起始偏移都要能打开，字按对齐地址读，前后多读的字节不能算进路径
+	for (int off = 0; off < 8; off++) {
+		memset(buf, 'x', sizeof(buf));
+		fill_dots(buf + off, 9);
+		ret = open_close(buf + off);
+		if (ret < 0) {
+			printf("FAIL: path at offset %d: %ld\n", off, ret);
+			bad++;
+		}
+	}
+	if (!bad) printf("PASS: unaligned paths\n");
+
+	fill_dots(end - 8, 7);
+	ret = open_close(end - 8);
+	bad += expect("terminator on the last byte of a page", ret, ret >= 0);
+
+	ret = open_close("");
+	bad += expect("empty path", ret, ret == -ENOENT);
+
+	memset(too_long, '/', PATH_MAX);
+	ret = open_close(too_long);
+	bad += expect("PATH_MAX bytes without a terminator", ret, ret == -ENAMETOOLONG);
+
+	fill_dots(too_long, PATH_MAX - 1);
+	ret = open_close(too_long);
+	bad += expect("PATH_MAX - 1 bytes", ret, ret >= 0);
+	return bad;
+}
+
+int main(void) {
+	int bad;
+
+	fill_dots(long_path, LONG_PATH_LEN);
+	if (open_close("/") < 0 || open_close(long_path) < 0) {
+		printf("path_bench: cannot open /\n");
+		return 1;
+	}
+
+	bench("short", "/");
+	bench("long", long_path);
+	bench("missing", "/no-such-file");
+
+	bad = check_edges();
+	printf("%s: %d path copy checks failed\n", bad ? "FAIL" : "PASS", bad);
+	return bad != 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * 实时调度测试：在同一个hart上放一个普通的CPU密集线程和两个同优先级的
+ * 实时线程，各自在固定的墙钟时间内计数。
+ *
+ * SCHED_FIFO下第一个实时线程一直运行到时间结束，第二个几乎分不到时间；
+ * SCHED_RR下两者轮流运行，计数接近。普通线程只能在实时节流时运行，
+ * 计数约为单独运行时的5%。分得不对（FIFO下第二个超过MAX_FIFO_SHARE%，
+ * RR下少的一个不到MIN_RR_SHARE%，普通线程不在NORMAL_SHARE_MIN%到
+ * NORMAL_SHARE_MAX%之间）就算失败。
+ *
+ * yield：两个SCHED_RR线程，rt-a在队列里只有自己时sched_yield()一次，
+ * 再叫醒睡着的rt-b。让出把时间片清零，之后它必须重新拿到时间片，
+ * 否则时钟中断不再让它轮转，rt-b一直等到rt-a结束。两者计数应该接近。
+ *
+ * 用法：rt_sched [fifo|rr|yield] [运行秒数]，需要root
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spawn.h"
+
+#define SYS_futex 98
+#define SYS_sched_setscheduler 119
+#define SYS_sched_getscheduler 120
+#define SYS_sched_setaffinity 122
+#define SYS_sched_yield 124
+
+#define FUTEX_WAIT_PRIVATE 128
+#define FUTEX_WAKE_PRIVATE 129
+
+#define SCHED_NORMAL 0
+#define SCHED_FIFO 1
+#define SCHED_RR 2
+
+#define TIMEBASE_FREQ 10000000UL  // qemu virt
+#define MIN_SHARE 25  // yield：rt-b至少要分到这么多百分比
+#define MAX_FIFO_SHARE 5
+#define MIN_RR_SHARE 40
+#define NORMAL_SHARE_MIN 1
+#define NORMAL_SHARE_MAX 15
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x13 asm("a3") = 0;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x13), "r"(x17) : "memory");
+	return x10;
+}
+
+static inline unsigned long rdtime(void) {
+	unsigned long t;
+	asm volatile("rdtime %0" : "=r"(t));
+	return t;
+}
+
+static unsigned long spin_until(unsigned long end) {
+	unsigned long iters = 0;
+
+	while (rdtime() < end) iters++;
+	return iters;
+}
+
+struct worker {
+	struct spawn thread;
+	const char *name;
+	int policy;   // 要设的调度策略
+	long set_ret; // sched_setscheduler的返回值
+	long got;     // 结束时的调度策略
+	unsigned long end;
+	unsigned long iters;
+};
+
+static void worker_main(void *arg) {
+	struct worker *w = arg;
+	int prio = w->policy == SCHED_NORMAL ? 0 : 10;
+
+	// 线程继承了主线程创建时的SCHED_FIFO 20，普通线程也要降回来
+	w->set_ret = raw_syscall(SYS_sched_setscheduler, 0, w->policy, (long)&prio);
+	w->iters = spin_until(w->end);
+	w->got = raw_syscall(SYS_sched_getscheduler, 0, 0, 0);
+}
+
+struct yield_test {
+	struct spawn thread[2];
+	int b_ready;  // rt-b已经是SCHED_RR，马上要睡在go上
+	int go;
+	unsigned long end;
+	long set_ret[2];
+	unsigned long iters[2];
+};
+
+static void yield_b(void *arg) {
+	struct yield_test *t = arg;
+	int prio = 10;
+
+	t->set_ret[1] = raw_syscall(SYS_sched_setscheduler, 0, SCHED_RR, (long)&prio);
+	__atomic_store_n(&t->b_ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&t->go, __ATOMIC_ACQUIRE)) raw_syscall(SYS_futex, (long)&t->go, FUTEX_WAIT_PRIVATE, 0);
+	t->iters[1] = spin_until(t->end);
+}
+
+static void yield_a(void *arg) {
+	struct yield_test *t = arg;
+	int prio = 10;
+
+	t->set_ret[0] = raw_syscall(SYS_sched_setscheduler, 0, SCHED_RR, (long)&prio);
+	while (!__atomic_load_n(&t->b_ready, __ATOMIC_ACQUIRE)) raw_syscall(SYS_sched_yield, 0, 0, 0);
+	// rt-b睡在go上，主线程睡在join里，这次让出时队列里只有自己
+	raw_syscall(SYS_sched_yield, 0, 0, 0);
+	__atomic_store_n(&t->go, 1, __ATOMIC_RELEASE);
+	raw_syscall(SYS_futex, (long)&t->go, FUTEX_WAKE_PRIVATE, 1);
+	t->iters[0] = spin_until(t->end);
+}
+
+/*
+ * 主线程以SCHED_FIFO 20创建两个线程后睡在join里，不占就绪队列；
+ * 两个线程都降到SCHED_RR 10以后才开始比较。
+ */
+static int run_yield(unsigned long seconds) {
+	static struct yield_test t;
+	void (*fns[2])(void *) = {yield_a, yield_b};
+	unsigned long total, share;
+
+	t.end = rdtime() + seconds * TIMEBASE_FREQ;
+	for (int i = 0; i < 2; i++) {
+		long tid = spawn_thread(&t.thread[i], fns[i], &t);
+		if (tid < 0) {
+			printf("clone failed: %ld\n", tid);
+			return 1;
+		}
+	}
+	for (int i = 0; i < 2; i++) spawn_join(&t.thread[i]);
+
+	for (int i = 0; i < 2; i++)
+		if (t.set_ret[i] < 0) printf("rt-%c: sched_setscheduler failed: %ld\n", 'a' + i, t.set_ret[i]);
+	total = t.iters[0] + t.iters[1];
+	share = total ? t.iters[1] * 100 / total : 0;
+	printf("yield: rt-a %lu, rt-b %lu iterations, rt-b got %lu%%\n", t.iters[0], t.iters[1], share);
+	printf("rt_sched: %s\n", share >= MIN_SHARE ? "passed" : "FAILED");
+	return share < MIN_SHARE;
+}
+
+int main(int argc, char *argv[]) {
+	int policy = (argc > 1 && strcmp(argv[1], "fifo") == 0) ? SCHED_FIFO : SCHED_RR;
+	unsigned long seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 3;
+	unsigned long mask = 1;  // 都放在hart 0上，才会互相竞争
+	static struct worker workers[3] = {{.name = "normal"}, {.name = "rt-a"}, {.name = "rt-b"}};
+	int prio = 20, normal = 0;
+	unsigned long rt_total, rt_min, rt_share, all, normal_share;
+	int failed = 0;
+	long ret;
+
+	raw_syscall(SYS_sched_setaffinity, 0, sizeof(mask), (long)&mask);
+	// 创建worker期间主线程优先级比它们高，否则rt-a一开始运行主线程就要等节流才能创建rt-b
+	ret = raw_syscall(SYS_sched_setscheduler, 0, SCHED_FIFO, (long)&prio);
+	if (ret < 0) printf("rt_sched: sched_setscheduler failed: %ld\n", ret);
+
+	if (argc > 1 && strcmp(argv[1], "yield") == 0) {
+		failed = run_yield(seconds);
+		raw_syscall(SYS_sched_setscheduler, 0, SCHED_NORMAL, (long)&normal);
+		return failed;
+	}
+
+	unsigned long end = rdtime() + seconds * TIMEBASE_FREQ;
+	for (int i = 0; i < 3; i++) {
+		workers[i].policy = i > 0 ? policy : SCHED_NORMAL;
+		workers[i].end = end;
+		long tid = spawn_thread(&workers[i].thread, worker_main, &workers[i]);
+		if (tid < 0) {
+			printf("clone failed: %ld\n", tid);
+			return 1;
+		}
+	}
+	raw_syscall(SYS_sched_setscheduler, 0, SCHED_NORMAL, (long)&normal);
+
+	for (int i = 0; i < 3; i++) spawn_join(&workers[i].thread);
+	for (int i = 0; i < 3; i++) {
+		if (workers[i].set_ret < 0) printf("%s: sched_setscheduler failed: %ld\n", workers[i].name, workers[i].set_ret);
+		printf("%s: policy %ld, %lu iterations\n", workers[i].name, workers[i].got, workers[i].iters);
+		if (workers[i].got != workers[i].policy) failed = 1;
+	}
+
+	// 两个实时线程里分得少的那个占多少，以及普通线程占全部的多少
+	rt_total = workers[1].iters + workers[2].iters;
+	all = rt_total + workers[0].iters;
+	rt_min = workers[1].iters < workers[2].iters ? workers[1].iters : workers[2].iters;
+	rt_share = rt_total ? rt_min * 100 / rt_total : 0;
+	normal_share = all ? workers[0].iters * 100 / all : 0;
+	printf("%s: the smaller real-time thread got %lu%%, normal got %lu%%\n", policy == SCHED_FIFO ? "fifo" : "rr",
+	       rt_share, normal_share);
+	if (policy == SCHED_FIFO ? rt_share > MAX_FIFO_SHARE : rt_share < MIN_RR_SHARE) failed = 1;
+	if (normal_share < NORMAL_SHARE_MIN || normal_share > NORMAL_SHARE_MAX) failed = 1;
+	printf("rt_sched: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
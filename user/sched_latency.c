@@ -0,0 +1,99 @@
+/*
+ * 调度延迟测试：一个线程空转占满CPU，主线程在一段时间内反复读time CSR，
+ * 记录相邻两次读数之间的最大间隔，即主线程被挤出CPU的最长时间。
+ * 两个线程绑在同一个hart上。没有抢占时主线程要等空转线程自己让出CPU，
+ * 最大间隔会接近整个测试时长；有抢占时两个普通任务在一个调度周期
+ * （18ms）里各跑一半，切换只发生在时钟中断上，最大间隔不应超过
+ * 调度周期加两个时钟中断间隔。空转线程一次都没抢到CPU也算失败。
+ *
+ * 用法：sched_latency [测试秒数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spawn.h"
+
+#define SYS_sched_setaffinity 122
+#define SYS_sched_rr_get_interval 127
+#define SYS_sched_tune 502
+
+#define TIMEBASE_FREQ 10000000UL  // qemu virt
+#define FAIR_PERIOD (TIMEBASE_FREQ * 18 / 1000)  // 内核的sysctl_sched_latency
+
+struct kernel_timespec {
+	long tv_sec;
+	long tv_nsec;
+};
+
+struct sched_tunables {
+	unsigned long timeslice;
+	unsigned long timer_interval;
+};
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static inline unsigned long rdtime(void) {
+	unsigned long t;
+	asm volatile("rdtime %0" : "=r"(t));
+	return t;
+}
+
+static volatile unsigned long hog_end;
+
+// CPU hog：只跑用户态，不做系统调用，只能被时钟中断抢占
+static void hog(void *arg) {
+	while (rdtime() < hog_end)
+		;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long seconds = argc > 1 ? strtoul(argv[1], NULL, 10) : 2;
+	unsigned long duration = seconds * TIMEBASE_FREQ;
+	unsigned long mask = 1;  // 都放在hart 0上，才会互相竞争
+	struct kernel_timespec slice;
+	struct sched_tunables t;
+	struct spawn worker;
+	unsigned long limit;
+	int failed;
+
+	if (raw_syscall(SYS_sched_rr_get_interval, 0, (long)&slice, 0) == 0)
+		printf("time slice: %ld.%09ld s\n", slice.tv_sec, slice.tv_nsec);
+	if (raw_syscall(SYS_sched_tune, 0, (long)&t, 0) < 0) {
+		printf("sched_latency: cannot read the timer interval\n");
+		return 1;
+	}
+	limit = FAIR_PERIOD + 2 * t.timer_interval;
+	if (raw_syscall(SYS_sched_setaffinity, 0, sizeof(mask), (long)&mask) < 0)
+		printf("sched_latency: sched_setaffinity failed, the hog may run on another hart\n");
+
+	hog_end = rdtime() + duration + TIMEBASE_FREQ;
+	long tid = spawn_thread(&worker, hog, 0);
+	if (tid < 0) {
+		printf("clone failed: %ld\n", tid);
+		return 1;
+	}
+
+	unsigned long start = rdtime(), prev = start, now, gap, max_gap = 0;
+	unsigned long stalls = 0;
+	while ((now = rdtime()) - start < duration) {
+		gap = now - prev;
+		if (gap > max_gap) max_gap = gap;
+		if (gap > TIMEBASE_FREQ / 1000) stalls++;  // 超过1ms视为被抢占
+		prev = now;
+	}
+	spawn_join(&worker);
+
+	printf("sched_latency: %lu s with a cpu hog, %lu stalls > 1ms\n", seconds, stalls);
+	printf("max scheduling latency: %lu us, limit %lu us\n", max_gap / (TIMEBASE_FREQ / 1000000),
+	       limit / (TIMEBASE_FREQ / 1000000));
+	failed = !stalls || max_gap > limit;
+	printf("sched_latency: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
@@ -0,0 +1,44 @@
+/*
+ * 打印线程组的CPU时间、切换次数和调度延迟直方图。
+ *
+ * 时间单位是time CSR的tick，qemu virt上是0.1微秒。
+ * 用法：sched_stat [pid]，不给pid看自己，pid为-1看各hart的就绪队列
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/times.h>
+
+#define SYS_sched_stat 501
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static char buf[4096];
+
+int main(int argc, char *argv[]) {
+	long pid = argc > 1 ? atol(argv[1]) : 0;
+	long n = raw_syscall(SYS_sched_stat, pid, (long)buf, sizeof(buf));
+	struct rusage ru;
+	struct tms t;
+
+	if (n < 0) {
+		printf("sched_stat: error %ld\n", n);
+		return 1;
+	}
+	fputs(buf, stdout);
+
+	if (pid) return 0;
+	getrusage(RUSAGE_SELF, &ru);
+	times(&t);
+	printf("getrusage: utime %ld.%06lds stime %ld.%06lds nvcsw %ld nivcsw %ld\n", (long)ru.ru_utime.tv_sec,
+	       (long)ru.ru_utime.tv_usec, (long)ru.ru_stime.tv_sec, (long)ru.ru_stime.tv_usec, ru.ru_nvcsw, ru.ru_nivcsw);
+	printf("times: utime %ld stime %ld clock_t\n", (long)t.tms_utime, (long)t.tms_stime);
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * 查看和修改调度参数：SCHED_RR的时间片（时钟中断数）和时钟中断间隔
+ * （time CSR的tick，qemu virt上是0.1微秒）。
+ *
+ * 不带参数时只打印当前值。带参数时改成给定的值（0表示不改），再读回来
+ * 核对；自己临时切到SCHED_RR，确认sched_rr_get_interval()报告的时间片
+ * 等于时间片乘以时钟间隔。修改需要root。
+ *
+ * 用法：sched_tune [时间片 [时钟间隔]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SYS_sched_setscheduler 119
+#define SYS_sched_rr_get_interval 127
+#define SYS_sched_tune 502
+
+#define SCHED_NORMAL 0
+#define SCHED_RR 2
+
+#define TIMEBASE_FREQ 10000000UL  // qemu virt
+
+struct sched_tunables {
+	unsigned long timeslice;
+	unsigned long timer_interval;
+};
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static void print_tunables(const char *what, const struct sched_tunables *t) {
+	printf("%s: timeslice %lu ticks, timer interval %lu (%lu us), rr slice %lu us\n", what, t->timeslice,
+	       t->timer_interval, t->timer_interval * 1000000 / TIMEBASE_FREQ,
+	       t->timeslice * t->timer_interval * 1000000 / TIMEBASE_FREQ);
+}
+
+// 以SCHED_RR身份读sched_rr_get_interval()，换算成time CSR的tick
+static long rr_interval_ticks(void) {
+	struct timespec ts;
+	int prio = 1, normal = 0;
+	long ret;
+
+	ret = raw_syscall(SYS_sched_setscheduler, 0, SCHED_RR, (long)&prio);
+	if (ret < 0) return ret;
+	ret = raw_syscall(SYS_sched_rr_get_interval, 0, (long)&ts, 0);
+	raw_syscall(SYS_sched_setscheduler, 0, SCHED_NORMAL, (long)&normal);
+	if (ret < 0) return ret;
+	return ts.tv_sec * TIMEBASE_FREQ + ts.tv_nsec / (1000000000 / TIMEBASE_FREQ);
+}
+
+int main(int argc, char *argv[]) {
+	struct sched_tunables old, new, now;
+	long ret, rr;
+	int failed = 0;
+
+	ret = raw_syscall(SYS_sched_tune, 0, (long)&old, 0);
+	if (ret < 0) {
+		printf("sched_tune: error %ld\n", ret);
+		return 1;
+	}
+	print_tunables("current", &old);
+	if (argc < 2) return 0;
+
+	new.timeslice = strtoul(argv[1], NULL, 10);
+	new.timer_interval = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+	ret = raw_syscall(SYS_sched_tune, (long)&new, 0, 0);
+	if (ret < 0) {
+		printf("sched_tune: setting failed: %ld (-1 is EPERM, -22 EINVAL)\n", ret);
+		return 1;
+	}
+
+	raw_syscall(SYS_sched_tune, 0, (long)&now, 0);
+	print_tunables("now", &now);
+	if ((new.timeslice && now.timeslice != new.timeslice) ||
+	    (new.timer_interval && now.timer_interval != new.timer_interval)) {
+		printf("sched_tune: the kernel did not take the new values\n");
+		failed = 1;
+	}
+
+	rr = rr_interval_ticks();
+	if (rr < 0) {
+		printf("sched_tune: sched_rr_get_interval as SCHED_RR failed: %ld\n", rr);
+		failed = 1;
+	} else if ((unsigned long)rr != now.timeslice * now.timer_interval) {
+		printf("sched_tune: sched_rr_get_interval says %ld ticks, expected %lu\n", rr,
+		       now.timeslice * now.timer_interval);
+		failed = 1;
+	}
+	printf("sched_tune: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
@@ -0,0 +1,64 @@
+/*
+ * 定时器测试：nanosleep和clock_nanosleep(TIMER_ABSTIME)的误差，
+ * 以及setitimer(ITIMER_REAL)按周期送来SIGALRM。
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NSLEEPS 20
+#define SLEEP_NS 2000000L // 2ms，比一个tick短
+#define NALARMS 5
+
+static volatile int alarms;
+
+static long ns_between(const struct timespec *a, const struct timespec *b) {
+	return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+static void on_alarm(int sig) {
+	(void)sig;
+	alarms++;
+}
+
+int main(void) {
+	struct timespec req = {0, SLEEP_NS}, second = {1, 0}, start, end, deadline;
+	struct itimerval it = {{0, 10000}, {0, 10000}}, off = {{0, 0}, {0, 0}};
+	long late, worst = 0, total = 0;
+	int early = 0;
+
+	for (int i = 0; i < NSLEEPS; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		nanosleep(&req, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		late = ns_between(&start, &end) - SLEEP_NS;
+		if (late < 0) early++;
+		if (late > worst) worst = late;
+		total += late;
+	}
+	printf("nanosleep(2ms): avg late %ld us, worst %ld us, early %d\n", total / NSLEEPS / 1000, worst / 1000, early);
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += 50000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	late = ns_between(&deadline, &end);
+	printf("clock_nanosleep(ABSTIME): late %ld us%s\n", late / 1000, late < 0 ? " (EARLY)" : "");
+
+	signal(SIGALRM, on_alarm);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	setitimer(ITIMER_REAL, &it, NULL);
+	// SIGALRM打断睡眠
+	while (alarms < NALARMS) nanosleep(&second, NULL);
+	setitimer(ITIMER_REAL, &off, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("setitimer(10ms): %d alarms in %ld ms\n", alarms, ns_between(&start, &end) / 1000000);
+
+	return early || late < 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * 多核扩展性测试：起N个CPU密集的线程，每个做同样多的计算，记录各自的
+ * 完成时间。N从1增加到给定的最大值，每轮报告墙钟时间。理想情况下在4个
+ * hart上墙钟时间保持不变，直到worker数超过hart数才开始线性增长。
+ * worker数不超过可用hart数时，墙钟时间超过单个worker的MAX_SLOWDOWN%
+ * 就算失败：说明有worker挤在同一个hart上，没有被分散或偷走。
+ *
+ * 用法：smp_scale [最多worker数] [每个worker的迭代次数]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spawn.h"
+
+#define SYS_sched_getaffinity 123
+
+#define TIMEBASE_FREQ 10000000UL  // qemu virt
+#define MAX_WORKERS 16
+#define MAX_SLOWDOWN 150
+
+static inline long raw_syscall(long n, long a0, long a1, long a2) {
+	register long x10 asm("a0") = a0;
+	register long x11 asm("a1") = a1;
+	register long x12 asm("a2") = a2;
+	register long x17 asm("a7") = n;
+	asm volatile("ecall" : "+r"(x10) : "r"(x11), "r"(x12), "r"(x17) : "memory");
+	return x10;
+}
+
+static inline unsigned long rdtime(void) {
+	unsigned long t;
+	asm volatile("rdtime %0" : "=r"(t));
+	return t;
+}
+
+static unsigned long work(unsigned long iters) {
+	unsigned long x = 88172645463325252UL;
+	for (unsigned long i = 0; i < iters; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+	}
+	return x;
+}
+
+struct worker {
+	struct spawn thread;
+	unsigned long iters;
+	unsigned long done;  // 完成时刻，time CSR
+	unsigned long result;
+};
+
+static void worker_main(void *arg) {
+	struct worker *w = arg;
+
+	w->result = work(w->iters);
+	w->done = rdtime();
+}
+
+int main(int argc, char *argv[]) {
+	int max_workers = argc > 1 ? atoi(argv[1]) : 4;
+	unsigned long iters = argc > 2 ? strtoul(argv[2], NULL, 10) : 50000000UL;
+	static struct worker workers[MAX_WORKERS];
+	unsigned long mask = 0, base = 0;
+	int harts, failed = 0;
+
+	if (max_workers < 1 || max_workers > MAX_WORKERS) max_workers = 4;
+	if (raw_syscall(SYS_sched_getaffinity, 0, sizeof(mask), (long)&mask) > 0)
+		printf("smp_scale: up to %d workers, %lu iterations each, cpu mask 0x%lx\n", max_workers, iters,
+		       mask);
+	harts = __builtin_popcountl(mask);
+
+	for (int n = 1; n <= max_workers; n++) {
+		unsigned long start = rdtime(), wall = 0;
+
+		for (int i = 0; i < n; i++) {
+			workers[i].iters = iters;
+			long tid = spawn_thread(&workers[i].thread, worker_main, &workers[i]);
+			if (tid < 0) {
+				printf("clone failed: %ld\n", tid);
+				return 1;
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			spawn_join(&workers[i].thread);
+			if (workers[i].done - start > wall) wall = workers[i].done - start;
+		}
+
+		wall /= TIMEBASE_FREQ / 1000;
+		if (n == 1) base = wall;
+		printf("%d workers: %lu ms", n, wall);
+		for (int i = 0; i < n; i++)
+			printf(" %lu", (workers[i].done - start) / (TIMEBASE_FREQ / 1000));
+		printf(" (%lu.%02lux of one worker)\n", base ? wall / base : 0, base ? wall * 100 / base % 100 : 0);
+		if (n <= harts && wall * 100 > base * MAX_SLOWDOWN) {
+			printf("smp_scale: %d workers on %d harts should not take longer than one\n", n, harts);
+			failed = 1;
+		}
+	}
+	printf("smp_scale: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}
@@ -0,0 +1,108 @@
+/*
+ * 测试程序共用的线程创建和等待。
+ *
+ * 内核还不能复制地址空间，不带CLONE_VM的fork会返回-ENOSYS，所以worker都是
+ * 和调用者共用地址空间的线程：CLONE_VM|CLONE_THREAD等，栈用mmap单独分配。
+ * 内核在clone返回前把tid写进spawn.tid（CLONE_PARENT_SETTID），线程退出时
+ * 清零并做futex唤醒（CLONE_CHILD_CLEARTID），spawn_join()就睡在上面。
+ *
+ * worker直接用clone出来的线程，没有经过libc，tp还是主线程的：
+ * worker里只做系统调用和计算，不要调用printf这类要用TLS或加锁的函数，
+ * 结果写到共享的变量里，join以后由主线程打印。
+ */
+#ifndef _USER_SPAWN_H_
+#define _USER_SPAWN_H_
+
+#include <sys/mman.h>
+
+#define SPAWN_SYS_exit 93
+#define SPAWN_SYS_futex 98
+#define SPAWN_SYS_clone 220
+
+#define SPAWN_CLONE_VM 0x00000100
+#define SPAWN_CLONE_FS 0x00000200
+#define SPAWN_CLONE_FILES 0x00000400
+#define SPAWN_CLONE_SIGHAND 0x00000800
+#define SPAWN_CLONE_THREAD 0x00010000
+#define SPAWN_CLONE_SYSVSEM 0x00040000
+#define SPAWN_CLONE_PARENT_SETTID 0x00100000
+#define SPAWN_CLONE_CHILD_CLEARTID 0x00200000
+#define SPAWN_FUTEX_WAIT 0
+
+#define SPAWN_STACK_SIZE (64 * 1024)
+
+struct spawn {
+	volatile int tid;  // 线程运行期间是它的tid，退出后为0
+	void *stack;
+};
+
+/*
+ * 在新栈上clone一个线程。栈顶放着fn和arg，子线程从ecall返回时sp已经是
+ * 新栈，不能再回到调用者的C代码里，直接在这段汇编里调用fn然后exit。
+ */
+static inline long __spawn_clone(unsigned long flags, unsigned long *sp, volatile int *tid) {
+	register long a0 asm("a0") = flags;
+	register long a1 asm("a1") = (long)sp;
+	register long a2 asm("a2") = (long)tid;
+	register long a3 asm("a3") = 0;
+	register long a4 asm("a4") = (long)tid;
+	register long a7 asm("a7") = SPAWN_SYS_clone;
+	asm volatile(
+	    "ecall\n"
+	    "bnez a0, 1f\n"
+	    "ld a1, 0(sp)\n"
+	    "ld a0, 8(sp)\n"
+	    "jalr a1\n"
+	    "li a0, 0\n"
+	    "li a7, %[sys_exit]\n"
+	    "ecall\n"
+	    "1:\n"
+	    : "+r"(a0)
+	    : "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a7), [sys_exit] "i"(SPAWN_SYS_exit)
+	    : "memory");
+	return a0;
+}
+
+/*
+ * 创建一个运行fn(arg)的线程，成功返回tid，失败返回负的errno。
+ */
+static inline long spawn_thread(struct spawn *t, void (*fn)(void *), void *arg) {
+	unsigned long flags = SPAWN_CLONE_VM | SPAWN_CLONE_FS | SPAWN_CLONE_FILES | SPAWN_CLONE_SIGHAND |
+	                      SPAWN_CLONE_THREAD | SPAWN_CLONE_SYSVSEM | SPAWN_CLONE_PARENT_SETTID |
+	                      SPAWN_CLONE_CHILD_CLEARTID;
+	unsigned long *sp;
+	long ret;
+
+	t->stack = mmap(0, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (t->stack == MAP_FAILED) return -12;  // ENOMEM
+	sp = (unsigned long *)((char *)t->stack + SPAWN_STACK_SIZE) - 2;
+	sp[0] = (unsigned long)fn;
+	sp[1] = (unsigned long)arg;
+
+	ret = __spawn_clone(flags, sp, &t->tid);
+	if (ret < 0) {
+		munmap(t->stack, SPAWN_STACK_SIZE);
+		t->stack = 0;
+	}
+	return ret;
+}
+
+/*
+ * 等线程退出，然后放掉它的栈。
+ */
+static inline void spawn_join(struct spawn *t) {
+	int tid;
+
+	while ((tid = t->tid) != 0) {
+		register long a0 asm("a0") = (long)&t->tid;
+		register long a1 asm("a1") = SPAWN_FUTEX_WAIT;
+		register long a2 asm("a2") = tid;
+		register long a3 asm("a3") = 0;
+		register long a7 asm("a7") = SPAWN_SYS_futex;
+		asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(a7) : "memory");
+	}
+	if (t->stack) munmap(t->stack, SPAWN_STACK_SIZE);
+	t->stack = 0;
+}
+
+#endif
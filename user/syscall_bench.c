@@ -0,0 +1,76 @@
+/*
+ * 空系统调用的往返开销：反复ecall调用getppid，取平均和最小值。
+ * 内核打开CONFIG_NO_FAST_SYSCALL_RETURN编译一次可以得到没有快速返回时的数字。
+ *
+ * 另外检查系统调用前后除a0以外的寄存器不变，快速返回只重新装入一部分寄存器，
+ * tp在内核里被换成了hart号，也要换回来。
+ */
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#define NLOOPS 100000
+#define NROUNDS 10
+
+static long ns_between(const struct timespec *a, const struct timespec *b) {
+	return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+static inline long null_syscall(void) {
+	register long a0 asm("a0");
+	register long a7 asm("a7") = SYS_getppid;
+	asm volatile("ecall" : "=r"(a0) : "r"(a7) : "memory");
+	return a0;
+}
+
+// s0-s11、a1-a7和tp在ecall前后应当不变（内核里tp是hart号）；返回变了的寄存器个数
+static int check_registers(void) {
+	long before[20], after[20];
+	int bad = 0;
+
+	asm volatile(
+	    "li s0, 0x100\n li s1, 0x101\n li s2, 0x102\n li s3, 0x103\n li s4, 0x104\n li s5, 0x105\n"
+	    "li s6, 0x106\n li s7, 0x107\n li s8, 0x108\n li s9, 0x109\n li s10, 0x10a\n li s11, 0x10b\n"
+	    "li a1, 0x201\n li a2, 0x202\n li a3, 0x203\n li a4, 0x204\n li a5, 0x205\n li a6, 0x206\n"
+	    "li a7, %2\n"
+	    "sd s0, 0(%0)\n sd s1, 8(%0)\n sd s2, 16(%0)\n sd s3, 24(%0)\n sd s4, 32(%0)\n sd s5, 40(%0)\n"
+	    "sd s6, 48(%0)\n sd s7, 56(%0)\n sd s8, 64(%0)\n sd s9, 72(%0)\n sd s10, 80(%0)\n sd s11, 88(%0)\n"
+	    "sd a1, 96(%0)\n sd a2, 104(%0)\n sd a3, 112(%0)\n sd a4, 120(%0)\n sd a5, 128(%0)\n sd a6, 136(%0)\n"
+	    "sd a7, 144(%0)\n sd tp, 152(%0)\n"
+	    "ecall\n"
+	    "sd s0, 0(%1)\n sd s1, 8(%1)\n sd s2, 16(%1)\n sd s3, 24(%1)\n sd s4, 32(%1)\n sd s5, 40(%1)\n"
+	    "sd s6, 48(%1)\n sd s7, 56(%1)\n sd s8, 64(%1)\n sd s9, 72(%1)\n sd s10, 80(%1)\n sd s11, 88(%1)\n"
+	    "sd a1, 96(%1)\n sd a2, 104(%1)\n sd a3, 112(%1)\n sd a4, 120(%1)\n sd a5, 128(%1)\n sd a6, 136(%1)\n"
+	    "sd a7, 144(%1)\n sd tp, 152(%1)\n"
+	    :
+	    : "r"(before), "r"(after), "i"(SYS_getppid)
+	    : "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "a0", "a1", "a2", "a3", "a4",
+	      "a5", "a6", "a7", "memory");
+	for (int i = 0; i < 20; i++) {
+		if (before[i] != after[i]) {
+			printf("register %d changed: %lx -> %lx\n", i, before[i], after[i]);
+			bad++;
+		}
+	}
+	return bad;
+}
+
+int main(void) {
+	struct timespec start, end;
+	long best = -1, total = 0;
+	int bad;
+
+	for (int r = 0; r < NROUNDS; r++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < NLOOPS; i++) null_syscall();
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		long ns = ns_between(&start, &end);
+		total += ns;
+		if (best < 0 || ns < best) best = ns;
+	}
+	printf("getppid: %ld ns per call average, %ld ns best round\n", total / (NROUNDS * NLOOPS), best / NLOOPS);
+
+	bad = check_registers();
+	printf("%s: %d registers changed across ecall\n", bad ? "FAIL" : "PASS", bad);
+	return bad != 0;
+}
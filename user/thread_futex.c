@@ -0,0 +1,65 @@
+/*
+ * 线程和futex测试：几个线程在pthread_mutex上争同一个计数器，再用
+ * 条件变量一个接一个地传递令牌，最后逐个join。
+ *
+ * 有竞争的加锁在futex里睡眠而不是自旋，join靠CLONE_CHILD_CLEARTID
+ * 退出时的futex唤醒。线程栈用静态数组，不依赖mprotect。
+ */
+#include <pthread.h>
+#include <stdio.h>
+
+#define NTHREADS 4
+#define NLOOPS 10000
+#define STACK_SIZE 16384
+
+static char stacks[NTHREADS][STACK_SIZE] __attribute__((aligned(16)));
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static long counter;
+static int turn;
+
+static void *worker(void *arg) {
+	int id = (int)(long)arg;
+
+	for (int i = 0; i < NLOOPS; i++) {
+		pthread_mutex_lock(&lock);
+		counter++;
+		pthread_mutex_unlock(&lock);
+	}
+
+	// 按编号顺序轮流拿令牌
+	pthread_mutex_lock(&lock);
+	while (turn != id) pthread_cond_wait(&cond, &lock);
+	printf("thread %d: got the token\n", id);
+	turn++;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+	return (void *)(long)(id * 10);
+}
+
+int main(void) {
+	pthread_t tids[NTHREADS];
+	pthread_attr_t attr;
+	int failed = 0;
+
+	for (int i = 0; i < NTHREADS; i++) {
+		pthread_attr_init(&attr);
+		pthread_attr_setstack(&attr, stacks[i], STACK_SIZE);
+		if (pthread_create(&tids[i], &attr, worker, (void *)(long)i)) {
+			printf("thread_futex: pthread_create %d failed\n", i);
+			return 1;
+		}
+		pthread_attr_destroy(&attr);
+	}
+	for (int i = 0; i < NTHREADS; i++) {
+		void *ret;
+		pthread_join(tids[i], &ret);
+		if ((long)ret != i * 10) failed = 1;
+	}
+
+	printf("counter = %ld (expected %d)\n", counter, NTHREADS * NLOOPS);
+	if (counter != NTHREADS * NLOOPS) failed = 1;
+	printf("thread_futex: %s\n", failed ? "FAILED" : "passed");
+	return failed;
+}